@@ -0,0 +1,44 @@
+# - Check for the presence of ZSTD
+#
+# The following variables are set when ZSTD is found:
+#  HAVE_ZSTD       = Set to true, if all components of ZSTD
+#                          have been found.
+#  ZSTD_INCLUDES   = Include path for the header files of ZSTD
+#  ZSTD_LIBRARIES  = Link these to use ZSTD
+## Check for the header files
+
+find_path (ZSTD_INCLUDES zstd.h
+  PATHS /usr/local/include /usr/include /include /sw/include ${CMAKE_EXTRA_INCLUDES}
+  )
+
+## -----------------------------------------------------------------------------
+## Check for the library
+
+find_library (ZSTD_LIBRARIES NAMES zstd
+  PATHS /usr/local/lib /usr/lib /lib /sw/lib ${CMAKE_EXTRA_LIBRARIES}
+  )
+
+## -----------------------------------------------------------------------------
+## Actions taken when all components have been found
+
+if (ZSTD_INCLUDES AND ZSTD_LIBRARIES)
+  set (HAVE_ZSTD TRUE)
+  if (NOT ZSTD_FIND_QUIETLY)
+    message (STATUS "Found components for ZSTD")
+    message (STATUS "ZSTD_INCLUDES = ${ZSTD_INCLUDES}")
+    message (STATUS "ZSTD_LIBRARIES = ${ZSTD_LIBRARIES}")
+  endif (NOT ZSTD_FIND_QUIETLY)
+else (ZSTD_INCLUDES AND ZSTD_LIBRARIES)
+  if (NOT ZSTD_FIND_QUIETLY)
+    message (STATUS "Unable to find ZSTD, reading zstd compressed input is disabled")
+  endif (NOT ZSTD_FIND_QUIETLY)
+  if (ZSTD_FIND_REQUIRED)
+    message (FATAL_ERROR "Could not find ZSTD!")
+  endif (ZSTD_FIND_REQUIRED)
+endif (ZSTD_INCLUDES AND ZSTD_LIBRARIES)
+
+mark_as_advanced (
+  HAVE_ZSTD
+  ZSTD_LIBRARIES
+  ZSTD_INCLUDES
+  )
@@ -1,4 +1,5 @@
 #include "Infomap-igraph-interface.h"
+#include <vector>
 
 namespace infomap
 {
@@ -6,25 +7,28 @@ void igraphToInfomapNetwork(Network& network, const igraph_t* graph,
                             const igraph_vector_t *e_weights, const igraph_vector_t *v_weights)
 {
     unsigned int numNodes = static_cast<unsigned int>(igraph_vcount(graph));
-    unsigned int numLinks = static_cast<unsigned int>(igraph_ecount(graph));
+    int numLinks = static_cast<int>(igraph_ecount(graph));
 
-    double linkWeight = 1.0;
-    igraph_integer_t from, to;
+    // All sources followed by all targets, in edge id order
+    igraph_vector_t edges;
+    igraph_vector_init(&edges, 0);
+    igraph_get_edgelist(graph, &edges, 1);
 
-    for (unsigned int i = 0; i < numLinks; ++i)
+    std::vector<unsigned int> sources(numLinks);
+    std::vector<unsigned int> targets(numLinks);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < numLinks; ++i)
     {
-        igraph_edge(graph, i, &from, &to);
-        linkWeight = e_weights ? (double)VECTOR(*e_weights)[i] : 1.0;
+        sources[i] = static_cast<unsigned int>(VECTOR(edges)[i]);
+        targets[i] = static_cast<unsigned int>(VECTOR(edges)[numLinks + i]);
+    }
+    igraph_vector_destroy(&edges);
 
-        network.addLink(static_cast<unsigned int>(from), static_cast<unsigned int>(to), linkWeight);
+    network.addLinks(sources.data(), targets.data(), e_weights ? VECTOR(*e_weights) : NULL, numLinks);
+
+    if (v_weights)
+        network.setNodeWeights(VECTOR(*v_weights), numNodes);
 
-        double nodeWeight = 1.0;
-        if (v_weights) {
-            for (unsigned int i = 0; i < numNodes; ++i) {
-                nodeWeight = (double)VECTOR(*v_weights)[i];
-            }
-        }
-    }
     network.finalizeAndCheckNetwork(true, numNodes);
 }
 }
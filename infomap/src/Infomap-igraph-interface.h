@@ -11,7 +11,8 @@ namespace infomap
 	* e_weights: Numeric vector giving the weights of the edges. If it is a NULL pointer then all edges
 	* will have equal weights. The weights are expected to be positive.
 	* v_weights: Numeric vector giving the weights of the vertices. If it is a NULL pointer then all
-	* vertices will have equal weights. The weights are expected to be positive.
+	* vertices will have equal weights. The weights are expected to be positive and are used as
+	* teleportation weights when teleporting to nodes.
 	*/
         void igraphToInfomapNetwork(Network& network, const igraph_t* graph,
 		const igraph_vector_t *e_weights = NULL, const igraph_vector_t *v_weights = NULL);
@@ -34,6 +34,7 @@
 #include "utils/Logger.h"
 #include "utils/Stopwatch.h"
 #include "io/ProgramInterface.h"
+#include "io/CompressedFile.h"
 #include "io/convert.h"
 #include "utils/FileURI.h"
 #include "utils/Date.h"
@@ -44,8 +45,75 @@ namespace infomap
 {
 #endif
 
+/**
+ * Run once per teleportation setting in the comma-separated sweep, such as
+ * "0.05,0.15n,0.15l", where an optional 'n' or 'l' teleports to nodes or links.
+ * The network is parsed once and the flow for all runs calculated together.
+ */
+void runTeleportationSweep(Config const& config)
+{
+	if (config.isMemoryNetwork())
+		throw InputDomainError("The teleportation sweep is not supported for memory networks.");
+
+	std::vector<Config> configs;
+	std::vector<std::string> settings;
+	std::istringstream sweep(config.teleportationSweep);
+	std::string setting;
+	while (std::getline(sweep, setting, ','))
+	{
+		if (setting.empty())
+			continue;
+		Config conf(config);
+		conf.teleportationSweep = "";
+		char* end = 0;
+		conf.teleportationProbability = std::strtod(setting.c_str(), &end);
+		std::string target(end);
+		if (target == "n")
+			conf.teleportToNodes = true;
+		else if (target == "l")
+			conf.teleportToNodes = false;
+		else if (!target.empty() || end == setting.c_str())
+			throw InputDomainError(io::Str() << "Can't parse teleportation setting '" << setting << "'.");
+		if (conf.teleportationProbability < 0.0 || conf.teleportationProbability > 1.0)
+			throw InputDomainError(io::Str() << "Teleportation probability " << setting << " is out of range [0, 1].");
+		conf.outName = io::Str() << config.outName << "_p" << setting;
+		configs.push_back(conf);
+		settings.push_back(setting);
+	}
+	if (configs.empty())
+		throw InputDomainError("No teleportation settings to sweep.");
+
+	Network network(config);
+	network.readInputData();
+	if (!network.isFinalized()) {
+		Log() << "Finalizing network...\n";
+		network.finalizeAndCheckNetwork();
+	}
+	network.initNodeNames();
+
+	std::vector<FlowNetwork> flowNetworks;
+	FlowNetwork::calculateFlows(network, configs, flowNetworks);
+	network.disposeLinks();
+
+	for (unsigned int i = 0; i < configs.size(); ++i)
+	{
+		Log() << "\n=======================================================\n";
+		Log() << "  Run " << i + 1 << "/" << configs.size() << " with teleportation " << settings[i] << "\n";
+		Log() << "=======================================================\n";
+		InfomapContext context(configs[i]);
+		context.getInfomap()->run(network, flowNetworks[i]);
+		flowNetworks[i] = FlowNetwork();
+	}
+}
+
 void runInfomap(Config const& config)
 {
+	if (!config.teleportationSweep.empty())
+	{
+		runTeleportationSweep(config);
+		return;
+	}
+
 	InfomapContext context(config);
 	context.getInfomap()->run();
 }
@@ -97,7 +165,7 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 			"Use non-backtracking dynamics and let nodes be part of different and overlapping modules. Applies to ordinary networks by first representing the non-backtracking dynamics with memory nodes.", true);
 
 	api.addOptionArgument(conf.parseWithoutIOStreams, "without-iostream",
-			"Parse the input network data without the iostream library. Can be a bit faster, but not as robust.", true);
+			"Deprecated, has no effect. All input formats are now parsed from a memory-mapped file without the iostream library.", true);
 
 	api.addOptionArgument(conf.zeroBasedNodeNumbers, 'z', "zero-based-numbering",
 			"Assume node numbers start from zero in the input file instead of one.");
@@ -105,6 +173,9 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 	api.addOptionArgument(conf.includeSelfLinks, 'k', "include-self-links",
 			"Include links with the same source and target node. (Ignored by default.)");
 
+	api.addOptionArgument(conf.remapNodeIds, "remap-node-ids",
+			"Read the node numbers in a link list as arbitrary 64-bit ids and remap them to consecutive nodes. The ids are used in the output.", true);
+
 	api.addOptionArgument(conf.skipCompleteDanglingMemoryNodes, "skip-complete-dangling-memory-nodes",
 			"Skip add first order links to complete dangling memory nodes.");
 
@@ -117,6 +188,12 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 	api.addOptionArgument(conf.clusterDataFile, 'c', "cluster-data",
 			"Provide an initial two-level (.clu format) or multi-layer (.tree format) solution.", "p", true);
 
+	api.addOptionArgument(conf.flowStartFile, "flow-start",
+			"Start the power iteration for the flow from the node flow in a .rank file from --node-ranks, such as from a previous run on a similar network. Skips the minimum number of iterations.", "p", true);
+
+	api.addOptionArgument(conf.flowCacheDirectory, "flow-cache",
+			"Cache the calculated flow network in this directory, keyed by the input and the flow options, and load it from there on later runs instead of parsing the input and calculating the flow.", "p", true);
+
 	api.addOptionArgument(conf.noInfomap, "no-infomap",
 			"Don't run Infomap. Useful if initial cluster data should be preserved or non-modular data printed.", true);
 
@@ -158,6 +235,12 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 	api.addOptionArgument(conf.printStateNetwork, "print-state-network",
 			"Print the internal state network.", true);
 
+	api.addOptionArgument(conf.printBinaryNetwork, "bnet",
+			"Print the parsed network in a binary format that is loaded directly without parsing.", true);
+
+	api.addOptionArgument(conf.binaryFloatWeights, "bnet-float",
+			"Store the link weights in the binary network with single precision.", true);
+
 	api.addOptionArgument(conf.printExpanded, "expanded",
 			"Print the expanded network of memory nodes if possible.", true);
 
@@ -190,6 +273,21 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 	api.addOptionArgument(conf.teleportationProbability, 'p', "teleportation-probability",
 			"The probability of teleporting to a random node or link.", "f", true);
 
+	api.addOptionArgument(conf.teleportationSweep, "teleportation-sweep",
+			"Run once for each comma-separated teleportation probability, with the flow for all runs calculated together. Add 'n' or 'l' to a value to teleport to nodes or links in that run, as in 0.15n,0.15l. The output names get the suffix _p<value>.", "s", true);
+
+	api.addOptionArgument(conf.flowTolerance, "flow-tolerance",
+			"Stop the power iteration for the flow when the L1 difference between iterations is below this value.", "f", true);
+
+	api.addOptionArgument(conf.flowMinIterations, "flow-min-iterations",
+			"The minimum number of power iterations for the flow.", "n", true);
+
+	api.addOptionArgument(conf.flowMaxIterations, "flow-max-iterations",
+			"The maximum number of power iterations for the flow. Defaults to 200, or 300 for memory networks.", "n", true);
+
+	api.addOptionArgument(conf.flowExtrapolationInterval, "flow-extrapolation",
+			"Extrapolate the power iteration for the flow every n iterations, at least 2, where it converges geometrically. Typically saves 15-45% of the iterations. Off if zero.", "n", true);
+
 	api.addOptionArgument(conf.selfTeleportationProbability, 'y', "self-link-teleportation-probability",
 			"Additional probability of teleporting to itself. Effectively increasing the code rate, generating more and smaller modules.", "f", true);
 
@@ -255,7 +353,7 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 			"Prioritize memory efficient algorithms before fast. Use -ll to optimize even more, but this may give approximate results.", true);
 
 	api.addOptionArgument(conf.innerParallelization, "inner-parallelization",
-			"Parallelize the innermost loop for greater speed. Note that this may give some accuracy tradeoff.");
+			"Parallelize the innermost loop for greater speed. The result doesn't depend on the number of threads, but may differ from the serial loop.");
 
 	api.addOptionArgument(conf.resetConfigBeforeRecursion, "reset-options-before-recursion",
 			"Reset options tuning the speed and accuracy before the recursive part.", true);
@@ -294,6 +392,9 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 	}
 
 	// Some checks
+	if (conf.flowExtrapolationInterval == 1)
+		throw InputDomainError("The flow extrapolation interval must be zero or at least two, to have two power iterations to extrapolate from.");
+
 	if (*--conf.outDirectory.end() != '/')
 		conf.outDirectory.append("/");
 
@@ -302,7 +403,13 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& flags, bool
 				conf.outDirectory << "'. Check that the directory exists and that you have write permissions.");
 
 	if (conf.outName.empty())
-		conf.outName = FileURI(conf.networkFile).getName();
+	{
+		FileURI networkFilename(conf.networkFile);
+		conf.outName = networkFilename.getName();
+		// Strip the extension before the compression extension too, as in 'network.net.gz'
+		if (CompressedFile::isCompressedExtension(networkFilename.getExtension()))
+			conf.outName = FileURI(conf.outName).getName();
+	}
 
 	return api.getUsedOptionArguments();
 }
@@ -332,6 +439,8 @@ Config init(const std::string& flags)
 
 		Log() << "=======================================================\n";
 		Log() << "  Infomap v" << INFOMAP_VERSION << " starts at " << Date() << "\n";
+		if (*INFOMAP_BUILD_OPTIONS)
+			Log() << "  -> Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 		if (!parsedFlags.empty()) {
 			for (unsigned int i = 0; i < parsedFlags.size(); ++i)
 				Log() << (i == 0 ? "  -> Configuration: " : "                    ") << parsedFlags[i] << "\n";
@@ -380,6 +489,8 @@ int run(const std::string& flags)
 
 		Log() << "=======================================================\n";
 		Log() << "  Infomap v" << INFOMAP_VERSION << " starts at " << Date() << "\n";
+		if (*INFOMAP_BUILD_OPTIONS)
+			Log() << "  -> Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 		Log() << "  -> Input network: " << conf.networkFile << "\n";
 		Log() << "  -> Output path:   " << conf.outDirectory << "\n";
 		if (!parsedFlags.empty()) {
@@ -408,7 +519,7 @@ int run(const std::string& flags)
 		return EXIT_FAILURE;
 	}
 
-	ASSERT(NodeBase::nodeCount() == 0); //TODO: Not working with OpenMP
+	ASSERT(NodeBase::nodeCount() == 0);
 //	if (NodeBase::nodeCount() != 0)
 //		Log() << "Warning: " << NodeBase::nodeCount() << " nodes not deleted!\n";
 
@@ -65,6 +65,22 @@ class Infomap {
         return network.addLink(n1, n2, weight);
     }
 
+    link_index addLinks(const unsigned int* sources, const unsigned int* targets, const double* weights, std::size_t numLinks) {
+        return network.addLinks(sources, targets, weights, numLinks);
+    }
+
+    void setLinks(unsigned int numNodes, std::vector<link_index>& offsets, std::vector<unsigned int>& targets, std::vector<double>& weights) {
+        network.setLinks(numNodes, offsets, targets, weights);
+    }
+
+    link_index addLinksByIds(const uint64_t* sourceIds, const uint64_t* targetIds, const double* weights, std::size_t numLinks) {
+        return network.addLinksByIds(sourceIds, targetIds, weights, numLinks);
+    }
+
+    void setStartNodeFlow(const double* flow, unsigned int numNodes) {
+        network.setStartNodeFlow(flow, numNodes);
+    }
+
     int run() {
         try
         {
@@ -99,6 +115,10 @@ class MemInfomap {
         network.readInputData(filename);
     }
 
+    void setStartNodeFlow(const double* flow, unsigned int numNodes) {
+        network.setStartNodeFlow(flow, numNodes);
+    }
+
     bool addTrigram(unsigned int n1, unsigned int n2, unsigned int n3, double weight = 1.0){
         return network.addStateLink(n1, n2, n2, n3, weight);
     }
@@ -111,6 +131,16 @@ class MemInfomap {
         network.addMultiplexLink(layer1, node1, layer2, node2, weight);
     }
 
+    link_index addStateLinks(const unsigned int* n1PriorStates, const unsigned int* n1s,
+            const unsigned int* n2PriorStates, const unsigned int* n2s, const double* weights, std::size_t numLinks) {
+        return network.addStateLinks(n1PriorStates, n1s, n2PriorStates, n2s, weights, numLinks);
+    }
+
+    void addMultiplexLinks(const int* layer1, const int* node1, const int* layer2, const int* node2,
+            const double* weights, std::size_t numLinks) {
+        network.addMultiplexLinks(layer1, node1, layer2, node2, weights, numLinks);
+    }
+
     int run() {
         try
         {
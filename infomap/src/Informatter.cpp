@@ -36,6 +36,7 @@
 #include "infomap/InfomapContext.h"
 #include "utils/Stopwatch.h"
 #include "io/ProgramInterface.h"
+#include "io/CompressedFile.h"
 #include "io/convert.h"
 #include "utils/FileURI.h"
 #include "utils/Date.h"
@@ -47,6 +48,9 @@ namespace infomap
 {
 #endif
 
+namespace
+{
+
 std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 {
 	ProgramInterface api("Informatter", "Infomap formatter utility", INFOMAP_VERSION);
@@ -62,7 +66,13 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 		"  ./Informatter my_network.net output/ --pajek\n" <<
 		"\n" <<
 		"Convert a .tree file to a .bftree file with directed links by providing the source network:\n" <<
-		"  ./Informatter my_network.net -c my_network.tree -d --bftree\n");
+		"  ./Informatter my_network.net -c my_network.tree -d --bftree\n" <<
+		"\n" <<
+		"Convert a directed network to the binary network format, to be loaded without parsing:\n" <<
+		"  ./Informatter my_network.net output/ -d --bnet\n" <<
+		"\n" <<
+		"Convert trigrams to a binary state network, to be loaded with '-i states':\n" <<
+		"  ./Informatter my_network.txt output/ -i 3gram --bnet\n");
 
 
 	// --------------------- Input options ---------------------
@@ -73,7 +83,7 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 			"More network layers for multiplex.", true);
 
 	api.addOptionArgument(conf.inputFormat, 'i', "input-format",
-			"Specify input format ('pajek', 'link-list', '3gram' or 'multiplex') to override format possibly implied by file extension.", "s");
+			"Specify input format ('pajek', 'link-list', '3gram', 'states' or 'multiplex') to override format possibly implied by file extension.", "s");
 
 	api.addOptionArgument(conf.withMemory, "with-memory",
 			"Use second order Markov dynamics and let nodes be part of different modules. Simulate memory from first-order data if not '3gram' input.", true);
@@ -82,7 +92,7 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 			"Let nodes be part of different, and thus overlapping, modules. (Same as --with-memory for ordinary networks)");
 
 	api.addOptionArgument(conf.parseWithoutIOStreams, "without-iostream",
-			"Parse the input network data without the iostream library. Can be a bit faster, but not as robust.", true);
+			"Deprecated, has no effect. All input formats are now parsed from a memory-mapped file without the iostream library.", true);
 
 	api.addOptionArgument(conf.zeroBasedNodeNumbers, 'z', "zero-based-numbering",
 			"Assume node numbers start from zero in the input file instead of one.");
@@ -97,6 +107,9 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 			"Provide an initial two-level solution (.clu format).", "p");
 
 	// --------------------- Output options ---------------------
+	api.addOptionArgument(conf.outName, "out-name",
+			"Use this name for the output files, like [output_directory]/[out-name].bnet", "s");
+
 	api.addOptionArgument(conf.noFileOutput, '0', "no-file-output",
 			"Don't print any output to file.", true);
 
@@ -127,6 +140,12 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 	api.addOptionArgument(conf.printPajekNetwork, "pajek",
 			"Print the parsed network in Pajek format.");
 
+	api.addOptionArgument(conf.printBinaryNetwork, "bnet",
+			"Print the parsed network in a binary format that is loaded directly without parsing. Memory networks are printed as state networks.");
+
+	api.addOptionArgument(conf.binaryFloatWeights, "bnet-float",
+			"Store the link weights in the binary network with single precision.");
+
 	api.addOptionArgument(conf.printExpanded, "expanded",
 			"Print the expanded network of memory nodes if possible.");
 
@@ -196,6 +215,15 @@ std::vector<ParsedOption> getConfig(Config& conf, const std::string& args)
 		throw FileOpenError(io::Str() << "Can't write to directory '" <<
 				conf.outDirectory << "'. Check that the directory exists and that you have write permissions.");
 
+	if (conf.outName.empty())
+	{
+		FileURI networkFilename(conf.networkFile);
+		conf.outName = networkFilename.getName();
+		// Strip the extension before the compression extension too, as in 'network.net.gz'
+		if (CompressedFile::isCompressedExtension(networkFilename.getExtension()))
+			conf.outName = FileURI(conf.outName).getName();
+	}
+
 	return api.getUsedOptionArguments();
 }
 
@@ -252,15 +280,21 @@ int run(const std::string& args)
 	return 0;
 }
 
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
+
 int main(int argc, char* argv[])
 {
 	std::ostringstream args("");
 	for (int i = 1; i < argc; ++i)
 		args << argv[i] << (i + 1 == argc? "" : " ");
 
-	return run(args.str());
-}
-
 #ifdef NS_INFOMAP
-}
+	return infomap::run(args.str());
+#else
+	return run(args.str());
 #endif
+}
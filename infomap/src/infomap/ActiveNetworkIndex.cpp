@@ -0,0 +1,113 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+
+#include "ActiveNetworkIndex.h"
+#include "Node.h"
+#include <algorithm>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+void ActiveNetworkIndex::build(const std::vector<NodeBase*>& activeNetwork)
+{
+	unsigned int numNodes = activeNetwork.size();
+	m_offsets.resize(numNodes + 1);
+	m_inOffsets.resize(numNodes);
+	m_module.resize(numNodes);
+	m_dirty.resize(numNodes);
+
+	// Use the index on the nodes for the position in the active network while indexing
+	link_index maxNumLinks = 0;
+	for (unsigned int i = 0; i < numNodes; ++i)
+	{
+		NodeBase& node = *activeNetwork[i];
+		m_module[i] = node.index;
+		m_dirty[i] = node.dirty;
+		node.index = i;
+		maxNumLinks += node.degree();
+	}
+
+	m_links.resize(maxNumLinks);
+	link_index numLinks = 0;
+	m_maxDegree = 0;
+	for (unsigned int i = 0; i < numNodes; ++i)
+	{
+		NodeBase& node = *activeNetwork[i];
+		m_offsets[i] = numLinks;
+		for (NodeBase::edge_iterator edgeIt(node.begin_outEdge()), endIt(node.end_outEdge());
+				edgeIt != endIt; ++edgeIt)
+		{
+			NodeBase::EdgeType& edge = **edgeIt;
+			if (edge.isSelfPointing())
+				continue;
+			m_links[numLinks].node = edge.target.index;
+			m_links[numLinks].flow = edge.data.flow;
+			++numLinks;
+		}
+		m_inOffsets[i] = numLinks;
+		for (NodeBase::edge_iterator edgeIt(node.begin_inEdge()), endIt(node.end_inEdge());
+				edgeIt != endIt; ++edgeIt)
+		{
+			NodeBase::EdgeType& edge = **edgeIt;
+			if (edge.isSelfPointing())
+				continue;
+			m_links[numLinks].node = edge.source.index;
+			m_links[numLinks].flow = edge.data.flow;
+			++numLinks;
+		}
+		m_maxDegree = std::max(m_maxDegree, static_cast<unsigned int>(numLinks - m_offsets[i]));
+	}
+	m_offsets[numNodes] = numLinks;
+	m_links.resize(numLinks);
+
+	for (unsigned int i = 0; i < numNodes; ++i)
+		activeNetwork[i]->index = m_module[i];
+}
+
+void ActiveNetworkIndex::storeDirtyFlags(const std::vector<NodeBase*>& activeNetwork) const
+{
+	unsigned int numNodes = activeNetwork.size();
+	for (unsigned int i = 0; i < numNodes; ++i)
+		activeNetwork[i]->dirty = m_dirty[i] != 0;
+}
+
+void ActiveNetworkIndex::clear()
+{
+	std::vector<link_index>().swap(m_offsets);
+	std::vector<link_index>().swap(m_inOffsets);
+	std::vector<Link>().swap(m_links);
+	std::vector<unsigned int>().swap(m_module);
+	std::vector<unsigned char>().swap(m_dirty);
+	m_maxDegree = 0;
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
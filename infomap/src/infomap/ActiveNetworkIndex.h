@@ -0,0 +1,118 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+
+#ifndef ACTIVENETWORKINDEX_H_
+#define ACTIVENETWORKINDEX_H_
+#include <vector>
+#include "../utils/types.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+class NodeBase;
+
+/**
+ * A flat, index-based view of the active network for the core loop.
+ *
+ * The links of each node are stored in compressed sparse row format as
+ * (neighbour index, flow) pairs, with the out-links followed by the in-links
+ * in one contiguous row, both in the order of the edge lists of the node.
+ * Self-links are left out as they never contribute to a move. The module
+ * index and dirty flag of the nodes are kept in contiguous arrays, so that
+ * visiting the neighbours of a node doesn't touch the node objects.
+ */
+class ActiveNetworkIndex
+{
+public:
+	struct Link
+	{
+		unsigned int node;
+		edge_flow flow;
+	};
+
+	ActiveNetworkIndex() : m_maxDegree(0) {}
+
+	/**
+	 * Index the links of the active network and copy the current module
+	 * index and dirty flag of each node.
+	 * @note The links must only connect nodes within the active network.
+	 */
+	void build(const std::vector<NodeBase*>& activeNetwork);
+
+	/**
+	 * Copy the dirty flags back to the nodes of the active network.
+	 */
+	void storeDirtyFlags(const std::vector<NodeBase*>& activeNetwork) const;
+
+	unsigned int numNodes() const { return m_module.size(); }
+
+	/**
+	 * The maximum number of links in a row.
+	 */
+	unsigned int maxDegree() const { return m_maxDegree; }
+
+	const Link* beginOutLinks(unsigned int node) const { return m_links.data() + m_offsets[node]; }
+	const Link* endOutLinks(unsigned int node) const { return m_links.data() + m_inOffsets[node]; }
+	const Link* beginInLinks(unsigned int node) const { return m_links.data() + m_inOffsets[node]; }
+	const Link* endInLinks(unsigned int node) const { return m_links.data() + m_offsets[node + 1]; }
+
+	/**
+	 * Mark all neighbours of a node as dirty.
+	 */
+	void markNeighboursDirty(unsigned int node)
+	{
+		for (const Link* it(beginOutLinks(node)), *end(endInLinks(node)); it != end; ++it)
+			m_dirty[it->node] = 1;
+	}
+
+	unsigned int& module(unsigned int node) { return m_module[node]; }
+	unsigned int module(unsigned int node) const { return m_module[node]; }
+	bool dirty(unsigned int node) const { return m_dirty[node] != 0; }
+	void setDirty(unsigned int node, bool dirty) { m_dirty[node] = dirty; }
+
+	/**
+	 * Release all memory.
+	 */
+	void clear();
+
+private:
+	std::vector<link_index> m_offsets; // numNodes + 1 row offsets
+	std::vector<link_index> m_inOffsets; // Start of the in-links within each row
+	std::vector<Link> m_links;
+	std::vector<unsigned int> m_module;
+	std::vector<unsigned char> m_dirty;
+	unsigned int m_maxDegree;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* ACTIVENETWORKINDEX_H_ */
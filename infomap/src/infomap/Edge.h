@@ -29,15 +29,38 @@
 #define EDGE_H_
 
 #include <ostream>
+#include "../utils/types.h"
 
 #ifdef NS_INFOMAP
 namespace infomap
 {
 #endif
 
+/**
+ * The weight and flow of an edge. If built with INFOMAP_COMPACT_EDGES, only
+ * the flow is stored, in single precision, as the weight is not used after
+ * the flow is calculated.
+ */
 struct EdgeData
 {
 public:
+#ifdef INFOMAP_COMPACT_EDGES
+	EdgeData() :
+		flow(0.0)
+	{}
+
+	EdgeData(double weight) :
+		flow(weight)
+	{}
+
+	EdgeData(double weight, double flow) :
+		flow(flow)
+	{}
+
+	double getWeight() const { return flow; }
+
+	edge_flow flow;
+#else
 	EdgeData() :
 		weight(0.0),
 		flow(0.0)
@@ -53,8 +76,11 @@ public:
 		flow(flow)
 	{}
 
+	double getWeight() const { return weight; }
+
 	double weight;
-	double flow;
+	edge_flow flow;
+#endif
 };
 
 template <typename node_type>
@@ -28,47 +28,97 @@
 #include "FlowNetwork.h"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "../utils/Logger.h"
+#include "../io/convert.h"
 
 #ifdef NS_INFOMAP
 namespace infomap
 {
 #endif
 
-void FlowNetwork::calculateFlow(const Network& network, const Config& config)
+namespace
 {
-	Log() << "Calculating global flow... " << std::flush;
+	// Fixed chunks make the parallel sums independent of the number of threads
+	const unsigned int NODE_CHUNK_SIZE = 1 << 16;
+	const link_index LINK_CHUNK_SIZE = 1 << 20;
 
-	// Prepare data in sequence containers for fast access of individual elements
-	unsigned int numNodes = network.numNodes();
-	const std::vector<double>& nodeOutDegree = network.outDegree();
-	const std::vector<double>& sumLinkOutWeight = network.sumLinkOutWeight();
-	m_nodeFlow.assign(numNodes, 0.0);
-	m_nodeTeleportRates.assign(numNodes, 0.0);
+	unsigned int chunkEnd(int chunk, unsigned int size)
+	{
+		return static_cast<unsigned int>(std::min(static_cast<link_index>(chunk + 1) * NODE_CHUNK_SIZE,
+				static_cast<link_index>(size)));
+	}
 
-	const LinkMap& linkMap = network.linkMap();
-	unsigned int numLinks = network.numLinks();
-	m_flowLinks.resize(numLinks);
-	double totalLinkWeight = network.totalLinkWeight();
-	double sumUndirLinkWeight = 2 * totalLinkWeight - network.totalSelfLinkWeight();
-	unsigned int linkIndex = 0;
+	// Extrapolate only if the last two differences between iterates are this close to parallel
+	const double MIN_EXTRAPOLATION_COSINE_SQUARED = 0.99;
+	// Limit the extrapolation step for ratios close to one
+	const double MAX_EXTRAPOLATION_RATIO = 0.95;
+
+	/**
+	 * The step factor to extrapolate the power iteration from the last two
+	 * differences between iterates, d0 = x1 - x0 and d1 = x2 - x1, or zero to
+	 * not extrapolate.
+	 *
+	 * If the error is dominated by one eigenvector, it shrinks by the same ratio
+	 * r each iteration, d1 = r d0, and the limit is x2 + r / (1 - r) d1. The
+	 * ratio is estimated by projecting d1 on d0, and only used when the
+	 * differences are close to parallel, as otherwise the residuals are not
+	 * shrinking geometrically and the step would move away from the limit.
+	 */
+	inline double extrapolationFactor(double d00, double d01, double d11)
+	{
+		if (!(d00 > 0.0 && d11 > 0.0))
+			return 0.0;
+		double ratio = d01 / d00;
+		if (d01 * d01 < MIN_EXTRAPOLATION_COSINE_SQUARED * d00 * d11 || std::abs(ratio) > MAX_EXTRAPOLATION_RATIO)
+			return 0.0;
+		return ratio / (1.0 - ratio);
+	}
 
-	for (LinkMap::const_iterator linkIt(linkMap.begin()); linkIt != linkMap.end(); ++linkIt)
+	/**
+	 * The flow to a node along its in-links for a batch of interleaved flow
+	 * vectors, damped by beta and added to the initial flow in the order of
+	 * the in-links. Each link is loaded once for all vectors in the batch.
+	 */
+	inline void pullFlow(const SparseLinks& inLinks, unsigned int node, const double* nodeFlow,
+			unsigned int batchSize, const double* beta, double* flow)
 	{
-		unsigned int linkEnd1 = linkIt->first;
-		const std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt, ++linkIndex)
+		if (node >= inLinks.numRows())
+			return;
+		link_index end = inLinks.rowEnd(node);
+		for (link_index i = inLinks.rowBegin(node); i < end; ++i)
 		{
-			unsigned int linkEnd2 = subIt->first;
-			double linkWeight = subIt->second;
-
-			m_nodeFlow[linkEnd1] += linkWeight / sumUndirLinkWeight;
-			m_flowLinks[linkIndex] = Link(linkEnd1, linkEnd2, linkWeight);
+			double weight = inLinks.weight(i);
+			const double* sourceFlow = nodeFlow + static_cast<std::size_t>(inLinks.target(i)) * batchSize;
+			for (unsigned int k = 0; k < batchSize; ++k)
+				flow[k] += beta[k] * weight * sourceFlow[k];
+		}
+	}
 
-			if (linkEnd1 != linkEnd2 && !config.outdirdir)
-				m_nodeFlow[linkEnd2] += linkWeight / sumUndirLinkWeight;
+	std::vector<unsigned int> danglingNodes(const Network& network)
+	{
+		const std::vector<double>& nodeOutDegree = network.outDegree();
+		std::vector<unsigned int> danglings;
+		for (unsigned int i = 0; i < network.numNodes(); ++i)
+		{
+			if (nodeOutDegree[i] == 0)
+				danglings.push_back(i);
 		}
+		return danglings;
 	}
+}
+
+void FlowNetwork::calculateFlow(const Network& network, const Config& config)
+{
+	Log() << "Calculating global flow... " << std::flush;
+
+	initLinks(network, config);
+
+	unsigned int numNodes = network.numNodes();
+	const std::vector<double>& sumLinkOutWeight = network.sumLinkOutWeight();
+	link_index numLinks = network.numLinks();
+	double totalLinkWeight = network.totalLinkWeight();
+	double sumUndirLinkWeight = 2 * totalLinkWeight - network.totalSelfLinkWeight();
 
 	if (config.rawdir)
 	{
@@ -120,7 +170,7 @@ void FlowNetwork::calculateFlow(const Network& network, const Config& config)
 		}
 		else // undirected
 		{
-			for (unsigned int i = 0; i < numLinks; ++i)
+			for (link_index i = 0; i < numLinks; ++i)
 				m_flowLinks[i].flow /= sumUndirLinkWeight;
 			finalize(network, config);
 		}
@@ -130,6 +180,101 @@ void FlowNetwork::calculateFlow(const Network& network, const Config& config)
 	Log() << "\n  -> Using " << (config.recordedTeleportation ? "recorded" : "unrecorded") << " teleportation to " <<
 			(config.teleportToNodes ? "nodes" : "links") << ". " << std::flush;
 
+	initTeleportation(network, config);
+
+	std::vector<unsigned int> danglings = danglingNodes(network);
+	SparseLinks inLinks;
+	transposeLinkFlow(network, inLinks);
+
+	m_hasStartFlow = false;
+	if (!network.startNodeFlow().empty())
+		setStartFlow(network.startNodeFlow(), danglings, config);
+
+	calculatePageRank(inLinks, danglings, config, 200);
+	finalize(network, config);
+}
+
+void FlowNetwork::calculateFlows(const Network& network, const std::vector<Config>& configs,
+		std::vector<FlowNetwork>& flowNetworks)
+{
+	unsigned int batchSize = configs.size();
+	flowNetworks.assign(batchSize, FlowNetwork());
+	std::vector<FlowNetwork*> batch;
+	std::vector<const Config*> batchConfigs;
+	for (unsigned int k = 0; k < batchSize; ++k)
+	{
+		if (configs[k].directed && !configs[k].rawdir)
+		{
+			batch.push_back(&flowNetworks[k]);
+			batchConfigs.push_back(&configs[k]);
+		}
+		else
+			flowNetworks[k].calculateFlow(network, configs[k]);
+	}
+	if (batch.empty())
+		return;
+
+	Log() << "Calculating global flow for " << batch.size() << " teleportation settings... " << std::flush;
+
+	std::vector<unsigned int> danglings = danglingNodes(network);
+	for (unsigned int k = 0; k < batch.size(); ++k)
+	{
+		batch[k]->initLinks(network, *batchConfigs[k]);
+		batch[k]->initTeleportation(network, *batchConfigs[k]);
+	}
+
+	// The transition probabilities don't depend on the teleportation
+	SparseLinks inLinks;
+	batch[0]->transposeLinkFlow(network, inLinks);
+
+	for (unsigned int k = 0; k < batch.size(); ++k)
+	{
+		batch[k]->m_hasStartFlow = false;
+		if (!network.startNodeFlow().empty())
+			batch[k]->setStartFlow(network.startNodeFlow(), danglings, *batchConfigs[k]);
+	}
+
+	calculatePageRank(inLinks, danglings, batch, batchConfigs, 200);
+
+	for (unsigned int k = 0; k < batch.size(); ++k)
+		batch[k]->finalize(network, *batchConfigs[k]);
+}
+
+void FlowNetwork::initLinks(const Network& network, const Config& config)
+{
+	// Prepare data in sequence containers for fast access of individual elements
+	unsigned int numNodes = network.numNodes();
+	m_nodeFlow.assign(numNodes, 0.0);
+	m_nodeTeleportRates.assign(numNodes, 0.0);
+
+	const SparseLinks& links = network.links();
+	link_index numLinks = network.numLinks();
+	m_flowLinks.resize(numLinks);
+	double totalLinkWeight = network.totalLinkWeight();
+	double sumUndirLinkWeight = 2 * totalLinkWeight - network.totalSelfLinkWeight();
+	link_index linkIndex = 0;
+
+	for (unsigned int linkEnd1 = 0; linkEnd1 < links.numRows(); ++linkEnd1)
+	{
+		for (link_index i = links.rowBegin(linkEnd1); i < links.rowEnd(linkEnd1); ++i, ++linkIndex)
+		{
+			unsigned int linkEnd2 = links.target(i);
+			double linkWeight = links.weight(i);
+
+			m_nodeFlow[linkEnd1] += linkWeight / sumUndirLinkWeight;
+			m_flowLinks[linkIndex] = Link(linkEnd1, linkEnd2, linkWeight);
+
+			if (linkEnd1 != linkEnd2 && !config.outdirdir)
+				m_nodeFlow[linkEnd2] += linkWeight / sumUndirLinkWeight;
+		}
+	}
+}
+
+void FlowNetwork::initTeleportation(const Network& network, const Config& config)
+{
+	unsigned int numNodes = network.numNodes();
+	const std::vector<double>& sumLinkOutWeight = network.sumLinkOutWeight();
+	double totalLinkWeight = network.totalLinkWeight();
 
 	// Calculate the teleport rate distribution
 	if (config.teleportToNodes)
@@ -162,99 +307,431 @@ void FlowNetwork::calculateFlow(const Network& network, const Config& config)
 	{
 		linkIt->flow /= sumLinkOutWeight[linkIt->source];
 	}
+}
 
-	// Collect dangling nodes
-	std::vector<unsigned int> danglings;
+void FlowNetwork::transposeLinkFlow(const Network& network, SparseLinks& inLinks) const
+{
+	// Gather the transition probabilities on the in-links of each node, with
+	// sources in increasing order as in the link order above, to pull the flow
+	// to each node without write conflicts between threads
+	link_index numLinks = m_flowLinks.size();
+	std::vector<double> linkFlow(numLinks);
+	for (link_index i = 0; i < numLinks; ++i)
+		linkFlow[i] = m_flowLinks[i].flow;
+	network.links().transpose(inLinks, linkFlow.data());
+}
+
+
+void FlowNetwork::assign(unsigned int numNodes, const double* nodeFlow, const double* nodeTeleportRates,
+		link_index numLinks, const uint32_t* sources, const uint32_t* targets,
+		const double* weights, const double* flows)
+{
+	m_nodeFlow.assign(nodeFlow, nodeFlow + numNodes);
+	m_nodeTeleportRates.assign(nodeTeleportRates, nodeTeleportRates + numNodes);
+	m_flowLinks.clear();
+	m_flowLinks.reserve(numLinks);
+	for (link_index i = 0; i < numLinks; ++i)
+	{
+		m_flowLinks.push_back(Link(sources[i], targets[i], weights[i]));
+		m_flowLinks.back().flow = flows[i];
+	}
+	m_flowResiduals.clear();
+}
+
+void FlowNetwork::setStartFlow(const std::vector<double>& startFlow, const std::vector<unsigned int>& danglings,
+		const Config& config)
+{
+	unsigned int numNodes = m_nodeFlow.size();
+	unsigned int numStartNodes = 0;
+	double sumFlow = 0.0;
 	for (unsigned int i = 0; i < numNodes; ++i)
 	{
-		if (nodeOutDegree[i] == 0)
-			danglings.push_back(i);
+		if (i < startFlow.size() && startFlow[i] >= 0.0)
+		{
+			m_nodeFlow[i] = startFlow[i];
+			++numStartNodes;
+		}
+		sumFlow += m_nodeFlow[i];
+	}
+	if (numStartNodes == 0 || sumFlow <= 0.0)
+		return;
+	for (unsigned int i = 0; i < numNodes; ++i)
+		m_nodeFlow[i] /= sumFlow;
+
+	if (!config.recordedTeleportation)
+	{
+		// The flow f written with unrecorded teleportation is one step along
+		// the links from the stationary flow x, f = P'x / (1 - d) with dangling
+		// rank d. As x = (alpha + beta d) v + beta P'x with teleport rates v,
+		// solve for d from the dangling sums of f and v and invert the step.
+		double alpha = config.teleportationProbability;
+		double beta = 1.0 - alpha;
+		double danglingFlow = 0.0;
+		double danglingTeleportRate = 0.0;
+		for (unsigned int i = 0; i < danglings.size(); ++i)
+		{
+			danglingFlow += m_nodeFlow[danglings[i]];
+			danglingTeleportRate += m_nodeTeleportRates[danglings[i]];
+		}
+		double danglingRank = (beta * danglingFlow + alpha * danglingTeleportRate) /
+				(1.0 + beta * danglingFlow - beta * danglingTeleportRate);
+		for (unsigned int i = 0; i < numNodes; ++i)
+			m_nodeFlow[i] = beta * (1.0 - danglingRank) * m_nodeFlow[i] + (alpha + beta * danglingRank) * m_nodeTeleportRates[i];
+	}
+	m_hasStartFlow = true;
+	Log() << "Starting from given flow on " << numStartNodes << " nodes. " << std::flush;
+}
+
+void FlowNetwork::calculatePageRank(const SparseLinks& inLinks, const std::vector<unsigned int>& danglings,
+		const Config& config, unsigned int defaultMaxIterations)
+{
+	calculatePageRank(inLinks, danglings, std::vector<FlowNetwork*>(1, this),
+			std::vector<const Config*>(1, &config), defaultMaxIterations);
+}
+
+void FlowNetwork::calculatePageRank(const SparseLinks& inLinks, const std::vector<unsigned int>& danglings,
+		const std::vector<FlowNetwork*>& flowNetworks, const std::vector<const Config*>& configs,
+		unsigned int defaultMaxIterations)
+{
+	unsigned int batchSize = flowNetworks.size();
+	unsigned int numNodes = flowNetworks[0]->m_nodeFlow.size();
+	std::size_t numValues = static_cast<std::size_t>(numNodes) * batchSize;
+
+	// The settings and iteration state of each flow network in the batch
+	std::vector<double> alpha(batchSize);
+	std::vector<double> beta(batchSize);
+	std::vector<double> sqdiff(batchSize, 1.0);
+	std::vector<double> danglingRank(batchSize, 0.0);
+	std::vector<double> teleportFlow(batchSize);
+	std::vector<unsigned int> minIterations(batchSize);
+	std::vector<unsigned int> maxIterations(batchSize);
+	std::vector<unsigned int> numIterations(batchSize, 0);
+	std::vector<char> extrapolate(batchSize);
+	std::vector<double> extrapolationFactors(batchSize, 0.0);
+	std::vector<char> active(batchSize, 1);
+	unsigned int numActive = batchSize;
+	bool useExtrapolation = false;
+
+	// The node flow and teleport rates of all flow networks interleaved per node,
+	// so that each in-link is loaded once for the whole batch
+	std::vector<double> nodeFlow(numValues);
+	std::vector<double> nodeTeleportRates(numValues);
+	for (unsigned int k = 0; k < batchSize; ++k)
+	{
+		FlowNetwork& flowNetwork = *flowNetworks[k];
+		const Config& config = *configs[k];
+		alpha[k] = config.teleportationProbability;
+		beta[k] = 1.0 - alpha[k];
+		// The minimum guards against stopping early on the way from a uniform start
+		minIterations[k] = flowNetwork.m_hasStartFlow ? 0 : config.flowMinIterations;
+		maxIterations[k] = config.flowMaxIterations != 0 ? config.flowMaxIterations : defaultMaxIterations;
+		useExtrapolation = useExtrapolation || config.flowExtrapolationInterval != 0;
+		for (unsigned int i = 0; i < numNodes; ++i)
+		{
+			nodeFlow[i * batchSize + k] = flowNetwork.m_nodeFlow[i];
+			nodeTeleportRates[i * batchSize + k] = flowNetwork.m_nodeTeleportRates[i];
+		}
+		flowNetwork.m_flowResiduals.clear();
+	}
+
+	int numNodeChunks = static_cast<int>((numNodes + NODE_CHUNK_SIZE - 1) / NODE_CHUNK_SIZE);
+	int numDanglingChunks = static_cast<int>((danglings.size() + NODE_CHUNK_SIZE - 1) / NODE_CHUNK_SIZE);
+	std::vector<double> chunkSum(static_cast<std::size_t>(numNodeChunks) * batchSize);
+	std::vector<double> chunkDiff(static_cast<std::size_t>(numNodeChunks) * batchSize);
+	std::vector<double> chunkDot;
+
+	// The node flow two iterations back, kept for extrapolation
+	std::vector<double> nodeFlowOld;
+	std::vector<char> hasOldFlow(batchSize, 0);
+	if (useExtrapolation)
+	{
+		nodeFlowOld.assign(numValues, 0.0);
+		chunkDot.assign(static_cast<std::size_t>(numNodeChunks) * batchSize * 3, 0.0);
 	}
 
 	// Calculate PageRank
-	std::vector<double> nodeFlowTmp(numNodes, 0.0);
-	unsigned int numIterations = 0;
-	double alpha = config.teleportationProbability;
-	double beta = 1.0 - alpha;
-	double sqdiff = 1.0;
-	double danglingRank = 0.0;
+	std::vector<double> nodeFlowTmp(numValues, 0.0);
+	unsigned int iteration = 0;
 	do
 	{
-		// Calculate dangling rank
-		danglingRank = 0.0;
-		for (std::vector<unsigned int>::iterator danglingIt(danglings.begin()); danglingIt != danglings.end(); ++danglingIt)
+		bool anyExtrapolate = false;
+		for (unsigned int k = 0; k < batchSize; ++k)
 		{
-			danglingRank += m_nodeFlow[*danglingIt];
+			// The interval is at least two, so the snapshot is taken the iteration before extrapolating
+			unsigned int extrapolationInterval = configs[k]->flowExtrapolationInterval;
+			extrapolate[k] = active[k] && extrapolationInterval != 0 && (iteration + 1) % extrapolationInterval == 0 &&
+					hasOldFlow[k];
+			anyExtrapolate = anyExtrapolate || extrapolate[k];
+			if (active[k] && extrapolationInterval != 0 && (iteration + 2) % extrapolationInterval == 0)
+			{
+				for (unsigned int i = 0; i < numNodes; ++i)
+					nodeFlowOld[i * batchSize + k] = nodeFlow[i * batchSize + k];
+				hasOldFlow[k] = 1;
+			}
 		}
 
-		// Flow from teleportation
-		for (unsigned int i = 0; i < numNodes; ++i)
+		// Calculate dangling rank
+#pragma omp parallel for schedule(static) if(numDanglingChunks > 1)
+		for (int c = 0; c < numDanglingChunks; ++c)
+		{
+			unsigned int end = chunkEnd(c, danglings.size());
+			double* sum = &chunkSum[static_cast<std::size_t>(c) * batchSize];
+			for (unsigned int k = 0; k < batchSize; ++k)
+				sum[k] = 0.0;
+			for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+			{
+				const double* flow = &nodeFlow[static_cast<std::size_t>(danglings[i]) * batchSize];
+				for (unsigned int k = 0; k < batchSize; ++k)
+					sum[k] += flow[k];
+			}
+		}
+		for (unsigned int k = 0; k < batchSize; ++k)
 		{
-			nodeFlowTmp[i] = (alpha + beta*danglingRank) * m_nodeTeleportRates[i];
+			danglingRank[k] = 0.0;
+			for (int c = 0; c < numDanglingChunks; ++c)
+				danglingRank[k] += chunkSum[static_cast<std::size_t>(c) * batchSize + k];
+			// Flow from teleportation and links
+			teleportFlow[k] = alpha[k] + beta[k] * danglingRank[k];
 		}
 
-		// Flow from links
-		for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
+		// Converged flow networks keep their last iterate in nodeFlowTmp
+#pragma omp parallel for schedule(dynamic) if(numNodeChunks > 1)
+		for (int c = 0; c < numNodeChunks; ++c)
 		{
-			Link& link = *linkIt;
-			nodeFlowTmp[link.target] += beta * link.flow * m_nodeFlow[link.source];
+			std::vector<double> flow(batchSize);
+			unsigned int end = chunkEnd(c, numNodes);
+			for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+			{
+				std::size_t offset = static_cast<std::size_t>(i) * batchSize;
+				for (unsigned int k = 0; k < batchSize; ++k)
+					flow[k] = teleportFlow[k] * nodeTeleportRates[offset + k];
+				pullFlow(inLinks, i, &nodeFlow[0], batchSize, &beta[0], &flow[0]);
+				for (unsigned int k = 0; k < batchSize; ++k)
+				{
+					if (active[k])
+						nodeFlowTmp[offset + k] = flow[k];
+				}
+			}
 		}
 
-		// Update node flow from the power iteration above and check if converged
-		double sum = 0.0;
-		double sqdiff_old = sqdiff;
-		sqdiff = 0.0;
-		for (unsigned int i = 0; i < numNodes; ++i)
+		if (anyExtrapolate)
 		{
-			sum += nodeFlowTmp[i];
-			sqdiff += std::abs(nodeFlowTmp[i] - m_nodeFlow[i]);
-			m_nodeFlow[i] = nodeFlowTmp[i];
+			// Dot products of the last two differences between iterates, x0 in nodeFlowOld,
+			// x1 in nodeFlow and x2 in nodeFlowTmp
+#pragma omp parallel for schedule(static) if(numNodeChunks > 1)
+			for (int c = 0; c < numNodeChunks; ++c)
+			{
+				unsigned int end = chunkEnd(c, numNodes);
+				double* dot = &chunkDot[static_cast<std::size_t>(c) * batchSize * 3];
+				for (unsigned int k = 0; k < batchSize * 3; ++k)
+					dot[k] = 0.0;
+				for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+				{
+					std::size_t offset = static_cast<std::size_t>(i) * batchSize;
+					for (unsigned int k = 0; k < batchSize; ++k)
+					{
+						if (!extrapolate[k])
+							continue;
+						double d0 = nodeFlow[offset + k] - nodeFlowOld[offset + k];
+						double d1 = nodeFlowTmp[offset + k] - nodeFlow[offset + k];
+						dot[k * 3] += d0 * d0;
+						dot[k * 3 + 1] += d0 * d1;
+						dot[k * 3 + 2] += d1 * d1;
+					}
+				}
+			}
+			anyExtrapolate = false;
+			for (unsigned int k = 0; k < batchSize; ++k)
+			{
+				if (!extrapolate[k])
+					continue;
+				double d00 = 0.0, d01 = 0.0, d11 = 0.0;
+				for (int c = 0; c < numNodeChunks; ++c)
+				{
+					const double* dot = &chunkDot[(static_cast<std::size_t>(c) * batchSize + k) * 3];
+					d00 += dot[0];
+					d01 += dot[1];
+					d11 += dot[2];
+				}
+				extrapolationFactors[k] = extrapolationFactor(d00, d01, d11);
+				extrapolate[k] = extrapolationFactors[k] != 0.0;
+				anyExtrapolate = anyExtrapolate || extrapolate[k];
+			}
 		}
 
-		// Normalize if needed
-		if (std::abs(sum - 1.0) > 1.0e-10)
+		if (anyExtrapolate)
 		{
-			Log() << "(Normalizing ranks after " <<	numIterations << " power iterations with error " << (sum-1.0) << ") ";
-			for (unsigned int i = 0; i < numNodes; ++i)
+#pragma omp parallel for schedule(static) if(numNodeChunks > 1)
+			for (int c = 0; c < numNodeChunks; ++c)
 			{
-				m_nodeFlow[i] /= sum;
+				unsigned int end = chunkEnd(c, numNodes);
+				for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+				{
+					std::size_t offset = static_cast<std::size_t>(i) * batchSize;
+					for (unsigned int k = 0; k < batchSize; ++k)
+					{
+						if (!extrapolate[k])
+							continue;
+						double x2 = nodeFlowTmp[offset + k];
+						double x = x2 + extrapolationFactors[k] * (x2 - nodeFlow[offset + k]);
+						nodeFlowTmp[offset + k] = x > 0.0 ? x : 0.0;
+					}
+				}
 			}
 		}
 
-		// Perturb the system if equilibrium
-		if(sqdiff == sqdiff_old)
+		// Update node flow from the power iteration above and check if converged
+#pragma omp parallel for schedule(static) if(numNodeChunks > 1)
+		for (int c = 0; c < numNodeChunks; ++c)
 		{
-			alpha += 1.0e-10;
-			beta = 1.0 - alpha;
+			unsigned int end = chunkEnd(c, numNodes);
+			double* sum = &chunkSum[static_cast<std::size_t>(c) * batchSize];
+			double* diff = &chunkDiff[static_cast<std::size_t>(c) * batchSize];
+			for (unsigned int k = 0; k < batchSize; ++k)
+			{
+				sum[k] = 0.0;
+				diff[k] = 0.0;
+			}
+			for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+			{
+				std::size_t offset = static_cast<std::size_t>(i) * batchSize;
+				for (unsigned int k = 0; k < batchSize; ++k)
+				{
+					if (!active[k])
+						continue;
+					sum[k] += nodeFlowTmp[offset + k];
+					diff[k] += std::abs(nodeFlowTmp[offset + k] - nodeFlow[offset + k]);
+					nodeFlow[offset + k] = nodeFlowTmp[offset + k];
+				}
+			}
 		}
 
-		numIterations++;
-	}  while((numIterations < 200) && (sqdiff > 1.0e-15 || numIterations < 50));
+		for (unsigned int k = 0; k < batchSize; ++k)
+		{
+			if (!active[k])
+				continue;
+			double sum = 0.0;
+			double sqdiff_old = sqdiff[k];
+			sqdiff[k] = 0.0;
+			for (int c = 0; c < numNodeChunks; ++c)
+			{
+				sum += chunkSum[static_cast<std::size_t>(c) * batchSize + k];
+				sqdiff[k] += chunkDiff[static_cast<std::size_t>(c) * batchSize + k];
+			}
+			flowNetworks[k]->m_flowResiduals.push_back(sqdiff[k]);
+			Log(1) << "\n    Iteration " << numIterations[k] + 1;
+			if (batchSize > 1)
+				Log(1) << " [" << k + 1 << "]";
+			Log(1) << ": residual " << sqdiff[k] << (extrapolate[k] ? " (extrapolated)" : "");
+
+			// Normalize if needed, always after extrapolation as negative flow is cut off
+			if (extrapolate[k])
+			{
+				for (unsigned int i = 0; i < numNodes; ++i)
+					nodeFlow[i * batchSize + k] /= sum;
+			}
+			else if (std::abs(sum - 1.0) > 1.0e-10)
+			{
+				Log() << "(Normalizing ranks after " <<	numIterations[k] << " power iterations with error " << (sum-1.0) << ") ";
+				for (unsigned int i = 0; i < numNodes; ++i)
+					nodeFlow[i * batchSize + k] /= sum;
+			}
 
-	double sumNodeRank = 1.0;
+			// Perturb the system if equilibrium
+			if(sqdiff[k] == sqdiff_old && !extrapolate[k])
+			{
+				alpha[k] += 1.0e-10;
+				beta[k] = 1.0 - alpha[k];
+			}
 
-	if (!config.recordedTeleportation)
+			// The residual of an extrapolated step is not that of a power iteration, so don't stop on it
+			numIterations[k]++;
+			if (numIterations[k] >= maxIterations[k] ||
+					(!extrapolate[k] && sqdiff[k] <= configs[k]->flowTolerance && numIterations[k] >= minIterations[k]))
+			{
+				active[k] = 0;
+				--numActive;
+			}
+		}
+		++iteration;
+	}  while(numActive > 0);
+
+	for (unsigned int k = 0; k < batchSize; ++k)
 	{
-		//Take one last power iteration excluding the teleportation (and normalize node flow to sum 1.0)
-		sumNodeRank = 1.0 - danglingRank;
-		m_nodeFlow.assign(numNodes, 0.0);
-		for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
+		FlowNetwork& flowNetwork = *flowNetworks[k];
+		for (unsigned int i = 0; i < numNodes; ++i)
+			flowNetwork.m_nodeFlow[i] = nodeFlow[i * batchSize + k];
+	}
+
+	// Take one last power iteration excluding the teleportation for unrecorded
+	// teleportation (and normalize node flow to sum 1.0)
+	std::vector<double> sumNodeRank(batchSize, 1.0);
+	std::vector<char> unrecorded(batchSize);
+	bool anyUnrecorded = false;
+	for (unsigned int k = 0; k < batchSize; ++k)
+	{
+		unrecorded[k] = !configs[k]->recordedTeleportation;
+		anyUnrecorded = anyUnrecorded || unrecorded[k];
+		if (unrecorded[k])
+			sumNodeRank[k] = 1.0 - danglingRank[k];
+	}
+	if (anyUnrecorded)
+	{
+#pragma omp parallel for schedule(dynamic) if(numNodeChunks > 1)
+		for (int c = 0; c < numNodeChunks; ++c)
 		{
-			Link& link = *linkIt;
-			m_nodeFlow[link.target] += link.flow * nodeFlowTmp[link.source] / sumNodeRank;
+			std::vector<double> flow(batchSize);
+			unsigned int end = chunkEnd(c, numNodes);
+			for (unsigned int i = c * NODE_CHUNK_SIZE; i < end; ++i)
+			{
+				for (unsigned int k = 0; k < batchSize; ++k)
+					flow[k] = 0.0;
+				if (i < inLinks.numRows())
+				{
+					for (link_index j = inLinks.rowBegin(i); j < inLinks.rowEnd(i); ++j)
+					{
+						double weight = inLinks.weight(j);
+						const double* sourceFlow = &nodeFlowTmp[static_cast<std::size_t>(inLinks.target(j)) * batchSize];
+						for (unsigned int k = 0; k < batchSize; ++k)
+							flow[k] += weight * sourceFlow[k] / sumNodeRank[k];
+					}
+				}
+				for (unsigned int k = 0; k < batchSize; ++k)
+				{
+					if (unrecorded[k])
+						flowNetworks[k]->m_nodeFlow[i] = flow[k];
+				}
+			}
+		}
+		for (unsigned int k = 0; k < batchSize; ++k)
+		{
+			if (unrecorded[k])
+				beta[k] = 1.0;
 		}
-		beta = 1.0;
 	}
 
-
 	// Update the links with their global flow from the PageRank values. (Note: beta is set to 1 if unrec)
-	for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
+	for (unsigned int k = 0; k < batchSize; ++k)
 	{
-		linkIt->flow *= beta * nodeFlowTmp[linkIt->source] / sumNodeRank;
+		LinkVec& flowLinks = flowNetworks[k]->m_flowLinks;
+		link_index numLinks = flowLinks.size();
+		int numLinkChunks = static_cast<int>((numLinks + LINK_CHUNK_SIZE - 1) / LINK_CHUNK_SIZE);
+#pragma omp parallel for schedule(static) if(numLinkChunks > 1)
+		for (int c = 0; c < numLinkChunks; ++c)
+		{
+			link_index end = std::min(static_cast<link_index>(c + 1) * LINK_CHUNK_SIZE, numLinks);
+			for (link_index i = static_cast<link_index>(c) * LINK_CHUNK_SIZE; i < end; ++i)
+			{
+				Link& link = flowLinks[i];
+				link.flow *= beta[k] * nodeFlowTmp[static_cast<std::size_t>(link.source) * batchSize + k] / sumNodeRank[k];
+			}
+		}
 	}
 
-	Log() << "\n  -> PageRank calculation done in " << numIterations << " iterations." << std::endl;
-	finalize(network, config);
+	if (batchSize == 1)
+		Log() << "\n  -> PageRank calculation done in " << numIterations[0] << " iterations." << std::endl;
+	else
+		Log() << "\n  -> PageRank calculation done in [" << io::stringify(numIterations, ", ") << "] iterations." << std::endl;
 }
 
 void FlowNetwork::finalize(const Network& network, const Config& config, bool normalizeNodeFlow)
@@ -63,25 +63,95 @@ public:
 		double flow;
 	};
 
-	typedef Network::LinkMap										LinkMap;
 	typedef std::vector<Link>										LinkVec;
 
-	FlowNetwork() {}
+	FlowNetwork() : m_hasStartFlow(false) {}
 	virtual ~FlowNetwork() {}
 
 	virtual void calculateFlow(const Network& network, const Config& config);
 
+	/**
+	 * Calculate the flow on the same network for a batch of configs, such as a
+	 * sweep over teleportation settings. The PageRank iterations of all directed
+	 * configs run together over the shared links, with the flow vectors
+	 * interleaved per node so that each link is loaded once per iteration for
+	 * the whole batch. Other flow models are calculated one by one.
+	 * @param flowNetworks Set to one flow network per config
+	 */
+	static void calculateFlows(const Network& network, const std::vector<Config>& configs,
+			std::vector<FlowNetwork>& flowNetworks);
+
+	/**
+	 * Replace the flow network with previously calculated node and link flow,
+	 * given as parallel arrays.
+	 */
+	void assign(unsigned int numNodes, const double* nodeFlow, const double* nodeTeleportRates,
+			link_index numLinks, const uint32_t* sources, const uint32_t* targets,
+			const double* weights, const double* flows);
+
 	const std::vector<double>& getNodeFlow() const { return m_nodeFlow; }
 	const std::vector<double>& getNodeTeleportRates() const { return m_nodeTeleportRates; }
 	const LinkVec& getFlowLinks() const { return m_flowLinks; }
 
+	/**
+	 * The L1 difference between successive iterates of the last PageRank
+	 * calculation, one per power iteration.
+	 */
+	const std::vector<double>& getFlowResiduals() const { return m_flowResiduals; }
+
 protected:
 
+	/**
+	 * Set the links with their weights as flow, and the initial node flow.
+	 */
+	void initLinks(const Network& network, const Config& config);
+
+	/**
+	 * Set the teleport rates and normalize the link flow to transition probabilities.
+	 */
+	void initTeleportation(const Network& network, const Config& config);
+
+	/**
+	 * Write the transition probabilities on the in-links of each node.
+	 */
+	void transposeLinkFlow(const Network& network, SparseLinks& inLinks) const;
+
 	void finalize(const Network& network, const Config& config, bool normalizeNodeFlow = false);
 
+	/**
+	 * Start the power iteration from the given node flow instead of the
+	 * initial node flow, keeping the initial flow on nodes with negative start
+	 * flow. Expects the teleport rates.
+	 * @param startFlow The final node flow from a previous calculation
+	 * @param danglings The nodes without out-links
+	 */
+	void setStartFlow(const std::vector<double>& startFlow, const std::vector<unsigned int>& danglings,
+			const Config& config);
+
+	/**
+	 * Calculate the node flow with teleportation by power iteration and set
+	 * the link flow from it. Expects the teleport rates and the transition
+	 * probabilities as link flow.
+	 * @param inLinks The transition probabilities on the in-links of each node
+	 * @param danglings The nodes without out-links
+	 * @param defaultMaxIterations The iteration limit if not set in the config
+	 */
+	void calculatePageRank(const SparseLinks& inLinks, const std::vector<unsigned int>& danglings,
+			const Config& config, unsigned int defaultMaxIterations);
+
+	/**
+	 * Calculate PageRank for a batch of flow networks with the same transition
+	 * probabilities, iterating each until its own convergence.
+	 */
+	static void calculatePageRank(const SparseLinks& inLinks, const std::vector<unsigned int>& danglings,
+			const std::vector<FlowNetwork*>& flowNetworks, const std::vector<const Config*>& configs,
+			unsigned int defaultMaxIterations);
+
 	std::vector<double> m_nodeFlow;
 	std::vector<double> m_nodeTeleportRates;
 	LinkVec m_flowLinks;
+	std::vector<double> m_flowResiduals;
+	bool m_hasStartFlow;
 
 };
 
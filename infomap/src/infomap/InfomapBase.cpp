@@ -53,6 +53,7 @@
 #include "Network.h"
 #include "FlowNetwork.h"
 #include "../io/version.h"
+#include "../io/FlowNetworkCache.h"
 #include <functional>
 
 #ifdef NS_INFOMAP
@@ -76,6 +77,20 @@ void InfomapBase::run()
 	if (!initNetwork())
 		return;
 
+	runTrials();
+}
+
+void InfomapBase::run(const Network& network, const FlowNetwork& flowNetwork)
+{
+	setBipartiteNodes(network.numNodes(), network.numBipartiteNodes());
+	m_nodeNames = network.nodeNames();
+	initFlowNetwork(flowNetwork);
+
+	runTrials();
+}
+
+void InfomapBase::runTrials()
+{
 	calcOneLevelCodelength();
 
 	if (m_config.benchmark)
@@ -1463,21 +1478,53 @@ bool InfomapBase::initNetwork()
 		return true;
 	}
 
+	// The cached flow network can't replace the parsed network for output of the network itself
+	bool useFlowCache = !m_config.flowCacheDirectory.empty() && !m_config.networkFile.empty() &&
+			m_config.flowStartFile.empty() && !m_config.printBinaryNetwork &&
+			!m_config.printPajekNetwork && !m_config.printStateNetwork;
+	std::string flowCacheFile = "";
+	uint64_t cacheKey = 0;
+	if (useFlowCache)
+	{
+		cacheKey = flowCacheKey(m_config);
+		flowCacheFile = flowCacheFilename(m_config, cacheKey);
+		FlowNetwork flowNetwork;
+		unsigned int numBipartiteNodes = 0;
+		if (readFlowCache(flowCacheFile, cacheKey, flowNetwork, m_nodeNames, numBipartiteNodes))
+		{
+			Log() << "Loaded flow network with " << flowNetwork.getNodeFlow().size() << " nodes and " <<
+					flowNetwork.getFlowLinks().size() << " links from cache '" << flowCacheFile << "'.\n";
+			setBipartiteNodes(flowNetwork.getNodeFlow().size(), numBipartiteNodes);
+			initFlowNetwork(flowNetwork);
+			return true;
+		}
+	}
+
 	Network network(m_config);
 
 	network.readInputData();
 
+	setBipartiteNodes(network.numNodes(), network.numBipartiteNodes());
+
+	return initNetwork(network, flowCacheFile, cacheKey);
+}
+
+void InfomapBase::setBipartiteNodes(unsigned int numNodes, unsigned int numBipartiteNodes)
+{
 	if (m_config.isBipartite() && !m_config.showBiNodes) {
-		m_config.maxNodeIndexVisible = network.numNodes() - network.numBipartiteNodes() - 1;
-		Log(1) << "Skip " << network.numBipartiteNodes() << " bipartites nodes in output, limit to " <<
+		m_config.maxNodeIndexVisible = numNodes - numBipartiteNodes - 1;
+		Log(1) << "Skip " << numBipartiteNodes << " bipartites nodes in output, limit to " <<
 				m_config.maxNodeIndexVisible + 1 << " ordinary nodes.\n";
 	}
-	m_config.minBipartiteNodeIndex = network.numNodes() - network.numBipartiteNodes();
-
-	return initNetwork(network);
+	m_config.minBipartiteNodeIndex = numNodes - numBipartiteNodes;
 }
 
 bool InfomapBase::initNetwork(Network& network)
+{
+	return initNetwork(network, "", 0);
+}
+
+bool InfomapBase::initNetwork(Network& network, const std::string& flowCacheFile, uint64_t flowCacheKey)
 {
 	if (m_config.isMemoryNetwork())
 	{
@@ -1493,10 +1540,18 @@ bool InfomapBase::initNetwork(Network& network)
  	if (network.numNodes() == 0)
 		throw InternalOrderError("Zero nodes or missing finalization of network.");
 
+	std::string outname = m_config.outName;
+	if (m_config.printBinaryNetwork)
+	{
+		// Before generating default node names, to only store names from the input
+		std::string outName = io::Str() << m_config.outDirectory << outname << ".bnet";
+		Log() << "Printing binary network to " << outName << "... " << std::flush;
+		network.writeBinaryNetwork(outName, m_config.binaryFloatWeights);
+		Log() << "done!\n";
+	}
 
  	network.initNodeNames();
 
-	std::string outname = m_config.outName;
  	if (m_config.printPajekNetwork)
  	{
  		std::string outName = io::Str() << m_config.outDirectory << outname << ".net";
@@ -1512,20 +1567,38 @@ bool InfomapBase::initNetwork(Network& network)
 		Log() << "done!\n";
  	}
 
+	if (!m_config.flowStartFile.empty())
+		network.readStartNodeFlow(m_config.flowStartFile);
+
  	FlowNetwork flowNetwork;
  	flowNetwork.calculateFlow(network, m_config);
 
  	network.disposeLinks();
 	network.swapNodeNames(m_nodeNames);
 
+	if (!flowCacheFile.empty())
+	{
+		Log() << "Writing flow network to cache '" << flowCacheFile << "'... " << std::flush;
+		writeFlowCache(flowCacheFile, flowCacheKey, flowNetwork, m_nodeNames, network.numBipartiteNodes());
+		Log() << "done!\n";
+	}
+
+	initFlowNetwork(flowNetwork);
+
+ 	return true;
+}
+
+void InfomapBase::initFlowNetwork(const FlowNetwork& flowNetwork)
+{
+	std::string outname = m_config.outName;
  	const std::vector<double>& nodeFlow = flowNetwork.getNodeFlow();
  	const std::vector<double>& nodeTeleportWeights = flowNetwork.getNodeTeleportRates();
- 	m_treeData.reserveNodeCount(network.numNodes());
+ 	m_treeData.reserveNodeCount(nodeFlow.size());
 
- 	for (unsigned int i = 0; i < network.numNodes(); ++i)
- 		m_treeData.addNewNode(m_nodeNames[i], nodeFlow[i], nodeTeleportWeights[i]);
+ 	for (unsigned int i = 0; i < nodeFlow.size(); ++i)
+ 		m_treeData.addNewNode(nodeFlow[i], nodeTeleportWeights[i]);
  	const FlowNetwork::LinkVec& links = flowNetwork.getFlowLinks();
- 	for (unsigned int i = 0; i < links.size(); ++i)
+ 	for (link_index i = 0; i < links.size(); ++i)
  		m_treeData.addEdge(links[i].source, links[i].target, links[i].weight, links[i].flow * m_config.markovTime);
 
 
@@ -1545,11 +1618,22 @@ bool InfomapBase::initNetwork(Network& network)
 				m_config.outDirectory << outname << ".rank";
 		Log() << "Printing node flow to " << outfile << "... ";
 		SafeOutFile out(outfile.c_str());
+		// Full precision to start the flow calculation from it with --flow-start
+		out << std::setprecision(std::numeric_limits<double>::digits10 + 2);
 
-		out << "# node-flow\n";
-		for (unsigned int i = 0; i < nodeFlow.size(); ++i)
+		// Write the ids of nodes added by id, to start from this flow on a renumbered network
+		if (!m_nodeNames.hasIds())
 		{
-			out << nodeFlow[i] << "\n";
+			out << "# node-flow\n";
+			for (unsigned int i = 0; i < nodeFlow.size(); ++i)
+				out << nodeFlow[i] << "\n";
+		}
+		else
+		{
+			unsigned int indexOffset = m_config.zeroBasedNodeNumbers ? 0 : 1;
+			out << "# node-id node-flow\n";
+			for (unsigned int i = 0; i < nodeFlow.size(); ++i)
+				out << m_nodeNames.id(i, indexOffset) << " " << nodeFlow[i] << "\n";
 		}
 
 		Log() << "done!\n";
@@ -1564,8 +1648,6 @@ bool InfomapBase::initNetwork(Network& network)
 		printFlowNetwork(flowOut);
 		Log() << "done!\n";
 	}
-
- 	return true;
 }
 
 void InfomapBase::initMemoryNetwork()
@@ -1588,9 +1670,17 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
 	if (network.numNodes() == 0)
 		throw InternalOrderError("Zero nodes or missing finalization of network.");
 
+	std::string outname = m_config.outName;
+	if (m_config.printBinaryNetwork)
+	{
+		std::string outName = io::Str() << m_config.outDirectory << outname << "_states.bnet";
+		Log() << "Printing binary state network to " << outName << "... " << std::flush;
+		network.writeBinaryNetwork(outName, m_config.binaryFloatWeights);
+		Log() << "done!\n";
+	}
+
 	network.initNodeNames();
 
-	std::string outname = m_config.outName;
 	if (m_config.printPajekNetwork)
  	{
  		std::string outName = io::Str() << m_config.outDirectory << outname << ".net";
@@ -1607,6 +1697,9 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
  	}
 
 
+	if (!m_config.flowStartFile.empty())
+		network.readStartNodeFlow(m_config.flowStartFile);
+
 	MemFlowNetwork flowNetwork;
 	flowNetwork.calculateFlow(network, m_config);
 
@@ -1620,7 +1713,7 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
 	const std::vector<StateNode>& stateNodes = flowNetwork.getStateNodes();
 
 	for (unsigned int i = 0; i < network.numStateNodes(); ++i) {
-		m_treeData.addNewNode("", nodeFlow[i], nodeTeleportWeights[i]);
+		m_treeData.addNewNode(nodeFlow[i], nodeTeleportWeights[i]);
 		StateNode& stateNode = getMemoryNode(m_treeData.getLeafNode(i));
 		stateNode.stateIndex = stateNodes[i].stateIndex;
 		stateNode.physIndex = stateNodes[i].physIndex;
@@ -1628,7 +1721,7 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
 
 	const FlowNetwork::LinkVec& links = flowNetwork.getFlowLinks();
 
-	for (unsigned int i = 0; i < links.size(); ++i) {
+	for (link_index i = 0; i < links.size(); ++i) {
 		// Ignore self-links
 //		if (links[i].source == links[i].target)
 //			continue;
@@ -1638,12 +1731,10 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
 //	std::vector<double> m1Flow(network.numNodes(), 0.0);
 
 	// Add physical nodes
-	const MemNetwork::StateNodeMap& nodeMap = network.stateNodeMap();
-	for (MemNetwork::StateNodeMap::const_iterator statenodeIt(nodeMap.begin()); statenodeIt != nodeMap.end(); ++statenodeIt)
+	for (unsigned int i = 0; i < stateNodes.size(); ++i)
 	{
-		unsigned int nodeIndex = statenodeIt->second;
-		getPhysicalMembers(m_treeData.getLeafNode(nodeIndex)).push_back(PhysData(statenodeIt->first.physIndex, nodeFlow[nodeIndex]));
-//		m1Flow[statenodeIt->first.physIndex] += nodeFlow[nodeIndex];
+		getPhysicalMembers(m_treeData.getLeafNode(i)).push_back(PhysData(stateNodes[i].physIndex, nodeFlow[i]));
+//		m1Flow[stateNodes[i].physIndex] += nodeFlow[i];
 	}
 
 	double sumNodeFlow = 0.0;
@@ -1688,6 +1779,7 @@ void InfomapBase::initMemoryNetwork(MemNetwork& network)
 					m_config.outDirectory << outname << ".rank";
 			Log() << "Printing physical flow to " << outName << "... " << std::flush;
 			SafeOutFile out(outName.c_str());
+			out << std::setprecision(std::numeric_limits<double>::digits10 + 2);
 			double sumFlow = 0.0;
 			double sumStateflow = 0.0;
 			std::vector<double> m1Flow(network.numNodes(), 0.0);
@@ -1967,6 +2059,8 @@ void InfomapBase::printClusterNumbers(std::ostream& out)
 		"partitioned in " << m_config.elapsedTime() << " from codelength " <<
 		io::toPrecision(oneLevelCodelength, 9, true) << " in one level to codelength " <<
 		io::toPrecision(codelength, 9, true) << ".\n";
+	if (*INFOMAP_BUILD_OPTIONS)
+		out << "# Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 
 	out << "*Vertices " << m_treeData.numLeafNodes() << "\n";
 	for (TreeData::leafIterator it(m_treeData.begin_leaf()), itEnd(m_treeData.end_leaf());
@@ -36,6 +36,7 @@
 #include <limits>
 #include "../io/HierarchicalNetwork.h"
 #include "MemNetwork.h"
+#include "FlowNetwork.h"
 
 #ifdef NS_INFOMAP
 namespace infomap
@@ -104,6 +105,12 @@ public:
 
 	void run(Network& input, HierarchicalNetwork& output);
 
+	/**
+	 * Run on a flow network calculated beforehand on the network, which
+	 * should have its node names initiated.
+	 */
+	void run(const Network& network, const FlowNetwork& flowNetwork);
+
 	bool initNetwork();
 
 	bool initNetwork(Network& input);
@@ -301,6 +308,20 @@ private:
 	void setActiveNetworkFromChildrenOfRoot();
 	void setActiveNetworkFromLeafModules();
 	void setActiveNetworkFromLeafs();
+	/**
+	 * Calculate the flow on a parsed network, and write it to the flow cache
+	 * if a cache file is given.
+	 */
+	bool initNetwork(Network& input, const std::string& flowCacheFile, uint64_t flowCacheKey);
+	/**
+	 * Set the leaf nodes and links from a calculated flow network.
+	 */
+	void initFlowNetwork(const FlowNetwork& flowNetwork);
+	void setBipartiteNodes(unsigned int numNodes, unsigned int numBipartiteNodes);
+	/**
+	 * Run all trials on the initiated network and print the best solution.
+	 */
+	void runTrials();
 	void initMemoryNetwork();
 	void initMemoryNetwork(MemNetwork& input);
 	void initNodeNames(Network& network);
@@ -323,7 +344,7 @@ protected:
 	Config m_config;
 	MTRand m_rand;
 	TreeData m_treeData;
-	std::vector<std::string> m_nodeNames;
+	NodeNames m_nodeNames;
 	std::vector<NodeBase*>& m_activeNetwork; // Points either to m_nonLeafActiveNetwork or m_treeData.m_leafNodes
 	std::vector<unsigned int> m_moveTo;
 	bool m_isCoarseTune;
@@ -116,7 +116,7 @@ protected:
 	virtual void sortTree(NodeBase& parent);
 
 	virtual void saveHierarchicalNetwork(HierarchicalNetwork& output, std::string rootName, bool includeLinks);
-	void buildHierarchicalNetworkHelper(HierarchicalNetwork& hierarchicalNetwork, HierarchicalNetwork::node_type& parent, std::vector<std::string>& leafNodeNames, NodeBase* node = 0);
+	void buildHierarchicalNetworkHelper(HierarchicalNetwork& hierarchicalNetwork, HierarchicalNetwork::node_type& parent, NodeBase* node = 0);
 	// Don't add leaf nodes, but collect all leaf modules instead
 	void buildHierarchicalNetworkHelper(HierarchicalNetwork& hierarchicalNetwork, HierarchicalNetwork::node_type& parent, std::deque<std::pair<NodeBase*, HierarchicalNetwork::node_type*> >& leafModules, NodeBase* node = 0);
 
@@ -223,8 +223,9 @@ void InfomapGreedy<InfomapImplementation>::saveHierarchicalNetwork(HierarchicalN
 	output.init(rootName, hierarchicalCodelength, oneLevelCodelength);
 
 	output.prepareAddLeafNodes(m_treeData.numLeafNodes());
+	output.setLeafNodeNames(m_nodeNames);
 
-	buildHierarchicalNetworkHelper(output, output.getRootNode(), m_nodeNames);
+	buildHierarchicalNetworkHelper(output, output.getRootNode());
 
 	if (includeLinks)
 	{
@@ -243,14 +244,14 @@ void InfomapGreedy<InfomapImplementation>::saveHierarchicalNetwork(HierarchicalN
 
 template<typename InfomapImplementation>
 inline
-void InfomapGreedy<InfomapImplementation>::buildHierarchicalNetworkHelper(HierarchicalNetwork& hierarchicalNetwork, HierarchicalNetwork::node_type& parent, std::vector<std::string>& leafNodeNames, NodeBase* rootNode)
+void InfomapGreedy<InfomapImplementation>::buildHierarchicalNetworkHelper(HierarchicalNetwork& hierarchicalNetwork, HierarchicalNetwork::node_type& parent, NodeBase* rootNode)
 {
 	if (rootNode == 0)
 		rootNode = root();
 
 	if (rootNode->getSubInfomap() != 0)
 	{
-		getImpl(*rootNode->getSubInfomap()).buildHierarchicalNetworkHelper(hierarchicalNetwork, parent, leafNodeNames);
+		getImpl(*rootNode->getSubInfomap()).buildHierarchicalNetworkHelper(hierarchicalNetwork, parent);
 		return;
 	}
 
@@ -262,18 +263,18 @@ void InfomapGreedy<InfomapImplementation>::buildHierarchicalNetworkHelper(Hierar
 		{
 			if (m_config.isMemoryNetwork()) {
 				const StateNode& stateNode = getMemoryNode(*childIt);
-				hierarchicalNetwork.addLeafNode(parent, node.data.flow, node.data.exitFlow, leafNodeNames[node.originalIndex],
+				hierarchicalNetwork.addLeafNode(parent, node.data.flow, node.data.exitFlow,
 						node.originalIndex, node.originalIndex, true, stateNode.stateIndex, stateNode.physIndex);
 
 			}
 			else
-				hierarchicalNetwork.addLeafNode(parent, node.data.flow, node.data.exitFlow, leafNodeNames[node.originalIndex],
+				hierarchicalNetwork.addLeafNode(parent, node.data.flow, node.data.exitFlow,
 				node.originalIndex, node.originalIndex, false, 0, node.originalIndex);
 		}
 		else
 		{
 			SNode& newParent = hierarchicalNetwork.addNode(parent, node.data.flow, node.data.exitFlow);
-			buildHierarchicalNetworkHelper(hierarchicalNetwork, newParent, leafNodeNames, childIt.base());
+			buildHierarchicalNetworkHelper(hierarchicalNetwork, newParent, childIt.base());
 		}
 	}
 }
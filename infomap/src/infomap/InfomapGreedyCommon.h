@@ -28,6 +28,8 @@
 #ifndef INFOMAPGREEDYCOMMON_H_
 #define INFOMAPGREEDYCOMMON_H_
 #include "InfomapGreedySpecialized.h"
+#include "ActiveNetworkIndex.h"
+#include "SparseLinks.h"
 #include <memory>
 #ifdef _OPENMP
 #include <omp.h>
@@ -52,15 +54,62 @@ class InfomapGreedyCommon : public InfomapGreedySpecialized<typename derived_tra
 	typedef typename flowData_traits<FlowType>::teleportation_type 							TeleportationType;
 	typedef typename flowData_traits<FlowType>::is_directed_type							IsDirectedType;
 	typedef Edge<NodeBase>																	EdgeType;
+
+	/**
+	 * Scratch arrays for collecting the module links of a node, one per thread.
+	 */
+	struct MoveScratch
+	{
+		MoveScratch() : offset(1) {}
+		/**
+		 * Size the arrays for the active network, only filling them if the size changes.
+		 */
+		void resize(unsigned int numNodes, unsigned int maxNumModuleLinks)
+		{
+			if (redirect.size() != numNodes)
+			{
+				redirect.assign(numNodes, 0);
+				offset = 1;
+			}
+			if (moduleDeltaEnterExit.size() != maxNumModuleLinks)
+				moduleDeltaEnterExit.resize(maxNumModuleLinks);
+		}
+		void clear()
+		{
+			std::vector<unsigned int>().swap(redirect);
+			std::vector<DeltaFlowType>().swap(moduleDeltaEnterExit);
+			offset = 1;
+		}
+		std::vector<unsigned int> redirect;
+		std::vector<DeltaFlowType> moduleDeltaEnterExit;
+		DeltaCodelengthBatch deltaCodelengthBatch;
+		unsigned int offset;
+	};
+
+	/**
+	 * The best move of a node found in parallel, to be committed in order.
+	 */
+	struct ProposedMove
+	{
+		enum Action { SKIP, STAY, MOVE, STALE };
+		ProposedMove() : action(SKIP), deltaCodelength(0.0) {}
+		Action action;
+		DeltaFlowType oldModuleDelta;
+		DeltaFlowType newModuleDelta;
+		double deltaCodelength;
+	};
+
 public:
 
 	InfomapGreedyCommon(const Config& conf, NodeFactoryBase* nodeFactory) :
 		InfomapGreedySpecialized<FlowType>(conf, nodeFactory),
-		m_coreLoopCount(0)
+		m_coreLoopCount(0),
+		m_maxNumModuleLinks(0)
 		{}
 	InfomapGreedyCommon(const InfomapBase& infomap, NodeFactoryBase* nodeFactory) :
 		InfomapGreedySpecialized<FlowType>(infomap, nodeFactory),
-		m_coreLoopCount(0)
+		m_coreLoopCount(0),
+		m_maxNumModuleLinks(0)
 		{}
 	virtual ~InfomapGreedyCommon() {}
 
@@ -99,6 +148,21 @@ protected:
 
 	unsigned int tryMoveEachNodeIntoBestModuleInParallel();
 
+	void findBestMove(unsigned int nodeIndex, unsigned int emptyModule, MoveScratch& scratch, ProposedMove& move);
+
+	void markMoveStale(unsigned int nodeIndex, unsigned int oldModuleIndex, unsigned int newModuleIndex);
+
+	void initMoveScratch();
+
+	void clearMoveScratch();
+
+	/**
+	 * If the delta flow between a node and a module also depends on the flow data
+	 * of the module, and not only on the links to its members.
+	 */
+	bool deltaFlowDependsOnModuleFlow(DirectedWithRecordedTeleportation) const { return true; }
+	bool deltaFlowDependsOnModuleFlow(NotDirectedWithRecordedTeleportation) const { return false; }
+
 	unsigned int tryMoveEachNodeIntoStrongestConnectedModule();
 
 	virtual void moveNodesToPredefinedModules();
@@ -106,6 +170,16 @@ protected:
 	virtual unsigned int consolidateModules(bool replaceExistingStructure, bool asSubModules);
 
 	unsigned int m_coreLoopCount;
+	ActiveNetworkIndex m_activeNetworkIndex;
+	DeltaCodelengthBatch m_deltaCodelengthBatch;
+
+	// State of the parallel core loop, sized once per optimization level
+	std::vector<MoveScratch> m_moveScratch;
+	unsigned int m_maxNumModuleLinks;
+	std::vector<ProposedMove> m_proposedMoves;
+	std::vector<unsigned int> m_moveQueue;
+	std::vector<unsigned int> m_batchPosition;
+	std::vector<unsigned char> m_moduleChanged;
 	using Super::m_treeData;
 	using Super::m_config;
 };
@@ -366,6 +440,11 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::optimizeModules()
 		loopLimit = static_cast<unsigned int>(Super::m_rand() * (loopLimit - minRandLoop)) + minRandLoop;
 	unsigned int loopLimitOnAggregationLevels = 20;
 
+	// The links are constant during the optimization, index them for the core loop
+	m_activeNetworkIndex.build(Super::m_activeNetwork);
+	if (Super::m_config.innerParallelization && Super::isTopLevel())
+		initMoveScratch();
+
 	// Iterate while the optimization loop moves some nodes within the dynamic modular structure
 	do
 	{
@@ -378,6 +457,9 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::optimizeModules()
 	} while (m_coreLoopCount != (Super::m_aggregationLevel == 0 && !Super::m_isCoarseTune? loopLimit : loopLimitOnAggregationLevels) &&
 			Super::codelength < oldCodelength - Super::m_config.minimumCodelengthImprovement);
 
+	m_activeNetworkIndex.clear();
+	clearMoveScratch();
+
 	return m_coreLoopCount;
 }
 
@@ -418,6 +500,7 @@ template<typename InfomapGreedyDerivedType>
 inline
 unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoBestModule()
 {
+	ActiveNetworkIndex& activeNetwork = m_activeNetworkIndex;
 	unsigned int numNodes = Super::m_activeNetwork.size();
 	// Get random enumeration of nodes
 	std::vector<unsigned int> randomOrder(numNodes);
@@ -441,11 +524,11 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 
 		// Pick nodes in random order
 		unsigned int flip = randomOrder[i];
-		NodeType& current = getNode(*Super::m_activeNetwork[flip]);
-
-		if (!current.dirty)
+		if (!activeNetwork.dirty(flip))
 			continue;
 
+		NodeType& current = getNode(*Super::m_activeNetwork[flip]);
+
 		// Don't move out from previous merge on first loop
 		if (Super::m_moduleMembers[current.index] > 1 && Super::isFirstLoop())
 			continue;
@@ -482,43 +565,37 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 		else
 		{
 			// For all outlinks
-			for (NodeBase::edge_iterator edgeIt(current.begin_outEdge()), endIt(current.end_outEdge());
-					edgeIt != endIt; ++edgeIt)
+			for (const ActiveNetworkIndex::Link* linkIt(activeNetwork.beginOutLinks(flip)), *endIt(activeNetwork.endOutLinks(flip));
+					linkIt != endIt; ++linkIt)
 			{
-				EdgeType& edge = **edgeIt;
-				if (edge.isSelfPointing())
-					continue;
-				NodeType& neighbour = getNode(edge.target);
+				unsigned int neighbourModule = activeNetwork.module(linkIt->node);
 
-				if (redirect[neighbour.index] >= offset)
+				if (redirect[neighbourModule] >= offset)
 				{
-					moduleDeltaEnterExit[redirect[neighbour.index] - offset].deltaExit += edge.data.flow;
+					moduleDeltaEnterExit[redirect[neighbourModule] - offset].deltaExit += linkIt->flow;
 				}
 				else
 				{
-					redirect[neighbour.index] = offset + numModuleLinks;
-					moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbour.index, edge.data.flow, 0.0);
+					redirect[neighbourModule] = offset + numModuleLinks;
+					moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbourModule, linkIt->flow, 0.0);
 					++numModuleLinks;
 				}
 			}
 		}
 		// For all inlinks
-		for (NodeBase::edge_iterator edgeIt(current.begin_inEdge()), endIt(current.end_inEdge());
-				edgeIt != endIt; ++edgeIt)
+		for (const ActiveNetworkIndex::Link* linkIt(activeNetwork.beginInLinks(flip)), *endIt(activeNetwork.endInLinks(flip));
+				linkIt != endIt; ++linkIt)
 		{
-			EdgeType& edge = **edgeIt;
-			if (edge.isSelfPointing())
-				continue;
-			NodeType& neighbour = getNode(edge.source);
+			unsigned int neighbourModule = activeNetwork.module(linkIt->node);
 
-			if (redirect[neighbour.index] >= offset)
+			if (redirect[neighbourModule] >= offset)
 			{
-				moduleDeltaEnterExit[redirect[neighbour.index] - offset].deltaEnter += edge.data.flow;
+				moduleDeltaEnterExit[redirect[neighbourModule] - offset].deltaEnter += linkIt->flow;
 			}
 			else
 			{
-				redirect[neighbour.index] = offset + numModuleLinks;
-				moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbour.index, 0.0, edge.data.flow);
+				redirect[neighbourModule] = offset + numModuleLinks;
+				moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbourModule, 0.0, linkIt->flow);
 				++numModuleLinks;
 			}
 		}
@@ -563,13 +640,16 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 		DeltaFlowType strongestConnectedModule(oldModuleDelta);
 		double deltaCodelengthOnStrongestConnectedModule = 0.0;
 
+		Super::getDeltaCodelengthOnMovingNode(current, oldModuleDelta, moduleDeltaEnterExit, numModuleLinks, m_deltaCodelengthBatch);
+		const std::vector<double>& moduleDeltaCodelength = m_deltaCodelengthBatch.deltaCodelength;
+
 		// Find the move that minimizes the description length
 		for (unsigned int j = 0; j < numModuleLinks; ++j)
 		{
 			unsigned int otherModule = moduleDeltaEnterExit[j].module;
 			if(otherModule != current.index)
 			{
-				double deltaCodelength = Super::getDeltaCodelengthOnMovingNode(current, oldModuleDelta, moduleDeltaEnterExit[j]);
+				double deltaCodelength = moduleDeltaCodelength[j];
 				deltaCodelength += derived().getDeltaCodelengthOnMovingMemoryNode(oldModuleDelta, moduleDeltaEnterExit[j]);
 
 				if (deltaCodelength < bestDeltaCodelength - Super::m_config.minimumSingleNodeCodelengthImprovement)
@@ -616,6 +696,7 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 
 			unsigned int oldModuleIndex = current.index;
 			current.index = bestModuleIndex;
+			activeNetwork.module(flip) = bestModuleIndex;
 
 			// Update physical node map on move for memory networks
 			derived().performMoveOfMemoryNode(current, oldModuleIndex, bestModuleIndex);
@@ -623,19 +704,16 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 			++numMoved;
 
 			// Mark neighbours as dirty
-			for (NodeBase::edge_iterator edgeIt(current.begin_outEdge()), endIt(current.end_outEdge());
-					edgeIt != endIt; ++edgeIt)
-				(*edgeIt)->target.dirty = true;
-			for (NodeBase::edge_iterator edgeIt(current.begin_inEdge()), endIt(current.end_inEdge());
-					edgeIt != endIt; ++edgeIt)
-				(*edgeIt)->source.dirty = true;
+			activeNetwork.markNeighboursDirty(flip);
 		}
 		else
-			current.dirty = false;
+			activeNetwork.setDirty(flip, false);
 
 		offset += numNodes;
 	}
 
+	activeNetwork.storeDirtyFlags(Super::m_activeNetwork);
+
 	return numMoved;
 }
 
@@ -829,9 +907,19 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 /**
  * Minimize the codelength by trying to move each node into best module, in parallel.
  *
- * For each node:
- * 1. Calculate the change in codelength for a move to each of its neighbouring modules or to an empty module
- * 2. Move to the one that reduces the codelength the most, if any.
+ * The nodes are processed in batches, in random order. For each batch:
+ * 1. Find the best move of each node in parallel, against the modular structure before the batch.
+ * 2. Commit the moves in order. The delta codelength of a move is updated to the current
+ * flow of its two modules, and the move is kept if it still decreases the codelength. A move
+ * conflicts with earlier moves in the batch if a neighbour, or a memory node sharing a
+ * physical node, has moved from or to one of its modules, or if its new module was an
+ * empty module claimed by another node.
+ *
+ * Conflicting nodes are deferred to a later batch, once, and are otherwise left dirty for
+ * the next core loop, so that no node is evaluated serially. The batch size shrinks when
+ * many moves conflict and grows again when few do.
+ *
+ * The result only depends on the seed, not on the number of threads.
  *
  * @return The number of nodes moved.
  */
@@ -843,270 +931,386 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::tryMoveEachNodeIntoB
 	if (!Super::isTopLevel())
 		return tryMoveEachNodeIntoBestModule();
 
+	ActiveNetworkIndex& activeNetwork = m_activeNetworkIndex;
 	unsigned int numNodes = Super::m_activeNetwork.size();
-	// Get random enumeration of nodes
-	std::vector<unsigned int> randomOrder(numNodes);
-	infomath::getRandomizedIndexVector(randomOrder, Super::m_rand);
+	// Get random enumeration of nodes, the deferred nodes are appended
+	std::vector<unsigned int>& moveQueue = m_moveQueue;
+	moveQueue.resize(numNodes);
+	infomath::getRandomizedIndexVector(moveQueue, Super::m_rand);
+
+	// Fixed limits to not make the result depend on the number of threads
+	const unsigned int MIN_BATCH_SIZE = 1 << 10;
+	const unsigned int MAX_BATCH_SIZE = 1 << 14;
+	const int CHUNK_SIZE = 64;
+	const unsigned int NOT_IN_BATCH = std::numeric_limits<unsigned int>::max();
+
+	// The flow between a node and its modules may also change by moves of non-neighbours
+	bool checkModuleChanges = deltaFlowDependsOnModuleFlow(DirectedWithRecordedTeleportationType());
+	std::vector<ProposedMove>& moves = m_proposedMoves;
+	moves.resize(std::min(MAX_BATCH_SIZE, numNodes));
+	std::vector<unsigned int>& batchPosition = m_batchPosition;
+	std::vector<unsigned char>& moduleChanged = m_moduleChanged;
+	std::vector<unsigned int> changedModules;
 
 	unsigned int numMoved = 0;
-	unsigned int numInvalidMoves = 0;
-	double diffSerialParallelCodelength = 0.0;
-	const unsigned int emptyTarget = numNodes; // Use last node index + 1 as index for empty module target.
-	int numNodesInt = static_cast<int>(numNodes);
-
-//#pragma omp parallel for schedule(static)
-#pragma omp parallel for schedule(dynamic) // Use dynamic scheduling as some threads could end early
-	for (int i = 0; i < numNodesInt; ++i)
+	unsigned int batchSize = MAX_BATCH_SIZE;
+	unsigned int batchBegin = 0;
+	while (batchBegin < moveQueue.size())
 	{
-//		printf("Node %d processed by thread %d\n", i, omp_get_thread_num());
-		// Pick nodes in random order
-		unsigned int flip = randomOrder[i];
-		NodeType& current = getNode(*Super::m_activeNetwork[flip]);
+		unsigned int batchEnd = std::min(batchBegin + batchSize, static_cast<unsigned int>(moveQueue.size()));
+		int numInBatch = static_cast<int>(batchEnd - batchBegin);
+		int numChunks = (numInBatch + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		// Candidate empty module for all nodes in the batch, claimed by the first move to it
+		unsigned int emptyModule = Super::m_emptyModules.empty() ? numNodes : Super::m_emptyModules.back();
+
+#pragma omp parallel for schedule(dynamic) if(numChunks > 1)
+		for (int chunk = 0; chunk < numChunks; ++chunk)
+		{
+			int threadIndex = 0;
+#ifdef _OPENMP
+			threadIndex = omp_get_thread_num();
+#endif
+			MoveScratch& threadScratch = m_moveScratch[threadIndex];
+			threadScratch.resize(numNodes, m_maxNumModuleLinks);
+			int end = std::min(numInBatch, (chunk + 1) * CHUNK_SIZE);
+			for (int i = chunk * CHUNK_SIZE; i < end; ++i)
+				findBestMove(moveQueue[batchBegin + i], emptyModule, threadScratch, moves[i]);
+		}
 
-		if (!current.dirty)
-			continue;
+		for (int i = 0; i < numInBatch; ++i)
+			batchPosition[moveQueue[batchBegin + i]] = i;
 
-		// If other nodes have moved here, don't move away on first loop
-		if (Super::m_moduleMembers[current.index] > 1 && Super::isFirstLoop())
-			continue;
+		unsigned int numProposed = 0;
+		unsigned int numConflicts = 0;
+		for (int i = 0; i < numInBatch; ++i)
+		{
+			ProposedMove& move = moves[i];
+			unsigned int flip = moveQueue[batchBegin + i];
+			batchPosition[flip] = NOT_IN_BATCH;
+			if (move.action != ProposedMove::MOVE && move.action != ProposedMove::STALE)
+				continue;
+			++numProposed;
 
-		// Don't decrease the number of modules if already equal the preferred number
-		if (Super::isTopLevel() && Super::numActiveModules() == m_config.preferredNumberOfModules && Super::m_moduleMembers[current.index] == 1)
-			continue;
+			NodeType& current = getNode(*Super::m_activeNetwork[flip]);
+			unsigned int oldModuleIndex = move.oldModuleDelta.module;
+			unsigned int bestModuleIndex = move.newModuleDelta.module;
+			bool isValid = move.action == ProposedMove::MOVE;
 
-		// If no links connecting this node with other nodes, it won't move into others,
-		// and others won't move into this. TODO: Always best leave it alone?
-//		if (current.degree() == 0)
-		if (current.degree() == 0 ||
-			(Super::m_config.includeSelfLinks &&
-			(current.outDegree() == 1 && current.inDegree() == 1) &&
-			(**current.begin_outEdge()).target == current))
-		{
-			DEBUG_OUT("SKIPPING isolated node " << current << "\n");
-			//TODO: If not skipping self-links, this yields different results from moveNodesToPredefinedModules!!
-			ASSERT(!m_config.includeSelfLinks);
-			current.dirty = false;
-			continue;
-		}
+			if (isValid && bestModuleIndex == emptyModule && Super::m_moduleMembers[bestModuleIndex] != 0)
+				isValid = false;
 
-		// Create map with module links
-		std::map<unsigned int, DeltaFlowType> deltaFlow;
+			if (isValid && checkModuleChanges && (moduleChanged[oldModuleIndex] || moduleChanged[bestModuleIndex]))
+				isValid = false;
 
-		// If alone in the module, add virtual link to the module (used when adding teleportation)
-		deltaFlow[current.index] += DeltaFlowType(current.index, 0.0, 0.0);
+			// Keep the preferred number of modules
+			if (isValid && m_config.preferredNumberOfModules != 0 && Super::numActiveModules() == m_config.preferredNumberOfModules &&
+					(Super::m_moduleMembers[oldModuleIndex] == 1 || Super::m_moduleMembers[bestModuleIndex] == 0))
+				isValid = false;
 
-		// For all outlinks
-		for (NodeBase::edge_iterator edgeIt(current.begin_outEdge()), endIt(current.end_outEdge());
-				edgeIt != endIt; ++edgeIt)
-		{
-			EdgeType& edge = **edgeIt;
-			if (edge.isSelfPointing())
-				continue;
-			NodeType& neighbour = getNode(edge.target);
+			if (isValid)
+			{
+				// The flow between the node and the two modules is unchanged, but not the flow of the modules.
+				// Keep the move if it still improves the codelength, or is not worse than proposed
+				double deltaCodelength = Super::getDeltaCodelengthOnMovingNode(current, move.oldModuleDelta, move.newModuleDelta);
+				deltaCodelength += derived().getDeltaCodelengthOnMovingMemoryNode(move.oldModuleDelta, move.newModuleDelta);
+				isValid = deltaCodelength < -m_config.minimumSingleNodeCodelengthImprovement ||
+						deltaCodelength <= move.deltaCodelength + m_config.minimumCodelengthImprovement;
+			}
 
-			deltaFlow[neighbour.index] += DeltaFlowType(neighbour.index, edge.data.flow, 0.0);
-		}
-		// For all inlinks
-		for (NodeBase::edge_iterator edgeIt(current.begin_inEdge()), endIt(current.end_inEdge());
-				edgeIt != endIt; ++edgeIt)
-		{
-			EdgeType& edge = **edgeIt;
-			if (edge.isSelfPointing())
+			if (!isValid)
+			{
+				++numConflicts;
+				// Defer to a later batch if not deferred before, the node is still dirty
+				if (batchBegin + i < numNodes)
+					moveQueue.push_back(flip);
 				continue;
-			NodeType& neighbour = getNode(edge.source);
+			}
 
-			deltaFlow[neighbour.index] += DeltaFlowType(neighbour.index, 0.0, edge.data.flow);
-		}
+			//Update empty module vector
+			if (Super::m_moduleMembers[bestModuleIndex] == 0)
+			{
+				std::vector<unsigned int>& emptyModules = Super::m_emptyModules;
+				unsigned int pos = emptyModules.size() - 1;
+				while (emptyModules[pos] != bestModuleIndex)
+					--pos;
+				emptyModules.erase(emptyModules.begin() + pos);
+			}
+			if (Super::m_moduleMembers[oldModuleIndex] == 1)
+			{
+				Super::m_emptyModules.push_back(oldModuleIndex);
+			}
 
+			Super::updateCodelengthOnMovingNode(current, move.oldModuleDelta, move.newModuleDelta);
+			derived().updateCodelengthOnMovingMemoryNode(move.oldModuleDelta, move.newModuleDelta);
 
-		// Empty function if no teleportation coding model
-		Super::template addTeleportationDeltaFlowIfMove<DeltaFlowType>(current, deltaFlow);
+			Super::m_moduleMembers[oldModuleIndex] -= 1;
+			Super::m_moduleMembers[bestModuleIndex] += 1;
 
-		// Option to move to empty module (if node not already alone, and not already at the preferred number of modules)
-		unsigned int emptyModuleIndex = emptyTarget;
-		if (Super::m_moduleMembers[current.index] > 1 && Super::m_emptyModules.size() > 0 &&
-				(m_config.preferredNumberOfModules == 0 || (Super::isTopLevel() && Super::numActiveModules() != m_config.preferredNumberOfModules)))
-		{
-			emptyModuleIndex = Super::m_emptyModules.back();
-			deltaFlow[emptyModuleIndex] += DeltaFlowType(emptyModuleIndex, 0.0, 0.0);
-		}
+			current.index = bestModuleIndex;
+			activeNetwork.module(flip) = bestModuleIndex;
 
-		// Store the DeltaFlow of the current module
-		DeltaFlowType oldModuleDelta(deltaFlow[current.index]);
+			// Update physical node map on move for memory networks
+			derived().performMoveOfMemoryNode(current, oldModuleIndex, bestModuleIndex);
 
-		// For memory networks
-		derived().addContributionOfMovingMemoryNodes(current, oldModuleDelta, deltaFlow);
+			++numMoved;
 
+			// Mark neighbours as dirty
+			activeNetwork.markNeighboursDirty(flip);
 
-		std::vector<DeltaFlowType> moduleDeltaEnterExit(deltaFlow.size());
-		unsigned int numModuleLinks = 0;
-		for (typename std::map<unsigned int, DeltaFlowType>::iterator it(deltaFlow.begin()); it != deltaFlow.end(); ++it)
-		{
-			moduleDeltaEnterExit[numModuleLinks] = it->second;
-			++numModuleLinks;
-		}
+			// Mark the later moves of neighbours from or to the two modules as stale
+			for (const ActiveNetworkIndex::Link* linkIt(activeNetwork.beginOutLinks(flip)), *endIt(activeNetwork.endInLinks(flip));
+					linkIt != endIt; ++linkIt)
+				markMoveStale(linkIt->node, oldModuleIndex, bestModuleIndex);
+			derived().markStaleMovesOfMemoryNeighbours(current, oldModuleIndex, bestModuleIndex);
 
-		// Randomize link order for optimized search
-		for (unsigned int j = 0; j < numModuleLinks - 1; ++j)
-		{
-			unsigned int randPos = j + Super::m_rand.randInt(numModuleLinks - j - 1);
-			swap(moduleDeltaEnterExit[j], moduleDeltaEnterExit[randPos]);
+			if (checkModuleChanges)
+			{
+				moduleChanged[oldModuleIndex] = 1;
+				moduleChanged[bestModuleIndex] = 1;
+				changedModules.push_back(oldModuleIndex);
+				changedModules.push_back(bestModuleIndex);
+			}
 		}
 
-		DeltaFlowType bestDeltaModule(oldModuleDelta);
-		double bestDeltaCodelength = 0.0;
-		DeltaFlowType strongestConnectedModule(oldModuleDelta);
-		double deltaCodelengthOnStrongestConnectedModule = 0.0;
+		for (unsigned int i = 0; i < changedModules.size(); ++i)
+			moduleChanged[changedModules[i]] = 0;
+		changedModules.clear();
 
-		// Find the move that minimizes the description length
-		for (unsigned int j = 0; j < numModuleLinks; ++j)
-		{
-			unsigned int otherModule = moduleDeltaEnterExit[j].module;
-			if(otherModule != current.index)
-			{
-				double deltaCodelength = Super::getDeltaCodelengthOnMovingNode(current, oldModuleDelta, moduleDeltaEnterExit[j]);
-				deltaCodelength += derived().getDeltaCodelengthOnMovingMemoryNode(oldModuleDelta, moduleDeltaEnterExit[j]);
+		batchBegin = batchEnd;
+		if (numConflicts * 4 > numProposed)
+			batchSize = std::max(MIN_BATCH_SIZE, batchSize / 2);
+		else if (numConflicts * 16 < numProposed)
+			batchSize = std::min(MAX_BATCH_SIZE, batchSize * 2);
+	}
 
-				if (deltaCodelength < bestDeltaCodelength - Super::m_config.minimumSingleNodeCodelengthImprovement)
-				{
-					bestDeltaModule = moduleDeltaEnterExit[j];
-					bestDeltaCodelength = deltaCodelength;
-				}
+	activeNetwork.storeDirtyFlags(Super::m_activeNetwork);
 
-				// Save strongest connected module to prefer if codelength improvement equal
-				if (moduleDeltaEnterExit[j].deltaExit > strongestConnectedModule.deltaExit)
-				{
-					strongestConnectedModule = moduleDeltaEnterExit[j];
-					deltaCodelengthOnStrongestConnectedModule = deltaCodelength;
-				}
-			}
-		}
+	return numMoved;
+}
 
-		// Prefer strongest connected module if equal delta codelength
-		if (strongestConnectedModule.module != bestDeltaModule.module &&
-				deltaCodelengthOnStrongestConnectedModule <= bestDeltaCodelength)// + Super::m_config.minimumCodelengthImprovement)
+/**
+ * Mark the proposed move of a node later in the batch as stale if it is from or to
+ * one of the modules of a committed move.
+ */
+template<typename InfomapGreedyDerivedType>
+inline
+void InfomapGreedyCommon<InfomapGreedyDerivedType>::markMoveStale(unsigned int nodeIndex, unsigned int oldModuleIndex, unsigned int newModuleIndex)
+{
+	unsigned int position = m_batchPosition[nodeIndex];
+	if (position == std::numeric_limits<unsigned int>::max())
+		return;
+	ProposedMove& move = m_proposedMoves[position];
+	if (move.action != ProposedMove::MOVE)
+		return;
+	unsigned int moveOldModule = move.oldModuleDelta.module;
+	unsigned int moveNewModule = move.newModuleDelta.module;
+	if (moveOldModule == oldModuleIndex || moveOldModule == newModuleIndex ||
+			moveNewModule == oldModuleIndex || moveNewModule == newModuleIndex)
+		move.action = ProposedMove::STALE;
+}
+
+/**
+ * Size the state of the parallel core loop for the active network. The scratch
+ * arrays of each thread are filled on first use.
+ */
+template<typename InfomapGreedyDerivedType>
+inline
+void InfomapGreedyCommon<InfomapGreedyDerivedType>::initMoveScratch()
+{
+	unsigned int numNodes = Super::m_activeNetwork.size();
+	int numThreads = 1;
+#ifdef _OPENMP
+	numThreads = omp_get_max_threads();
+#endif
+	derived().indexPhysicalNodes();
+	// The module links of a node, its own module, an empty module and for memory nodes
+	// the other modules of its physical nodes
+	m_maxNumModuleLinks = std::min(numNodes + 1,
+			m_activeNetworkIndex.maxDegree() + 2 + derived().maxNumPhysicalModuleLinks());
+	m_moveScratch.resize(numThreads);
+	m_moveQueue.reserve(2 * numNodes);
+	m_batchPosition.assign(numNodes, std::numeric_limits<unsigned int>::max());
+	m_moduleChanged.assign(numNodes, 0);
+}
+
+template<typename InfomapGreedyDerivedType>
+inline
+void InfomapGreedyCommon<InfomapGreedyDerivedType>::clearMoveScratch()
+{
+	for (unsigned int i = 0; i < m_moveScratch.size(); ++i)
+		m_moveScratch[i].clear();
+	std::vector<ProposedMove>().swap(m_proposedMoves);
+	std::vector<unsigned int>().swap(m_moveQueue);
+	std::vector<unsigned int>().swap(m_batchPosition);
+	std::vector<unsigned char>().swap(m_moduleChanged);
+	m_maxNumModuleLinks = 0;
+	derived().clearPhysicalNodeIndex();
+}
+
+/**
+ * Find the best move of a node without changing the modular structure,
+ * to evaluate the moves of many nodes in parallel. Only the dirty flag of
+ * the node is cleared if it is best to stay, so that later moves in the
+ * batch can mark it dirty again.
+ * @param emptyModule An empty module to consider, or the number of nodes if none
+ */
+template<typename InfomapGreedyDerivedType>
+inline
+void InfomapGreedyCommon<InfomapGreedyDerivedType>::findBestMove(unsigned int nodeIndex, unsigned int emptyModule,
+		MoveScratch& scratch, ProposedMove& move)
+{
+	ActiveNetworkIndex& activeNetwork = m_activeNetworkIndex;
+	move.action = ProposedMove::SKIP;
+	if (!activeNetwork.dirty(nodeIndex))
+		return;
+
+	unsigned int currentModule = activeNetwork.module(nodeIndex);
+
+	// If other nodes have moved here, don't move away on first loop
+	if (Super::m_moduleMembers[currentModule] > 1 && Super::isFirstLoop())
+		return;
+
+	// Don't decrease the number of modules if already equal the preferred number
+	if (Super::isTopLevel() && Super::numActiveModules() == m_config.preferredNumberOfModules && Super::m_moduleMembers[currentModule] == 1)
+		return;
+
+	NodeType& current = getNode(*Super::m_activeNetwork[nodeIndex]);
+	std::vector<unsigned int>& redirect = scratch.redirect;
+	std::vector<DeltaFlowType>& moduleDeltaEnterExit = scratch.moduleDeltaEnterExit;
+	unsigned int numNodes = redirect.size();
+
+	// Reset offset before overflow
+	if (scratch.offset > std::numeric_limits<unsigned int>::max() - 1 - numNodes)
+	{
+		redirect.assign(numNodes, 0);
+		scratch.offset = 1;
+	}
+	unsigned int offset = scratch.offset;
+	scratch.offset += numNodes;
+
+	// Create vector with module links
+
+	unsigned int numModuleLinks = 0;
+	if (current.isDangling())
+	{
+		redirect[currentModule] = offset + numModuleLinks;
+		moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(currentModule, 0.0, 0.0);
+		++numModuleLinks;
+	}
+	else
+	{
+		// For all outlinks
+		for (const ActiveNetworkIndex::Link* linkIt(activeNetwork.beginOutLinks(nodeIndex)), *endIt(activeNetwork.endOutLinks(nodeIndex));
+				linkIt != endIt; ++linkIt)
 		{
-			bestDeltaModule = strongestConnectedModule;
+			unsigned int neighbourModule = activeNetwork.module(linkIt->node);
+
+			if (redirect[neighbourModule] >= offset)
+			{
+				moduleDeltaEnterExit[redirect[neighbourModule] - offset].deltaExit += linkIt->flow;
+			}
+			else
+			{
+				redirect[neighbourModule] = offset + numModuleLinks;
+				moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbourModule, linkIt->flow, 0.0);
+				++numModuleLinks;
+			}
 		}
+	}
+	// For all inlinks
+	for (const ActiveNetworkIndex::Link* linkIt(activeNetwork.beginInLinks(nodeIndex)), *endIt(activeNetwork.endInLinks(nodeIndex));
+			linkIt != endIt; ++linkIt)
+	{
+		unsigned int neighbourModule = activeNetwork.module(linkIt->node);
 
-		// Make best possible move
-		if(bestDeltaModule.module == current.index)
+		if (redirect[neighbourModule] >= offset)
 		{
-			current.dirty = false;
-			continue;
+			moduleDeltaEnterExit[redirect[neighbourModule] - offset].deltaEnter += linkIt->flow;
 		}
 		else
 		{
-#pragma omp critical (moveUpdate)
-			{
-				unsigned int bestModuleIndex = bestDeltaModule.module;
-				unsigned int oldModuleIndex = current.index;
+			redirect[neighbourModule] = offset + numModuleLinks;
+			moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(neighbourModule, 0.0, linkIt->flow);
+			++numModuleLinks;
+		}
+	}
 
-				bool validMove = true;
-				if (bestModuleIndex == emptyModuleIndex)	{
-					// Check validity of move to empty target
-					validMove = Super::m_moduleMembers[current.index] > 1 && Super::m_emptyModules.size() > 0;
-				}
-				else
-				{
-					// Not valid if the best module is empty now but not when decided
-					validMove = Super::m_moduleMembers[bestModuleIndex] > 0;
-				}
+	// If alone in the module, add virtual link to the module (used when adding teleportation)
+	if (redirect[currentModule] < offset)
+	{
+		redirect[currentModule] = offset + numModuleLinks;
+		moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(currentModule, 0.0, 0.0);
+		++numModuleLinks;
+	}
 
-				if (validMove)
-				{
+	// Empty function if no teleportation coding model
+	Super::template addTeleportationDeltaFlowIfMove<DeltaFlowType>(current, moduleDeltaEnterExit, numModuleLinks);
 
-					// Recalculate delta codelength for proposed move to see if still an improvement
-					DeltaFlowType oldModuleDelta(oldModuleIndex, 0.0, 0.0, 0.0, 0.0);
-					DeltaFlowType newModuleDelta(bestModuleIndex, 0.0, 0.0, 0.0, 0.0);
-
-					Super::addTeleportationDeltaFlowOnOldModuleIfMove(current, oldModuleDelta);
-					Super::addTeleportationDeltaFlowOnNewModuleIfMove(current, newModuleDelta);
-
-					// For all outlinks
-					for (NodeBase::edge_iterator edgeIt(current.begin_outEdge()), endIt(current.end_outEdge());
-							edgeIt != endIt; ++edgeIt)
-					{
-						EdgeType& edge = **edgeIt;
-						if (edge.isSelfPointing())
-							continue;
-						unsigned int otherModule = edge.target.index;
-						if (otherModule == oldModuleIndex)
-							oldModuleDelta.deltaExit += edge.data.flow;
-						else if (otherModule == bestModuleIndex)
-							newModuleDelta.deltaExit += edge.data.flow;
-					}
-
-					// For all inlinks
-					for (NodeBase::edge_iterator edgeIt(current.begin_inEdge()), endIt(current.end_inEdge());
-							edgeIt != endIt; ++edgeIt)
-					{
-						EdgeType& edge = **edgeIt;
-						if (edge.isSelfPointing())
-							continue;
-						unsigned int otherModule = edge.source.index;
-						if (otherModule == oldModuleIndex)
-							oldModuleDelta.deltaEnter += edge.data.flow;
-						else if (otherModule == bestModuleIndex)
-							newModuleDelta.deltaEnter += edge.data.flow;
-					}
-
-
-					double deltaCodelength = Super::getDeltaCodelengthOnMovingNode(current, oldModuleDelta, newModuleDelta);
-					deltaCodelength += derived().getDeltaCodelengthOnMovingMemoryNode(oldModuleDelta, newModuleDelta);
-
-					if (deltaCodelength <= 0.0 - Super::m_config.minimumSingleNodeCodelengthImprovement)
-					{
-						//Update empty module vector
-						if(Super::m_moduleMembers[bestModuleIndex] == 0)
-						{
-							Super::m_emptyModules.pop_back();
-						}
-						if(Super::m_moduleMembers[oldModuleIndex] == 1)
-						{
-							Super::m_emptyModules.push_back(oldModuleIndex);
-						}
-
-						Super::updateCodelengthOnMovingNode(current, oldModuleDelta, newModuleDelta);
-						derived().updateCodelengthOnMovingMemoryNode(oldModuleDelta, newModuleDelta);
-
-						// Update physical node map on move for memory networks
-						derived().performMoveOfMemoryNode(current, oldModuleIndex, bestModuleIndex);
-
-						// Mark neighbours as dirty
-						for (NodeBase::edge_iterator edgeIt(current.begin_outEdge()), endIt(current.end_outEdge());
-								edgeIt != endIt; ++edgeIt)
-							(*edgeIt)->target.dirty = true;
-						for (NodeBase::edge_iterator edgeIt(current.begin_inEdge()), endIt(current.end_inEdge());
-								edgeIt != endIt; ++edgeIt)
-							(*edgeIt)->source.dirty = true;
-
-						Super::m_moduleMembers[oldModuleIndex] -= 1;
-						Super::m_moduleMembers[bestModuleIndex] += 1;
-
-						current.index = bestModuleIndex;
-						++numMoved;
-						diffSerialParallelCodelength += bestDeltaCodelength - deltaCodelength;
-					}
-					else
-					{
-						++numInvalidMoves;
-					}
-				}
-				else
-				{
-					++numInvalidMoves;
-				}
+	// Option to move to empty module (if node not already alone, and not already at the preferred number of modules)
+	if (Super::m_moduleMembers[currentModule] > 1 && emptyModule != numNodes &&
+			(m_config.preferredNumberOfModules == 0 || (Super::isTopLevel() && Super::numActiveModules() != m_config.preferredNumberOfModules)))
+	{
+		moduleDeltaEnterExit[numModuleLinks] = DeltaFlowType(emptyModule, 0.0, 0.0);
+		++numModuleLinks;
+	}
+
+	// Store the DeltaFlow of the current module
+	DeltaFlowType oldModuleDelta(moduleDeltaEnterExit[redirect[currentModule] - offset]);
+
+	// For memory networks
+	derived().addContributionOfMovingMemoryNodes(current, oldModuleDelta, moduleDeltaEnterExit, redirect, offset, numModuleLinks);
+
+	DeltaFlowType bestDeltaModule(oldModuleDelta);
+	double bestDeltaCodelength = 0.0;
+	DeltaFlowType strongestConnectedModule(oldModuleDelta);
+	double deltaCodelengthOnStrongestConnectedModule = 0.0;
+
+	Super::getDeltaCodelengthOnMovingNode(current, oldModuleDelta, moduleDeltaEnterExit, numModuleLinks, scratch.deltaCodelengthBatch);
+	const std::vector<double>& moduleDeltaCodelength = scratch.deltaCodelengthBatch.deltaCodelength;
+
+	// Find the move that minimizes the description length
+	for (unsigned int j = 0; j < numModuleLinks; ++j)
+	{
+		unsigned int otherModule = moduleDeltaEnterExit[j].module;
+		if(otherModule != currentModule)
+		{
+			double deltaCodelength = moduleDeltaCodelength[j];
+			deltaCodelength += derived().getDeltaCodelengthOnMovingMemoryNode(oldModuleDelta, moduleDeltaEnterExit[j]);
+
+			if (deltaCodelength < bestDeltaCodelength - Super::m_config.minimumSingleNodeCodelengthImprovement)
+			{
+				bestDeltaModule = moduleDeltaEnterExit[j];
+				bestDeltaCodelength = deltaCodelength;
+			}
+
+			// Save strongest connected module to prefer if codelength improvement equal
+			if (moduleDeltaEnterExit[j].deltaExit > strongestConnectedModule.deltaExit)
+			{
+				strongestConnectedModule = moduleDeltaEnterExit[j];
+				deltaCodelengthOnStrongestConnectedModule = deltaCodelength;
 			}
 		}
+	}
 
+	// Prefer strongest connected module if equal delta codelength
+	if (strongestConnectedModule.module != bestDeltaModule.module &&
+			deltaCodelengthOnStrongestConnectedModule <= bestDeltaCodelength + Super::m_config.minimumCodelengthImprovement)
+	{
+		bestDeltaModule = strongestConnectedModule;
+		bestDeltaCodelength = deltaCodelengthOnStrongestConnectedModule;
 	}
 
-//	Log() << "\n(#invalidMoves: " << numInvalidMoves <<
-//			", diffSerialParallelCodelength: " << diffSerialParallelCodelength << ") ";
+	if (bestDeltaModule.module == currentModule)
+	{
+		move.action = ProposedMove::STAY;
+		activeNetwork.setDirty(nodeIndex, false);
+		return;
+	}
 
-//	return numMoved;
-	return numMoved + numInvalidMoves;
+	move.action = ProposedMove::MOVE;
+	move.oldModuleDelta = oldModuleDelta;
+	move.newModuleDelta = bestDeltaModule;
+	move.deltaCodelength = bestDeltaCodelength;
 }
 
 
@@ -1357,7 +1561,7 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::consolidateModules(b
 		unsigned int moduleIndex = node->index;
 		if (modules[moduleIndex] == 0)
 		{
-			modules[moduleIndex] = new NodeType(Super::m_moduleFlowData[moduleIndex]);
+			modules[moduleIndex] = new (Super::m_treeData.nodeFactory().memoryPool()) NodeType(Super::m_moduleFlowData[moduleIndex]);
 			node->parent->addChild(modules[moduleIndex]);
 			modules[moduleIndex]->index = moduleIndex;
 			// If node->parent is a module, its former children (leafnodes) has been released above, getting only submodules
@@ -1390,44 +1594,68 @@ unsigned int InfomapGreedyCommon<InfomapGreedyDerivedType>::consolidateModules(b
 	}
 
 
-	// Aggregate links from lower level to the new modular level
-	typedef std::pair<NodeBase*, NodeBase*> NodePair;
-	typedef std::map<NodePair, double> EdgeMap;
-	EdgeMap moduleLinks;
+	// Aggregate links from lower level to the new modular level. The links are relabeled to module
+	// index pairs and collected in chunks of the active network, then radix sorted and aggregated
+	// into rows of module links. Duplicates are summed in active network order, so the result
+	// doesn't depend on memory addresses or on the number of threads.
+	const int CHUNK_SIZE = 1 << 12;
+	int numChunks = (static_cast<int>(numNodes) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::vector<link_index> chunkOffsets(numChunks + 1, 0);
 
-	for (typename Super::activeNetwork_iterator nodeIt(Super::m_activeNetwork.begin()), nodeEnd(Super::m_activeNetwork.end());
-			nodeIt != nodeEnd; ++nodeIt)
+#pragma omp parallel for schedule(dynamic) if(numChunks > 1)
+	for (int chunk = 0; chunk < numChunks; ++chunk)
 	{
-		NodeBase* node = *nodeIt;
-
-		NodeBase* parent = node->parent;
-		for (NodeBase::edge_iterator edgeIt(node->begin_outEdge()), edgeEnd(node->end_outEdge());
-				edgeIt != edgeEnd; ++edgeIt)
+		unsigned int end = std::min(numNodes, static_cast<unsigned int>((chunk + 1) * CHUNK_SIZE));
+		link_index numLinks = 0;
+		for (unsigned int i = chunk * CHUNK_SIZE; i < end; ++i)
 		{
-			EdgeType* edge = *edgeIt;
-			NodeBase* otherParent = edge->target.parent;
+			NodeBase* node = Super::m_activeNetwork[i];
+			for (NodeBase::edge_iterator edgeIt(node->begin_outEdge()), edgeEnd(node->end_outEdge());
+					edgeIt != edgeEnd; ++edgeIt)
+			{
+				if ((*edgeIt)->target.index != node->index)
+					++numLinks;
+			}
+		}
+		chunkOffsets[chunk + 1] = numLinks;
+	}
+	for (int chunk = 0; chunk < numChunks; ++chunk)
+		chunkOffsets[chunk + 1] += chunkOffsets[chunk];
 
-			if (otherParent != parent)
+	SparseLinks moduleLinks;
+	SparseLinks::Entry* entries = moduleLinks.extend(chunkOffsets[numChunks]);
+
+#pragma omp parallel for schedule(dynamic) if(numChunks > 1)
+	for (int chunk = 0; chunk < numChunks; ++chunk)
+	{
+		unsigned int end = std::min(numNodes, static_cast<unsigned int>((chunk + 1) * CHUNK_SIZE));
+		SparseLinks::Entry* entry = entries + chunkOffsets[chunk];
+		for (unsigned int i = chunk * CHUNK_SIZE; i < end; ++i)
+		{
+			NodeBase* node = Super::m_activeNetwork[i];
+			unsigned int moduleIndex = node->index;
+			for (NodeBase::edge_iterator edgeIt(node->begin_outEdge()), edgeEnd(node->end_outEdge());
+					edgeIt != edgeEnd; ++edgeIt)
 			{
-				NodeBase *m1 = parent, *state = otherParent;
+				EdgeType* edge = *edgeIt;
+				unsigned int otherModuleIndex = edge->target.index;
+				if (otherModuleIndex == moduleIndex)
+					continue;
+				unsigned int m1 = moduleIndex, m2 = otherModuleIndex;
 				// If undirected, the order may be swapped to aggregate the edge on an opposite one
-				if (!IsDirectedType() && m1->index > state->index)
-					std::swap(m1, state);
-				// Insert the node pair in the edge map. If not inserted, add the flow value to existing node pair.
-				std::pair<EdgeMap::iterator, bool> ret = \
-						moduleLinks.insert(std::make_pair(NodePair(m1, state), edge->data.flow));
-				if (!ret.second)
-					ret.first->second += edge->data.flow;
+				if (!IsDirectedType() && m1 > m2)
+					std::swap(m1, m2);
+				*entry++ = SparseLinks::Entry(m1, m2, edge->data.flow);
 			}
 		}
 	}
+	moduleLinks.compact(numNodes);
 
 	// Add the aggregated edge flow structure to the new modules
-	for (EdgeMap::const_iterator edgeIt(moduleLinks.begin()), edgeEnd(moduleLinks.end());
-			edgeIt != edgeEnd; ++edgeIt)
+	for (unsigned int m1 = 0; m1 < moduleLinks.numRows(); ++m1)
 	{
-		const NodePair& nodePair = edgeIt->first;
-		nodePair.first->addOutEdge(*nodePair.second, 0.0, edgeIt->second);
+		for (SparseLinks::Row row(moduleLinks.row(m1)); !row.empty(); row.pop())
+			modules[m1]->addOutEdge(*modules[row.target()], 0.0, row.weight());
 	}
 
 	// Replace active network with its children if not at leaf level.
@@ -30,12 +30,37 @@
 #include "InfomapGreedy.h"
 #include "flowData.h"
 #include <map>
+#include <vector>
 
 #ifdef NS_INFOMAP
 namespace infomap
 {
 #endif
 
+/**
+ * Scratch arrays to calculate the delta codelength of moving a node to many modules at once.
+ * The arguments to each plogp term are stored for all modules in turn, to be evaluated in one batch.
+ */
+struct DeltaCodelengthBatch
+{
+	// Fewer modules are calculated one by one, as the batch wouldn't pay off
+	static const unsigned int MIN_SIZE = 8;
+
+	void resize(unsigned int numTerms, unsigned int numModules)
+	{
+		if (plogpArguments.size() < numTerms * numModules)
+		{
+			plogpArguments.resize(numTerms * numModules);
+			plogpValues.resize(numTerms * numModules);
+		}
+		if (deltaCodelength.size() < numModules)
+			deltaCodelength.resize(numModules);
+	}
+	std::vector<double> plogpArguments;
+	std::vector<double> plogpValues;
+	std::vector<double> deltaCodelength;
+};
+
 /**
  * Infomap methods specialized on the flow type, e.g. including teleportation flow if coding teleportation.
  * As methods can't be partially specialized, the network type template variable is dropped, so
@@ -77,6 +102,16 @@ protected:
 	void addTeleportationDeltaFlowIfMove(NodeType& current, std::map<unsigned int, DeltaFlowType>& moduleDeltaFlow) {}
 
 	double getDeltaCodelengthOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta, DeltaFlow& newModuleDelta);
+
+	/**
+	 * Calculate the delta codelength of moving a node to each of the new modules into
+	 * batch.deltaCodelength, with identical results to calling getDeltaCodelengthOnMovingNode
+	 * for each. The terms of the old module are only calculated once. The result for
+	 * the old module itself, if among the new modules, is undefined.
+	 */
+	template<typename DeltaFlowType>
+	void getDeltaCodelengthOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta,
+			std::vector<DeltaFlowType>& newModuleDeltas, unsigned int numNewModules, DeltaCodelengthBatch& batch);
 	void updateCodelengthOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta, DeltaFlow& newModuleDelta);
 
 	void updateFlowOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta, DeltaFlow& newModuleDelta);
@@ -311,6 +346,159 @@ double InfomapGreedySpecialized<FlowUndirected>::getDeltaCodelengthOnMovingNode(
 	return deltaL;
 }
 
+template<typename FlowType>
+template<typename DeltaFlowType>
+inline
+void InfomapGreedySpecialized<FlowType>::getDeltaCodelengthOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta,
+		std::vector<DeltaFlowType>& newModuleDeltas, unsigned int numNewModules, DeltaCodelengthBatch& batch)
+{
+	if (numNewModules < DeltaCodelengthBatch::MIN_SIZE)
+	{
+		batch.resize(0, numNewModules);
+		for (unsigned int j = 0; j < numNewModules; ++j)
+		{
+			if (newModuleDeltas[j].module != oldModuleDelta.module)
+				batch.deltaCodelength[j] = getDeltaCodelengthOnMovingNode(current, oldModuleDelta, newModuleDeltas[j]);
+		}
+		return;
+	}
+
+	using infomath::plogp;
+	std::vector<FlowType>& moduleFlowData = Super::m_moduleFlowData;
+	const FlowType& oldModuleData = moduleFlowData[oldModuleDelta.module];
+	double deltaEnterExitOldModule = oldModuleDelta.deltaEnter + oldModuleDelta.deltaExit;
+
+	double plogpOldEnter = plogp(oldModuleData.enterFlow);
+	double plogpOldEnterAfter = plogp(oldModuleData.enterFlow - current.data.enterFlow + deltaEnterExitOldModule);
+	double plogpOldExit = plogp(oldModuleData.exitFlow);
+	double plogpOldExitAfter = plogp(oldModuleData.exitFlow - current.data.exitFlow + deltaEnterExitOldModule);
+	double plogpOldFlow = plogp(oldModuleData.exitFlow + oldModuleData.flow);
+	double plogpOldFlowAfter = plogp(oldModuleData.exitFlow + oldModuleData.flow \
+			- current.data.exitFlow - current.data.flow + deltaEnterExitOldModule);
+
+	const unsigned int numTerms = 7;
+	unsigned int n = numNewModules;
+	batch.resize(numTerms, n);
+	double* enter = &batch.plogpArguments[0];
+	double* newEnter = enter + n;
+	double* newEnterAfter = newEnter + n;
+	double* newExit = newEnterAfter + n;
+	double* newExitAfter = newExit + n;
+	double* newFlow = newExitAfter + n;
+	double* newFlowAfter = newFlow + n;
+	for (unsigned int j = 0; j < n; ++j)
+	{
+		// No move to the old module, plogp of zero is free
+		if (newModuleDeltas[j].module == oldModuleDelta.module)
+		{
+			enter[j] = newEnter[j] = newEnterAfter[j] = newExit[j] = newExitAfter[j] = newFlow[j] = newFlowAfter[j] = 0.0;
+			continue;
+		}
+		const FlowType& newModuleData = moduleFlowData[newModuleDeltas[j].module];
+		double deltaEnterExitNewModule = newModuleDeltas[j].deltaEnter + newModuleDeltas[j].deltaExit;
+		enter[j] = Super::enterFlow + deltaEnterExitOldModule - deltaEnterExitNewModule;
+		newEnter[j] = newModuleData.enterFlow;
+		newEnterAfter[j] = newModuleData.enterFlow + current.data.enterFlow - deltaEnterExitNewModule;
+		newExit[j] = newModuleData.exitFlow;
+		newExitAfter[j] = newModuleData.exitFlow + current.data.exitFlow - deltaEnterExitNewModule;
+		newFlow[j] = newModuleData.exitFlow + newModuleData.flow;
+		newFlowAfter[j] = newModuleData.exitFlow + newModuleData.flow \
+				+ current.data.exitFlow + current.data.flow - deltaEnterExitNewModule;
+	}
+
+	plogp(&batch.plogpArguments[0], &batch.plogpValues[0], numTerms * n);
+
+	const double* plogpEnter = &batch.plogpValues[0];
+	const double* plogpNewEnter = plogpEnter + n;
+	const double* plogpNewEnterAfter = plogpNewEnter + n;
+	const double* plogpNewExit = plogpNewEnterAfter + n;
+	const double* plogpNewExitAfter = plogpNewExit + n;
+	const double* plogpNewFlow = plogpNewExitAfter + n;
+	const double* plogpNewFlowAfter = plogpNewFlow + n;
+	for (unsigned int j = 0; j < n; ++j)
+	{
+		double delta_enter = plogpEnter[j] - Super::enterFlow_log_enterFlow;
+		double delta_enter_log_enter = - plogpOldEnter - plogpNewEnter[j] + plogpOldEnterAfter + plogpNewEnterAfter[j];
+		double delta_exit_log_exit = - plogpOldExit - plogpNewExit[j] + plogpOldExitAfter + plogpNewExitAfter[j];
+		double delta_flow_log_flow = - plogpOldFlow - plogpNewFlow[j] + plogpOldFlowAfter + plogpNewFlowAfter[j];
+		batch.deltaCodelength[j] = delta_enter - delta_enter_log_enter - delta_exit_log_exit + delta_flow_log_flow;
+	}
+}
+
+template<>
+template<typename DeltaFlowType>
+inline
+void InfomapGreedySpecialized<FlowUndirected>::getDeltaCodelengthOnMovingNode(NodeType& current, DeltaFlow& oldModuleDelta,
+		std::vector<DeltaFlowType>& newModuleDeltas, unsigned int numNewModules, DeltaCodelengthBatch& batch)
+{
+	if (numNewModules < DeltaCodelengthBatch::MIN_SIZE)
+	{
+		batch.resize(0, numNewModules);
+		for (unsigned int j = 0; j < numNewModules; ++j)
+		{
+			if (newModuleDeltas[j].module != oldModuleDelta.module)
+				batch.deltaCodelength[j] = getDeltaCodelengthOnMovingNode(current, oldModuleDelta, newModuleDeltas[j]);
+		}
+		return;
+	}
+
+	using infomath::plogp;
+	std::vector<FlowType>& moduleFlowData = Super::m_moduleFlowData;
+	const FlowType& oldModuleData = moduleFlowData[oldModuleDelta.module];
+	double deltaEnterExitOldModule = oldModuleDelta.deltaEnter + oldModuleDelta.deltaExit;
+
+	// Double the effect as each link works in both directions
+	deltaEnterExitOldModule *= 2;
+
+	double plogpOldExit = plogp(oldModuleData.exitFlow);
+	double plogpOldExitAfter = plogp(oldModuleData.exitFlow - current.data.exitFlow + deltaEnterExitOldModule);
+	double plogpOldFlow = plogp(oldModuleData.exitFlow + oldModuleData.flow);
+	double plogpOldFlowAfter = plogp(oldModuleData.exitFlow + oldModuleData.flow \
+			- current.data.exitFlow - current.data.flow + deltaEnterExitOldModule);
+
+	const unsigned int numTerms = 5;
+	unsigned int n = numNewModules;
+	batch.resize(numTerms, n);
+	double* exit = &batch.plogpArguments[0];
+	double* newExit = exit + n;
+	double* newExitAfter = newExit + n;
+	double* newFlow = newExitAfter + n;
+	double* newFlowAfter = newFlow + n;
+	for (unsigned int j = 0; j < n; ++j)
+	{
+		// No move to the old module, plogp of zero is free
+		if (newModuleDeltas[j].module == oldModuleDelta.module)
+		{
+			exit[j] = newExit[j] = newExitAfter[j] = newFlow[j] = newFlowAfter[j] = 0.0;
+			continue;
+		}
+		const FlowType& newModuleData = moduleFlowData[newModuleDeltas[j].module];
+		double deltaEnterExitNewModule = newModuleDeltas[j].deltaEnter + newModuleDeltas[j].deltaExit;
+		deltaEnterExitNewModule *= 2;
+		exit[j] = enterFlow + deltaEnterExitOldModule - deltaEnterExitNewModule;
+		newExit[j] = newModuleData.exitFlow;
+		newExitAfter[j] = newModuleData.exitFlow + current.data.exitFlow - deltaEnterExitNewModule;
+		newFlow[j] = newModuleData.exitFlow + newModuleData.flow;
+		newFlowAfter[j] = newModuleData.exitFlow + newModuleData.flow \
+				+ current.data.exitFlow + current.data.flow - deltaEnterExitNewModule;
+	}
+
+	plogp(&batch.plogpArguments[0], &batch.plogpValues[0], numTerms * n);
+
+	const double* plogpExit = &batch.plogpValues[0];
+	const double* plogpNewExit = plogpExit + n;
+	const double* plogpNewExitAfter = plogpNewExit + n;
+	const double* plogpNewFlow = plogpNewExitAfter + n;
+	const double* plogpNewFlowAfter = plogpNewFlow + n;
+	for (unsigned int j = 0; j < n; ++j)
+	{
+		double delta_exit = plogpExit[j] - enterFlow_log_enterFlow;
+		double delta_exit_log_exit = - plogpOldExit - plogpNewExit[j] + plogpOldExitAfter + plogpNewExitAfter[j];
+		double delta_flow_log_flow = - plogpOldFlow - plogpNewFlow[j] + plogpOldFlowAfter + plogpNewFlowAfter[j];
+		batch.deltaCodelength[j] = delta_exit - 2.0*delta_exit_log_exit + delta_flow_log_flow;
+	}
+}
+
 
 /**
  * Update the codelength to reflect the move of node current
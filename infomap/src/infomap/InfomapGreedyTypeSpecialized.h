@@ -30,6 +30,7 @@
 
 #include "InfomapGreedyCommon.h"
 #include <ostream>
+#include "../io/version.h"
 
 #ifdef NS_INFOMAP
 namespace infomap
@@ -81,6 +82,14 @@ protected:
 
 	void consolidatePhysicalNodes(std::vector<NodeBase*>& modules) {}
 
+	void indexPhysicalNodes() {}
+
+	void clearPhysicalNodeIndex() {}
+
+	unsigned int maxNumPhysicalModuleLinks() { return 0; }
+
+	void markStaleMovesOfMemoryNeighbours(NodeType& current, unsigned int oldModuleIndex, unsigned int bestModuleIndex) {}
+
 	void generateNetworkFromChildren(NodeBase& parent);
 
 	using Super::calculateCodelengthFromActiveNetwork;
@@ -178,6 +187,14 @@ protected:
 
 	void consolidatePhysicalNodes(std::vector<NodeBase*>& modules);
 
+	void indexPhysicalNodes();
+
+	void clearPhysicalNodeIndex();
+
+	unsigned int maxNumPhysicalModuleLinks();
+
+	void markStaleMovesOfMemoryNeighbours(NodeType& current, unsigned int oldModuleIndex, unsigned int bestModuleIndex);
+
 	void generateNetworkFromChildren(NodeBase& parent);
 
 	virtual void saveHierarchicalNetwork(HierarchicalNetwork& output, std::string rootName, bool includeLinks);
@@ -204,7 +221,9 @@ private:
 
 	std::vector<ModuleToMemNodes> m_physToModuleToMemNodes; // vector[physicalNodeID] map<moduleID, {#memNodes, sumFlow}>
 	unsigned int m_numPhysicalNodes;
-
+	// The active nodes of each physical node, for the parallel core loop
+	std::vector<unsigned int> m_physNodeMembersBegin;
+	std::vector<unsigned int> m_physNodeMembers;
 
 };
 
@@ -294,7 +313,7 @@ inline bool InfomapGreedyTypeSpecialized<FlowType, WithMemory>::preClusterMultip
 	for (unsigned int i = 0; i < modules.size(); ++i) {
 		unsigned int moduleIndex = modules[i];
 		if (moduleNodes[moduleIndex] == 0)
-			moduleNodes[moduleIndex] = Super::m_treeData.nodeFactory().createNode("", 0.0, 0.0);
+			moduleNodes[moduleIndex] = Super::m_treeData.nodeFactory().createNode(0.0, 0.0);
 		// Set child pointers from the module nodes to all leaf nodes
 		moduleNodes[moduleIndex]->addChild(&Super::m_treeData.getLeafNode(i));
 	}
@@ -460,6 +479,81 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::initModuleOptimization(
 }
 
 
+/**
+ * Index the active nodes of each physical node.
+ */
+template<typename FlowType>
+void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::indexPhysicalNodes()
+{
+	m_physNodeMembersBegin.assign(m_numPhysicalNodes + 1, 0);
+	for (typename Super::activeNetwork_iterator it(Super::m_activeNetwork.begin()), itEnd(Super::m_activeNetwork.end());
+			it != itEnd; ++it)
+	{
+		NodeType& node = getNode(**it);
+		for (unsigned int j = 0; j < node.physicalNodes.size(); ++j)
+			++m_physNodeMembersBegin[node.physicalNodes[j].physNodeIndex + 1];
+	}
+	for (unsigned int i = 0; i < m_numPhysicalNodes; ++i)
+		m_physNodeMembersBegin[i + 1] += m_physNodeMembersBegin[i];
+
+	m_physNodeMembers.resize(m_physNodeMembersBegin[m_numPhysicalNodes]);
+	std::vector<unsigned int> position(m_physNodeMembersBegin.begin(), m_physNodeMembersBegin.end() - 1);
+	unsigned int nodeIndex = 0;
+	for (typename Super::activeNetwork_iterator it(Super::m_activeNetwork.begin()), itEnd(Super::m_activeNetwork.end());
+			it != itEnd; ++it, ++nodeIndex)
+	{
+		NodeType& node = getNode(**it);
+		for (unsigned int j = 0; j < node.physicalNodes.size(); ++j)
+			m_physNodeMembers[position[node.physicalNodes[j].physNodeIndex]++] = nodeIndex;
+	}
+}
+
+template<typename FlowType>
+void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::clearPhysicalNodeIndex()
+{
+	std::vector<unsigned int>().swap(m_physNodeMembersBegin);
+	std::vector<unsigned int>().swap(m_physNodeMembers);
+}
+
+/**
+ * The maximum number of modules that a node can reach through its physical nodes,
+ * as each module sharing a physical node has one of the nodes containing it.
+ */
+template<typename FlowType>
+unsigned int InfomapGreedyTypeSpecialized<FlowType, WithMemory>::maxNumPhysicalModuleLinks()
+{
+	unsigned int maxNumModules = 0;
+	for (typename Super::activeNetwork_iterator it(Super::m_activeNetwork.begin()), itEnd(Super::m_activeNetwork.end());
+			it != itEnd; ++it)
+	{
+		NodeType& node = getNode(**it);
+		unsigned int numModules = 0;
+		for (unsigned int j = 0; j < node.physicalNodes.size(); ++j)
+		{
+			unsigned int physNodeIndex = node.physicalNodes[j].physNodeIndex;
+			numModules += m_physNodeMembersBegin[physNodeIndex + 1] - m_physNodeMembersBegin[physNodeIndex];
+		}
+		maxNumModules = std::max(maxNumModules, numModules);
+	}
+	return maxNumModules;
+}
+
+/**
+ * The flow of the physical nodes in the two modules has changed for all nodes
+ * sharing a physical node with the moved node.
+ */
+template<typename FlowType>
+void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::markStaleMovesOfMemoryNeighbours(NodeType& current,
+		unsigned int oldModuleIndex, unsigned int bestModuleIndex)
+{
+	for (unsigned int i = 0; i < current.physicalNodes.size(); ++i)
+	{
+		unsigned int physNodeIndex = current.physicalNodes[i].physNodeIndex;
+		for (unsigned int j = m_physNodeMembersBegin[physNodeIndex]; j < m_physNodeMembersBegin[physNodeIndex + 1]; ++j)
+			Super::markMoveStale(m_physNodeMembers[j], oldModuleIndex, bestModuleIndex);
+	}
+}
+
 template<typename FlowType>
 void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::calculateNodeFlow_log_nodeFlowForMemoryNetwork()
 {
@@ -688,7 +782,7 @@ void InfomapGreedyTypeSpecialized<FlowType, NetworkType>::generateNetworkFromChi
 			childIt != endIt; ++childIt, ++i)
 	{
 		NodeType& otherNode = Super::getNode(*childIt);
-		NodeBase* node = new NodeType(otherNode);
+		NodeBase* node = new (Super::m_treeData.nodeFactory().memoryPool()) NodeType(otherNode);
 		node->originalIndex = childIt->originalIndex;
 		Super::m_treeData.addClonedNode(node);
 		childIt->index = i; // Set index to its place in this subnetwork to be able to find edge target below
@@ -709,7 +803,7 @@ void InfomapGreedyTypeSpecialized<FlowType, NetworkType>::generateNetworkFromChi
 			// If neighbour node is within the same module, add the link to this subnetwork.
 			if (edge.target.parent == parentPtr)
 			{
-				Super::m_treeData.addEdge(node.index, edge.target.index, edge.data.weight, edge.data.flow);
+				Super::m_treeData.addEdge(node.index, edge.target.index, edge.data.getWeight(), edge.data.flow);
 			}
 		}
 	}
@@ -751,7 +845,7 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::generateNetworkFromChil
 			childIt != endIt; ++childIt, ++i)
 	{
 		NodeType& otherNode = getNode(*childIt);
-		NodeBase* node = new NodeType(otherNode);
+		NodeBase* node = new (Super::m_treeData.nodeFactory().memoryPool()) NodeType(otherNode);
 		node->originalIndex = childIt->originalIndex;
 		Super::m_treeData.addClonedNode(node);
 		childIt->index = i; // Set index to its place in this subnetwork to be able to find edge target below
@@ -798,7 +892,7 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::generateNetworkFromChil
 			// If neighbour node is within the same module, add the link to this subnetwork.
 			if (edge.target.parent == parentPtr)
 			{
-				Super::m_treeData.addEdge(node.index, edge.target.index, edge.data.weight, edge.data.flow);
+				Super::m_treeData.addEdge(node.index, edge.target.index, edge.data.getWeight(), edge.data.flow);
 			}
 		}
 	}
@@ -823,22 +917,23 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::saveHierarchicalNetwork
 	if (Super::m_config.printExpanded)
 	{
 		// Create vector of node names for memory nodes
-		std::vector<std::string>& physicalNames = Super::m_nodeNames;
-		std::vector<std::string> stateNodeNames(Super::m_treeData.numLeafNodes());
-		unsigned int i = 0;
-		for (typename TreeData::leafIterator leafIt(Super::m_treeData.begin_leaf()); leafIt != Super::m_treeData.end_leaf(); ++leafIt, ++i)
+		NodeNames& physicalNames = Super::m_nodeNames;
+		NodeNames stateNodeNames;
+		stateNodeNames.reserve(Super::m_treeData.numLeafNodes());
+		for (typename TreeData::leafIterator leafIt(Super::m_treeData.begin_leaf()); leafIt != Super::m_treeData.end_leaf(); ++leafIt)
 		{
 			NodeType& node = getNode(**leafIt);
 			StateNode& stateNode = node.stateNode;
 			if (Super::m_config.isMultiplexNetwork())
-				stateNodeNames[i] = io::Str() << physicalNames[stateNode.physIndex] << " | " << (stateNode.layer() + indexOffset);
+				stateNodeNames.push_back(io::Str() << physicalNames[stateNode.physIndex] << " | " << (stateNode.layer() + indexOffset));
 			else
-				stateNodeNames[i] = stateNode.print(physicalNames, indexOffset);
+				stateNodeNames.push_back(stateNode.print(physicalNames, indexOffset));
 		}
 
 		ioNetwork.prepareAddLeafNodes(Super::m_treeData.numLeafNodes());
+		ioNetwork.setLeafNodeNames(stateNodeNames);
 
-		Super::buildHierarchicalNetworkHelper(ioNetwork, ioNetwork.getRootNode(), stateNodeNames);
+		Super::buildHierarchicalNetworkHelper(ioNetwork, ioNetwork.getRootNode());
 
 		if (includeLinks)
 		{
@@ -888,6 +983,7 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::saveHierarchicalNetwork
 
 	Log() << " to " << numCondensedNodes << " nodes... " << std::flush;
 	ioNetwork.prepareAddLeafNodes(numCondensedNodes);
+	ioNetwork.setLeafNodeNames(Super::m_nodeNames);
 
 	unsigned int sortedNodeIndex = 0;
 	for (unsigned int i = 0; i < leafModules.size(); ++i)
@@ -909,7 +1005,7 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::saveHierarchicalNetwork
 			CondensedIterator& condensedIt(it->second);
 			IndexedFlow& nodeData = condensedIt->second;
 			unsigned int physIndex = condensedIt->first;
-			ioNetwork.addLeafNode(*parent, nodeData.flowData.flow, nodeData.flowData.exitFlow, Super::m_nodeNames[nodeData.index], sortedNodeIndex, nodeData.index, false, 0, physIndex);
+			ioNetwork.addLeafNode(*parent, nodeData.flowData.flow, nodeData.flowData.exitFlow, sortedNodeIndex, nodeData.index, false, 0, physIndex);
 			// Remap to sorted indices to help link creation
 			nodeData.index = sortedNodeIndex;
 			++sortedNodeIndex;
@@ -946,6 +1042,8 @@ void InfomapGreedyTypeSpecialized<FlowType, WithMemory>::printClusterNumbers(std
 		"partitioned in " << m_config.elapsedTime() << " from codelength " <<
 		io::toPrecision(Super::oneLevelCodelength, 9, true) << " in one level to codelength " <<
 		io::toPrecision(Super::codelength, 9, true) << ".\n";
+	if (*INFOMAP_BUILD_OPTIONS)
+		out << "# Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 
 	if (m_config.printExpanded)
 	{
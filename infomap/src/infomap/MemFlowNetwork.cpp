@@ -27,6 +27,7 @@
 
 #include "MemFlowNetwork.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iterator>
@@ -43,6 +44,16 @@ namespace infomap
 {
 #endif
 
+namespace
+{
+	const unsigned int NODE_CHUNK_SIZE = 1 << 16;
+
+	bool lessWeight(const std::pair<double, unsigned int>& a, const std::pair<double, unsigned int>& b)
+	{
+		return a.first < b.first;
+	}
+}
+
 void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 {
 	if (!config.isMemoryNetwork())
@@ -61,35 +72,21 @@ void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 	m_nodeFlow.assign(numStateNodes, 0.0);
 	m_nodeTeleportRates.assign(numStateNodes, 0.0);
 
-	const MemNetwork::StateLinkMap& linkMap = network.stateLinkMap();
-	unsigned int numLinks = network.numStateLinks();
+	const SparseLinks& stateLinks = network.indexedStateLinks();
+	link_index numLinks = stateLinks.size();
 	m_flowLinks.resize(numLinks);
 	double totalStateLinkWeight = network.totalStateLinkWeight();
 	double sumUndirLinkWeight = 2 * totalStateLinkWeight - network.totalMemorySelfLinkWeight();
-	unsigned int linkIndex = 0;
-	const MemNetwork::StateNodeMap& nodeMap = network.stateNodeMap();
 
-	for (MemNetwork::StateLinkMap::const_iterator linkIt(linkMap.begin()); linkIt != linkMap.end(); ++linkIt)
+	for (unsigned int sourceIndex = 0; sourceIndex < stateLinks.numRows(); ++sourceIndex)
 	{
-		const StateNode& statesource = linkIt->first;
-		const std::map<StateNode, double>& subLinks = linkIt->second;
-		for (std::map<StateNode, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt, ++linkIndex)
+		for (link_index i = stateLinks.rowBegin(sourceIndex); i < stateLinks.rowEnd(sourceIndex); ++i)
 		{
-			const StateNode& statetarget = subIt->first;
-			double linkWeight = subIt->second;
-
-			// Get the indices for the state nodes
-			MemNetwork::StateNodeMap::const_iterator nodeMapIt = nodeMap.find(statesource);
-			if (nodeMapIt == nodeMap.end())
-				throw InputDomainError(io::Str() << "Couldn't find mapped index for source State node " << statesource);
-			unsigned int sourceIndex = nodeMapIt->second;
-			nodeMapIt = nodeMap.find(statetarget);
-			if (nodeMapIt == nodeMap.end())
-				throw InputDomainError(io::Str() << "Couldn't find mapped index for target State node " << statetarget);
-			unsigned int targetIndex = nodeMapIt->second;
+			unsigned int targetIndex = stateLinks.target(i);
+			double linkWeight = stateLinks.weight(i);
 
 			m_nodeFlow[sourceIndex] += linkWeight;// / sumUndirLinkWeight;
-			m_flowLinks[linkIndex] = Link(sourceIndex, targetIndex, linkWeight);
+			m_flowLinks[i] = Link(sourceIndex, targetIndex, linkWeight);
 
 			if (sourceIndex != targetIndex && !config.outdirdir)
 				m_nodeFlow[targetIndex] += linkWeight;// / sumUndirLinkWeight;
@@ -97,61 +94,37 @@ void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 		}
 	}
 
-	m_statenodes.resize(numStateNodes);
-	for (MemNetwork::StateNodeMap::const_iterator statenodeIt(nodeMap.begin()); statenodeIt != nodeMap.end(); ++statenodeIt)
-	{
-		m_statenodes[statenodeIt->second] = statenodeIt->first;
-	}
+	m_statenodes = network.indexedStateNodes();
 
 	if (!config.isStateNetwork() && !config.skipCompleteDanglingMemoryNodes)
 	{
-		unsigned int numM1Nodes = network.numNodes();
-		typedef std::multimap<double, unsigned int> PhysToMemWeightMap;
-		std::vector<PhysToMemWeightMap> netPhysToMem(numM1Nodes);
-
-		const LinkMap& m1LinkMap = network.linkMap();
-		// Map middle column in trigrams to target state nodes (source to link for m1 links)
-		for (LinkMap::const_iterator linkIt(m1LinkMap.begin()); linkIt != m1LinkMap.end(); ++linkIt)
+		// Map middle column in trigrams to target state nodes (source to link for m1 links),
+		// with the state nodes from each physical node ordered on the link weight
+		typedef std::pair<double, unsigned int> PhysToMemWeight;
+		const SparseLinks& m1Links = network.links();
+		std::vector<PhysToMemWeight> netPhysToMem(m1Links.size());
+		unsigned int numM1Rows = m1Links.numRows();
+		int numM1Chunks = static_cast<int>((numM1Rows + NODE_CHUNK_SIZE - 1) / NODE_CHUNK_SIZE);
+		int numMissing = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:numMissing) if(numM1Chunks > 1)
+		for (int c = 0; c < numM1Chunks; ++c)
 		{
-			unsigned int linkEnd1 = linkIt->first;
-			const std::map<unsigned int, double>& subLinks = linkIt->second;
-			for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+			unsigned int end = std::min(numM1Rows, (c + 1) * NODE_CHUNK_SIZE);
+			for (unsigned int linkEnd1 = c * NODE_CHUNK_SIZE; linkEnd1 < end; ++linkEnd1)
 			{
-				unsigned int linkEnd2 = subIt->first;
-				double linkWeight = subIt->second;
-				MemNetwork::StateNodeMap::const_iterator stateit = nodeMap.find(StateNode(linkEnd1, linkEnd2));
-				if (stateit == nodeMap.end())
-					throw InputDomainError(io::Str() << "Memory node (" << linkEnd1 << ", " << linkEnd2 << ") not indexed!");
-				unsigned int statenodeIndex = stateit->second;
-				PhysToMemWeightMap& physMap = netPhysToMem[linkEnd1];
-				physMap.insert(std::make_pair(linkWeight, statenodeIndex));
+				for (link_index i = m1Links.rowBegin(linkEnd1); i < m1Links.rowEnd(linkEnd1); ++i)
+				{
+					unsigned int statenodeIndex = network.findStateNodeIndex(StateNode(linkEnd1, m1Links.target(i)));
+					if (statenodeIndex == numStateNodes)
+						++numMissing;
+					netPhysToMem[i] = PhysToMemWeight(m1Links.weight(i), statenodeIndex);
+				}
+				std::stable_sort(netPhysToMem.begin() + m1Links.rowBegin(linkEnd1),
+						netPhysToMem.begin() + m1Links.rowEnd(linkEnd1), lessWeight);
 			}
 		}
-
-	// Other ways to complete dangling nodes...
-		// for (unsigned int i = 0; i < numStateNodes; ++i)
-		// {
-		// 	const StateNode& statenode = m_statenodes[i];
-		// 	PhysToMemWeightMap& physMap = netPhysToMem[statenode.priorState];
-		// 	double stateweight = network.stateNodes().find(statenode)->second;
-		// 	physMap.insert(std::make_pair(stateweight, i));
-		// }
-
-		// for (map<StateNode, double>::const_iterator stateit = network.stateNodes.begin(); stateit != network.stateNodes.end(); ++stateit)
-		// {
-		// 	const StateNode& statenode = stateit->first;
-		// 	double weight = stateit->second;
-		// 	PhysToMemWeightMap& physMap = netPhysToMem[statenode.priorState];
-		// 	physMap.insert(std::make_pair(weight, statenodeIndex));
-		// }
-
-		// for (unsigned int i = 0; i < m_flowLinks.size(); ++i)
-		// {
-		// 	const Link& link = m_flowLinks[i];
-		// 	const StateNode& statenode = m_statenodes[link.target];
-		// 	PhysToMemWeightMap& physMap = netPhysToMem[statenode.priorState];
-		// 	physMap.insert(std::make_pair(link.weight, link.target));
-		// }
+		if (numMissing != 0)
+			throw InputDomainError(io::Str() << numMissing << " memory nodes from first order links not indexed!");
 
 		// Add M1 flow to dangling State nodes
 		unsigned int numDanglingStateNodes = 0;
@@ -165,12 +138,14 @@ void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 				++numDanglingStateNodes;
 				// We are in physIndex, lookup all mem nodes in that physical node
 				// and add a link to the target node of those mem nodes (pre-mapped above)
-				const PhysToMemWeightMap& physToMem = netPhysToMem[m_statenodes[i].physIndex];
-				for(PhysToMemWeightMap::const_iterator it = physToMem.begin(); it != physToMem.end(); it++)
+				unsigned int physIndex = m_statenodes[i].physIndex;
+				if (physIndex >= numM1Rows)
+					continue;
+				for (link_index j = m1Links.rowBegin(physIndex); j < m1Links.rowEnd(physIndex); ++j)
 				{
 					unsigned int from = i;
-					unsigned int to = it->second;
-					double linkWeight = it->first;
+					unsigned int to = netPhysToMem[j].second;
+					double linkWeight = netPhysToMem[j].first;
 					if(linkWeight > 0.0) {
 						if(from == to) {
 							++numSelfLinks;
@@ -265,7 +240,7 @@ void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 		}
 		else // undirected
 		{
-			for (unsigned int i = 0; i < numLinks; ++i)
+			for (link_index i = 0; i < numLinks; ++i)
 				m_flowLinks[i].flow /= sumUndirLinkWeight;
 		}
 
@@ -323,90 +298,37 @@ void MemFlowNetwork::calculateFlow(const Network& net, const Config& config)
 			danglings.push_back(i);
 	}
 
-	// Calculate PageRank
-	std::vector<double> nodeFlowTmp(numStateNodes, 0.0);
-	unsigned int numIterations = 0;
-	double alpha = config.teleportationProbability;
-	double beta = 1.0 - alpha;
-	double sqdiff = 1.0;
-	double danglingRank = 0.0;
-	do
+	m_hasStartFlow = false;
+	if (!network.startNodeFlow().empty())
 	{
-		// Calculate dangling rank
-		danglingRank = 0.0;
-		for (std::vector<unsigned int>::iterator danglingIt(danglings.begin()); danglingIt != danglings.end(); ++danglingIt)
-		{
-			danglingRank += m_nodeFlow[*danglingIt];
-		}
-
-		// Flow from teleportation
+		// Split the start flow of each physical node over its state nodes in
+		// proportion to their initial flow
+		const std::vector<double>& physStartFlow = network.startNodeFlow();
+		std::vector<double> physFlow(physStartFlow.size(), 0.0);
 		for (unsigned int i = 0; i < numStateNodes; ++i)
 		{
-			nodeFlowTmp[i] = (alpha + beta*danglingRank) * m_nodeTeleportRates[i];
-		}
-
-		// Flow from links
-		for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
-		{
-			Link& link = *linkIt;
-			nodeFlowTmp[link.target] += beta * link.flow * m_nodeFlow[link.source];
+			if (m_statenodes[i].physIndex < physFlow.size())
+				physFlow[m_statenodes[i].physIndex] += m_nodeFlow[i];
 		}
-
-		// Update node flow from the power iteration above and check if converged
-		double sum = 0.0;
-		double sqdiff_old = sqdiff;
-		sqdiff = 0.0;
+		std::vector<double> startFlow(numStateNodes, -1.0);
 		for (unsigned int i = 0; i < numStateNodes; ++i)
 		{
-			sum += nodeFlowTmp[i];
-			sqdiff += std::abs(nodeFlowTmp[i] - m_nodeFlow[i]);
-			m_nodeFlow[i] = nodeFlowTmp[i];
+			unsigned int physIndex = m_statenodes[i].physIndex;
+			if (physIndex < physStartFlow.size() && physStartFlow[physIndex] >= 0.0 && physFlow[physIndex] > 0.0)
+				startFlow[i] = physStartFlow[physIndex] * m_nodeFlow[i] / physFlow[physIndex];
 		}
-
-		// Normalize if needed
-		if (std::abs(sum - 1.0) > 1.0e-10)
-		{
-			Log() << "(Normalizing ranks after " <<	numIterations << " power iterations with error " << (sum-1.0) << ") ";
-			for (unsigned int i = 0; i < numStateNodes; ++i)
-			{
-				m_nodeFlow[i] /= sum;
-			}
-			std::cerr << "DEBUG BREAK!!" << std::endl;
-			break;
-		}
-
-		// Perturb the system if equilibrium
-		if(sqdiff == sqdiff_old)
-		{
-			alpha += 1.0e-10;
-			beta = 1.0 - alpha;
-		}
-
-		numIterations++;
-	}  while((numIterations < 300) && (sqdiff > 1.0e-15 || numIterations < 50));
-
-	double sumNodeRank = 1.0;
-
-	if (!config.recordedTeleportation)
-	{
-		//Take one last power iteration excluding the teleportation (and normalize node flow to sum 1.0)
-		sumNodeRank = 1.0 - danglingRank;
-		m_nodeFlow.assign(numStateNodes, 0.0);
-		for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
-		{
-			Link& link = *linkIt;
-			m_nodeFlow[link.target] += link.flow * nodeFlowTmp[link.source] / sumNodeRank;
-		}
-		beta = 1.0;
+		setStartFlow(startFlow, danglings, config);
 	}
 
-	// Update the links with their global flow from the PageRank values. (Note: beta is set to 1 if unrec)
+	// Gather the transition probabilities on the in-links of each state node,
+	// including the links added to dangling state nodes
+	SparseLinks inLinks;
+	inLinks.reserve(m_flowLinks.size());
 	for (LinkVec::iterator linkIt(m_flowLinks.begin()); linkIt != m_flowLinks.end(); ++linkIt)
-	{
-		linkIt->flow *= beta * nodeFlowTmp[linkIt->source] / sumNodeRank;
-	}
+		inLinks.append(linkIt->target, linkIt->source, linkIt->flow);
+	inLinks.compact(numStateNodes);
 
-	Log() << "\n  -> PageRank calculation done in " << numIterations << " iterations." << std::endl;
+	calculatePageRank(inLinks, danglings, config, 300);
 }
 
 #ifdef NS_INFOMAP
@@ -27,9 +27,13 @@
 
 #include "MemNetwork.h"
 #include "../utils/FileURI.h"
+#include "../io/BinaryNetworkFormat.h"
 #include "../io/convert.h"
+#include "../io/LineReader.h"
 #include "../io/SafeFile.h"
+#include "../io/TextScanner.h"
 #include "../utils/Logger.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -44,12 +48,23 @@ namespace infomap
 
 using std::make_pair;
 
+namespace {
+	struct TrigramRecord
+	{
+		int n1;
+		unsigned int n2, n3;
+		double weight;
+	};
+}
+
 void MemNetwork::readInputData(std::string filename)
 {
 	if (filename.empty())
 		filename = m_config.networkFile;
 	if (m_config.inputFormat == "3gram")
 		parseTrigram(filename);
+	else if (m_config.inputFormat == "states" && isBinaryNetworkFile(filename))
+		parseBinaryStateNetwork(filename);
 	else if (m_config.inputFormat == "states")
 		parseStateNetwork(filename);
 	else
@@ -64,10 +79,9 @@ void MemNetwork::parseTrigram(std::string filename)
 	Log() << "Parsing directed trigram from file '" << filename << "'... " << std::flush;
 	string line;
 	string buf;
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
-	std::getline(input,line);
-	if (!input.good())
+	if (!input.getline(line) || input.eof())
 		throw FileFormatError("Can't read first line of pajek file.");
 
 	unsigned int numNodes = 0;
@@ -92,7 +106,8 @@ void MemNetwork::parseTrigram(std::string filename)
 		numNodes = m_config.nodeLimit;
 
 	m_numNodes = numNodes;
-	m_nodeNames.resize(numNodes);
+	m_nodeNames.clear();
+	m_nodeNames.reserve(numNodes);
 	m_nodeWeights.assign(numNodes, 1.0);
 	m_sumNodeWeights = 0.0;
 
@@ -100,43 +115,27 @@ void MemNetwork::parseTrigram(std::string filename)
 	for (unsigned int i = 0; i < numNodes; ++i)
 	{
 		unsigned int id = 0;
-		if (!(input >> id) || id != static_cast<unsigned int>(i+1))
-		{
-			throw BadConversionError(io::Str() << "Couldn't parse node number " << (i+1) << " from line " << (i+2) << ".");
-		}
-		std::getline(input,line);
-		unsigned int nameStart = line.find_first_of("\"");
-		unsigned int nameEnd = line.find_last_of("\"");
 		string name;
 		double nodeWeight = 1.0;
-		if(nameStart < nameEnd) {
-			name = string(line.begin() + nameStart + 1, line.begin() + nameEnd);
-			line = line.substr(nameEnd + 1);
-			ss.clear();
-			ss.str(line);
-		}
-		else {
-			ss.clear();
-			ss.str(line);
-			ss >> buf; // Take away the index from the stream
-			ss >> name; // Extract the next token as the name assuming no spaces
+		if (!parseVertex(input, id, name, nodeWeight) || id != static_cast<unsigned int>(i+1))
+		{
+			throw BadConversionError(io::Str() << "Couldn't parse node number " << (i+1) << " from line " << (i+2) << ".");
 		}
-		ss >> nodeWeight; // Extract the next token as node weight. If failed, the old value (1.0) is kept.
 		m_sumNodeWeights += nodeWeight;
 		m_nodeWeights[i] = nodeWeight;
 		//		m_nodeMap.insert(make_pair(name, i));
-		m_nodeNames[i] = name;
+		m_nodeNames.push_back(name);
 	}
 
 	if (m_config.nodeLimit > 0 && numNodes < specifiedNumNodes)
 	{
 		unsigned int surplus = specifiedNumNodes - numNodes;
 		for (unsigned int i = 0; i < surplus; ++i)
-			std::getline(input, line);
+			input.getline(line);
 	}
 
 	// Read the number of links in the network
-	getline(input, line);
+	input.getline(line);
 	ss.clear();
 	ss.str(line);
 	ss >> buf;
@@ -147,27 +146,26 @@ void MemNetwork::parseTrigram(std::string filename)
 	m_totalLinkWeight = 0.0;
 
 	// Read links in format "from through to [weight = 1.0]", for example "1 2 3 1.0"
-	while(!std::getline(input, line).fail())
-	{
-		if (line.length() == 0)
-			continue;
-
-		int n1;
-		unsigned int n2, n3;
-		double weight;
-		parseStateLink(line, n1, n2, n3, weight);
-
-		if (n1 + static_cast<int>(m_indexOffset) == -1)
-		{
-			addIncompleteStateLink(n2, n3, weight);
-		}
-		else
-			addStateLink(n1, n2, n2, n3, weight);
+	input.parseLines<TrigramRecord>(
+		[this](const char* begin, const char* end, TrigramRecord& link) -> bool {
+			if (begin == end)
+				return false;
+			parseStateLink(begin, end, link.n1, link.n2, link.n3, link.weight);
+			return true;
+		},
+		[this](const TrigramRecord& link) {
+			if (link.n1 + static_cast<int>(m_indexOffset) == -1)
+			{
+				addIncompleteStateLink(link.n2, link.n3, link.weight);
+			}
+			else
+				addStateLink(link.n1, link.n2, link.n2, link.n3, link.weight);
 
-		// Also add first order link to be able to complete dangling state nodes
-		if (n2 != n3 || m_config.includeSelfLinks)
-			insertLink(n2, n3, weight);
-	}
+			// Also add first order link to be able to complete dangling state nodes
+			if (link.n2 != link.n3 || m_config.includeSelfLinks)
+				insertLink(link.n2, link.n3, link.weight);
+		},
+		false);
 
 	Log() << "done!" << std::endl;
 
@@ -180,7 +178,7 @@ void MemNetwork::parseStateNetwork(std::string filename)
 	Log() << "Parsing state network from file '" <<
 			filename << "'... " << std::flush;
 
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
 	// Parse the vertices and return the line after
 	std::string line = parseVertices(input, false);
@@ -231,28 +229,86 @@ void MemNetwork::parseStateNetwork(std::string filename)
 	finalizeAndCheckNetwork();
 }
 
-std::string MemNetwork::parseStateNodes(std::ifstream& file)
+void MemNetwork::parseBinaryStateNetwork(std::string filename)
 {
-	std::string line;
-	while(!std::getline(file, line).fail())
+	Log() << "Loading binary state network from file '" <<
+			filename << "'... " << std::flush;
+
+	BinaryNetworkReader input(filename);
+	const BinaryNetworkHeader& header = input.header();
+
+	if (!(header.flags & BinaryNetwork::STATE_NETWORK))
+		throw FileFormatError(io::Str() << "The binary network file '" << filename <<
+				"' doesn't contain a state network.");
+
+	input.checkNumLinks(header.numLinks);
+	unsigned int numNodes = header.numNodes;
+	unsigned int numStateNodes = header.numStateNodes;
+	link_index numLinks = header.numLinks;
+	const unsigned int* stateIds = input.section<unsigned int>(BinaryNetwork::STATE_IDS, numStateNodes);
+	const unsigned int* physIds = input.section<unsigned int>(BinaryNetwork::STATE_PHYSICAL_IDS, numStateNodes);
+	const double* stateWeights = input.section<double>(BinaryNetwork::STATE_WEIGHTS, numStateNodes);
+	std::vector<link_index> convertedOffsets;
+	const link_index* offsets = input.linkOffsets(numStateNodes + 1, convertedOffsets);
+	const unsigned int* targets = input.section<unsigned int>(BinaryNetwork::LINK_TARGETS, numLinks);
+	if (stateIds == 0 || physIds == 0 || stateWeights == 0 || offsets == 0 || header.numRows != numStateNodes)
+		throw FileFormatError(io::Str() << "Missing state nodes in binary network file '" << filename << "'.");
+	if (targets == 0 && numLinks > 0)
+		throw FileFormatError(io::Str() << "Missing links in binary network file '" << filename << "'.");
+
+	bool floatWeights = (header.flags & BinaryNetwork::FLOAT_WEIGHTS) != 0;
+	const double* weights = floatWeights ? 0 : input.section<double>(BinaryNetwork::LINK_WEIGHTS, numLinks);
+	const float* weightsAsFloat = floatWeights ? input.section<float>(BinaryNetwork::LINK_WEIGHTS, numLinks) : 0;
+
+	readBinaryNodeNames(input, numNodes);
+	m_numNodes = m_numNodesFound = numNodes;
+
+	std::vector<StateNode> stateNodes(numStateNodes);
+	for (unsigned int i = 0; i < numStateNodes; ++i)
 	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
+		stateNodes[i] = StateNode(stateIds[i], physIds[i], stateWeights[i]);
+		addStateNode(stateNodes[i]);
+		++m_numStateNodesFound;
+	}
 
-		if (line[0] == '*')
-			break;
+	if (offsets[0] != 0 || offsets[numStateNodes] != numLinks)
+		throw FileFormatError(io::Str() << "Corrupt link offsets in binary network file '" << filename << "'.");
+	for (unsigned int source = 0; source < numStateNodes; ++source)
+	{
+		if (offsets[source] > offsets[source + 1])
+			throw FileFormatError(io::Str() << "Corrupt link offsets in binary network file '" << filename << "'.");
+		for (link_index i = offsets[source]; i < offsets[source + 1]; ++i)
+		{
+			if (targets[i] >= numStateNodes)
+				throw InputDomainError(io::Str() << "At least one link is defined with state node numbers that exceeds the number of nodes.");
+			double weight = weights != 0 ? weights[i] : weightsAsFloat != 0 ? weightsAsFloat[i] : 1.0;
+			addStateLink(stateNodes[source], stateNodes[targets[i]], weight);
+		}
+	}
 
-		StateNode stateNode;
-		parseStateNode(line, stateNode);
+	Log() << "done!" << std::endl;
 
-		addStateNode(stateNode);
+	finalizeAndCheckNetwork();
+}
 
-		++m_numStateNodesFound;
-	}
-	return line;
+std::string MemNetwork::parseStateNodes(LineReader& input)
+{
+	return input.parseLines<StateNode>(
+		[this](const char* begin, const char* end, StateNode& stateNode) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseStateNode(begin, end, stateNode);
+			return true;
+		},
+		[this](const StateNode& parsedStateNode) {
+			StateNode stateNode(parsedStateNode);
+			addStateNode(stateNode);
+
+			++m_numStateNodesFound;
+		});
 }
 
-std::string MemNetwork::parseStateLinks(std::ifstream& file)
+std::string MemNetwork::parseStateLinks(LineReader& input)
 {
 	// First index the state nodes on state index
 	// Check max state index to index in vector
@@ -274,28 +330,24 @@ std::string MemNetwork::parseStateLinks(std::ifstream& file)
 	}
 
 	// Parse state links
-	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int s1Index, s2Index;
-		double weight;
-		parseLink(line, s1Index, s2Index, weight);
+	return input.parseLines<SparseLinks::Entry>(
+		[this](const char* begin, const char* end, SparseLinks::Entry& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseLink(begin, end, link.source, link.target, link.weight);
+			return true;
+		},
+		[this, &stateNodes, zeroMinusOne](const SparseLinks::Entry& link) {
+			unsigned int s1Index = link.source;
+			unsigned int s2Index = link.target;
+			if (s1Index >= stateNodes.size() || s2Index >= stateNodes.size()) {
+				if (s1Index == zeroMinusOne || s2Index == zeroMinusOne)
+					throw InputDomainError(io::Str() << "Integer overflow, be sure to use zero-based node numbering if the node numbers start from zero.");
+				throw InputDomainError(io::Str() << "At least one link is defined with state node numbers that exceeds the number of nodes.");
 
-		if (s1Index >= stateNodes.size() || s2Index >= stateNodes.size()) {
-			if (s1Index == zeroMinusOne || s2Index == zeroMinusOne)
-				throw InputDomainError(io::Str() << "Integer overflow, be sure to use zero-based node numbering if the node numbers start from zero.");
-			throw InputDomainError(io::Str() << "At least one link is defined with state node numbers that exceeds the number of nodes.");
-
-		}
-		addStateLink(*stateNodes[s1Index], *stateNodes[s2Index], weight);
-	}
-	return line;
+			}
+			addStateLink(*stateNodes[s1Index], *stateNodes[s2Index], link.weight);
+		});
 }
 
 void MemNetwork::simulateMemoryFromOrdinaryNetwork()
@@ -310,16 +362,14 @@ void MemNetwork::simulateMemoryFromOrdinaryNetwork()
 	if (m_config.originallyUndirected)
 	{
 		Log() << "(inflating undirected network... " << std::flush;
-		LinkMap oldNetwork;
+		SparseLinks oldNetwork;
 		oldNetwork.swap(m_links);
-		for (LinkMap::const_iterator linkIt(oldNetwork.begin()); linkIt != oldNetwork.end(); ++linkIt)
+		for (unsigned int linkEnd1 = 0; linkEnd1 < oldNetwork.numRows(); ++linkEnd1)
 		{
-			unsigned int linkEnd1 = linkIt->first;
-			const std::map<unsigned int, double>& subLinks = linkIt->second;
-			for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+			for (link_index i = oldNetwork.rowBegin(linkEnd1); i < oldNetwork.rowEnd(linkEnd1); ++i)
 			{
-				unsigned int linkEnd2 = subIt->first;
-				double linkWeight = subIt->second;
+				unsigned int linkEnd2 = oldNetwork.target(i);
+				double linkWeight = oldNetwork.weight(i);
 				// Add link to both directions
 				insertLink(linkEnd1, linkEnd2, linkWeight);
 				insertLink(linkEnd2, linkEnd1, linkWeight);
@@ -327,31 +377,29 @@ void MemNetwork::simulateMemoryFromOrdinaryNetwork()
 		}
 
 		// Dispose old network from memory
-		LinkMap().swap(oldNetwork);
+		oldNetwork.clear();
+		compactLinks();
 		Log() << ") " << std::flush;
 	}
 
-	for (LinkMap::const_iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
+	for (unsigned int n1 = 0; n1 < m_links.numRows(); ++n1)
 	{
-		unsigned int n1 = linkIt->first;
-		const std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index i = m_links.rowBegin(n1); i < m_links.rowEnd(n1); ++i)
 		{
-			unsigned int n2 = subIt->first;
-			double firstLinkWeight = subIt->second;
+			unsigned int n2 = m_links.target(i);
+			double firstLinkWeight = m_links.weight(i);
 
 			// Create trigrams with all links that start with the end node of current link
-			LinkMap::iterator secondLinkIt = m_links.find(n2);
-			if (secondLinkIt != m_links.end())
+			unsigned int numSecondLinks = m_links.rowSize(n2);
+			if (numSecondLinks != 0)
 			{
-				std::map<unsigned int, double>& secondLinkSubMap = secondLinkIt->second;
-				for (std::map<unsigned int, double>::const_iterator secondSubIt(secondLinkSubMap.begin()); secondSubIt != secondLinkSubMap.end(); ++secondSubIt)
+				for (link_index j = m_links.rowBegin(n2); j < m_links.rowEnd(n2); ++j)
 				{
-					unsigned int n3 = secondSubIt->first;
-					double linkWeight = secondSubIt->second;
+					unsigned int n3 = m_links.target(j);
+					double linkWeight = m_links.weight(j);
 
 					if(!m_config.nonBacktracking || (n1 != n3))
-						addStateLink(n1, n2, n2, n3, linkWeight, firstLinkWeight / secondLinkSubMap.size(), 0.0);
+						addStateLink(n1, n2, n2, n3, linkWeight, firstLinkWeight / numSecondLinks, 0.0);
 
 				}
 			}
@@ -380,7 +428,7 @@ void MemNetwork::simulateMemoryToIncompleteData()
 	std::vector<std::deque<ComplementaryData> > complementaryData(m_numIncompleteStateLinks);
 	std::vector<int> incompleteSourceMapping(m_numNodes, -1);
 	int compactIndex = 0;
-	for (LinkMap::const_iterator linkIt(m_incompleteStateLinks.begin()); linkIt != m_incompleteStateLinks.end(); ++linkIt, ++compactIndex)
+	for (IncompleteLinkMap::const_iterator linkIt(m_incompleteStateLinks.begin()); linkIt != m_incompleteStateLinks.end(); ++linkIt, ++compactIndex)
 	{
 		unsigned int n1 = linkIt->first;
 		incompleteSourceMapping[n1] = compactIndex;
@@ -540,49 +588,23 @@ void MemNetwork::simulateMemoryToIncompleteData()
 
 }
 
-void MemNetwork::parseStateNode(const std::string& line, StateNode& stateNode)
+void MemNetwork::parseStateNode(const char* begin, const char* end, StateNode& stateNode) const
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> stateNode.stateIndex >> stateNode.physIndex))
-		throw FileFormatError(io::Str() << "Can't parse any state node from line '" << line << "'");
-	(m_extractor >> stateNode.weight) || (stateNode.weight = 1.0);
+	const char* pos = begin;
+	if (!io::scanUnsigned(pos, end, stateNode.stateIndex) || !io::scanUnsigned(pos, end, stateNode.physIndex))
+		throw FileFormatError(io::Str() << "Can't parse any state node from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, stateNode.weight))
+		stateNode.weight = 1.0;
 
 	stateNode.subtractIndexOffset(m_indexOffset);
 }
 
-void MemNetwork::parseStateLink(const std::string& line, int& n1, unsigned int& n2, unsigned int& n3, double& weight)
+void MemNetwork::parseStateLink(const char* begin, const char* end, int& n1, unsigned int& n2, unsigned int& n3, double& weight) const
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> n1 >> n2 >> n3))
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
-
-	n1 -= m_indexOffset;
-	n2 -= m_indexOffset;
-	n3 -= m_indexOffset;
-}
-
-void MemNetwork::parseStateLink(char line[], int& n1, unsigned int& n2, unsigned int& n3, double& weight)
-{
-	char *cptr;
-	cptr = strtok(line, " \t"); // Get first non-whitespace character position
-	if (cptr == NULL)
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	n1 = atoi(cptr); // get first connected node
-	cptr = strtok(NULL, " \t"); // Get second non-whitespace character position
-	if (cptr == NULL)
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	n2 = atoi(cptr); // get second connected node
-	cptr = strtok(NULL, " \t"); // Get third non-whitespace character position
-	if (cptr == NULL)
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	n3 = atoi(cptr); // get the third connected node
-	cptr = strtok(NULL, " \t"); // Get fourth non-whitespace character position
-	if (cptr != NULL)
-		weight = atof(cptr); // get the link weight
-	else
+	const char* pos = begin;
+	if (!io::scanInt(pos, end, n1) || !io::scanUnsigned(pos, end, n2) || !io::scanUnsigned(pos, end, n3))
+		throw FileFormatError(io::Str() << "Can't parse link data from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
 		weight = 1.0;
 
 	n1 -= m_indexOffset;
@@ -679,6 +701,19 @@ bool MemNetwork::addStateLink(StateLinkMap::iterator firstStateNode, unsigned in
 	return true;
 }
 
+link_index MemNetwork::addStateLinks(const unsigned int* n1PriorStates, const unsigned int* n1s,
+		const unsigned int* n2PriorStates, const unsigned int* n2s, const double* weights, std::size_t numLinks)
+{
+	link_index numAdded = 0;
+	for (std::size_t i = 0; i < numLinks; ++i)
+	{
+		double weight = weights == 0 ? 1.0 : weights[i];
+		if (addStateLink(n1PriorStates[i], n1s[i], n2PriorStates[i], n2s[i], weight, weight, 0.0))
+			++numAdded;
+	}
+	return numAdded;
+}
+
 bool MemNetwork::addStateLink(const StateNode& s1, const StateNode& s2, double weight)
 {
 	++m_numStateLinksFound;
@@ -761,7 +796,7 @@ bool MemNetwork::addIncompleteStateLink(unsigned int n1, unsigned int n2, double
 	++m_numIncompleteStateLinks;
 
 	// Aggregate link weights if they are definied more than once
-	LinkMap::iterator firstIt = m_incompleteStateLinks.lower_bound(n1);
+	IncompleteLinkMap::iterator firstIt = m_incompleteStateLinks.lower_bound(n1);
 	if (firstIt != m_incompleteStateLinks.end() && firstIt->first == n1) // First linkEnd already exists, check second linkEnd
 	{
 		std::pair<std::map<unsigned int, double>::iterator, bool> ret2 = firstIt->second.insert(std::make_pair(n2, weight));
@@ -784,7 +819,10 @@ bool MemNetwork::addIncompleteStateLink(unsigned int n1, unsigned int n2, double
 void MemNetwork::finalizeAndCheckNetwork(bool printSummary)
 {
 	m_isFinalized = true;
-	
+
+	// First order links inserted directly, as from trigrams, are not compacted yet
+	compactLinks();
+
 	simulateMemoryToIncompleteData();
 
 	if (m_stateLinks.empty())
@@ -822,7 +860,6 @@ void MemNetwork::finalizeAndCheckNetwork(bool printSummary)
 	m_stateNodeWeights.resize(m_stateNodes.size());
 	m_totStateNodeWeight = 0.0;
 	unsigned int stateNodeIndex = 0;
-	std::vector<unsigned int> existingPhysicalNodes(m_numNodes);
 	for(std::map<StateNode,double>::iterator it = m_stateNodes.begin(); it != m_stateNodes.end(); ++it, ++stateNodeIndex)
 	{
 		m_stateNodeMap[it->first] = stateNodeIndex;
@@ -831,6 +868,8 @@ void MemNetwork::finalizeAndCheckNetwork(bool printSummary)
 		m_totStateNodeWeight += weight;
 	}
 
+	indexStateNetwork();
+
 	initNodeDegrees();
 
 	if (printSummary)
@@ -856,33 +895,87 @@ unsigned int MemNetwork::addMissingPhysicalNodes()
 	return numMissingPhysicalNodes;
 }
 
+unsigned int MemNetwork::findStateNodeIndex(const StateNode& stateNode) const
+{
+	std::vector<StateNode>::const_iterator it = std::lower_bound(m_indexedStateNodes.begin(),
+			m_indexedStateNodes.end(), stateNode);
+	if (it == m_indexedStateNodes.end() || *it != stateNode)
+		return m_indexedStateNodes.size();
+	return static_cast<unsigned int>(it - m_indexedStateNodes.begin());
+}
+
+void MemNetwork::indexStateNetwork()
+{
+	unsigned int numStateNodes = m_stateNodes.size();
+	m_indexedStateNodes.clear();
+	m_indexedStateNodes.reserve(numStateNodes);
+	for (std::map<StateNode,double>::const_iterator it(m_stateNodes.begin()); it != m_stateNodes.end(); ++it)
+		m_indexedStateNodes.push_back(it->first);
+
+	// The link rows and the state nodes are both ordered on the state node, so
+	// the source indices are found by walking them together
+	std::vector<StateLinkMap::const_iterator> rows;
+	std::vector<unsigned int> rowSources;
+	rows.reserve(m_stateLinks.size());
+	rowSources.reserve(m_stateLinks.size());
+	std::vector<link_index> offsets(numStateNodes + 1, 0);
+	unsigned int sourceIndex = 0;
+	for (StateLinkMap::const_iterator linkIt(m_stateLinks.begin()); linkIt != m_stateLinks.end(); ++linkIt)
+	{
+		while (sourceIndex < numStateNodes && m_indexedStateNodes[sourceIndex] < linkIt->first)
+			++sourceIndex;
+		if (sourceIndex == numStateNodes || m_indexedStateNodes[sourceIndex] != linkIt->first)
+			throw InputDomainError(io::Str() << "Couldn't find mapped index for source State node " << linkIt->first);
+		offsets[sourceIndex + 1] = linkIt->second.size();
+		rows.push_back(linkIt);
+		rowSources.push_back(sourceIndex);
+	}
+	for (unsigned int i = 0; i < numStateNodes; ++i)
+		offsets[i + 1] += offsets[i];
+
+	// Look up the targets in parallel. The sub-links are ordered on the state
+	// node too, so the targets in each row come out in increasing index order.
+	link_index numLinks = offsets[numStateNodes];
+	std::vector<unsigned int> targets(numLinks);
+	std::vector<double> weights(numLinks);
+	const int CHUNK_SIZE = 1 << 12;
+	int numRows = static_cast<int>(rows.size());
+	int numChunks = (numRows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	int numMissing = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:numMissing) if(numChunks > 1)
+	for (int c = 0; c < numChunks; ++c)
+	{
+		int end = std::min(numRows, (c + 1) * CHUNK_SIZE);
+		for (int r = c * CHUNK_SIZE; r < end; ++r)
+		{
+			const std::map<StateNode, double>& subLinks = rows[r]->second;
+			link_index i = offsets[rowSources[r]];
+			for (std::map<StateNode, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt, ++i)
+			{
+				targets[i] = findStateNodeIndex(subIt->first);
+				weights[i] = subIt->second;
+				if (targets[i] == numStateNodes)
+					++numMissing;
+			}
+		}
+	}
+	if (numMissing != 0)
+		throw InputDomainError(io::Str() << "Couldn't find mapped index for " << numMissing << " target State nodes.");
+
+	m_indexedStateLinks.assign(numStateNodes, offsets, targets, weights);
+}
+
 void MemNetwork::initNodeDegrees()
 {
 	m_outDegree.assign(m_stateNodes.size(), 0.0);
 	m_sumLinkOutWeight.assign(m_stateNodes.size(), 0.0);
 
-	for (MemNetwork::StateLinkMap::const_iterator linkIt(m_stateLinks.begin()); linkIt != m_stateLinks.end(); ++linkIt)
+	for (unsigned int i = 0; i < m_indexedStateLinks.numRows(); ++i)
 	{
-		const StateNode& statesource = linkIt->first;
-		const std::map<StateNode, double>& subLinks = linkIt->second;
-
-		// Get the index for the state source node
-		MemNetwork::StateNodeMap::const_iterator nodeMapIt = m_stateNodeMap.find(statesource);
-		if (nodeMapIt == m_stateNodeMap.end())
-			throw InputDomainError(io::Str() << "Couldn't find mapped index for source State node " << statesource);
-		unsigned int sourceIndex = nodeMapIt->second;
-
-		for (std::map<StateNode, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index j = m_indexedStateLinks.rowBegin(i); j < m_indexedStateLinks.rowEnd(i); ++j)
 		{
-//			const StateNode& statetarget = subIt->first;
-			double linkWeight = subIt->second;
-//			nodeMapIt = m_stateNodeMap.find(statetarget);
-//			if (nodeMapIt == m_stateNodeMap.end())
-//				throw InputDomainError(io::Str() << "Couldn't find mapped index for target State node " << statetarget);
-//			unsigned int targetIndex = nodeMapIt->second;
-
-			++m_outDegree[sourceIndex];
-			m_sumLinkOutWeight[sourceIndex] += linkWeight;
+			++m_outDegree[i];
+			m_sumLinkOutWeight[i] += m_indexedStateLinks.weight(j);
 
 			// Never undirected memory links
 		}
@@ -997,10 +1090,61 @@ void MemNetwork::printStateNetwork(std::string filename) const
 	}
 }
 
+void MemNetwork::writeBinaryNetwork(std::string filename, bool floatWeights) const
+{
+	BinaryNetworkWriter out(filename);
+	BinaryNetworkHeader& header = out.header();
+
+	unsigned int numStateNodes = m_stateNodeMap.size();
+	header.flags = BinaryNetwork::STATE_NETWORK;
+	header.numNodes = m_numNodes;
+	header.numRows = numStateNodes;
+	header.numStateNodes = numStateNodes;
+	header.numNodesFound = m_numNodesFound;
+	header.numLinksFound = m_numStateLinksFound;
+	header.minNodeIndex = m_minNodeIndex;
+	header.maxNodeIndex = m_maxNodeIndex;
+	header.totalLinkWeight = m_totStateLinkWeight;
+
+	writeBinaryNodeNames(out);
+
+	// The state node map is ordered on the state node index
+	std::vector<unsigned int> stateIds(numStateNodes);
+	std::vector<unsigned int> physIds(numStateNodes);
+	std::vector<double> stateWeights(numStateNodes);
+	for (StateNodeMap::const_iterator it(m_stateNodeMap.begin()); it != m_stateNodeMap.end(); ++it) {
+		const StateNode& stateNode = it->first;
+		stateIds[it->second] = m_config.isStateNetwork()? stateNode.stateIndex : it->second;
+		physIds[it->second] = stateNode.physIndex;
+		stateWeights[it->second] = stateNode.weight;
+	}
+	out.writeSection(BinaryNetwork::STATE_IDS, stateIds.data(), numStateNodes * sizeof(unsigned int));
+	out.writeSection(BinaryNetwork::STATE_PHYSICAL_IDS, physIds.data(), numStateNodes * sizeof(unsigned int));
+	out.writeSection(BinaryNetwork::STATE_WEIGHTS, stateWeights.data(), numStateNodes * sizeof(double));
+
+	const SparseLinks& links = m_indexedStateLinks;
+	link_index numLinks = links.size();
+	header.numLinks = numLinks;
+
+	out.writeLinkOffsets(links.offsets(), numStateNodes + 1);
+	out.writeSection(BinaryNetwork::LINK_TARGETS, links.targets(), numLinks * sizeof(unsigned int));
+	if (floatWeights)
+	{
+		header.flags |= BinaryNetwork::FLOAT_WEIGHTS;
+		std::vector<float> weightsAsFloat(links.weights(), links.weights() + numLinks);
+		out.writeSection(BinaryNetwork::LINK_WEIGHTS, weightsAsFloat.data(), weightsAsFloat.size() * sizeof(float));
+	}
+	else
+		out.writeSection(BinaryNetwork::LINK_WEIGHTS, links.weights(), numLinks * sizeof(double));
+
+	out.close();
+}
+
 void MemNetwork::disposeLinks()
 {
 	Network::disposeLinks();
 	m_stateLinks.clear();
+	m_indexedStateLinks.clear();
 	m_incompleteStateLinks.clear();
 }
 
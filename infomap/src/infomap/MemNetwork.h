@@ -98,6 +98,7 @@ public:
 	// typedef map<pair<StateNode, StateNode>, double> StateLinkMap;
 	typedef map<StateNode, map<StateNode, double> > StateLinkMap; // Main key is first state-node, sub-key is second state-node
 	typedef map<StateNode, unsigned int> StateNodeMap;
+	typedef map<unsigned int, map<unsigned int, double> > IncompleteLinkMap;
 
 	MemNetwork() :
 		Network(),
@@ -182,6 +183,14 @@ public:
 	bool addStateLink(StateLinkMap::iterator firstStateNode, unsigned int n2PriorState, unsigned int n2, double weight, double firstStateNodeWeight, double secondStateNodeWeight);
 	bool addStateLink(const StateNode& s1, const StateNode& s2, double weight);
 
+	/**
+	 * Add weighted links between memory nodes from parallel arrays, in order.
+	 * @param weights The link weights, or null for unit weights
+	 * @return The number of links accepted
+	 */
+	link_index addStateLinks(const unsigned int* n1PriorStates, const unsigned int* n1s,
+			const unsigned int* n2PriorStates, const unsigned int* n2s, const double* weights, std::size_t numLinks);
+
 	void addStateNode(unsigned int priorState, unsigned int nodeIndex, double weight);
 	void addStateNode(StateNode& stateNode);
 
@@ -194,16 +203,40 @@ public:
 	const std::vector<double>& stateNodeWeights() const { return m_stateNodeWeights; }
 	double totalStateNodeWeight() const { return m_totStateNodeWeight; }
 	const StateLinkMap& stateLinkMap() const { return m_stateLinks; }
-	unsigned int numStateLinks() const { return m_numStateLinks; }
+	link_index numStateLinks() const { return m_numStateLinks; }
 	double totalStateLinkWeight() const { return m_totStateLinkWeight; }
 	double totalMemorySelfLinkWeight() const { return m_totalMemorySelfLinkWeight; }
 
 	const map<StateNode, double>& stateNodes() const { return m_stateNodes; }
 
+	/**
+	 * The state nodes by their dense index, in the same order as the state
+	 * node map. Set on finalization.
+	 */
+	const std::vector<StateNode>& indexedStateNodes() const { return m_indexedStateNodes; }
+
+	/**
+	 * The state links in compressed sparse row format on the dense state node
+	 * indices, with the targets of each row in increasing index order. Set on
+	 * finalization and released with the other links.
+	 */
+	const SparseLinks& indexedStateLinks() const { return m_indexedStateLinks; }
+
+	/**
+	 * The dense index of a state node by binary search, or numStateNodes() if missing.
+	 */
+	unsigned int findStateNodeIndex(const StateNode& stateNode) const;
+
 	virtual void printNetworkAsPajek(std::string filename) const;
 
 	virtual void printStateNetwork(std::string filename) const;
 
+	/**
+	 * Write the state network in the binary CSR format, with the same state
+	 * ids as printStateNetwork, to be loaded with input format 'states'.
+	 */
+	virtual void writeBinaryNetwork(std::string filename, bool floatWeights = false) const;
+
 	virtual void disposeLinks();
 
 protected:
@@ -212,9 +245,11 @@ protected:
 
 	void parseStateNetwork(std::string filename);
 
-	std::string parseStateNodes(std::ifstream& file);
+	void parseBinaryStateNetwork(std::string filename);
 
-	std::string parseStateLinks(std::ifstream& file);
+	std::string parseStateNodes(LineReader& input);
+
+	std::string parseStateLinks(LineReader& input);
 
 	/**
 	 * Create trigrams from first order data by chaining pair of overlapping links.
@@ -278,17 +313,17 @@ protected:
 
 	// Helper methods
 
-	void parseStateNode(const std::string& line, StateNode& stateNode);
+	void parseStateNode(const char* begin, const char* end, StateNode& stateNode) const;
 
 	/**
 	 * Parse a string of link data.
 	 * If no weight data can be extracted, the default value 1.0 will be used.
 	 * Note that the first node number can be negative, which means that memory
 	 * information is missing.
+	 * @note Thread safe, used to parse lines in parallel.
 	 * @throws an error if not both node numbers can be extracted.
 	 */
-	void parseStateLink(const std::string& line, int& n1, unsigned int& n2, unsigned int& n3, double& weight);
-	void parseStateLink(char line[], int& n1, unsigned int& n2, unsigned int& n3, double& weight);
+	void parseStateLink(const char* begin, const char* end, int& n1, unsigned int& n2, unsigned int& n3, double& weight) const;
 
 	/**
 	 * Insert memory link, indexed on first state-node and aggregated if exist
@@ -303,26 +338,33 @@ protected:
 
 	unsigned int addMissingPhysicalNodes();
 
+	/**
+	 * Index the state nodes densely and build the state link rows on the indices.
+	 */
+	void indexStateNetwork();
+
 	virtual void initNodeDegrees();
 
 	map<StateNode, double> m_stateNodes;
 	StateNodeMap m_stateNodeMap;
+	std::vector<StateNode> m_indexedStateNodes;
+	SparseLinks m_indexedStateLinks;
 	std::vector<double> m_stateNodeWeights; // out weights on memory nodes
 	double m_totStateNodeWeight;
-	LinkMap m_incompleteStateLinks;
+	IncompleteLinkMap m_incompleteStateLinks;
 
-	unsigned int m_numStateLinksFound;
-	unsigned int m_numStateLinks;
+	link_index m_numStateLinksFound;
+	link_index m_numStateLinks;
 	StateLinkMap m_stateLinks; // Raw data from file
 
 	double m_totStateLinkWeight;
-	unsigned int m_numAggregatedStateLinks;
-	unsigned int m_numMemorySelfLinks;
+	link_index m_numAggregatedStateLinks;
+	link_index m_numMemorySelfLinks;
 	double m_totalMemorySelfLinkWeight;
 
-	unsigned int m_numIncompleteStateLinksFound;
-	unsigned int m_numIncompleteStateLinks;
-	unsigned int m_numAggregatedIncompleteStateLinks;
+	link_index m_numIncompleteStateLinksFound;
+	link_index m_numIncompleteStateLinks;
+	link_index m_numAggregatedIncompleteStateLinks;
 
 	unsigned int m_numStateNodesFound;
 	// std::deque<StateNode> m_stateNodes;
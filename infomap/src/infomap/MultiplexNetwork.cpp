@@ -28,15 +28,22 @@
 #include "MultiplexNetwork.h"
 #include "../utils/FileURI.h"
 #include "../io/convert.h"
+#include "../io/LineReader.h"
 #include "../io/SafeFile.h"
+#include "../io/TextScanner.h"
 #include "../utils/Logger.h"
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <exception>
 
 #include "../utils/infomath.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef NS_INFOMAP
 namespace infomap
 {
@@ -44,6 +51,14 @@ namespace infomap
 
 using std::make_pair;
 
+namespace {
+	struct MultiplexLinkRecord
+	{
+		unsigned int layer1, node1, layer2, node2;
+		double weight;
+	};
+}
+
 void MultiplexNetwork::readInputData(std::string filename)
 {
 	if (filename.empty())
@@ -122,7 +137,7 @@ void MultiplexNetwork::parseMultiplexNetwork(std::string filename)
 {
 	Log() << "Parsing multiplex network from file '" << filename << "'... " << std::flush;
 
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
 	// Assume general multiplex links
 	string line = parseMultiplexLinks(input);
@@ -159,11 +174,55 @@ void MultiplexNetwork::parseMultipleNetworks()
 	for (unsigned int i = 0; i < m_config.additionalInput.size(); ++i)
 		networkFilenames.push_back(m_config.additionalInput[i]);
 
-	for (unsigned int i = 0; i < networkFilenames.size(); ++i)
+	unsigned int numLayers = networkFilenames.size();
+	int numThreads = 1;
+#ifdef _OPENMP
+	numThreads = omp_get_max_threads();
+#endif
+
+	if (numLayers > 1 && numThreads > 1)
 	{
-		m_networks.push_back(Network(m_config));
-		Log() << "[Network layer " << (i + 1) << " from file '" << networkFilenames[i] << "']:\n";
-		m_networks[i].readInputData(networkFilenames[i]);
+		// Parse the layers concurrently with the log silenced, as it is not
+		// thread safe, and print the parsing results in order afterwards.
+		Log() << "Parsing " << numLayers << " network layers in parallel... " << std::flush;
+		for (unsigned int i = 0; i < numLayers; ++i)
+			m_networks.push_back(Network(m_config));
+		std::vector<std::exception_ptr> errors(numLayers);
+		bool silent = Log::isSilent();
+		Log::setSilent(true);
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < static_cast<int>(numLayers); ++i)
+		{
+			try
+			{
+				m_networks[i].readInputData(networkFilenames[i]);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+		Log::setSilent(silent);
+		for (unsigned int i = 0; i < numLayers; ++i)
+		{
+			if (errors[i])
+				std::rethrow_exception(errors[i]);
+		}
+		Log() << "done!" << std::endl;
+		for (unsigned int i = 0; i < numLayers; ++i)
+		{
+			Log() << "[Network layer " << (i + 1) << " from file '" << networkFilenames[i] << "']:\n";
+			m_networks[i].printParsingResult();
+		}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < numLayers; ++i)
+		{
+			m_networks.push_back(Network(m_config));
+			Log() << "[Network layer " << (i + 1) << " from file '" << networkFilenames[i] << "']:\n";
+			m_networks[i].readInputData(networkFilenames[i]);
+		}
 	}
 
 	m_numNodes = adjustForDifferentNumberOfNodes();
@@ -206,10 +265,8 @@ unsigned int MultiplexNetwork::adjustForDifferentNumberOfNodes()
 	}
 
 	if (m_nodeNames.size() > 0 && m_nodeNames.size() < maxNumNodes) {
-		m_nodeNames.reserve(maxNumNodes);
-		for (unsigned int i = m_nodeNames.size(); i < maxNumNodes; ++i) {
-			m_nodeNames.push_back(io::Str() << "_completion_node_" << (i + 1));
-		}
+		m_nodeNames.setDefaultName("_completion_node_", 1);
+		m_nodeNames.resize(maxNumNodes);
 	}
 
 	if (differentNodeCount)
@@ -233,18 +290,16 @@ unsigned int MultiplexNetwork::adjustForDifferentNumberOfNodes()
 }
 
 bool MultiplexNetwork::createIntraLinksToNeighbouringNodesInTargetLayer(StateLinkMap::iterator stateSourceIt,
-	unsigned int nodeIndex, unsigned int targetLayer, const LinkMap& targetLayerLinks,
+	unsigned int nodeIndex, unsigned int targetLayer, const SparseLinks& targetLayerLinks,
 	double linkWeightNormalizationFactor, double stateNodeWeightNormalizationFactor) {
 	// Distribute inter-links to outgoing intra-links in the target layer
-	LinkMap::const_iterator targetLayerOutLinkIt = targetLayerLinks.find(nodeIndex);
 	bool linkAdded = false;
-	if (targetLayerOutLinkIt != targetLayerLinks.end())
+	if (nodeIndex < targetLayerLinks.numRows())
 	{
-		const std::map<unsigned int, double>& targetLayerOutLinks = targetLayerOutLinkIt->second;
-		for (std::map<unsigned int, double>::const_iterator interIntraIt(targetLayerOutLinks.begin()); interIntraIt != targetLayerOutLinks.end(); ++interIntraIt)
+		for (link_index i = targetLayerLinks.rowBegin(nodeIndex); i < targetLayerLinks.rowEnd(nodeIndex); ++i)
 		{
-			unsigned int targetLayerTargetNodeIndex = interIntraIt->first;
-			double targetLayerLinkWeight = interIntraIt->second;
+			unsigned int targetLayerTargetNodeIndex = targetLayerLinks.target(i);
+			double targetLayerLinkWeight = targetLayerLinks.weight(i);
 
 			// double interIntraLinkWeight = scaledInterLinkWeight * targetLayerLinkWeight / sumOutWeights[layer2][nodeIndex];
 			double interIntraLinkWeight = linkWeightNormalizationFactor * targetLayerLinkWeight;
@@ -259,18 +314,16 @@ bool MultiplexNetwork::createIntraLinksToNeighbouringNodesInTargetLayer(StateLin
 }
 
 bool MultiplexNetwork::createIntraLinksToNeighbouringNodesInTargetLayer(unsigned int sourceLayer,
-	unsigned int nodeIndex, unsigned int targetLayer, const LinkMap& targetLayerLinks,
+	unsigned int nodeIndex, unsigned int targetLayer, const SparseLinks& targetLayerLinks,
 	double linkWeightNormalizationFactor, double stateNodeWeightNormalizationFactor) {
 	// Distribute inter-links to outgoing intra-links in the target layer
-	LinkMap::const_iterator targetLayerOutLinkIt = targetLayerLinks.find(nodeIndex);
 	bool linkAdded = false;
-	if (targetLayerOutLinkIt != targetLayerLinks.end())
+	if (nodeIndex < targetLayerLinks.numRows())
 	{
-		const std::map<unsigned int, double>& targetLayerOutLinks = targetLayerOutLinkIt->second;
-		for (std::map<unsigned int, double>::const_iterator interIntraIt(targetLayerOutLinks.begin()); interIntraIt != targetLayerOutLinks.end(); ++interIntraIt)
+		for (link_index i = targetLayerLinks.rowBegin(nodeIndex); i < targetLayerLinks.rowEnd(nodeIndex); ++i)
 		{
-			unsigned int targetLayerTargetNodeIndex = interIntraIt->first;
-			double targetLayerLinkWeight = interIntraIt->second;
+			unsigned int targetLayerTargetNodeIndex = targetLayerLinks.target(i);
+			double targetLayerLinkWeight = targetLayerLinks.weight(i);
 
 			double interIntraLinkWeight = linkWeightNormalizationFactor * targetLayerLinkWeight;
 			double stateNodeWeight = stateNodeWeightNormalizationFactor * targetLayerLinkWeight;
@@ -289,26 +342,24 @@ void MultiplexNetwork::generateMemoryNetworkWithInterLayerLinksFromData()
 	// First generate memory links from intra links (from ordinary links within each network)
 	std::vector<std::vector<double> > sumOutWeights(m_networks.size());
 
-	std::vector<LinkMap> oppositeLinkMaps;
+	std::vector<SparseLinks> oppositeLinks;
 	if (m_config.isUndirected()) {
-		oppositeLinkMaps.resize(m_networks.size());
+		oppositeLinks.resize(m_networks.size());
 		for (unsigned int i = 0; i < m_networks.size(); ++i) {
-			m_networks[i].generateOppositeLinkMap(oppositeLinkMaps[i]);
+			m_networks[i].generateOppositeLinks(oppositeLinks[i]);
 		}
 	}
 
 	for (unsigned int layerIndex = 0; layerIndex < m_networks.size(); ++layerIndex)
 	{
 		sumOutWeights[layerIndex].assign(m_numNodes, 0.0);
-		const LinkMap& linkMap = m_networks[layerIndex].linkMap();
-		for (LinkMap::const_iterator linkIt(linkMap.begin()); linkIt != linkMap.end(); ++linkIt)
+		const SparseLinks& links = m_networks[layerIndex].links();
+		for (unsigned int n1 = 0; n1 < links.numRows(); ++n1)
 		{
-			unsigned int n1 = linkIt->first;
-			const std::map<unsigned int, double>& subLinks = linkIt->second;
-			for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+			for (link_index i = links.rowBegin(n1); i < links.rowEnd(n1); ++i)
 			{
-				unsigned int n2 = subIt->first;
-				double linkWeight = subIt->second;
+				unsigned int n2 = links.target(i);
+				double linkWeight = links.weight(i);
 
 				sumOutWeights[layerIndex][n1] += linkWeight;
 				if (m_config.isUndirected()) {
@@ -384,23 +435,23 @@ void MultiplexNetwork::generateMemoryNetworkWithInterLayerLinksFromData()
 					double weightNormalizationFactor = scaledInterLinkWeight / sumOutWeights[layer2][nodeIndex];
 					if (m_config.isUndirected()) {
 						// Distribute inter-links to outgoing intra-links in the target layer
-						bool add1 = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, m_networks[layer2].linkMap(), weightNormalizationFactor, weightNormalizationFactor);
+						bool add1 = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, m_networks[layer2].links(), weightNormalizationFactor, weightNormalizationFactor);
 						
 						// Distribute inter-link to incoming intra-links in the target layer
-						bool add2 = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, oppositeLinkMaps[layer2], weightNormalizationFactor, weightNormalizationFactor);
+						bool add2 = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, oppositeLinks[layer2], weightNormalizationFactor, weightNormalizationFactor);
 
 						// Distribute inter-links to outgoing intra-links in the source layer
 						double oppositeWeightNormalizationFactor = scaledOppositeInterLinkWeight / sumOutWeights[layer1][nodeIndex];
-						createIntraLinksToNeighbouringNodesInTargetLayer(layer2, nodeIndex, layer1, m_networks[layer1].linkMap(), oppositeWeightNormalizationFactor, oppositeWeightNormalizationFactor);
+						createIntraLinksToNeighbouringNodesInTargetLayer(layer2, nodeIndex, layer1, m_networks[layer1].links(), oppositeWeightNormalizationFactor, oppositeWeightNormalizationFactor);
 						
 						// Distribute inter-link to incoming intra-links in the source layer
-						createIntraLinksToNeighbouringNodesInTargetLayer(layer2, nodeIndex, layer1, oppositeLinkMaps[layer1], oppositeWeightNormalizationFactor, oppositeWeightNormalizationFactor);
+						createIntraLinksToNeighbouringNodesInTargetLayer(layer2, nodeIndex, layer1, oppositeLinks[layer1], oppositeWeightNormalizationFactor, oppositeWeightNormalizationFactor);
 						
 						stateSourceNodeAdded = add1 | add2;
 					}
 					else {
 						// Distribute inter-link to the outgoing intra-links in the target layer
-						stateSourceNodeAdded = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, m_networks[layer2].linkMap(), weightNormalizationFactor, weightNormalizationFactor);
+						stateSourceNodeAdded = createIntraLinksToNeighbouringNodesInTargetLayer(stateSourceIt, nodeIndex, layer2, m_networks[layer2].links(), weightNormalizationFactor, weightNormalizationFactor);
 					}
 				}
 			}
@@ -429,11 +480,11 @@ void MultiplexNetwork::generateMemoryNetworkWithSimulatedInterLayerLinks()
 
 	Log() << "Generating memory network with multiplex relax rate " << relaxRate << "... " << std::flush;
 	
-	std::vector<LinkMap> oppositeLinkMaps;
+	std::vector<SparseLinks> oppositeLinks;
 	if (m_config.isUndirected()) {
-		oppositeLinkMaps.resize(m_networks.size());
+		oppositeLinks.resize(m_networks.size());
 		for (unsigned int i = 0; i < m_networks.size(); ++i) {
-			m_networks[i].generateOppositeLinkMap(oppositeLinkMaps[i]);
+			m_networks[i].generateOppositeLinks(oppositeLinks[i]);
 		}
 	}
 
@@ -478,11 +529,11 @@ void MultiplexNetwork::generateMemoryNetworkWithSimulatedInterLayerLinks()
 				}
 				double stateNodeWeightNormalizationFactor = 1.0;
 				
-				createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, m_networks[layer2].linkMap(), linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
+				createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, m_networks[layer2].links(), linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
 				
 				if (m_config.isUndirected()) {
 					// Create inter-links to the incoming nodes in the target layer too					
-					createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, oppositeLinkMaps[layer2], linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
+					createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, oppositeLinks[layer2], linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
 				}
 			}
 		}
@@ -497,11 +548,11 @@ void MultiplexNetwork::generateMemoryNetworkWithJensenShannonSimulatedInterLayer
 
 	Log() << "Generating memory network with Jensen-Shannon-weighted multiplex relax rate " << jsrelaxRate << "... " << std::flush;
 	
-	std::vector<LinkMap> oppositeLinkMaps;
+	std::vector<SparseLinks> oppositeLinks;
 	if (m_config.isUndirected()) {
-		oppositeLinkMaps.resize(m_networks.size());
+		oppositeLinks.resize(m_networks.size());
 		for (unsigned int i = 0; i < m_networks.size(); ++i) {
-			m_networks[i].generateOppositeLinkMap(oppositeLinkMaps[i]);
+			m_networks[i].generateOppositeLinks(oppositeLinks[i]);
 		}
 	}
 
@@ -523,43 +574,39 @@ void MultiplexNetwork::generateMemoryNetworkWithJensenShannonSimulatedInterLayer
 			if(m_config.multiplexRelaxLimit >= 0){
 				layer2from = ((int)layer1-m_config.multiplexRelaxLimit) < 0 ? 0 : layer1-m_config.multiplexRelaxLimit;			}
 
-			const LinkMap& layer1LinkMap = m_networks[layer1].linkMap();
-			LinkMap::const_iterator layer1OutLinksIt = layer1LinkMap.find(nodeIndex);
+			SparseLinks::Row layer1OutLinks = m_networks[layer1].links().row(nodeIndex);
 			double sumOutLinkWeightLayer1 = m_networks[layer1].sumLinkOutWeight()[nodeIndex];
 
 			if(m_config.isUndirected()){
  				
-				const LinkMap& layer1OppositeLinkMap = oppositeLinkMaps[layer1];
-				LinkMap::const_iterator layer1OppositeOutLinksIt = layer1OppositeLinkMap.find(nodeIndex);
+				SparseLinks::Row layer1OppositeOutLinks = oppositeLinks[layer1].row(nodeIndex);
 
 				// Will not link from dangling node (similarity 0)
-				if((layer1OutLinksIt == layer1LinkMap.end()) && (layer1OppositeOutLinksIt == layer1OppositeLinkMap.end()))
+				if(layer1OutLinks.empty() && layer1OppositeOutLinks.empty())
 					continue;
 
-				// Include non-empty link maps
-				std::vector<const InterLinkMap *> layer1LinksVec;
-				if(layer1OutLinksIt != layer1LinkMap.end())
-					layer1LinksVec.push_back(&layer1OutLinksIt->second);
-				if(layer1OppositeOutLinksIt != layer1OppositeLinkMap.end())
-					layer1LinksVec.push_back(&layer1OppositeOutLinksIt->second);
+				// Include non-empty link rows
+				std::vector<SparseLinks::Row> layer1LinksVec;
+				if(!layer1OutLinks.empty())
+					layer1LinksVec.push_back(layer1OutLinks);
+				if(!layer1OppositeOutLinks.empty())
+					layer1LinksVec.push_back(layer1OppositeOutLinks);
 
 				for (unsigned int layer2 = layer2from; layer2 < layer2to; ++layer2){
 
-					const LinkMap& layer2LinkMap = m_networks[layer2].linkMap();
-					LinkMap::const_iterator layer2OutLinksIt = layer2LinkMap.find(nodeIndex);						
-					const LinkMap& layer2OppositeLinkMap = oppositeLinkMaps[layer2];
-					LinkMap::const_iterator layer2OppositeOutLinksIt = layer2OppositeLinkMap.find(nodeIndex);
+					SparseLinks::Row layer2OutLinks = m_networks[layer2].links().row(nodeIndex);
+					SparseLinks::Row layer2OppositeOutLinks = oppositeLinks[layer2].row(nodeIndex);
 
 					// Will not link to dangling node (similarity 0)
-					if((layer2OutLinksIt == layer2LinkMap.end()) && (layer2OppositeOutLinksIt == layer2OppositeLinkMap.end()))
+					if(layer2OutLinks.empty() && layer2OppositeOutLinks.empty())
 						continue;
 
-					// Include non-empty link maps
-					std::vector<const InterLinkMap *> layer2LinksVec;
-					if(layer2OutLinksIt != layer2LinkMap.end())
-						layer2LinksVec.push_back(&layer2OutLinksIt->second);
-					if(layer2OppositeOutLinksIt != layer2OppositeLinkMap.end())
-						layer2LinksVec.push_back(&layer2OppositeOutLinksIt->second);
+					// Include non-empty link rows
+					std::vector<SparseLinks::Row> layer2LinksVec;
+					if(!layer2OutLinks.empty())
+						layer2LinksVec.push_back(layer2OutLinks);
+					if(!layer2OppositeOutLinks.empty())
+						layer2LinksVec.push_back(layer2OppositeOutLinks);
 	
 					double sumOutLinkWeightLayer2 = m_networks[layer2].sumLinkOutWeight()[nodeIndex];
 
@@ -580,19 +627,18 @@ void MultiplexNetwork::generateMemoryNetworkWithJensenShannonSimulatedInterLayer
 			else{
 
 				// Skip dangling nodes, because they have no information to calculate similarity
- 				if (layer1OutLinksIt == layer1LinkMap.end())
+ 				if (layer1OutLinks.empty())
  					continue;
 
 				for (unsigned int layer2 = layer2from; layer2 < layer2to; ++layer2){
-					const LinkMap& layer2LinkMap = m_networks[layer2].linkMap();
-					LinkMap::const_iterator layer2OutLinksIt = layer2LinkMap.find(nodeIndex);
-					if (layer2OutLinksIt == layer2LinkMap.end())
+					SparseLinks::Row layer2OutLinks = m_networks[layer2].links().row(nodeIndex);
+					if (layer2OutLinks.empty())
 						continue;
 	
 					double sumOutLinkWeightLayer2 = m_networks[layer2].sumLinkOutWeight()[nodeIndex];
 	
 					bool intersect;
-					double div = calculateJensenShannonDivergence(intersect,layer1OutLinksIt->second,sumOutLinkWeightLayer1,layer2OutLinksIt->second,sumOutLinkWeightLayer2);
+					double div = calculateJensenShannonDivergence(intersect,layer1OutLinks,sumOutLinkWeightLayer1,layer2OutLinks,sumOutLinkWeightLayer2);
 					double jsWeight = 1.0 - div;
 					if(intersect && (jsWeight >= m_config.multiplexRelaxLimit)){	
 						jsTotWeight[layer1] += jsWeight;
@@ -641,11 +687,11 @@ void MultiplexNetwork::generateMemoryNetworkWithJensenShannonSimulatedInterLayer
 						
 						double stateNodeWeightNormalizationFactor = 1.0;
 						
-						createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, m_networks[layer2].linkMap(), linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
+						createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, m_networks[layer2].links(), linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
 						
 						if (m_config.isUndirected()) {
 							// Create inter-links to the incoming nodes in the target layer too					
-							createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, oppositeLinkMaps[layer2], linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
+							createIntraLinksToNeighbouringNodesInTargetLayer(layer1, nodeIndex, layer2, oppositeLinks[layer2], linkWeightNormalizationFactor, stateNodeWeightNormalizationFactor);
 						}
 					}
 				}
@@ -655,7 +701,7 @@ void MultiplexNetwork::generateMemoryNetworkWithJensenShannonSimulatedInterLayer
 	Log() << "done!" << std::endl;
 }
 
-double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, const IntraLinkMap &layer1OutLinks, double sumOutLinkWeightLayer1, const IntraLinkMap &layer2OutLinks, double sumOutLinkWeightLayer2){
+double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, SparseLinks::Row layer1OutLinks, double sumOutLinkWeightLayer1, SparseLinks::Row layer2OutLinks, double sumOutLinkWeightLayer2){
 
 	intersect = false;
 	double h1 = 0.0; // The entropy rate of the node in the first layer
@@ -668,57 +714,53 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, const
 	double pi1 = ow1 / (ow1 + ow2);
 	double pi2 = ow2 / (ow1 + ow2);
 
-	IntraLinkMap::const_iterator layer1OutLinkIt = layer1OutLinks.begin();
-	IntraLinkMap::const_iterator layer2OutLinkIt = layer2OutLinks.begin();
-	IntraLinkMap::const_iterator layer1OutLinkItEnd = layer1OutLinks.end();
-	IntraLinkMap::const_iterator layer2OutLinkItEnd = layer2OutLinks.end();
-	while(layer1OutLinkIt != layer1OutLinkItEnd && layer2OutLinkIt != layer2OutLinkItEnd){
-		int diff = layer1OutLinkIt->first - layer2OutLinkIt->first;		
+	while(!layer1OutLinks.empty() && !layer2OutLinks.empty()){
+		int diff = layer1OutLinks.target() - layer2OutLinks.target();		
 		if(diff < 0){
 		// If the first state node has a link that the second has not
-			double p1 = layer1OutLinkIt->second/ow1;
-			h1 -= p1*log2(p1);
-			double p12 = pi1*layer1OutLinkIt->second/ow1;
-			h12 -= p12*log2(p12);
-			layer1OutLinkIt++;
+			double p1 = layer1OutLinks.weight()/ow1;
+			h1 -= infomath::plogp(p1);
+			double p12 = pi1*layer1OutLinks.weight()/ow1;
+			h12 -= infomath::plogp(p12);
+			layer1OutLinks.pop();
 		}
 		else if(diff > 0){
 		// If the second state node has a link that the second has not
-			double p2 = layer2OutLinkIt->second/ow2;
-			h2 -= p2*log2(p2);
-			double p12 = pi2*layer2OutLinkIt->second/ow2;
-			h12 -= p12*log2(p12);
-			layer2OutLinkIt++;
+			double p2 = layer2OutLinks.weight()/ow2;
+			h2 -= infomath::plogp(p2);
+			double p12 = pi2*layer2OutLinks.weight()/ow2;
+			h12 -= infomath::plogp(p12);
+			layer2OutLinks.pop();
 		}
 		else{ // If both state nodes have the link
 			intersect = true;
-			double p1 = layer1OutLinkIt->second/ow1;
-			h1 -= p1*log2(p1);
-			double p2 = layer2OutLinkIt->second/ow2;
-			h2 -= p2*log2(p2);
-			double p12 = pi1*layer1OutLinkIt->second/ow1 + pi2*layer2OutLinkIt->second/ow2;
-			h12 -= p12*log2(p12);
-			layer1OutLinkIt++;
-			layer2OutLinkIt++;
+			double p1 = layer1OutLinks.weight()/ow1;
+			h1 -= infomath::plogp(p1);
+			double p2 = layer2OutLinks.weight()/ow2;
+			h2 -= infomath::plogp(p2);
+			double p12 = pi1*layer1OutLinks.weight()/ow1 + pi2*layer2OutLinks.weight()/ow2;
+			h12 -= infomath::plogp(p12);
+			layer1OutLinks.pop();
+			layer2OutLinks.pop();
 		}
 	}
 
-	while(layer1OutLinkIt != layer1OutLinkItEnd){
+	while(!layer1OutLinks.empty()){
 		// If the first state node has a link that the second has not
-		double p1 = layer1OutLinkIt->second/ow1;
-		h1 -= p1*log2(p1);
-		double p12 = pi1*layer1OutLinkIt->second/ow1;
-		h12 -= p12*log2(p12);
-		layer1OutLinkIt++;
+		double p1 = layer1OutLinks.weight()/ow1;
+		h1 -= infomath::plogp(p1);
+		double p12 = pi1*layer1OutLinks.weight()/ow1;
+		h12 -= infomath::plogp(p12);
+		layer1OutLinks.pop();
 	}
 
-	while(layer2OutLinkIt != layer2OutLinkItEnd){
+	while(!layer2OutLinks.empty()){
 		// If the second state node has a link that the second has not
-		double p2 = layer2OutLinkIt->second/ow2;
-		h2 -= p2*log2(p2);
-		double p12 = pi2*layer2OutLinkIt->second/ow2;
-		h12 -= p12*log2(p12);
-		layer2OutLinkIt++;
+		double p2 = layer2OutLinks.weight()/ow2;
+		h2 -= infomath::plogp(p2);
+		double p12 = pi2*layer2OutLinks.weight()/ow2;
+		h12 -= infomath::plogp(p12);
+		layer2OutLinks.pop();
 	}	
 	
 	double div = (pi1+pi2)*h12 - pi1*h1 - pi2*h2;
@@ -735,7 +777,7 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, const
 
 }
 
-double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, std::vector<const IntraLinkMap *> &layer1LinksVec, double sumOutLinkWeightLayer1, std::vector<const IntraLinkMap *> &layer2LinksVec, double sumOutLinkWeightLayer2){
+double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, const std::vector<SparseLinks::Row> &layer1LinksVec, double sumOutLinkWeightLayer1, const std::vector<SparseLinks::Row> &layer2LinksVec, double sumOutLinkWeightLayer2){
 
 	intersect = false;
 	double h1 = 0.0; // The entropy rate of the node in the first layer
@@ -748,51 +790,47 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, std::
 	double pi1 = ow1 / (ow1 + ow2);
 	double pi2 = ow2 / (ow1 + ow2);
 
-	IntraLinkMap::const_iterator *layer1linkIt;
-	IntraLinkMap::const_iterator *layer2linkIt;
+	SparseLinks::Row *layer1linkIt;
+	SparseLinks::Row *layer2linkIt;
 
-	std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > layer1OutLinkItVec;
-	for(std::vector<const IntraLinkMap *>::iterator layer1linkPtrIt = layer1LinksVec.begin(); layer1linkPtrIt != layer1LinksVec.end(); layer1linkPtrIt++)
-		layer1OutLinkItVec.push_back(make_pair((*layer1linkPtrIt)->begin(),(*layer1linkPtrIt)->end()));
-
-	std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > layer2OutLinkItVec;
-	for(std::vector<const IntraLinkMap *>::iterator layer2linkPtrIt = layer2LinksVec.begin(); layer2linkPtrIt != layer2LinksVec.end(); layer2linkPtrIt++)
-		layer2OutLinkItVec.push_back(make_pair((*layer2linkPtrIt)->begin(),(*layer2linkPtrIt)->end()));
+	// Copy the rows to consume them
+	std::vector<SparseLinks::Row> layer1OutLinkItVec(layer1LinksVec);
+	std::vector<SparseLinks::Row> layer2OutLinkItVec(layer2LinksVec);
 
 	while(undirLinkRemains(layer1OutLinkItVec) && undirLinkRemains(layer2OutLinkItVec)){
 		
 		layer1linkIt = getUndirLinkItPtr(layer1OutLinkItVec);
 		layer2linkIt = getUndirLinkItPtr(layer2OutLinkItVec);
 
-		int diff = (*layer1linkIt)->first - (*layer2linkIt)->first;	
-		// Log() << "\n" << (*layer1linkIt)->first << " " << (*layer1linkIt)->second << " " << (*layer2linkIt)->first << " " << (*layer2linkIt)->second;
+		int diff = layer1linkIt->target() - layer2linkIt->target();	
+		// Log() << "\n" << layer1linkIt->target() << " " << layer1linkIt->weight() << " " << layer2linkIt->target() << " " << layer2linkIt->weight();
 		
 		if(diff < 0){
 		// If the first state node has a link that the second has not
-			double p1 = (*layer1linkIt)->second/ow1;
-			h1 -= p1*log2(p1);
-			double p12 = pi1*(*layer1linkIt)->second/ow1;
-			h12 -= p12*log2(p12);
-			(*layer1linkIt)++;
+			double p1 = layer1linkIt->weight()/ow1;
+			h1 -= infomath::plogp(p1);
+			double p12 = pi1*layer1linkIt->weight()/ow1;
+			h12 -= infomath::plogp(p12);
+			layer1linkIt->pop();
 		}
 		else if(diff > 0){
 		// If the second state node has a link that the second has not
-			double p2 = (*layer2linkIt)->second/ow2;
-			h2 -= p2*log2(p2);
-			double p12 = pi2*(*layer2linkIt)->second/ow2;
-			h12 -= p12*log2(p12);
-			(*layer2linkIt)++;
+			double p2 = layer2linkIt->weight()/ow2;
+			h2 -= infomath::plogp(p2);
+			double p12 = pi2*layer2linkIt->weight()/ow2;
+			h12 -= infomath::plogp(p12);
+			layer2linkIt->pop();
 		}
 		else{ // If both state nodes have the link
 			intersect = true;
-			double p1 = (*layer1linkIt)->second/ow1;
-			h1 -= p1*log2(p1);
-			double p2 = (*layer2linkIt)->second/ow2;
-			h2 -= p2*log2(p2);
-			double p12 = pi1*(*layer1linkIt)->second/ow1 + pi2*(*layer2linkIt)->second/ow2;
-			h12 -= p12*log2(p12);
-			(*layer1linkIt)++;
-			(*layer2linkIt)++;
+			double p1 = layer1linkIt->weight()/ow1;
+			h1 -= infomath::plogp(p1);
+			double p2 = layer2linkIt->weight()/ow2;
+			h2 -= infomath::plogp(p2);
+			double p12 = pi1*layer1linkIt->weight()/ow1 + pi2*layer2linkIt->weight()/ow2;
+			h12 -= infomath::plogp(p12);
+			layer1linkIt->pop();
+			layer2linkIt->pop();
 		}
 	}
 
@@ -801,11 +839,11 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, std::
 
 		layer1linkIt = getUndirLinkItPtr(layer1OutLinkItVec);
 
-		double p1 = (*layer1linkIt)->second/ow1;
-		h1 -= p1*log2(p1);
-		double p12 = pi1*(*layer1linkIt)->second/ow1;
-		h12 -= p12*log2(p12);
-		(*layer1linkIt)++;
+		double p1 = layer1linkIt->weight()/ow1;
+		h1 -= infomath::plogp(p1);
+		double p12 = pi1*layer1linkIt->weight()/ow1;
+		h12 -= infomath::plogp(p12);
+		layer1linkIt->pop();
 	}
 
 	while(undirLinkRemains(layer2OutLinkItVec)){
@@ -813,11 +851,11 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, std::
 		layer2linkIt = getUndirLinkItPtr(layer2OutLinkItVec);
 
 		// If the second state node has a link that the second has not
-		double p2 = (*layer2linkIt)->second/ow2;
-		h2 -= p2*log2(p2);
-		double p12 = pi2*(*layer2linkIt)->second/ow2;
-		h12 -= p12*log2(p12);
-		(*layer2linkIt)++;
+		double p2 = layer2linkIt->weight()/ow2;
+		h2 -= infomath::plogp(p2);
+		double p12 = pi2*layer2linkIt->weight()/ow2;
+		h12 -= infomath::plogp(p12);
+		layer2linkIt->pop();
 	}	
 	
 	double div = (pi1+pi2)*h12 - pi1*h1 - pi2*h2;
@@ -833,21 +871,14 @@ double MultiplexNetwork::calculateJensenShannonDivergence(bool &intersect, std::
 }
 
 
-MultiplexNetwork::IntraLinkMap::const_iterator *MultiplexNetwork::getUndirLinkItPtr(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > &outLinkItVec){
+SparseLinks::Row *MultiplexNetwork::getUndirLinkItPtr(std::vector<SparseLinks::Row> &outLinkItVec){
 
-	bool assigned = false;
-	IntraLinkMap::const_iterator *linkIt;
+	SparseLinks::Row *linkIt = 0;
 
-	for(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> >::iterator outLinkItVecIts = outLinkItVec.begin(); outLinkItVecIts != outLinkItVec.end(); outLinkItVecIts++){
-		if(outLinkItVecIts->first != outLinkItVecIts->second){
-			if(assigned){
-				if(outLinkItVecIts->first->first < (*linkIt)->first){
-					linkIt = &outLinkItVecIts->first;
-				}
-			}
-			else{
-				linkIt = &outLinkItVecIts->first;
-				assigned = true;
+	for(std::vector<SparseLinks::Row>::iterator outLinkItVecIts = outLinkItVec.begin(); outLinkItVecIts != outLinkItVec.end(); outLinkItVecIts++){
+		if(!outLinkItVecIts->empty()){
+			if(linkIt == 0 || outLinkItVecIts->target() < linkIt->target()){
+				linkIt = &*outLinkItVecIts;
 			}
 		}
 	}
@@ -856,10 +887,10 @@ MultiplexNetwork::IntraLinkMap::const_iterator *MultiplexNetwork::getUndirLinkIt
 
 }
 
-bool MultiplexNetwork::undirLinkRemains(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > &outLinkItVec){
+bool MultiplexNetwork::undirLinkRemains(std::vector<SparseLinks::Row> &outLinkItVec){
 
-	for(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> >::iterator outLinkItVecIts = outLinkItVec.begin(); outLinkItVecIts != outLinkItVec.end(); outLinkItVecIts++)
-		if(outLinkItVecIts->first != outLinkItVecIts->second)
+	for(std::vector<SparseLinks::Row>::iterator outLinkItVecIts = outLinkItVec.begin(); outLinkItVecIts != outLinkItVec.end(); outLinkItVecIts++)
+		if(!outLinkItVecIts->empty())
 			return true;
 
 	return false;
@@ -888,55 +919,41 @@ void MultiplexNetwork::addMemoryNetworkFromMultiplexLinks()
 	Log() << "done!" << std::endl;
 }
 
-std::string MultiplexNetwork::parseIntraLinks(std::ifstream& file)
+std::string MultiplexNetwork::parseIntraLinks(LineReader& input)
 {
-	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int layerIndex, n1, n2;
-		double weight;
-
-		parseIntraLink(line, layerIndex, n1, n2, weight);
-
-		while (m_networks.size() < layerIndex + 1)
-			m_networks.push_back(Network(m_config));
+	return input.parseLines<MultiplexLinkRecord>(
+		[this](const char* begin, const char* end, MultiplexLinkRecord& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseIntraLink(begin, end, link.layer1, link.node1, link.node2, link.weight);
+			return true;
+		},
+		[this](const MultiplexLinkRecord& link) {
+			while (m_networks.size() < link.layer1 + 1)
+				m_networks.push_back(Network(m_config));
 
-		m_networks[layerIndex].addLink(n1, n2, weight);
+			m_networks[link.layer1].addLink(link.node1, link.node2, link.weight);
 
-		++m_numIntraLinksFound;
-	}
-	return line;
+			++m_numIntraLinksFound;
+		});
 }
 
-std::string MultiplexNetwork::parseInterLinks(std::ifstream& file)
+std::string MultiplexNetwork::parseInterLinks(LineReader& input)
 {
-	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int nodeIndex, layer1, layer2;
-		double weight;
-
-		parseInterLink(line, layer1, nodeIndex, layer2, weight);
-
-		m_interLinks[StateNode(layer1, nodeIndex)][layer2] += weight;
+	return input.parseLines<MultiplexLinkRecord>(
+		[this](const char* begin, const char* end, MultiplexLinkRecord& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseInterLink(begin, end, link.layer1, link.node1, link.layer2, link.weight);
+			return true;
+		},
+		[this](const MultiplexLinkRecord& link) {
+			m_interLinks[StateNode(link.layer1, link.node1)][link.layer2] += link.weight;
 
-		++m_numInterLinksFound;
-		++m_interLinkLayers[layer1];
-		++m_interLinkLayers[layer2];
-	}
-	return line;
+			++m_numInterLinksFound;
+			++m_interLinkLayers[link.layer1];
+			++m_interLinkLayers[link.layer2];
+		});
 }
 
 void MultiplexNetwork::addMultiplexLink(int layer1, int node1, int layer2, int node2, double weight){
@@ -948,31 +965,30 @@ void MultiplexNetwork::addMultiplexLink(int layer1, int node1, int layer2, int n
 
 }
 
-std::string MultiplexNetwork::parseMultiplexLinks(std::ifstream& file)
+void MultiplexNetwork::addMultiplexLinks(const int* layer1, const int* node1, const int* layer2, const int* node2,
+		const double* weights, std::size_t numLinks)
 {
-	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int layer1, node1, layer2, node2;
-		double weight;
-
-		parseMultiplexLink(line, layer1, node1, layer2, node2, weight);
-
-		addMultiplexLink(layer1, node1, layer2, node2, weight);
-
-		if(layer1 == layer2)
-			++m_numIntraLinksFound;
-		else
-			++m_numInterLinksFound;
+	for (std::size_t i = 0; i < numLinks; ++i)
+		addMultiplexLink(layer1[i], node1[i], layer2[i], node2[i], weights == 0 ? 1.0 : weights[i]);
+}
 
-	}
-	return line;
+std::string MultiplexNetwork::parseMultiplexLinks(LineReader& input)
+{
+	return input.parseLines<MultiplexLinkRecord>(
+		[this](const char* begin, const char* end, MultiplexLinkRecord& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseMultiplexLink(begin, end, link.layer1, link.node1, link.layer2, link.node2, link.weight);
+			return true;
+		},
+		[this](const MultiplexLinkRecord& link) {
+			addMultiplexLink(link.layer1, link.node1, link.layer2, link.node2, link.weight);
+
+			if(link.layer1 == link.layer2)
+				++m_numIntraLinksFound;
+			else
+				++m_numInterLinksFound;
+		});
 }
 
 /**
@@ -980,13 +996,13 @@ std::string MultiplexNetwork::parseMultiplexLinks(std::ifstream& file)
  *
  *   layer node node [weight]
  */
-void MultiplexNetwork::parseIntraLink(const std::string& line, unsigned int& layerIndex, unsigned int& n1, unsigned int& n2, double& weight)
+void MultiplexNetwork::parseIntraLink(const char* begin, const char* end, unsigned int& layerIndex, unsigned int& n1, unsigned int& n2, double& weight) const
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> layerIndex >> n1 >> n2))
-		throw FileFormatError(io::Str() << "Can't parse multiplex intra link data (layer node1 node2) from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
+	const char* pos = begin;
+	if (!io::scanUnsigned(pos, end, layerIndex) || !io::scanUnsigned(pos, end, n1) || !io::scanUnsigned(pos, end, n2))
+		throw FileFormatError(io::Str() << "Can't parse multiplex intra link data (layer node1 node2) from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
+		weight = 1.0;
 	layerIndex -= m_indexOffset;
 	n1 -= m_indexOffset;
 	n2 -= m_indexOffset;
@@ -997,13 +1013,13 @@ void MultiplexNetwork::parseIntraLink(const std::string& line, unsigned int& lay
  *
  *   layer node layer [weight]
  */
-void MultiplexNetwork::parseInterLink(const std::string& line, unsigned int& layer1, unsigned int& node, unsigned int& layer2, double& weight)
+void MultiplexNetwork::parseInterLink(const char* begin, const char* end, unsigned int& layer1, unsigned int& node, unsigned int& layer2, double& weight) const
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> layer1 >> node >> layer2))
-		throw FileFormatError(io::Str() << "Can't parse multiplex inter link data (layer1 node layer2) from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
+	const char* pos = begin;
+	if (!io::scanUnsigned(pos, end, layer1) || !io::scanUnsigned(pos, end, node) || !io::scanUnsigned(pos, end, layer2))
+		throw FileFormatError(io::Str() << "Can't parse multiplex inter link data (layer1 node layer2) from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
+		weight = 1.0;
 	layer1 -= m_indexOffset;
 	node -= m_indexOffset;
 	layer2 -= m_indexOffset;
@@ -1014,13 +1030,13 @@ void MultiplexNetwork::parseInterLink(const std::string& line, unsigned int& lay
  *
  *   layer1 node1 layer2 node2 [weight]
  */
-void MultiplexNetwork::parseMultiplexLink(const std::string& line, unsigned int& layer1, unsigned int& node1, unsigned int& layer2, unsigned int& node2, double& weight)
+void MultiplexNetwork::parseMultiplexLink(const char* begin, const char* end, unsigned int& layer1, unsigned int& node1, unsigned int& layer2, unsigned int& node2, double& weight) const
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> layer1 >> node1 >> layer2 >> node2))
-		throw FileFormatError(io::Str() << "Can't parse multiplex link data (layer1 node1 layer2 node2) from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
+	const char* pos = begin;
+	if (!io::scanUnsigned(pos, end, layer1) || !io::scanUnsigned(pos, end, node1) || !io::scanUnsigned(pos, end, layer2) || !io::scanUnsigned(pos, end, node2))
+		throw FileFormatError(io::Str() << "Can't parse multiplex link data (layer1 node1 layer2 node2) from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
+		weight = 1.0;
 	layer1 -= m_indexOffset;
 	node1 -= m_indexOffset;
 	layer2 -= m_indexOffset;
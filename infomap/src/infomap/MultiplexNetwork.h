@@ -43,7 +43,6 @@ class MultiplexNetwork : public MemNetwork
 {
 public:
 	typedef std::map<unsigned int, double> InterLinkMap;
-	typedef std::map<unsigned int, double> IntraLinkMap;
 	typedef std::map<StateNode, std::map<StateNode, double> > MultiplexLinkMap;
 
 	MultiplexNetwork() :
@@ -66,6 +65,13 @@ public:
 
 	virtual void addMultiplexLink(int layer1, int node1, int layer2, int node2, double w);
 
+	/**
+	 * Add multiplex links from parallel arrays, in order.
+	 * @param weights The link weights, or null for unit weights
+	 */
+	void addMultiplexLinks(const int* layer1, const int* node1, const int* layer2, const int* node2,
+			const double* weights, std::size_t numLinks);
+
 	void addMemoryNetworkFromMultiplexLinks();
 
 protected:
@@ -82,18 +88,17 @@ protected:
     
 	void generateMemoryNetworkWithJensenShannonSimulatedInterLayerLinks();
 
-	double calculateJensenShannonDivergence(bool &intersect, const IntraLinkMap &layer1OutLinks, double sumOutLinkWeightLayer1, const IntraLinkMap &layer2OutLinks, double sumOutLinkWeightLayer2);
-	double calculateJensenShannonDivergence(bool &intersect, const IntraLinkMap &layer1OutLinks, const IntraLinkMap &layer1OppositeOutLinks, double sumOutLinkWeightLayer1, const IntraLinkMap &layer2OutLinks, const IntraLinkMap &layer2OppositeOutLinks, double sumOutLinkWeightLayer2);
-	double calculateJensenShannonDivergence(bool &intersect, std::vector<const IntraLinkMap *> &layer1LinksVec, double sumOutLinkWeightLayer1, std::vector<const IntraLinkMap *> &layer2LinksVec, double sumOutLinkWeightLayer2);
-	IntraLinkMap::const_iterator *getUndirLinkItPtr(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > &outLinkItVec);
-	bool undirLinkRemains(std::vector<pair<IntraLinkMap::const_iterator,IntraLinkMap::const_iterator> > &outLinkItVec);
+	double calculateJensenShannonDivergence(bool &intersect, SparseLinks::Row layer1OutLinks, double sumOutLinkWeightLayer1, SparseLinks::Row layer2OutLinks, double sumOutLinkWeightLayer2);
+	double calculateJensenShannonDivergence(bool &intersect, const std::vector<SparseLinks::Row> &layer1LinksVec, double sumOutLinkWeightLayer1, const std::vector<SparseLinks::Row> &layer2LinksVec, double sumOutLinkWeightLayer2);
+	SparseLinks::Row *getUndirLinkItPtr(std::vector<SparseLinks::Row> &outLinkItVec);
+	bool undirLinkRemains(std::vector<SparseLinks::Row> &outLinkItVec);
 
 
 	bool createIntraLinksToNeighbouringNodesInTargetLayer(StateLinkMap::iterator stateSourceIt,
-	unsigned int nodeIndex, unsigned int targetLayer, const LinkMap& targetLayerLinks,
+	unsigned int nodeIndex, unsigned int targetLayer, const SparseLinks& targetLayerLinks,
 	double linkWeightNormalizationFactor, double stateNodeWeightNormalizationFactor);
 	bool createIntraLinksToNeighbouringNodesInTargetLayer(unsigned int sourceLayer,
-	unsigned int nodeIndex, unsigned int targetLayer, const LinkMap& targetLayerLinks,
+	unsigned int nodeIndex, unsigned int targetLayer, const SparseLinks& targetLayerLinks,
 	double linkWeightNormalizationFactor, double stateNodeWeightNormalizationFactor);
 
 	// Helper methods
@@ -102,40 +107,40 @@ protected:
 	 * Parse intra-network links (links within a network) until end or new header.
 	 * @return The last line parsed, which may be a new header.
 	 */
-	std::string parseIntraLinks(std::ifstream& file);
+	std::string parseIntraLinks(LineReader& input);
 
 	/**
 	 * Parse inter-network links (links between networks) until end or new header.
 	 * @return The last line parsed, which may be a new header.
 	 */
-	std::string parseInterLinks(std::ifstream& file);
+	std::string parseInterLinks(LineReader& input);
 
 	/**
 	 * Parse general multiplex links until end or new header.
 	 * @return The last line parsed, which may be a new header.
 	 */
-	std::string parseMultiplexLinks(std::ifstream& file);
+	std::string parseMultiplexLinks(LineReader& input);
 
 	/**
 	 * Parse a string of intra link data for a certain network, "layer node node [weight]".
 	 * If no weight data can be extracted, the default value 1.0 will be used.
 	 * @throws an error if not enough data can be extracted.
 	 */
-	void parseIntraLink(const std::string& line, unsigned int& layer, unsigned int& node1, unsigned int& node2, double& weight);
+	void parseIntraLink(const char* begin, const char* end, unsigned int& layer, unsigned int& node1, unsigned int& node2, double& weight) const;
 
 	/**
 	 * Parse a string of inter link data for a certain node, "layer node layer [weight]".
 	 * If no weight data can be extracted, the default value 1.0 will be used.
 	 * @throws an error if not enough data can be extracted.
 	 */
-	void parseInterLink(const std::string& line, unsigned int& layer1, unsigned int& node, unsigned int& layer2, double& weight);
+	void parseInterLink(const char* begin, const char* end, unsigned int& layer1, unsigned int& node, unsigned int& layer2, double& weight) const;
 
 	/**
 	 * Parse a string of general multiplex link data, "layer1 node1 layer2 node2 weight".
 	 * If no weight data can be extracted, the default value 1.0 will be used.
 	 * @throws an error if not enough data can be extracted.
 	 */
-	void parseMultiplexLink(const std::string& line, unsigned int& node, unsigned int& level1, unsigned int& level2, unsigned int& node2, double& weight);
+	void parseMultiplexLink(const char* begin, const char* end, unsigned int& layer1, unsigned int& node1, unsigned int& layer2, unsigned int& node2, double& weight) const;
 
 	
 
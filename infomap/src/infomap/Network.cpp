@@ -27,14 +27,22 @@
 
 #include "Network.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+#include "../io/BinaryNetworkFormat.h"
+#include "../io/CompressedFile.h"
 #include "../io/convert.h"
+#include "../io/LineReader.h"
 #include "../io/SafeFile.h"
+#include "../io/TextScanner.h"
 #include "../utils/FileURI.h"
 #include "../utils/Logger.h"
 
@@ -45,6 +53,72 @@ namespace infomap
 
 using std::make_pair;
 
+namespace
+{
+	// Number of links per chunk when adding links in parallel
+	const std::size_t LINK_CHUNK_SIZE = 1 << 16;
+
+	struct LinkChunk
+	{
+		LinkChunk() :
+			numLinks(0),
+			numSelfLinksFound(0),
+			maxNodeIndex(std::numeric_limits<unsigned int>::min()),
+			minNodeIndex(std::numeric_limits<unsigned int>::max())
+		{}
+		std::size_t numLinks;
+		link_index numSelfLinksFound;
+		unsigned int maxNodeIndex;
+		unsigned int minNodeIndex;
+	};
+
+	struct NodeFlowLine
+	{
+		uint64_t id;
+		double flow;
+		bool hasId;
+	};
+
+	struct IdLink
+	{
+		uint64_t source;
+		uint64_t target;
+		double weight;
+	};
+
+	/**
+	 * Sort ids in parallel chunks merged pairwise.
+	 */
+	void sortIds(std::vector<uint64_t>& ids)
+	{
+		int numChunks = 1;
+#ifdef _OPENMP
+		if (ids.size() > LINK_CHUNK_SIZE)
+			numChunks = omp_get_max_threads();
+#endif
+		std::vector<std::size_t> bounds(numChunks + 1);
+		for (int i = 0; i <= numChunks; ++i)
+			bounds[i] = ids.size() * i / numChunks;
+
+#pragma omp parallel for schedule(static) if(numChunks > 1)
+		for (int i = 0; i < numChunks; ++i)
+			std::sort(ids.begin() + bounds[i], ids.begin() + bounds[i + 1]);
+
+		for (int width = 1; width < numChunks; width *= 2)
+		{
+			int numMerges = (numChunks + 2 * width - 1) / (2 * width);
+#pragma omp parallel for schedule(static) if(numMerges > 1)
+			for (int i = 0; i < numMerges; ++i)
+			{
+				int begin = 2 * i * width;
+				int middle = std::min(begin + width, numChunks);
+				int end = std::min(begin + 2 * width, numChunks);
+				std::inplace_merge(ids.begin() + bounds[begin], ids.begin() + bounds[middle], ids.begin() + bounds[end]);
+			}
+		}
+	}
+}
+
 void Network::readInputData(std::string filename)
 {
 	if (filename.empty())
@@ -52,9 +126,18 @@ void Network::readInputData(std::string filename)
 	FileURI networkFilename(filename, false);
 	std::string format = m_config.inputFormat;
 
+	if (isBinaryNetworkFile(filename))
+	{
+		parseBinaryNetwork(filename);
+		return;
+	}
+
 	if (format == "")
 	{
 		std::string type = networkFilename.getExtension();
+		// Use the extension before the compression extension, as in 'network.net.gz'
+		if (CompressedFile::isCompressedExtension(type))
+			type = FileURI(networkFilename.getName(), false).getExtension();
 		if (type == "net")
 			format = "pajek";
 		else if (type == "txt")
@@ -80,25 +163,85 @@ unsigned int Network::addNodes(const std::vector<std::string>& names)
 	if (m_config.nodeLimit > 0 && m_config.nodeLimit < m_numNodes)
 		m_numNodes = m_config.nodeLimit;
 
-	m_nodeNames.resize(m_numNodes);
+	m_nodeNames.clear();
+	m_nodeNames.reserve(m_numNodes);
 	m_nodeWeights.assign(m_numNodes, 1.0);
 	for (unsigned int i = 0; i < m_numNodes; ++i)
-		m_nodeNames[i] = names[i];
+		m_nodeNames.push_back(names[i]);
 	return m_numNodes;
 }
 
-void Network::parsePajekNetwork(std::string filename)
+void Network::setNodeWeights(const double* weights, unsigned int numNodes)
 {
-	if (m_config.parseWithoutIOStreams)
-	{
-		parsePajekNetworkWithoutIOStreams(filename);
-		return;
-	}
+	m_nodeWeights.assign(weights, weights + numNodes);
+	m_sumNodeWeights = 0.0;
+	for (unsigned int i = 0; i < numNodes; ++i)
+		m_sumNodeWeights += weights[i];
+}
+
+void Network::setStartNodeFlow(const double* flow, unsigned int numNodes)
+{
+	m_startNodeFlow.assign(flow, flow + numNodes);
+}
 
+void Network::readStartNodeFlow(std::string filename)
+{
+	Log() << "Reading start flow from file '" << filename << "'... " << std::flush;
+
+	LineReader input(filename);
+	unsigned int indexOffset = m_config.zeroBasedNodeNumbers ? 0 : 1;
+	unsigned int numFound = 0;
+	unsigned int nextIndex = 0;
+	m_startNodeFlow.assign(m_numNodes, -1.0);
+	input.parseLines<NodeFlowLine>(
+		[](const char* begin, const char* end, NodeFlowLine& line) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			const char* pos = begin;
+			double value = 0.0;
+			if (!io::scanDouble(pos, end, line.flow))
+				throw FileFormatError(io::Str() << "Can't parse node flow from line '" << std::string(begin, end) << "'");
+			line.hasId = io::scanDouble(pos, end, value);
+			if (line.hasId)
+			{
+				pos = begin;
+				if (!io::scanUnsigned(pos, end, line.id))
+					throw FileFormatError(io::Str() << "Can't parse node id from line '" << std::string(begin, end) << "'");
+				line.flow = value;
+			}
+			return true;
+		},
+		[&](const NodeFlowLine& line) {
+			unsigned int index = nextIndex++;
+			if (line.hasId)
+			{
+				if (!m_nodeIds.empty())
+				{
+					index = nodeIndex(line.id);
+					if (index == m_nodeIds.size() || m_nodeIds[index] != line.id)
+						index = m_numNodes;
+				}
+				else
+					index = line.id >= indexOffset && line.id - indexOffset < m_numNodes ?
+							static_cast<unsigned int>(line.id - indexOffset) : m_numNodes;
+			}
+			if (index < m_numNodes)
+			{
+				m_startNodeFlow[index] = line.flow;
+				++numFound;
+			}
+		},
+		false);
+
+	Log() << "done! Found start flow on " << numFound << " of " << m_numNodes << " nodes." << std::endl;
+}
+
+void Network::parsePajekNetwork(std::string filename)
+{
 	Log() << "Parsing " << (m_config.isUndirected() ? "undirected" : "directed") << " network from file '" <<
 			filename << "'... " << std::flush;
 
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
 	// Parse the vertices and return the line after
 	std::string line = parseVertices(input);
@@ -114,131 +257,15 @@ void Network::parsePajekNetwork(std::string filename)
 		Log() << "\n --> Notice: Links marked as directed in pajek file but parsed as undirected.\n";
 
 	// Read links in format "from to weight", for example "1 3 2" (all integers) and each undirected link only ones (weight is optional).
-	while(!std::getline(input, line).fail())
-	{
-		if (line.length() == 0)
-			continue;
-
-		unsigned int n1, n2;
-		double weight;
-		parseLink(line, n1, n2, weight);
-
-		addLink(n1, n2, weight);
-	}
-
-	Log() << "done!" << std::endl;
-
-	finalizeAndCheckNetwork();
-}
-
-void Network::parsePajekNetworkWithoutIOStreams(std::string filename)
-{
-	Log() << "Parsing " << (m_config.isUndirected() ? "undirected" : "directed") << " network from file '" <<
-				filename << "' (without iostreams)... " << std::flush;
-	FILE* file;
-	file = fopen(filename.c_str(), "r");
-	if (file == NULL)
-		throw FileOpenError(io::Str() << "Error opening file '" << filename << "'");
-
-	const int LINELENGTH = 511;
-	char line[LINELENGTH];
-	char *cptr;
-
-	while (m_numNodesFound == 0)
-	{
-		if (fgets(line , LINELENGTH , file) == NULL)
-			throw FileFormatError("Can't find a correct line that defines the beginning of the node section.");
-		if (strncmp(line, "*", 1) != 0)
-			continue;
-
-		cptr = strchr(line, ' ');
-		if (cptr == NULL)
-			throw FileFormatError("Can't find a correct line that defines the beginning of the node section.");
-		m_numNodesFound = atoi(++cptr);
-	}
-
-	bool checkNodeLimit = m_config.nodeLimit > 0;
-	m_numNodes = checkNodeLimit ? m_config.nodeLimit : m_numNodesFound;
-
-	m_nodeNames.resize(m_numNodes);
-	m_nodeWeights.assign(m_numNodes, 1.0);
-	m_sumNodeWeights = 0.0;
-
-	int next = fgetc(file);
-	ungetc(next, file);
-	if (next == '*') // Short pajek version (no nodes defined), set node number as name
-	{
-		char nameBuff[16];
-		for (unsigned int i = 0; i < m_numNodes; ++i)
-		{
-			m_nodeWeights[i] = 1.0;
-			snprintf(nameBuff, 16, "%d", i+1);
-			m_nodeNames[i] = std::string(nameBuff);
-		}
-		m_sumNodeWeights = m_numNodes * 1.0;
-	}
-	else
-	{
-		char *first;
-		char *last;
-		// Read node names, assuming order 1, 2, 3, ...
-		for(unsigned int i = 0; i < m_numNodes; ++i)
-		{
-			if (fgets (line , LINELENGTH , file) == NULL)
-				throw FileFormatError("Can't read enough nodes.");
-
-			first = strchr(line, '\"')+1;
-			last = strrchr(line, '\"');
-			if(last > first)
-			{
-				size_t len = (size_t)(last - first);
-				m_nodeNames[i] = std::string(first, len);
-			}
-			else
-			{
-				throw FileFormatError(io::Str() << "Can't read \"name\" of node " << (i+1) << ".");
-			}
-
-			double nodeWeight = strtod(++last, NULL);
-			if (nodeWeight < 1e-10)
-				nodeWeight = 1.0;
-
-			m_sumNodeWeights += nodeWeight;
-			m_nodeWeights[i] = nodeWeight;
-		}
-
-		if (m_config.nodeLimit > 0 && m_numNodes < m_numNodesFound)
-		{
-			unsigned int surplus = m_numNodesFound - m_numNodes;
-			for (unsigned int i = 0; i < surplus; ++i)
-			{
-				if (fgets (line , LINELENGTH , file) == NULL)
-					throw FileFormatError("The specified number of nodes is more than the number of lines that can be read.");
-			}
-		}
-	}
-
-
-	if (fgets (line , LINELENGTH , file) == NULL)
-		throw FileFormatError("Can't find a correct line that defines the beginning of the edge section.");
-	if (strncmp(line, "*", 1) != 0)
-		throw FileFormatError("Can't find a correct line that defines the beginning of the edge section.");
-
-	if (m_config.parseAsUndirected() && (strncmp(line, "*Arcs", 5) == 0 || strncmp(line, "*arcs", 5) == 0))
-		Log() << "\n --> Notice: Links marked as directed in pajek file but parsed as undirected.\n";
-
-
-	// Read links in format "from to weight", for example "1 3 2" (all integers) and each undirected link only ones (weight is optional).
-	while(fgets (line , LINELENGTH , file) != NULL)
-	{
-		unsigned int n1, n2;
-		double weight;
-		parseLink(line, n1, n2, weight);
-
-		addLink(n1, n2, weight);
-	}
-
-	fclose(file);
+	input.parseLines<SparseLinks::Entry>(
+		[this](const char* begin, const char* end, SparseLinks::Entry& link) -> bool {
+			if (begin == end)
+				return false;
+			parseLink(begin, end, link.source, link.target, link.weight);
+			return true;
+		},
+		[this](const SparseLinks::Entry& link) { addLink(link.source, link.target, link.weight); },
+		false);
 
 	Log() << "done!" << std::endl;
 
@@ -247,76 +274,27 @@ void Network::parsePajekNetworkWithoutIOStreams(std::string filename)
 
 void Network::parseLinkList(std::string filename)
 {
-	if (m_config.parseWithoutIOStreams)
-	{
-		parseLinkListWithoutIOStreams(filename);
-		return;
-	}
-
-	string line;
-	string buf;
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 	Log() << "Parsing " << (m_config.directed ? "directed" : "undirected") << " link list from file '" <<
 			filename << "'... " << std::flush;
 
-	std::istringstream ss;
-
-
 	// Read links in format "from to weight", for example "1 3 2" (all integers) and each undirected link only ones (weight is optional).
-
-	while(!std::getline(input, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		unsigned int n1, n2;
-		double weight;
-		parseLink(line, n1, n2, weight);
-
-		addLink(n1, n2, weight);
-	}
+	if (m_config.remapNodeIds)
+		parseLinksByIds(input);
+	else
+		parseLinks(input, false);
 
 	Log() << "done!" << std::endl;
 
 	finalizeAndCheckNetwork();
 }
 
-void Network::parseLinkListWithoutIOStreams(std::string filename)
-{
-	Log() << "Parsing " << (m_config.isUndirected() ? "undirected" : "directed") << " link list from file '" <<
-					filename << "' (without iostreams)... " << std::flush;
-	FILE* file;
-	file = fopen(filename.c_str(), "r");
-	if (file == NULL)
-		throw FileOpenError(io::Str() << "Error opening file '" << filename << "'");
-
-	const int LINELENGTH = 63;
-	char line[LINELENGTH];
-
-
-	// Read links in format "from to weight", for example "1 3 2" (all integers) and each undirected link only ones (weight is optional).
-	while(fgets (line , LINELENGTH , file) != NULL)
-	{
-		unsigned int n1, n2;
-		double weight;
-		parseLink(line, n1, n2, weight);
-
-		addLink(n1, n2, weight);
-	}
-
-	fclose(file);
-
-	Log() << "done! ";
-
-	finalizeAndCheckNetwork();
-}
-
 void Network::parseGeneralNetwork(std::string filename)
 {
 	Log() << "Parsing network from file '" <<
 			filename << "'... " << std::flush;
 
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
 	std::string line = parseLinks(input);
 
@@ -350,7 +328,7 @@ void Network::parseBipartiteNetwork(std::string filename)
 	Log() << "Parsing bipartite network from file '" <<
 			filename << "'... " << std::flush;
 
-	SafeInFile input(filename.c_str());
+	LineReader input(filename);
 
 	std::string line = parseBipartiteLinks(input);
 
@@ -387,28 +365,116 @@ void Network::parseBipartiteNetwork(std::string filename)
 //
 //////////////////////////////////////////////////////////////////////////////////////////
 
-std::string Network::skipUntilHeader(std::ifstream& file)
+void Network::parseBinaryNetwork(std::string filename)
 {
-	std::string line;
+	Log() << "Loading binary network from file '" << filename << "'... " << std::flush;
+
+	BinaryNetworkReader input(filename);
+	const BinaryNetworkHeader& header = input.header();
+
+	if (header.flags & BinaryNetwork::STATE_NETWORK)
+		throw FileFormatError(io::Str() << "The binary network file '" << filename <<
+				"' contains a state network, use input format 'states' to load it.");
+	if ((header.flags & BinaryNetwork::UNDIRECTED) && !m_config.parseAsUndirected())
+		Log() << "\n --> Notice: Links stored as undirected but parsed as directed.\n";
+	else if (!(header.flags & BinaryNetwork::UNDIRECTED) && m_config.parseAsUndirected())
+		Log() << "\n --> Notice: Links stored as directed but parsed as undirected.\n";
+
+	input.checkNumLinks(header.numLinks);
+	unsigned int numNodes = header.numNodes;
+	unsigned int numRows = header.numRows;
+	link_index numLinks = header.numLinks;
+
+	std::vector<link_index> convertedOffsets;
+	const link_index* offsets = input.linkOffsets(numRows + 1, convertedOffsets);
+	const unsigned int* targets = input.section<unsigned int>(BinaryNetwork::LINK_TARGETS, numLinks);
+	if (offsets == 0 || (targets == 0 && numLinks > 0) || numRows > numNodes)
+		throw FileFormatError(io::Str() << "Missing links in binary network file '" << filename << "'.");
+
+	// Check the link structure once, as it is used directly without further checks
+	if (offsets[0] != 0 || offsets[numRows] != numLinks)
+		throw FileFormatError(io::Str() << "Corrupt link offsets in binary network file '" << filename << "'.");
+	for (unsigned int row = 0; row < numRows; ++row)
+	{
+		if (offsets[row] > offsets[row + 1])
+			throw FileFormatError(io::Str() << "Corrupt link offsets in binary network file '" << filename << "'.");
+	}
+	for (link_index i = 0; i < numLinks; ++i)
+	{
+		if (targets[i] >= numNodes)
+			throw InputDomainError(io::Str() << "At least one link in binary network file '" << filename <<
+					"' is defined with node numbers that exceeds the number of nodes.");
+	}
 
-	// First skip lines until header
-	while(!std::getline(file, line).fail())
+	if (!input.header().hasSection(BinaryNetwork::LINK_WEIGHTS))
 	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-		if (line[0] == '*')
-			break;
+		std::vector<double> weights(numLinks, 1.0);
+		m_links.assign(numRows, offsets, targets, weights);
+	}
+	else if (header.flags & BinaryNetwork::FLOAT_WEIGHTS)
+	{
+		const float* floatWeights = input.section<float>(BinaryNetwork::LINK_WEIGHTS, numLinks);
+		std::vector<double> weights(floatWeights, floatWeights + numLinks);
+		m_links.assign(numRows, offsets, targets, weights);
+	}
+	else if (!convertedOffsets.empty())
+	{
+		const double* weightData = input.section<double>(BinaryNetwork::LINK_WEIGHTS, numLinks);
+		std::vector<double> weights(weightData, weightData + numLinks);
+		m_links.assign(numRows, offsets, targets, weights);
+	}
+	else
+	{
+		const double* weights = input.section<double>(BinaryNetwork::LINK_WEIGHTS, numLinks);
+		m_links.assignExternal(numRows, offsets, targets, weights, input.owner());
 	}
 
-	return line;
+	readBinaryNodeNames(input, numNodes);
+
+	if (header.hasSection(BinaryNetwork::NODE_WEIGHTS))
+	{
+		const double* nodeWeights = input.section<double>(BinaryNetwork::NODE_WEIGHTS, numNodes);
+		m_nodeWeights.assign(nodeWeights, nodeWeights + numNodes);
+	}
+
+	m_numNodes = numNodes;
+	m_numNodesFound = header.numNodesFound;
+	m_sumNodeWeights = header.sumNodeWeights;
+	m_numLinks = numLinks;
+	m_numLinksFound = header.numLinksFound;
+	m_totalLinkWeight = header.totalLinkWeight;
+	m_numAggregatedLinks = header.numAggregatedLinks;
+	m_numSelfLinks = header.numSelfLinks;
+	m_numSelfLinksFound = header.numSelfLinksFound;
+	m_totalSelfLinkWeight = header.totalSelfLinkWeight;
+	m_numAdditionalLinks = header.numAdditionalLinks;
+	m_sumAdditionalLinkWeight = header.sumAdditionalLinkWeight;
+	m_minNodeIndex = header.minNodeIndex;
+	m_maxNodeIndex = header.maxNodeIndex;
+	m_numBipartiteNodes = header.numBipartiteNodes;
+
+	Log() << "done!" << std::endl;
+
+	if (m_links.empty())
+		throw InputDomainError("No links added!");
+
+	m_isFinalized = true;
+
+	// Self-teleportation links are stored if added when written
+	if (m_addSelfLinks && m_numAdditionalLinks == 0)
+		zoom();
+
+	initNodeDegrees();
+
+	printParsingResult();
 }
 
-std::string Network::parseVertices(std::ifstream& file, bool required)
+std::string Network::skipUntilHeader(LineReader& input)
 {
 	std::string line;
 
 	// First skip lines until header
-	while(!std::getline(file, line).fail())
+	while(input.getline(line))
 	{
 		if (line.length() == 0 || line[0] == '#')
 			continue;
@@ -416,13 +482,20 @@ std::string Network::parseVertices(std::ifstream& file, bool required)
 			break;
 	}
 
+	return line;
+}
+
+std::string Network::parseVertices(LineReader& input, bool required)
+{
+	std::string line = skipUntilHeader(input);
+
 	if (line.length() == 0 || line[0] != '*')
 		throw FileFormatError("No matching header for vertices found.");
 
-	return parseVertices(file, line, required);
+	return parseVertices(input, line, required);
 }
 
-std::string Network::parseVertices(std::ifstream& file, std::string header, bool required)
+std::string Network::parseVertices(LineReader& input, std::string header, bool required)
 {
 	std::istringstream ss;
 	std::string buf;
@@ -445,19 +518,15 @@ std::string Network::parseVertices(std::ifstream& file, std::string header, bool
 	bool checkNodeLimit = m_config.nodeLimit > 0;
 	m_numNodes = checkNodeLimit ? m_config.nodeLimit : m_numNodesFound;
 
-	m_nodeNames.resize(m_numNodes);
+	m_nodeNames.clear();
 	m_nodeWeights.assign(m_numNodes, 1.0);
 	m_sumNodeWeights = 0.0;
 
 	std::string line;
-	char next = file.peek();
-	if (next == '*') // Short pajek version (no nodes defined), set node number as name
+	if (input.peek() == '*') // Short pajek version (no nodes defined), set node number as name
 	{
-		for (unsigned int i = 0; i < m_numNodes; ++i)
-		{
-			m_nodeWeights[i] = 1.0;
-			m_nodeNames[i] = io::stringify(i+1);
-		}
+		m_nodeNames.setDefaultName("", 1);
+		m_nodeNames.resize(m_numNodes);
 		m_sumNodeWeights = m_numNodes * 1.0;
 	}
 	else
@@ -466,138 +535,144 @@ std::string Network::parseVertices(std::ifstream& file, std::string header, bool
 		for (unsigned int i = 0; i < m_numNodes; ++i)
 		{
 			unsigned int id = 0;
-			if (!(file >> id) || id != static_cast<unsigned int>(i + m_indexOffset))
+			string name;
+			double nodeWeight = 1.0;
+			if (!parseVertex(input, id, name, nodeWeight) || id != static_cast<unsigned int>(i + m_indexOffset))
 			{
 				throw BadConversionError(io::Str() << "Couldn't parse line " << (i + m_indexOffset + 1) << ". Should begin with node number " << (i + m_indexOffset) <<
 						((m_indexOffset == 1 && id == i)? ".\nBe sure to use zero-based node numbering if the node numbers start from zero." : "."));
 			}
-			// Read the rest of the line
-			std::getline(file,line);
-			unsigned int nameStart = line.find_first_of("\"");
-			unsigned int nameEnd = line.find_last_of("\"");
-			string name;
-			double nodeWeight = 1.0;
-			if(nameStart < nameEnd) {
-				name = string(line.begin() + nameStart + 1, line.begin() + nameEnd);
-				line = line.substr(nameEnd + 1);
-				ss.clear();
-				ss.str(line);
-			}
-			else {
-				ss.clear();
-				ss.str(line);
-				ss >> buf; // Take away the index from the stream
-				ss >> name; // Extract the next token as the name assuming no spaces
-			}
-			ss >> nodeWeight; // Extract the next token as node weight. If failed, the old value (1.0) is kept.
 			m_sumNodeWeights += nodeWeight;
 			m_nodeWeights[i] = nodeWeight;
-			m_nodeNames[i] = name;
+			m_nodeNames.push_back(name);
 		}
 
 		if (m_config.nodeLimit > 0 && m_numNodes < m_numNodesFound)
 		{
 			unsigned int surplus = m_numNodesFound - m_numNodes;
 			for (unsigned int i = 0; i < surplus; ++i)
-				std::getline(file, line);
+				input.getline(line);
 		}
 	}
 	// Return the line after the vertices
-	std::getline(file, line);
+	input.getline(line);
 	// Continue past commented lines
 	while (line.length() > 0 && line[0] == '#')
-		std::getline(file, line);
+		input.getline(line);
 	return line;
 }
 
-std::string Network::parseLinks(std::ifstream& file)
+bool Network::parseVertex(LineReader& input, unsigned int& id, std::string& name, double& weight)
 {
+	// Skip blank lines before the id like the extraction operator
+	if (!input.skipSpace())
+		return false;
 	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int n1, n2;
-		double weight;
-		parseLink(line, n1, n2, weight);
+	input.getline(line);
+	const char* pos = line.data();
+	const char* end = pos + line.length();
+	if (!io::scanUnsigned(pos, end, id))
+		return false;
 
-		addLink(n1, n2, weight);
+	std::string::size_type nameStart = line.find_first_of('"');
+	std::string::size_type nameEnd = line.find_last_of('"');
+	if (nameStart != std::string::npos && nameStart < nameEnd) {
+		name.assign(line, nameStart + 1, nameEnd - nameStart - 1);
+		pos = line.data() + nameEnd + 1;
+		io::scanDouble(pos, end, weight);
 	}
-	return line;
+	else {
+		// Extract the next token as the name assuming no spaces, after the token following the index
+		std::string buf;
+		if (io::scanWord(pos, end, buf) && io::scanWord(pos, end, name))
+			io::scanDouble(pos, end, weight);
+	}
+	return true;
 }
 
-std::string Network::parseBipartiteLinks(std::ifstream& file)
+std::string Network::parseLinks(LineReader& input, bool stopAtHeader)
 {
-	std::string line;
-	while(!std::getline(file, line).fail())
-	{
-		if (line.length() == 0 || line[0] == '#')
-			continue;
-
-		if (line[0] == '*')
-			break;
-
-		unsigned int featureNode, ordinaryNode;
-		double weight;
-		bool swappedOrder = parseBipartiteLink(line, featureNode, ordinaryNode, weight);
+	return input.parseLines<SparseLinks::Entry>(
+		[this](const char* begin, const char* end, SparseLinks::Entry& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			parseLink(begin, end, link.source, link.target, link.weight);
+			return true;
+		},
+		[this](const SparseLinks::Entry& link) { addLink(link.source, link.target, link.weight); },
+		stopAtHeader);
+}
 
-		addBipartiteLink(featureNode, ordinaryNode, swappedOrder, weight);
-	}
-	return line;
+void Network::parseLinksByIds(LineReader& input)
+{
+	std::vector<uint64_t> sourceIds;
+	std::vector<uint64_t> targetIds;
+	std::vector<double> weights;
+	input.parseLines<IdLink>(
+		[](const char* begin, const char* end, IdLink& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			const char* pos = begin;
+			if (!io::scanUnsigned(pos, end, link.source) || !io::scanUnsigned(pos, end, link.target))
+				throw FileFormatError(io::Str() << "Can't parse link data from line '" << std::string(begin, end) << "'");
+			if (!io::scanDouble(pos, end, link.weight))
+				link.weight = 1.0;
+			return true;
+		},
+		[&](const IdLink& link) {
+			sourceIds.push_back(link.source);
+			targetIds.push_back(link.target);
+			weights.push_back(link.weight);
+		},
+		false);
+	addLinksByIds(sourceIds.data(), targetIds.data(), weights.data(), sourceIds.size());
 }
 
-void Network::parseLink(const std::string& line, unsigned int& n1, unsigned int& n2, double& weight)
+std::string Network::parseBipartiteLinks(LineReader& input)
 {
-	m_extractor.clear();
-	m_extractor.str(line);
-	if (!(m_extractor >> n1 >> n2))
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
-	n1 -= m_indexOffset;
-	n2 -= m_indexOffset;
+	typedef std::pair<BipartiteLink, double> WeightedBipartiteLink;
+	return input.parseLines<WeightedBipartiteLink>(
+		[this](const char* begin, const char* end, WeightedBipartiteLink& link) -> bool {
+			if (begin == end || *begin == '#')
+				return false;
+			link.first.swapOrder = parseBipartiteLink(begin, end, link.first.featureNode, link.first.node, link.second);
+			return true;
+		},
+		[this](const WeightedBipartiteLink& link) {
+			addBipartiteLink(link.first.featureNode, link.first.node, link.first.swapOrder, link.second);
+		});
 }
 
-void Network::parseLink(char line[], unsigned int& n1, unsigned int& n2, double& weight)
-{
-	char *cptr;
-	cptr = strtok(line, " \t"); // Get first non-whitespace character position
-	if (cptr == NULL)
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	n1 = atoi(cptr); // get first connected node
-	cptr = strtok(NULL, " \t"); // Get second non-whitespace character position
-	if (cptr == NULL)
-		throw FileFormatError(io::Str() << "Can't parse link data from line '" << line << "'");
-	n2 = atoi(cptr); // get the second connected node
-	cptr = strtok(NULL, " \t"); // Get third non-whitespace character position
-	if (cptr != NULL)
-		weight = atof(cptr); // get the link weight
-	else
+void Network::parseLink(const char* begin, const char* end, unsigned int& n1, unsigned int& n2, double& weight) const
+{
+	const char* pos = begin;
+	if (!io::scanUnsigned(pos, end, n1) || !io::scanUnsigned(pos, end, n2))
+		throw FileFormatError(io::Str() << "Can't parse link data from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
 		weight = 1.0;
 	n1 -= m_indexOffset;
 	n2 -= m_indexOffset;
 }
 
-bool Network::parseBipartiteLink(const std::string& line, unsigned int& featureNode, unsigned int& node, double& weight)
+bool Network::parseBipartiteLink(const char* begin, const char* end, unsigned int& featureNode, unsigned int& node, double& weight) const
 {
 	bool swappedOrder = false;
-	m_extractor.clear();
-	m_extractor.str(line);
+	const char* pos = begin;
 	std::string fn, n;
-	if (!(m_extractor >> fn >> n))
-		throw FileFormatError(io::Str() << "Can't parse bipartite link data from line '" << line << "'");
-	(m_extractor >> weight) || (weight = 1.0);
+	if (!io::scanWord(pos, end, fn) || !io::scanWord(pos, end, n))
+		throw FileFormatError(io::Str() << "Can't parse bipartite link data from line '" << std::string(begin, end) << "'");
+	if (!io::scanDouble(pos, end, weight))
+		weight = 1.0;
 	if (fn[0] != 'f') {
 		std::swap(fn, n);
 		swappedOrder = true;
 	}
-	if (fn[0] != 'f' || fn.length() == 1 || !(std::istringstream( fn.substr(1) ) >> featureNode))
-		throw FileFormatError(io::Str() << "Can't parse bipartite feature node (a numerical id prefixed by 'f') from line '" << line << "'");
-	if (n[0] != 'n' || n.length() == 1 || !(std::istringstream( n.substr(1) ) >> node))
-		throw FileFormatError(io::Str() << "Can't parse bipartite ordinary node (a numerical id prefixed by 'n') from line '" << line << "'");
+	const char* fnPos = fn.data() + 1;
+	if (fn[0] != 'f' || fn.length() == 1 || !io::scanUnsigned(fnPos, fn.data() + fn.length(), featureNode))
+		throw FileFormatError(io::Str() << "Can't parse bipartite feature node (a numerical id prefixed by 'f') from line '" << std::string(begin, end) << "'");
+	const char* nPos = n.data() + 1;
+	if (n[0] != 'n' || n.length() == 1 || !io::scanUnsigned(nPos, n.data() + n.length(), node))
+		throw FileFormatError(io::Str() << "Can't parse bipartite ordinary node (a numerical id prefixed by 'n') from line '" << std::string(begin, end) << "'");
 
 	featureNode -= m_indexOffset;
 	node -= m_indexOffset;
@@ -642,36 +717,247 @@ bool Network::addBipartiteLink(unsigned int featureNode, unsigned int node, bool
 	m_maxNodeIndex = std::max(m_maxNodeIndex, node);
 	m_minNodeIndex = std::min(m_minNodeIndex, node);
 
-	m_bipartiteLinks[BipartiteLink(featureNode, node, swapOrder)] += weight;
+	// Aggregated on finalize, when the feature nodes can be offset by the number of ordinary nodes
+	if (swapOrder)
+		m_swappedBipartiteLinks.append(featureNode, node, weight);
+	else
+		m_bipartiteLinks.append(featureNode, node, weight);
 
 	return true;
 }
 
 
-bool Network::insertLink(unsigned int n1, unsigned int n2, double weight)
+link_index Network::addLinks(const unsigned int* sources, const unsigned int* targets, const double* weights, std::size_t numLinks)
 {
-	++m_numLinks;
-	m_totalLinkWeight += weight;
+	m_numLinksFound += numLinks;
+
+	const unsigned int nodeLimit = m_config.nodeLimit;
+	const bool includeSelfLinks = m_config.includeSelfLinks;
+	const bool undirected = m_config.parseAsUndirected();
+
+	// Count the accepted links per chunk to give each chunk its own range in the edge buffer
+	int numChunks = static_cast<int>((numLinks + LINK_CHUNK_SIZE - 1) / LINK_CHUNK_SIZE);
+	std::vector<LinkChunk> chunks(numChunks);
 
-	// Aggregate link weights if they are definied more than once
-	LinkMap::iterator firstIt = m_links.lower_bound(n1);
-	if (firstIt != m_links.end() && firstIt->first == n1) // First linkEnd already exists, check second linkEnd
+#pragma omp parallel for schedule(static) if(numChunks > 1)
+	for (int i = 0; i < numChunks; ++i)
 	{
-		std::pair<std::map<unsigned int, double>::iterator, bool> ret2 = firstIt->second.insert(std::make_pair(n2, weight));
-		if (!ret2.second)
+		LinkChunk& chunk = chunks[i];
+		std::size_t end = std::min((i + 1) * LINK_CHUNK_SIZE, numLinks);
+		for (std::size_t j = i * LINK_CHUNK_SIZE; j < end; ++j)
 		{
-			ret2.first->second += weight;
-			++m_numAggregatedLinks;
-			--m_numLinks;
-			return false;
+			if (nodeLimit > 0 && (sources[j] >= nodeLimit || targets[j] >= nodeLimit))
+				continue;
+			if (sources[j] == targets[j])
+			{
+				++chunk.numSelfLinksFound;
+				if (!includeSelfLinks)
+					continue;
+			}
+			++chunk.numLinks;
 		}
 	}
-	else
+
+	std::vector<std::size_t> chunkBegin(numChunks + 1, 0);
+	for (int i = 0; i < numChunks; ++i)
+		chunkBegin[i + 1] = chunkBegin[i] + chunks[i].numLinks;
+	std::size_t numAdded = chunkBegin[numChunks];
+	SparseLinks::Entry* entries = m_links.extend(numAdded);
+
+#pragma omp parallel for schedule(static) if(numChunks > 1)
+	for (int i = 0; i < numChunks; ++i)
 	{
-		m_links.insert(firstIt, std::make_pair(n1, std::map<unsigned int, double>()))->second.insert(std::make_pair(n2, weight));
+		LinkChunk& chunk = chunks[i];
+		SparseLinks::Entry* entry = entries + chunkBegin[i];
+		std::size_t end = std::min((i + 1) * LINK_CHUNK_SIZE, numLinks);
+		for (std::size_t j = i * LINK_CHUNK_SIZE; j < end; ++j)
+		{
+			unsigned int n1 = sources[j];
+			unsigned int n2 = targets[j];
+			if (nodeLimit > 0 && (n1 >= nodeLimit || n2 >= nodeLimit))
+				continue;
+			if (n2 == n1 && !includeSelfLinks)
+				continue;
+			if (undirected && n2 < n1) // minimize number of links
+				std::swap(n1, n2);
+			chunk.maxNodeIndex = std::max(chunk.maxNodeIndex, n2 > n1 ? n2 : n1);
+			chunk.minNodeIndex = std::min(chunk.minNodeIndex, n2 < n1 ? n2 : n1);
+			*entry++ = SparseLinks::Entry(n1, n2, weights == 0 ? 1.0 : weights[j]);
+		}
 	}
 
-	return true;
+	for (int i = 0; i < numChunks; ++i)
+	{
+		m_numSelfLinksFound += chunks[i].numSelfLinksFound;
+		m_maxNodeIndex = std::max(m_maxNodeIndex, chunks[i].maxNodeIndex);
+		m_minNodeIndex = std::min(m_minNodeIndex, chunks[i].minNodeIndex);
+	}
+
+	// Sum the weights in input order to get the same totals as addLink
+	for (std::size_t i = 0; i < numAdded; ++i)
+	{
+		const SparseLinks::Entry& entry = entries[i];
+		m_totalLinkWeight += entry.weight;
+		if (entry.source == entry.target)
+		{
+			++m_numSelfLinks;
+			m_totalSelfLinkWeight += entry.weight;
+		}
+	}
+	m_numLinks += numAdded;
+
+	return numAdded;
+}
+
+void Network::setLinks(unsigned int numRows, std::vector<link_index>& offsets, std::vector<unsigned int>& targets, std::vector<double>& weights)
+{
+	if (offsets.size() != numRows + 1 || offsets[0] != 0 || offsets[numRows] != targets.size())
+		throw InputDomainError(io::Str() << "The " << offsets.size() << " row offsets don't match " << numRows <<
+				" rows with " << targets.size() << " links.");
+	if (!weights.empty() && weights.size() != targets.size())
+		throw InputDomainError(io::Str() << "The number of link weights (" << weights.size() <<
+				") doesn't match the number of links (" << targets.size() << ").");
+	for (unsigned int n1 = 0; n1 < numRows; ++n1)
+		if (offsets[n1 + 1] < offsets[n1])
+			throw InputDomainError(io::Str() << "Decreasing row offset on row " << n1 << ".");
+
+	const unsigned int nodeLimit = m_config.nodeLimit;
+	const bool includeSelfLinks = m_config.includeSelfLinks;
+	const bool undirected = m_config.parseAsUndirected();
+
+	// The rows can be used as they are if they are what compactLinks would produce
+	bool isCompact = m_links.empty();
+	for (unsigned int n1 = 0; isCompact && n1 < numRows; ++n1)
+	{
+		for (link_index i = offsets[n1]; i < offsets[n1 + 1]; ++i)
+		{
+			unsigned int n2 = targets[i];
+			if ((i > offsets[n1] && n2 <= targets[i - 1]) ||
+					(nodeLimit > 0 && (n1 >= nodeLimit || n2 >= nodeLimit)) ||
+					(n2 == n1 && !includeSelfLinks) ||
+					(undirected && n2 < n1))
+			{
+				isCompact = false;
+				break;
+			}
+		}
+	}
+
+	if (!isCompact)
+	{
+		std::vector<unsigned int> sources(targets.size());
+		for (unsigned int n1 = 0; n1 < numRows; ++n1)
+			std::fill(sources.begin() + offsets[n1], sources.begin() + offsets[n1 + 1], n1);
+		addLinks(sources.data(), targets.data(), weights.empty() ? 0 : weights.data(), targets.size());
+		std::vector<link_index>().swap(offsets);
+		std::vector<unsigned int>().swap(targets);
+		std::vector<double>().swap(weights);
+		return;
+	}
+
+	if (weights.empty())
+		weights.assign(targets.size(), 1.0);
+
+	for (unsigned int n1 = 0; n1 < numRows; ++n1)
+	{
+		if (offsets[n1] == offsets[n1 + 1])
+			continue;
+		m_minNodeIndex = std::min(m_minNodeIndex, std::min(n1, targets[offsets[n1]]));
+		m_maxNodeIndex = std::max(m_maxNodeIndex, std::max(n1, targets[offsets[n1 + 1] - 1]));
+		for (link_index i = offsets[n1]; i < offsets[n1 + 1]; ++i)
+		{
+			m_totalLinkWeight += weights[i];
+			if (targets[i] == n1)
+			{
+				++m_numSelfLinksFound;
+				++m_numSelfLinks;
+				m_totalSelfLinkWeight += weights[i];
+			}
+		}
+	}
+	m_numLinksFound += targets.size();
+	m_numLinks += targets.size();
+
+	// Trailing rows without links are added back on compaction if the nodes exist
+	while (numRows > 0 && offsets[numRows - 1] == offsets[numRows])
+		--numRows;
+	offsets.resize(numRows + 1);
+	m_links.assign(numRows, offsets, targets, weights);
+}
+
+link_index Network::addLinksByIds(const uint64_t* sourceIds, const uint64_t* targetIds, const double* weights, std::size_t numLinks)
+{
+	// Collect the new ids, sorted without duplicates
+	std::vector<uint64_t> ids(sourceIds, sourceIds + numLinks);
+	ids.insert(ids.end(), targetIds, targetIds + numLinks);
+	sortIds(ids);
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	if (!m_nodeIds.empty())
+	{
+		std::size_t numNew = 0;
+		for (std::size_t i = 0; i < ids.size(); ++i)
+		{
+			unsigned int index = nodeIndex(ids[i]);
+			if (index == m_nodeIds.size() || m_nodeIds[index] != ids[i])
+				ids[numNew++] = ids[i];
+		}
+		ids.resize(numNew);
+	}
+
+	std::size_t numIds = m_nodeIds.size() + ids.size();
+	if (numIds > std::numeric_limits<unsigned int>::max())
+		throw InputDomainError(io::Str() << "Can't remap " << numIds << " node ids, more than the maximum number of nodes.");
+
+	// Give the new ids the next node indices and merge them into the sorted lookup
+	unsigned int firstNewIndex = m_nodeIds.size();
+	m_nodeIds.insert(m_nodeIds.end(), ids.begin(), ids.end());
+	std::vector<uint64_t>().swap(ids);
+	m_nodeIdOrder.resize(numIds);
+	for (unsigned int i = firstNewIndex; i < numIds; ++i)
+		m_nodeIdOrder[i] = i;
+	const std::vector<uint64_t>& nodeIds = m_nodeIds;
+	std::inplace_merge(m_nodeIdOrder.begin(), m_nodeIdOrder.begin() + firstNewIndex, m_nodeIdOrder.end(),
+			[&nodeIds](unsigned int a, unsigned int b) { return nodeIds[a] < nodeIds[b]; });
+
+	std::vector<unsigned int> sources(numLinks);
+	std::vector<unsigned int> targets(numLinks);
+	int numChunks = static_cast<int>((numLinks + LINK_CHUNK_SIZE - 1) / LINK_CHUNK_SIZE);
+#pragma omp parallel for schedule(static) if(numChunks > 1)
+	for (int i = 0; i < numChunks; ++i)
+	{
+		std::size_t end = std::min((i + 1) * LINK_CHUNK_SIZE, numLinks);
+		for (std::size_t j = i * LINK_CHUNK_SIZE; j < end; ++j)
+		{
+			sources[j] = nodeIndex(sourceIds[j]);
+			targets[j] = nodeIndex(targetIds[j]);
+		}
+	}
+
+	return addLinks(sources.data(), targets.data(), weights, numLinks);
+}
+
+unsigned int Network::nodeIndex(uint64_t id) const
+{
+	const std::vector<uint64_t>& nodeIds = m_nodeIds;
+	std::vector<unsigned int>::const_iterator it = std::lower_bound(m_nodeIdOrder.begin(), m_nodeIdOrder.end(), id,
+			[&nodeIds](unsigned int index, uint64_t id) { return nodeIds[index] < id; });
+	return it == m_nodeIdOrder.end() ? m_nodeIds.size() : *it;
+}
+
+void Network::insertLink(unsigned int n1, unsigned int n2, double weight)
+{
+	++m_numLinks;
+	m_totalLinkWeight += weight;
+
+	// Aggregate link weights if they are definied more than once when compacted
+	m_links.append(n1, n2, weight);
+}
+
+void Network::compactLinks()
+{
+	link_index numAggregatedLinks = m_links.compact(m_numNodes);
+	m_numAggregatedLinks += numAggregatedLinks;
+	m_numLinks -= numAggregatedLinks;
 }
 
 void Network::finalizeAndCheckNetwork(bool printSummary, unsigned int desiredNumberOfNodes)
@@ -679,15 +965,15 @@ void Network::finalizeAndCheckNetwork(bool printSummary, unsigned int desiredNum
 	m_isFinalized = true;
 	// If no nodes defined
 	if (m_numNodes == 0)
-		m_numNodes = m_numNodesFound = m_maxNodeIndex + 1;
+		m_numNodes = m_numNodesFound = std::max<std::size_t>(m_maxNodeIndex + 1, m_nodeIds.size());
 
 	if (desiredNumberOfNodes != 0)
 	{
 		if (!m_nodeNames.empty() && desiredNumberOfNodes != m_nodeNames.size()) {
 			// throw InputDomainError("Can't change the number of nodes in networks with a specified number of nodes.");
-			m_nodeNames.reserve(desiredNumberOfNodes);
-			for (unsigned int i = m_nodeNames.size(); i < desiredNumberOfNodes; ++i) {
-				m_nodeNames.push_back(io::Str() << "_completion_node_" << (i + 1));
+			if (desiredNumberOfNodes > m_nodeNames.size()) {
+				m_nodeNames.setDefaultName("_completion_node_", 1);
+				m_nodeNames.resize(desiredNumberOfNodes);
 			}
 		}
 		m_numNodes = desiredNumberOfNodes;
@@ -702,25 +988,45 @@ void Network::finalizeAndCheckNetwork(bool printSummary, unsigned int desiredNum
 	if (m_minNodeIndex == 1 && m_config.zeroBasedNodeNumbers)
 		Log() << "(Warning: minimum link index is one, check that you don't use zero based numbering if it's not true.) ";
 
-	if (!m_bipartiteLinks.empty())
+	if (!m_bipartiteLinks.empty() || !m_swappedBipartiteLinks.empty())
 	{
 		if (m_numLinks > 0)
 			throw InputDomainError("Can't add bipartite links together with ordinary links.");
-		for (std::map<BipartiteLink, Weight>::iterator it(m_bipartiteLinks.begin()); it != m_bipartiteLinks.end(); ++it)
+		m_bipartiteLinks.compact();
+		m_swappedBipartiteLinks.compact();
+		unsigned int numFeatureNodes = std::max(m_bipartiteLinks.numRows(), m_swappedBipartiteLinks.numRows());
+		for (unsigned int featureNode = 0; featureNode < numFeatureNodes; ++featureNode)
 		{
-			const BipartiteLink& link = it->first;
+			SparseLinks::Row links(m_bipartiteLinks.row(featureNode));
+			SparseLinks::Row swappedLinks(m_swappedBipartiteLinks.row(featureNode));
+			if (links.empty() && swappedLinks.empty())
+				continue;
 			// Offset feature nodes by the number of ordinary nodes to make them unique
-			unsigned int featureNodeIndex = link.featureNode + m_numNodes;
+			unsigned int featureNodeIndex = featureNode + m_numNodes;
 			m_maxNodeIndex = std::max(m_maxNodeIndex, featureNodeIndex);
-			if (link.swapOrder)
-				insertLink(link.node, featureNodeIndex, it->second.weight);
-			else
-				insertLink(featureNodeIndex, link.node, it->second.weight);
+			// Merge the two rows to insert the links in (feature node, node) order
+			while (!links.empty() || !swappedLinks.empty())
+			{
+				if (swappedLinks.empty() || (!links.empty() && links.target() <= swappedLinks.target()))
+				{
+					insertLink(featureNodeIndex, links.target(), links.weight());
+					links.pop();
+				}
+				else
+				{
+					insertLink(swappedLinks.target(), featureNodeIndex, swappedLinks.weight());
+					swappedLinks.pop();
+				}
+			}
 		}
+		m_bipartiteLinks.clear();
+		m_swappedBipartiteLinks.clear();
 		m_numBipartiteNodes = m_maxNodeIndex + 1 - m_numNodes;
 		m_numNodes += m_numBipartiteNodes;
 	}
 
+	compactLinks();
+
 	if (m_links.empty())
 		throw InputDomainError("No links added!");
 
@@ -738,22 +1044,19 @@ void Network::zoom()
 	unsigned int numNodes = m_numNodes;
 	std::vector<unsigned int> nodeOutDegree(numNodes, 0);
 	std::vector<double> sumLinkOutWeight(numNodes, 0.0);
-	std::map<unsigned int, double> dummy;
-	std::vector<std::map<unsigned int, double>::iterator> existingSelfLinks(numNodes, dummy.end());
+	std::vector<link_index> existingSelfLinks(numNodes, SparseLinks::npos());
 
-	for (LinkMap::iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
+	for (unsigned int linkEnd1 = 0; linkEnd1 < m_links.numRows(); ++linkEnd1)
 	{
-		unsigned int linkEnd1 = linkIt->first;
-		std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index i = m_links.rowBegin(linkEnd1); i < m_links.rowEnd(linkEnd1); ++i)
 		{
-			unsigned int linkEnd2 = subIt->first;
-			double linkWeight = subIt->second;
+			unsigned int linkEnd2 = m_links.target(i);
+			double linkWeight = m_links.weight(i);
 			++nodeOutDegree[linkEnd1];
 			if (linkEnd1 == linkEnd2)
 			{
 				// Store existing self-link to aggregate additional weight
-				existingSelfLinks[linkEnd1] = subIt;
+				existingSelfLinks[linkEnd1] = i;
 //				sumLinkOutWeight[linkEnd1] += linkWeight;
 			}
 			else
@@ -781,16 +1084,19 @@ void Network::zoom()
 
 		double selfLinkWeight = sumLinkOutWeight[i] * selfProb / (1.0 - selfProb);
 
-		if (existingSelfLinks[i] != dummy.end()) {
-			existingSelfLinks[i]->second += selfLinkWeight;
+		if (existingSelfLinks[i] != SparseLinks::npos()) {
+			m_links.weight(existingSelfLinks[i]) += selfLinkWeight;
 		}
 		else {
-			m_links[i].insert(std::make_pair(i, selfLinkWeight));
+			m_links.append(i, i, selfLinkWeight);
 			++m_numAdditionalLinks;
 		}
 		m_sumAdditionalLinkWeight += selfLinkWeight;
 	}
 
+	// Merge the new self-links into the rows, no duplicates to aggregate
+	m_links.compact(numNodes);
+
 	m_numLinks += m_numAdditionalLinks;
 	m_numSelfLinks += m_numAdditionalLinks;
 	m_totalLinkWeight += m_sumAdditionalLinkWeight;
@@ -802,14 +1108,12 @@ void Network::initNodeDegrees()
 	m_outDegree.assign(m_numNodes, 0.0);
 	m_sumLinkOutWeight.assign(m_numNodes, 0.0);
 	m_numDanglingNodes = m_numNodes;
-	for (LinkMap::iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
+	for (unsigned int n1 = 0; n1 < m_links.numRows(); ++n1)
 	{
-		unsigned int n1 = linkIt->first;
-		std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index i = m_links.rowBegin(n1); i < m_links.rowEnd(n1); ++i)
 		{
-			unsigned int n2 = subIt->first;
-			double linkWeight = subIt->second;
+			unsigned int n2 = m_links.target(i);
+			double linkWeight = m_links.weight(i);
 			if (m_outDegree[n1] == 0)
 				--m_numDanglingNodes;
 			++m_outDegree[n1];
@@ -828,58 +1132,19 @@ void Network::initNodeDegrees()
 
 void Network::initNodeNames()
 {
-	unsigned int indexOffset = m_config.zeroBasedNodeNumbers? 0 : 1;
 	if (m_nodeNames.size() < numNodes())
 	{
-		// Define nodes
-		unsigned int oldSize = m_nodeNames.size();
+		// Name the remaining nodes by their number or id, generated when needed
+		m_nodeNames.setDefaultName("", m_config.zeroBasedNodeNumbers? 0 : 1);
+		if (!m_nodeIds.empty())
+			m_nodeNames.setDefaultIds(m_nodeIds);
 		m_nodeNames.resize(numNodes());
-
-		if (m_config.parseWithoutIOStreams)
-		{
-			const int NAME_BUFFER_SIZE = 32;
-			char line[NAME_BUFFER_SIZE];
-			for (unsigned int i = oldSize; i < numNodes(); ++i)
-			{
-				int length = snprintf(line, NAME_BUFFER_SIZE, "%d", i + indexOffset);
-				m_nodeNames[i] = std::string(line, length);
-			}
-		}
-		else
-		{
-			for (unsigned int i = oldSize; i < numNodes(); ++i)
-				m_nodeNames[i] = io::stringify(i + indexOffset);
-		}
 	}
 }
 
-void Network::generateOppositeLinkMap(LinkMap& oppositeLinks)
+void Network::generateOppositeLinks(SparseLinks& oppositeLinks) const
 {
-
-	for (LinkMap::const_iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
-	{
-		unsigned int sourceIndex = linkIt->first;
-		const std::map<unsigned int, double>& outLinks = linkIt->second;
-		for (std::map<unsigned int, double>::const_iterator outLinkIt(outLinks.begin()); outLinkIt != outLinks.end(); ++outLinkIt)
-		{
-			unsigned int targetIndex = outLinkIt->first;
-			double weight = outLinkIt->second;
-			// Insert opposite link, aggregate link weights if they are definied more than once
-			LinkMap::iterator firstIt = oppositeLinks.lower_bound(targetIndex);
-			if (firstIt != oppositeLinks.end() && firstIt->first == targetIndex) // First linkEnd already exists, check second linkEnd
-			{
-				std::pair<std::map<unsigned int, double>::iterator, bool> ret2 = firstIt->second.insert(std::make_pair(sourceIndex, weight));
-				if (!ret2.second)
-				{
-					ret2.first->second += weight;
-				}
-			}
-			else
-			{
-				oppositeLinks.insert(firstIt, std::make_pair(targetIndex, std::map<unsigned int, double>()))->second.insert(std::make_pair(sourceIndex, weight));
-			}
-		}
-	}
+	m_links.transpose(oppositeLinks);
 }
 
 void Network::printParsingResult(bool onlySummary)
@@ -956,19 +1221,102 @@ void Network::printNetworkAsPajek(std::string filename) const
 	}
 
 	out << (m_config.isUndirected() ? "*Edges " : "*Arcs ") << m_links.size() << "\n";
-	for (LinkMap::const_iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
+	for (unsigned int linkEnd1 = 0; linkEnd1 < m_links.numRows(); ++linkEnd1)
 	{
-		unsigned int linkEnd1 = linkIt->first;
-		const std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index i = m_links.rowBegin(linkEnd1); i < m_links.rowEnd(linkEnd1); ++i)
 		{
-			unsigned int linkEnd2 = subIt->first;
-			double linkWeight = subIt->second;
+			unsigned int linkEnd2 = m_links.target(i);
+			double linkWeight = m_links.weight(i);
 			out << (linkEnd1 + 1) << " " << (linkEnd2 + 1) << " " << linkWeight << "\n";
 		}
 	}
 }
 
+void Network::writeBinaryNetwork(std::string filename, bool floatWeights) const
+{
+	BinaryNetworkWriter out(filename);
+	BinaryNetworkHeader& header = out.header();
+
+	unsigned int numRows = m_links.numRows();
+	link_index numLinks = m_links.size();
+	header.flags = m_config.parseAsUndirected() ? BinaryNetwork::UNDIRECTED : 0;
+	header.numNodes = m_numNodes;
+	header.numRows = numRows;
+	header.numLinks = numLinks;
+	header.numNodesFound = m_numNodesFound;
+	header.numLinksFound = m_numLinksFound;
+	header.numAggregatedLinks = m_numAggregatedLinks;
+	header.numSelfLinks = m_numSelfLinks;
+	header.numSelfLinksFound = m_numSelfLinksFound;
+	header.numAdditionalLinks = m_numAdditionalLinks;
+	header.minNodeIndex = m_minNodeIndex;
+	header.maxNodeIndex = m_maxNodeIndex;
+	header.numBipartiteNodes = m_numBipartiteNodes;
+	header.totalLinkWeight = m_totalLinkWeight;
+	header.totalSelfLinkWeight = m_totalSelfLinkWeight;
+	header.sumAdditionalLinkWeight = m_sumAdditionalLinkWeight;
+	header.sumNodeWeights = m_sumNodeWeights;
+
+	writeBinaryNodeNames(out);
+
+	if (m_nodeWeights.size() == m_numNodes)
+		out.writeSection(BinaryNetwork::NODE_WEIGHTS, m_nodeWeights.data(), m_nodeWeights.size() * sizeof(double));
+
+	std::vector<link_index> emptyOffsets(1, 0);
+	const link_index* offsets = numRows == 0 ? &emptyOffsets[0] : m_links.offsets();
+	out.writeLinkOffsets(offsets, numRows + 1);
+	out.writeSection(BinaryNetwork::LINK_TARGETS, m_links.targets(), numLinks * sizeof(unsigned int));
+
+	// Omit the weights if all are one
+	bool isUnweighted = true;
+	for (link_index i = 0; i < numLinks && isUnweighted; ++i)
+		isUnweighted = m_links.weight(i) == 1.0;
+
+	if (!isUnweighted && floatWeights)
+	{
+		header.flags |= BinaryNetwork::FLOAT_WEIGHTS;
+		std::vector<float> weights(m_links.weights(), m_links.weights() + numLinks);
+		out.writeSection(BinaryNetwork::LINK_WEIGHTS, &weights[0], numLinks * sizeof(float));
+	}
+	else if (!isUnweighted)
+		out.writeSection(BinaryNetwork::LINK_WEIGHTS, m_links.weights(), numLinks * sizeof(double));
+
+	out.close();
+}
+
+void Network::readBinaryNodeNames(const BinaryNetworkReader& input, unsigned int numNodes)
+{
+	if (!input.header().hasSection(BinaryNetwork::NODE_NAME_OFFSETS))
+		return;
+	const uint64_t* nameOffsets = input.section<uint64_t>(BinaryNetwork::NODE_NAME_OFFSETS, numNodes + 1);
+	const char* names = input.section<char>(BinaryNetwork::NODE_NAME_DATA, nameOffsets[numNodes]);
+	if (nameOffsets[0] != 0)
+		throw FileFormatError("Corrupt node names in binary network file.");
+	m_nodeNames.assign(numNodes, nameOffsets, names);
+}
+
+void Network::writeBinaryNodeNames(BinaryNetworkWriter& out) const
+{
+	if (m_numNodes == 0 || (m_nodeNames.size() != m_numNodes && m_nodeIds.empty()))
+		return;
+	NodeNames materialized;
+	const NodeNames* names = &m_nodeNames;
+	if (m_nodeNames.numNamed() < m_numNodes)
+	{
+		// Store remapped nodes with their id as name
+		materialized = m_nodeNames;
+		if (!m_nodeIds.empty())
+		{
+			materialized.setDefaultIds(m_nodeIds);
+			materialized.resize(m_numNodes);
+		}
+		materialized.materialize();
+		names = &materialized;
+	}
+	out.writeSection(BinaryNetwork::NODE_NAME_OFFSETS, names->offsets(), (m_numNodes + 1) * sizeof(uint64_t));
+	out.writeSection(BinaryNetwork::NODE_NAME_DATA, names->data(), names->offsets()[m_numNodes]);
+}
+
 void Network::printStateNetwork(std::string filename) const
 {
 	SafeOutFile out(filename.c_str());
@@ -984,14 +1332,12 @@ void Network::printStateNetwork(std::string filename) const
 	}
 
 	out << (m_config.isUndirected() ? "*Edges " : "*Arcs ") << m_links.size() << "\n";
-	for (LinkMap::const_iterator linkIt(m_links.begin()); linkIt != m_links.end(); ++linkIt)
+	for (unsigned int linkEnd1 = 0; linkEnd1 < m_links.numRows(); ++linkEnd1)
 	{
-		unsigned int linkEnd1 = linkIt->first;
-		const std::map<unsigned int, double>& subLinks = linkIt->second;
-		for (std::map<unsigned int, double>::const_iterator subIt(subLinks.begin()); subIt != subLinks.end(); ++subIt)
+		for (link_index i = m_links.rowBegin(linkEnd1); i < m_links.rowEnd(linkEnd1); ++i)
 		{
-			unsigned int linkEnd2 = subIt->first;
-			double linkWeight = subIt->second;
+			unsigned int linkEnd2 = m_links.target(i);
+			double linkWeight = m_links.weight(i);
 			out << (linkEnd1 + 1) << " " << (linkEnd2 + 1) << " " << linkWeight << "\n";
 		}
 	}
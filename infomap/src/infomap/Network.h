@@ -27,11 +27,14 @@
 
 #ifndef NETWORK_H_
 #define NETWORK_H_
+#include <cstddef>
 #include <string>
 #include <map>
 #include <vector>
 #include <utility>
 #include "../io/Config.h"
+#include "SparseLinks.h"
+#include "../io/NodeNames.h"
 #include <limits>
 #include <sstream>
 
@@ -43,12 +46,13 @@ namespace infomap
 struct Bigram;
 struct Weight;
 struct BipartiteLink;
+class LineReader;
+class BinaryNetworkReader;
+class BinaryNetworkWriter;
 
 class Network
 {
 public:
-	typedef std::map<unsigned int, std::map<unsigned int, double> >	LinkMap;
-
 	Network()
 	:	m_config(Config()),
 	 	m_numNodesFound(0),
@@ -148,12 +152,73 @@ public:
 
 	unsigned int addNodes(const std::vector<std::string>& names);
 
+	/**
+	 * Set the node weights, used as teleportation weights when teleporting to nodes.
+	 */
+	void setNodeWeights(const double* weights, unsigned int numNodes);
+
+	/**
+	 * Set the node flow to start the power iteration for the flow from, such
+	 * as the flow from a previous run on a similar network. Negative for nodes
+	 * without start flow.
+	 */
+	void setStartNodeFlow(const double* flow, unsigned int numNodes);
+
+	/**
+	 * Read the start node flow from a file as written with --node-ranks, with
+	 * the flow of one node per line in node order, or a node id and its flow.
+	 * Ids are mapped to nodes added by id, otherwise read as node numbers.
+	 * Nodes not in the network are skipped.
+	 * @note Call after the network is finalized
+	 * @throws FileFormatError if a line can't be parsed
+	 */
+	void readStartNodeFlow(std::string filename);
+
+	const std::vector<double>& startNodeFlow() const { return m_startNodeFlow; }
+
 	/**
 	 * Add a weighted link between two nodes.
 	 * @return true if a new link was inserted, false if skipped due to cutoff limit or aggregated to existing link
 	 */
 	bool addLink(unsigned int n1, unsigned int n2, double weight = 1.0);
 
+	/**
+	 * Add weighted links from parallel arrays, filtered and counted as if added
+	 * one by one with addLink, but in parallel chunks if compiled with OpenMP.
+	 * @param weights The link weights, or null for unit weights
+	 * @return The number of links inserted, before aggregation of duplicates
+	 */
+	link_index addLinks(const unsigned int* sources, const unsigned int* targets, const double* weights, std::size_t numLinks);
+
+	/**
+	 * Set the links from a matrix in compressed sparse row format. If no links
+	 * are added yet and the rows are sorted on target without duplicates or
+	 * links to be filtered, the vectors are taken over without copying or
+	 * sorting, otherwise the links are added with addLinks.
+	 * @param offsets The numRows + 1 row offsets into targets and weights
+	 * @param weights The link weights, or empty for unit weights
+	 * @note The vectors are left empty.
+	 * @throws InputDomainError if the offsets don't match the targets
+	 */
+	void setLinks(unsigned int numRows, std::vector<link_index>& offsets, std::vector<unsigned int>& targets, std::vector<double>& weights);
+
+	/**
+	 * Add weighted links between nodes given by arbitrary 64-bit ids, such as
+	 * hashed ids. New ids are remapped to consecutive node indices in sorted
+	 * order after the nodes from previous calls, and are kept to name the nodes
+	 * in the output.
+	 * @param weights The link weights, or null for unit weights
+	 * @return The number of links inserted, before aggregation of duplicates
+	 * @note Don't mix with links added by node index.
+	 * @throws InputDomainError if there are more ids than possible nodes
+	 */
+	link_index addLinksByIds(const uint64_t* sourceIds, const uint64_t* targetIds, const double* weights, std::size_t numLinks);
+
+	/**
+	 * The external id of each node if added by id, otherwise empty.
+	 */
+	const std::vector<uint64_t>& nodeIds() const { return m_nodeIds; }
+
 	bool addBipartiteLink(unsigned int featureNode, unsigned int node, bool swapOrder, double weight = 1.0);
 
 	/**
@@ -173,25 +238,39 @@ public:
 
 	virtual void printStateNetwork(std::string filename) const;
 
+	/**
+	 * Write the finalized network in the binary CSR format, to be loaded
+	 * directly without parsing.
+	 * @param floatWeights Store the link weights with single precision
+	 */
+	virtual void writeBinaryNetwork(std::string filename, bool floatWeights = false) const;
+
 	unsigned int numNodes() const { return m_numNodes; }
-	const std::vector<std::string>& nodeNames() const { return m_nodeNames; }
+	const NodeNames& nodeNames() const { return m_nodeNames; }
 	const std::vector<double>& nodeWeights() const { return m_nodeWeights; }
 	double sumNodeWeights() const { return m_sumNodeWeights; }
 	const std::vector<double>& outDegree() const { return m_outDegree; }
 	const std::vector<double>& sumLinkOutWeight() const { return m_sumLinkOutWeight; }
 
-	const LinkMap& linkMap() const { return m_links; }
-	unsigned int numLinks() const { return m_numLinks; }
+	/**
+	 * The links in compressed sparse row format, indexed on source node.
+	 * @note Only valid after the network has been finalized.
+	 */
+	const SparseLinks& links() const { return m_links; }
+	link_index numLinks() const { return m_numLinks; }
 	double totalLinkWeight() const { return m_totalLinkWeight; }
 	double totalSelfLinkWeight() const { return m_totalSelfLinkWeight; }
 
 	bool isBipartite() const { return m_numBipartiteNodes > 0; }
 	unsigned int numBipartiteNodes() const { return m_numBipartiteNodes; }
 
+	/**
+	 * Give unnamed nodes their number as default name, generated when asked for.
+	 */
 	void initNodeNames();
-	void swapNodeNames(std::vector<std::string>& target) { target.swap(m_nodeNames); }
+	void swapNodeNames(NodeNames& target) { target.swap(m_nodeNames); }
 
-	void generateOppositeLinkMap(LinkMap& oppositeLinks);
+	void generateOppositeLinks(SparseLinks& oppositeLinks) const;
 
 	virtual void disposeLinks() { m_links.clear(); }
 
@@ -204,26 +283,39 @@ protected:
 	void parsePajekNetwork(std::string filename);
 	void parseLinkList(std::string filename);
 	void parseSparseLinkList(std::string filename);
-	void parsePajekNetworkWithoutIOStreams(std::string filename);
-	void parseLinkListWithoutIOStreams(std::string filename);
 	void parseGeneralNetwork(std::string filename);
 	void parseBipartiteNetwork(std::string filename);
 
+	/**
+	 * Load a finalized network from the binary CSR format. The links are
+	 * used directly from the memory mapped file if stored with double weights.
+	 */
+	void parseBinaryNetwork(std::string filename);
+
 	void zoom();
 
 	// Helper methods
 
-	std::string parseLinks(std::ifstream& file);
+	/**
+	 * Parse links in parallel until end, or until a new header if stopAtHeader is true.
+	 * @return The header line that ended the links, or an empty string at the end.
+	 */
+	std::string parseLinks(LineReader& input, bool stopAtHeader = true);
+
+	/**
+	 * Parse links with 64-bit node ids until end and add them with addLinksByIds.
+	 */
+	void parseLinksByIds(LineReader& input);
 
-	std::string parseBipartiteLinks(std::ifstream& file);
+	std::string parseBipartiteLinks(LineReader& input);
 
 	/**
-	 * Parse a string of link data.
+	 * Parse a line of link data.
 	 * If no weight data can be extracted, the default value 1.0 will be used.
+	 * @note Thread safe, used to parse lines in parallel.
 	 * @throws an error if not both node numbers can be extracted.
 	 */
-	void parseLink(const std::string& line, unsigned int& n1, unsigned int& n2, double& weight);
-	void parseLink(char line[], unsigned int& n1, unsigned int& n2, double& weight);
+	void parseLink(const char* begin, const char* end, unsigned int& n1, unsigned int& n2, double& weight) const;
 
 	/**
 	 * Parse a bipartite link of format "f1 n1 1.0" for a link between
@@ -231,16 +323,28 @@ protected:
 	 * The order of the feature nodes and ordinary nodes can be swapped.
 	 * Store the numberical id (minus possible indexOffset for non-zerobased indexing)
 	 * on the referenced uints.
+	 * @note Thread safe, used to parse lines in parallel.
 	 * @return true if the input order was swapped
 	 */
-	bool parseBipartiteLink(const std::string& line, unsigned int& featureNode, unsigned int& node, double& weight);
+	bool parseBipartiteLink(const char* begin, const char* end, unsigned int& featureNode, unsigned int& node, double& weight) const;
 
 	/**
-	 * Insert ordinary link, indexed on first node and aggregated if exist
+	 * Append ordinary link to the edge buffer, aggregated to existing links on compaction
 	 * @note Called by addLink
-	 * @return true if a new link was inserted, false if aggregated
 	 */
-	bool insertLink(unsigned int n1, unsigned int n2, double weight);
+	void insertLink(unsigned int n1, unsigned int n2, double weight);
+
+	/**
+	 * @return The node index of an id added by addLinksByIds
+	 */
+	unsigned int nodeIndex(uint64_t id) const;
+
+	/**
+	 * Sort and merge all inserted links into the compressed rows and update
+	 * the link counters with the number of aggregated links.
+	 * @note Idempotent, does nothing if no links was inserted since the last call
+	 */
+	void compactLinks();
 
 	virtual void initNodeDegrees();
 
@@ -248,44 +352,64 @@ protected:
 	* Read lines from file until it starts with '*'
 	* and return that line.
 	*/
-	std::string skipUntilHeader(std::ifstream& file);
+	std::string skipUntilHeader(LineReader& input);
 
 	/**
 	 * Parse vertices
 	 * @return The line after the vertices
 	 */
-	std::string parseVertices(std::ifstream& file, bool required = true);
+	std::string parseVertices(LineReader& input, bool required = true);
 
 	/**
 	 * Parse vertices under the heading
 	 * @return The line after the vertices
 	 */
-	std::string parseVertices(std::ifstream& file, std::string heading, bool required = true);
+	std::string parseVertices(LineReader& input, std::string heading, bool required = true);
+
+	/**
+	 * Parse a vertex line of format 'id "name" [weight]', or 'id name [weight]'
+	 * if not quoted. The weight is unchanged if not found.
+	 * @return false if no node id could be parsed
+	 */
+	bool parseVertex(LineReader& input, unsigned int& id, std::string& name, double& weight);
+
+	/**
+	 * Read the node names from a binary network file if stored.
+	 */
+	void readBinaryNodeNames(const BinaryNetworkReader& input, unsigned int numNodes);
+
+	/**
+	 * Write the node names to a binary network file if all nodes have names.
+	 */
+	void writeBinaryNodeNames(BinaryNetworkWriter& out) const;
 
 
 	Config m_config;
 
 	unsigned int m_numNodesFound;
 	unsigned int m_numNodes;
-	std::vector<std::string> m_nodeNames;
+	NodeNames m_nodeNames;
+	std::vector<uint64_t> m_nodeIds; // External id on node index
+	std::vector<unsigned int> m_nodeIdOrder; // Node indices sorted on id
+	std::vector<double> m_startNodeFlow;
 	std::vector<double> m_nodeWeights;
 	double m_sumNodeWeights;
 	std::vector<double> m_outDegree;
 	std::vector<double> m_sumLinkOutWeight;
 	unsigned int m_numDanglingNodes;
 
-	LinkMap m_links;
-	unsigned int m_numLinksFound;
-	unsigned int m_numLinks;
+	SparseLinks m_links;
+	link_index m_numLinksFound;
+	link_index m_numLinks;
 	double m_totalLinkWeight; // On whole network
-	unsigned int m_numAggregatedLinks;
-	unsigned int m_numSelfLinks;
-	unsigned int m_numSelfLinksFound;
+	link_index m_numAggregatedLinks;
+	link_index m_numSelfLinks;
+	link_index m_numSelfLinksFound;
 	double m_totalSelfLinkWeight; // On whole network
 
 	// Zooming
 	bool m_addSelfLinks;
-	unsigned int m_numAdditionalLinks;
+	link_index m_numAdditionalLinks;
 	unsigned int m_sumAdditionalLinkWeight;
 
 	// Checkers
@@ -293,11 +417,11 @@ protected:
 	unsigned int m_minNodeIndex; // On links
 
 	// Helpers
-	std::istringstream m_extractor;
 	unsigned int m_indexOffset;
 
 	// Bipartite
-	std::map<BipartiteLink, Weight> m_bipartiteLinks;
+	SparseLinks m_bipartiteLinks; // featureNode -> node, aggregated on finalize
+	SparseLinks m_swappedBipartiteLinks; // node -> featureNode, stored as (featureNode, node)
 	unsigned int m_numBipartiteNodes;
 
 	// Other
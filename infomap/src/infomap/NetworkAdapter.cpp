@@ -146,7 +146,7 @@ void NetworkAdapter::readClu(std::string filename)
 	for (unsigned int i = 0; i < m_numNodes; ++i) {
 		unsigned int clusterIndex = modules[i];
 		if (moduleNodes[clusterIndex] == 0)
-			moduleNodes[clusterIndex] = m_treeData.nodeFactory().createNode("", 0.0, 0.0);
+			moduleNodes[clusterIndex] = m_treeData.nodeFactory().createNode(0.0, 0.0);
 		// Add all leaf nodes to the modules defined by the parsed cluster indices
 		moduleNodes[clusterIndex]->addChild(&m_treeData.getLeafNode(i));
 	}
@@ -242,7 +242,7 @@ void NetworkAdapter::readBipartiteClu(std::string filename)
 	for (unsigned int i = 0; i < m_numNodes; ++i) {
 		unsigned int clusterIndex = modules[i];
 		if (moduleNodes[clusterIndex] == 0)
-			moduleNodes[clusterIndex] = m_treeData.nodeFactory().createNode("", 0.0, 0.0);
+			moduleNodes[clusterIndex] = m_treeData.nodeFactory().createNode(0.0, 0.0);
 		// Add all leaf nodes to the modules defined by the parsed cluster indices
 		moduleNodes[clusterIndex]->addChild(&m_treeData.getLeafNode(i));
 	}
@@ -262,7 +262,7 @@ void NetworkAdapter::readHumanReadableTree(std::string filename)
 	SafeInFile input(filename.c_str());
 	Log() << "Parsing tree '" << filename << "'... " << std::flush;
 
-	std::auto_ptr<NodeBase> root(m_treeData.nodeFactory().createNode("tmpRoot", 1.0, 0.0));
+	std::auto_ptr<NodeBase> root(m_treeData.nodeFactory().createNode(1.0, 0.0));
 	std::vector<double> flowValues(m_numNodes);
 	bool gotOriginalIndex = true;
 	unsigned int indexOffset = m_config.zeroBasedNodeNumbers ? 0 : 1;
@@ -325,13 +325,12 @@ void NetworkAdapter::readHumanReadableTree(std::string filename)
 			// Create new node if path doesn't exist
 			if (node->childDegree() <= childIndex)
 			{
-				NodeBase* child = m_treeData.nodeFactory().createNode("", 0.0, 0.0);
+				NodeBase* child = m_treeData.nodeFactory().createNode(0.0, 0.0);
 				node->addChild(child);
 			}
 			node = node->lastChild;
 			++depth;
 		}
-		node->name = name;
 		node->originalIndex = originalIndex;;
 		flowValues[originalIndex] = flow;
 		++nodeCount;
@@ -382,7 +381,7 @@ void NetworkAdapter::readHumanReadableTree(std::string filename)
 	if (nodeCount < m_numNodes) {
 		for (unsigned int i = 0; i < m_numNodes; ++i) {
 			if (assignedNodes[i] == 0) {
-				NodeBase* module = m_treeData.nodeFactory().createNode("", 0.0, 0.0);
+				NodeBase* module = m_treeData.nodeFactory().createNode(0.0, 0.0);
 				m_treeData.root()->addChild(module);
 				module->addChild(&m_treeData.getLeafNode(i));
 			}
@@ -35,35 +35,39 @@ namespace infomap
 {
 #endif
 
-long NodeBase::s_nodeCount = 0;
-unsigned long NodeBase::s_UID = 0;
+std::atomic<long> NodeBase::s_nodeCount(0);
+std::atomic<unsigned long> NodeBase::s_UID(0);
+
+namespace
+{
+	// The pool and the allocated size in front of each node, the size to return
+	// the block to the pool if the constructor throws
+	struct NodeHeader
+	{
+		MemoryPool* pool;
+		std::size_t size;
+	};
+
+	// Room for the header, keeping the block alignment
+	const std::size_t NODE_HEADER_SIZE = (sizeof(NodeHeader) + MemoryPool::BLOCK_ALIGNMENT - 1) /
+			MemoryPool::BLOCK_ALIGNMENT * MemoryPool::BLOCK_ALIGNMENT;
+
+	NodeHeader& nodeHeader(void* node)
+	{
+		return *reinterpret_cast<NodeHeader*>(static_cast<char*>(node) - NODE_HEADER_SIZE);
+	}
+
+	MemoryPool*& poolHeader(void* node)
+	{
+		return nodeHeader(node).pool;
+	}
+}
 
 SubStructure::SubStructure() : subInfomap(0), exploredWithoutImprovement(false) {}
 SubStructure::~SubStructure() {}
 
 NodeBase::NodeBase()
 :	id(s_UID++),
- 	name(),
- 	index(0),
- 	originalIndex(0),
-	parent(0),
-	previous(0),
-	next(0),
-	firstChild(0),
-	lastChild(0),
-	codelength(0.0),
-	dirty(false),
-	m_subStructure(),
-	m_childDegree(0),
-	m_childrenChanged(false),
-	m_numLeafMembers(1)
-{
-	++s_nodeCount;
-}
-
-NodeBase::NodeBase(std::string name)
-:	id(s_UID++),
- 	name(name),
  	index(0),
  	originalIndex(0),
 	parent(0),
@@ -83,7 +87,6 @@ NodeBase::NodeBase(std::string name)
 
 NodeBase::NodeBase(const NodeBase& other)
 :	id(s_UID++),
- 	name(other.name),
  	index(0),
  	originalIndex(0),
 	parent(0),
@@ -122,12 +125,69 @@ NodeBase::~NodeBase()
 	for (NodeBase::edge_iterator outEdgeIt(begin_outEdge());
 			outEdgeIt != end_outEdge(); ++outEdgeIt)
 	{
-		delete *outEdgeIt;
+		deleteEdge(*outEdgeIt);
 	}
 
 	--s_nodeCount;
 }
 
+void* NodeBase::operator new(std::size_t size)
+{
+	void* node = static_cast<char*>(::operator new(size + NODE_HEADER_SIZE)) + NODE_HEADER_SIZE;
+	nodeHeader(node).pool = 0;
+	nodeHeader(node).size = size;
+	return node;
+}
+
+void* NodeBase::operator new(std::size_t size, MemoryPool& pool)
+{
+	void* node = static_cast<char*>(pool.allocate(size + NODE_HEADER_SIZE)) + NODE_HEADER_SIZE;
+	nodeHeader(node).pool = &pool;
+	nodeHeader(node).size = size;
+	return node;
+}
+
+void NodeBase::operator delete(void* node, MemoryPool& pool)
+{
+	if (node == 0)
+		return;
+	pool.deallocate(static_cast<char*>(node) - NODE_HEADER_SIZE, nodeHeader(node).size + NODE_HEADER_SIZE);
+}
+
+void NodeBase::operator delete(void* node, std::size_t size)
+{
+	if (node == 0)
+		return;
+	MemoryPool* pool = poolHeader(node);
+	void* block = static_cast<char*>(node) - NODE_HEADER_SIZE;
+	if (pool != 0)
+		pool->deallocate(block, size + NODE_HEADER_SIZE);
+	else
+		::operator delete(block);
+}
+
+MemoryPool* NodeBase::memoryPool() const
+{
+	// All node types derive from NodeBase alone, so it starts at the allocated address
+	return poolHeader(const_cast<NodeBase*>(this));
+}
+
+void* NodeBase::allocateEdge()
+{
+	MemoryPool* pool = memoryPool();
+	return pool != 0 ? pool->allocate(sizeof(EdgeType)) : ::operator new(sizeof(EdgeType));
+}
+
+void NodeBase::deleteEdge(EdgeType* edge)
+{
+	MemoryPool* pool = memoryPool();
+	edge->~EdgeType();
+	if (pool != 0)
+		pool->deallocate(edge, sizeof(EdgeType));
+	else
+		::operator delete(edge);
+}
+
 void NodeBase::deleteChildren()
 {
 	if (firstChild == 0)
@@ -35,7 +35,11 @@
 #include "treeIterators.h"
 #include "../utils/gap_iterator.h"
 #include "../utils/Logger.h"
+#include "../io/NodeNames.h"
+#include "../utils/MemoryPool.h"
 #include <memory>
+#include <new>
+#include <atomic>
 
 #ifdef NS_INFOMAP
 namespace infomap
@@ -121,10 +125,10 @@ struct StateNode
 		return out.str();
 	}
 
-	std::string print(const std::vector<std::string>& names, unsigned int indexOffset = 0) const
+	std::string print(const NodeNames& names, unsigned int indexOffset = 0) const
 	{
 		std::ostringstream out;
-		out << stateIndex + indexOffset << " " << names.at(physIndex);
+		out << stateIndex + indexOffset << " " << names[physIndex];
 		return out.str();
 	}
 };
@@ -153,11 +157,24 @@ public:
 
 
 	NodeBase();
-	NodeBase(std::string name);
 	NodeBase(const NodeBase& other);
 
 	virtual ~NodeBase();
 
+	/**
+	 * Allocate the node on the heap or in a memory pool. Each node is preceded
+	 * by the pool it was allocated from, so that it is returned to the right
+	 * pool on delete, and its out-edges are allocated from the same pool.
+	 */
+	static void* operator new(std::size_t size);
+	static void* operator new(std::size_t size, MemoryPool& pool);
+	static void operator delete(void* node, std::size_t size);
+
+	/**
+	 * Return the block to the pool if the constructor throws in a pool allocation.
+	 */
+	static void operator delete(void* node, MemoryPool& pool);
+
 	static unsigned int nodeCount() { return s_nodeCount; }
 
 	// ---------------------------- Tree iterators ----------------------------
@@ -270,9 +287,7 @@ public:
 	{
 //		return out << "n" << node.id;// << " (" << node.data << ")";
 //		return out << node.name << " (" << node.data << ")";
-		if (node.name.empty())
-			return out << "n" << node.id;
-		return out << "n" << node.id << ":" << node.name;
+		return out << "n" << node.id;
 	}
 
 //	friend std::ostream& operator<<(std::ostream& out, const NodeBase* node)
@@ -326,7 +341,7 @@ public:
 
 	EdgeType* addOutEdge(NodeBase& target, double weight, double flow = 0.0)
 	{
-		EdgeType* edge = new EdgeType(*this, target, weight, flow);
+		EdgeType* edge = new (allocateEdge()) EdgeType(*this, target, weight, flow);
 		m_outEdges.push_back(edge);
 		target.m_inEdges.push_back(edge);
 		return edge;
@@ -350,9 +365,16 @@ public:
 private:
 	void calcChildDegree();
 
+	/**
+	 * The pool this node was allocated from, or null if allocated on the heap.
+	 */
+	MemoryPool* memoryPool() const;
+
+	void* allocateEdge();
+	void deleteEdge(EdgeType* edge);
+
 public:
 	unsigned long id;
-	std::string name;
 	unsigned int index; // Temporary index used in finding best module
 	unsigned int originalIndex; // Index in the original network (for leaf nodes)
 
@@ -370,8 +392,8 @@ protected:
 	bool m_childrenChanged;
 	unsigned int m_numLeafMembers;
 
-	static long s_nodeCount;
-	static unsigned long s_UID;
+	static std::atomic<long> s_nodeCount;
+	static std::atomic<unsigned long> s_UID;
 
 	std::vector<EdgeType*> m_outEdges;
 	std::vector<EdgeType*> m_inEdges;
@@ -612,9 +634,7 @@ public:
 
 	Node() : NodeBase()
 	{}
-	Node(std::string name) : NodeBase(name)
-	{}
-	Node(std::string name, double flow, double teleWeight) : NodeBase(name), data(flow, teleWeight)
+	Node(double flow, double teleWeight) : NodeBase(), data(flow, teleWeight)
 	{}
 	Node(T data) : NodeBase(), data(data)
 	{}
@@ -626,7 +646,7 @@ public:
 	friend std::ostream& operator<<(std::ostream& out, const node_type& node)
 	{
 //		return out << "n" << node.id << " (" << node.data << ")";
-		return out << node.name << " " << node.data.flow;
+		return out << "n" << node.id << " " << node.data.flow;
 	}
 
 	//debug
@@ -658,9 +678,7 @@ public:
 
 	MemNode() : node_base_type()
 	{}
-	MemNode(std::string name) : node_base_type(name)
-	{}
-	MemNode(std::string name, double flow, double teleWeight) : node_base_type(name, flow, teleWeight)
+	MemNode(double flow, double teleWeight) : node_base_type(flow, teleWeight)
 	{}
 	MemNode(T data) : node_base_type(data)
 	{}
@@ -672,7 +690,7 @@ public:
 
 	friend std::ostream& operator<<(std::ostream& out, const node_type& node)
 	{
-		return out << "(name: " << node.name << ", flow: " << node.data.flow << ", phys: " << node.stateNode << ")";
+		return out << "(id: " << node.id << ", flow: " << node.data.flow << ", phys: " << node.stateNode << ")";
 	}
 
 	virtual StateNode getStateNode()
@@ -36,13 +36,26 @@ namespace infomap
 {
 #endif
 
+/**
+ * Creates the nodes of a tree in a memory pool owned by the factory.
+ * The pool is released with the factory, after the last node is deleted.
+ */
 class NodeFactoryBase
 {
 public:
-	virtual ~NodeFactoryBase() {}
+	NodeFactoryBase() : m_pool(new MemoryPool()) {}
+	virtual ~NodeFactoryBase() { m_pool->release(); }
 
-	virtual NodeBase* createNode(std::string, double flow, double teleWeight = 1.0) const = 0;
+	virtual NodeBase* createNode(double flow, double teleWeight = 1.0) const = 0;
 	virtual NodeBase* createNode(const NodeBase&) const = 0;
+
+	MemoryPool& memoryPool() const { return *m_pool; }
+
+private:
+	NodeFactoryBase(const NodeFactoryBase&);
+	NodeFactoryBase& operator=(const NodeFactoryBase&);
+
+	MemoryPool* m_pool;
 };
 
 
@@ -52,13 +65,13 @@ class NodeFactory : public NodeFactoryBase
 	typedef Node<FlowType> 			node_type;
 	typedef const Node<FlowType>	const_node_type;
 public:
-	NodeBase* createNode(std::string name, double flow, double teleWeight) const
+	NodeBase* createNode(double flow, double teleWeight) const
 	{
-		return new node_type(name, flow, teleWeight);
+		return new (memoryPool()) node_type(flow, teleWeight);
 	}
 	NodeBase* createNode(const NodeBase& node) const
 	{
-		return new node_type(static_cast<const_node_type&>(node));
+		return new (memoryPool()) node_type(static_cast<const_node_type&>(node));
 	}
 };
 
@@ -68,13 +81,13 @@ class MemNodeFactory : public NodeFactoryBase
 	typedef MemNode<FlowType> 			node_type;
 	typedef const MemNode<FlowType>		const_node_type;
 public:
-	NodeBase* createNode(std::string name, double flow, double teleWeight) const
+	NodeBase* createNode(double flow, double teleWeight) const
 	{
-		return new node_type(name, flow, teleWeight);
+		return new (memoryPool()) node_type(flow, teleWeight);
 	}
 	NodeBase* createNode(const NodeBase& node) const
 	{
-		return new node_type(static_cast<const_node_type&>(node));
+		return new (memoryPool()) node_type(static_cast<const_node_type&>(node));
 	}
 };
 
@@ -0,0 +1,496 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "SparseLinks.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+namespace
+{
+	typedef SparseLinks::Entry Entry;
+
+	const unsigned int RADIX_BITS = 8;
+	const unsigned int RADIX_SIZE = 1 << RADIX_BITS;
+	const unsigned int RADIX_MASK = RADIX_SIZE - 1;
+
+	// Below this size the threading overhead is larger than the gain
+	const std::size_t MIN_PARALLEL_SIZE = 1 << 16;
+
+	int maxThreads(std::size_t size)
+	{
+#ifdef _OPENMP
+		if (size >= MIN_PARALLEL_SIZE)
+			return omp_get_max_threads();
+#endif
+		return 1;
+	}
+
+	int threadIndex()
+	{
+#ifdef _OPENMP
+		return omp_get_thread_num();
+#else
+		return 0;
+#endif
+	}
+
+	int numThreadsInRegion()
+	{
+#ifdef _OPENMP
+		return omp_get_num_threads();
+#else
+		return 1;
+#endif
+	}
+
+	unsigned int numSignificantBits(unsigned int value)
+	{
+		unsigned int numBits = 0;
+		while (value != 0)
+		{
+			++numBits;
+			value >>= 1;
+		}
+		return numBits;
+	}
+
+	inline unsigned int digit(const Entry& entry, bool onSource, unsigned int shift)
+	{
+		return ((onSource ? entry.source : entry.target) >> shift) & RADIX_MASK;
+	}
+
+	inline bool isSameLink(const Entry& a, const Entry& b)
+	{
+		return a.source == b.source && a.target == b.target;
+	}
+
+	/**
+	 * One stable counting sort pass on the digit at shift. Each thread counts and
+	 * scatters its own contiguous chunk, so the relative order within each bucket
+	 * is kept.
+	 * @return false if all entries share the digit and nothing was moved
+	 */
+	bool radixPass(const Entry* in, Entry* out, std::size_t size, bool onSource, unsigned int shift)
+	{
+		int numThreads = maxThreads(size);
+		std::vector<std::size_t> counts(numThreads * RADIX_SIZE, 0);
+		bool isSorted = false;
+
+#pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+		{
+			int numActive = numThreadsInRegion();
+			int t = threadIndex();
+			std::size_t begin = size * t / numActive;
+			std::size_t end = size * (t + 1) / numActive;
+			std::size_t* count = &counts[t * RADIX_SIZE];
+
+			for (std::size_t i = begin; i < end; ++i)
+				++count[digit(in[i], onSource, shift)];
+
+#pragma omp barrier
+#pragma omp single
+			{
+				std::size_t offset = 0;
+				for (unsigned int d = 0; d < RADIX_SIZE; ++d)
+				{
+					std::size_t bucketSize = 0;
+					for (int i = 0; i < numActive; ++i)
+					{
+						std::size_t c = counts[i * RADIX_SIZE + d];
+						counts[i * RADIX_SIZE + d] = offset;
+						offset += c;
+						bucketSize += c;
+					}
+					if (bucketSize == size)
+						isSorted = true;
+				}
+			}
+
+			if (!isSorted)
+			{
+				for (std::size_t i = begin; i < end; ++i)
+					out[count[digit(in[i], onSource, shift)]++] = in[i];
+			}
+		}
+		return !isSorted;
+	}
+}
+
+SparseLinks::SparseLinks(const SparseLinks& other) :
+	m_buffer(other.m_buffer),
+	m_offsets(other.m_offsets),
+	m_targets(other.m_targets),
+	m_weights(other.m_weights),
+	m_externalOwner(other.m_externalOwner),
+	m_offsetData(other.m_offsetData),
+	m_targetData(other.m_targetData),
+	m_weightData(other.m_weightData),
+	m_numRows(other.m_numRows),
+	m_numLinks(other.m_numLinks)
+{
+	if (!isExternal())
+		updateView();
+}
+
+SparseLinks& SparseLinks::operator=(const SparseLinks& other)
+{
+	if (this == &other)
+		return *this;
+	SparseLinks copy(other);
+	swap(copy);
+	return *this;
+}
+
+link_index SparseLinks::compact(unsigned int numRows)
+{
+	if (m_buffer.empty() && numRows <= this->numRows())
+		return 0;
+
+	if (isExternal())
+		detach();
+
+	link_index numAggregated = 0;
+	if (m_buffer.empty())
+		m_offsets.resize(numRows + 1, size());
+	else
+	{
+		sortBuffer();
+		if (m_targets.empty())
+			numAggregated = buildFromSortedBuffer(numRows);
+		else
+			numAggregated = mergeSortedBuffer(numRows);
+	}
+	updateView();
+	return numAggregated;
+}
+
+void SparseLinks::assignExternal(unsigned int numRows, const link_index* offsets, const unsigned int* targets,
+		const double* weights, const std::shared_ptr<const void>& owner)
+{
+	clear();
+	m_externalOwner = owner;
+	m_offsetData = offsets;
+	m_targetData = targets;
+	m_weightData = weights;
+	m_numRows = numRows;
+	m_numLinks = offsets[numRows];
+}
+
+void SparseLinks::assign(unsigned int numRows, const link_index* offsets, const unsigned int* targets,
+		std::vector<double>& weights)
+{
+	clear();
+	m_offsets.assign(offsets, offsets + numRows + 1);
+	m_targets.assign(targets, targets + offsets[numRows]);
+	m_weights.swap(weights);
+	m_weights.resize(m_targets.size());
+	updateView();
+}
+
+void SparseLinks::assign(unsigned int numRows, std::vector<link_index>& offsets, std::vector<unsigned int>& targets,
+		std::vector<double>& weights)
+{
+	clear();
+	m_offsets.swap(offsets);
+	m_offsets.resize(numRows + 1, m_offsets.empty() ? 0 : m_offsets.back());
+	m_targets.swap(targets);
+	m_weights.swap(weights);
+	m_weights.resize(m_targets.size());
+	updateView();
+}
+
+void SparseLinks::detach()
+{
+	m_offsets.assign(m_offsetData, m_offsetData + m_numRows + 1);
+	m_targets.assign(m_targetData, m_targetData + m_numLinks);
+	m_weights.assign(m_weightData, m_weightData + m_numLinks);
+	m_externalOwner.reset();
+	updateView();
+}
+
+void SparseLinks::updateView()
+{
+	m_externalOwner.reset();
+	m_offsetData = m_offsets.data();
+	m_targetData = m_targets.data();
+	m_weightData = m_weights.data();
+	m_numRows = m_offsets.empty() ? 0 : m_offsets.size() - 1;
+	m_numLinks = m_targets.size();
+}
+
+void SparseLinks::sortBuffer()
+{
+	std::size_t size = m_buffer.size();
+	if (size < 2)
+		return;
+
+	unsigned int maxSource = 0;
+	unsigned int maxTarget = 0;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		maxSource = std::max(maxSource, m_buffer[i].source);
+		maxTarget = std::max(maxTarget, m_buffer[i].target);
+	}
+
+	std::vector<Entry> tmp(size);
+	Entry* in = &m_buffer[0];
+	Entry* out = &tmp[0];
+
+	// Least significant digit first, on target and then on source
+	unsigned int targetBits = numSignificantBits(maxTarget);
+	for (unsigned int shift = 0; shift < targetBits; shift += RADIX_BITS)
+	{
+		if (radixPass(in, out, size, false, shift))
+			std::swap(in, out);
+	}
+	unsigned int sourceBits = numSignificantBits(maxSource);
+	for (unsigned int shift = 0; shift < sourceBits; shift += RADIX_BITS)
+	{
+		if (radixPass(in, out, size, true, shift))
+			std::swap(in, out);
+	}
+
+	if (in != &m_buffer[0])
+		m_buffer.swap(tmp);
+}
+
+link_index SparseLinks::buildFromSortedBuffer(unsigned int numRows)
+{
+	std::size_t size = m_buffer.size();
+	const Entry* in = &m_buffer[0];
+	numRows = std::max(std::max(numRows, this->numRows()), in[size - 1].source + 1);
+
+	int numThreads = maxThreads(size);
+	std::vector<std::size_t> chunkOffsets(numThreads + 1, 0);
+	m_offsets.resize(numRows + 1);
+
+#pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+	{
+		int numActive = numThreadsInRegion();
+		int t = threadIndex();
+		std::size_t begin = size * t / numActive;
+		std::size_t end = size * (t + 1) / numActive;
+
+		// Count the unique links that start in this chunk
+		std::size_t numUnique = 0;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			if (i == 0 || !isSameLink(in[i], in[i - 1]))
+				++numUnique;
+		}
+		chunkOffsets[t + 1] = numUnique;
+
+#pragma omp barrier
+#pragma omp single
+		{
+			for (int i = 0; i < numActive; ++i)
+				chunkOffsets[i + 1] += chunkOffsets[i];
+			m_targets.resize(chunkOffsets[numActive]);
+			m_weights.resize(chunkOffsets[numActive]);
+		}
+
+		// Aggregate each run of duplicates from its first link, which may extend into the next chunk
+		std::size_t linkIndex = chunkOffsets[t];
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			if (i != 0 && isSameLink(in[i], in[i - 1]))
+				continue;
+			unsigned int source = in[i].source;
+			double weight = in[i].weight;
+			for (std::size_t j = i + 1; j < size && isSameLink(in[j], in[i]); ++j)
+				weight += in[j].weight;
+			m_targets[linkIndex] = in[i].target;
+			m_weights[linkIndex] = weight;
+
+			// Start the rows up to this source if it's the first link from it
+			if (i == 0 || in[i - 1].source != source)
+			{
+				unsigned int firstRow = i == 0 ? 0 : in[i - 1].source + 1;
+				for (unsigned int row = firstRow; row <= source; ++row)
+					m_offsets[row] = linkIndex;
+			}
+			++linkIndex;
+		}
+	}
+
+	link_index numLinks = m_targets.size();
+	for (unsigned int row = in[size - 1].source + 1; row <= numRows; ++row)
+		m_offsets[row] = numLinks;
+
+	link_index numAggregated = size - numLinks;
+	std::vector<Entry>().swap(m_buffer);
+	return numAggregated;
+}
+
+link_index SparseLinks::mergeSortedBuffer(unsigned int numRows)
+{
+	std::size_t size = m_buffer.size();
+	unsigned int oldNumRows = this->numRows();
+	numRows = std::max(std::max(numRows, oldNumRows), m_buffer[size - 1].source + 1);
+
+	std::vector<link_index> offsets(numRows + 1, 0);
+	std::vector<unsigned int> targets;
+	std::vector<double> weights;
+	targets.reserve(m_targets.size() + size);
+	weights.reserve(m_targets.size() + size);
+
+	link_index numAggregated = 0;
+	std::size_t b = 0;
+	for (unsigned int row = 0; row < numRows; ++row)
+	{
+		offsets[row] = targets.size();
+		link_index i = row < oldNumRows ? m_offsets[row] : 0;
+		link_index end = row < oldNumRows ? m_offsets[row + 1] : 0;
+		while (true)
+		{
+			bool hasOld = i < end;
+			bool hasNew = b < size && m_buffer[b].source == row;
+			if (!hasOld && !hasNew)
+				break;
+			if (hasOld && (!hasNew || m_targets[i] < m_buffer[b].target))
+			{
+				targets.push_back(m_targets[i]);
+				weights.push_back(m_weights[i]);
+				++i;
+				continue;
+			}
+			unsigned int target = m_buffer[b].target;
+			double weight;
+			if (hasOld && m_targets[i] == target)
+			{
+				weight = m_weights[i];
+				++i;
+			}
+			else
+			{
+				weight = m_buffer[b].weight;
+				++b;
+			}
+			for (; b < size && m_buffer[b].source == row && m_buffer[b].target == target; ++b)
+			{
+				weight += m_buffer[b].weight;
+				++numAggregated;
+			}
+			targets.push_back(target);
+			weights.push_back(weight);
+		}
+	}
+	offsets[numRows] = targets.size();
+
+	m_offsets.swap(offsets);
+	m_targets.swap(targets);
+	m_weights.swap(weights);
+	std::vector<Entry>().swap(m_buffer);
+	return numAggregated;
+}
+
+void SparseLinks::transpose(SparseLinks& target, const double* weights) const
+{
+	if (weights == 0)
+		weights = m_weightData;
+	target.clear();
+	link_index numLinks = size();
+	unsigned int numSources = numRows();
+	unsigned int numTargetRows = numSources;
+	for (link_index i = 0; i < numLinks; ++i)
+		numTargetRows = std::max(numTargetRows, m_targetData[i] + 1);
+
+	target.m_offsets.assign(numTargetRows + 1, 0);
+	for (link_index i = 0; i < numLinks; ++i)
+		++target.m_offsets[m_targetData[i] + 1];
+	for (unsigned int row = 0; row < numTargetRows; ++row)
+		target.m_offsets[row + 1] += target.m_offsets[row];
+
+	// Iterate sources in order to keep each transposed row sorted
+	std::vector<link_index> nextIndex(target.m_offsets.begin(), target.m_offsets.end() - 1);
+	target.m_targets.resize(numLinks);
+	target.m_weights.resize(numLinks);
+	for (unsigned int source = 0; source < numSources; ++source)
+	{
+		for (link_index i = m_offsetData[source]; i < m_offsetData[source + 1]; ++i)
+		{
+			link_index linkIndex = nextIndex[m_targetData[i]]++;
+			target.m_targets[linkIndex] = source;
+			target.m_weights[linkIndex] = weights[i];
+		}
+	}
+	target.updateView();
+}
+
+link_index SparseLinks::find(unsigned int source, unsigned int target) const
+{
+	if (source >= numRows())
+		return npos();
+	const unsigned int* begin = m_targetData + m_offsetData[source];
+	const unsigned int* end = m_targetData + m_offsetData[source + 1];
+	const unsigned int* it = std::lower_bound(begin, end, target);
+	if (it == end || *it != target)
+		return npos();
+	return it - m_targetData;
+}
+
+SparseLinks::Row SparseLinks::row(unsigned int source) const
+{
+	if (source >= numRows())
+		return Row();
+	link_index begin = m_offsetData[source];
+	return Row(m_targetData + begin, m_weightData + begin, static_cast<unsigned int>(m_offsetData[source + 1] - begin));
+}
+
+void SparseLinks::swap(SparseLinks& other)
+{
+	m_buffer.swap(other.m_buffer);
+	m_offsets.swap(other.m_offsets);
+	m_targets.swap(other.m_targets);
+	m_weights.swap(other.m_weights);
+	m_externalOwner.swap(other.m_externalOwner);
+	std::swap(m_offsetData, other.m_offsetData);
+	std::swap(m_targetData, other.m_targetData);
+	std::swap(m_weightData, other.m_weightData);
+	std::swap(m_numRows, other.m_numRows);
+	std::swap(m_numLinks, other.m_numLinks);
+}
+
+void SparseLinks::clear()
+{
+	std::vector<Entry>().swap(m_buffer);
+	std::vector<link_index>().swap(m_offsets);
+	std::vector<unsigned int>().swap(m_targets);
+	std::vector<double>().swap(m_weights);
+	updateView();
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
@@ -0,0 +1,235 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef SPARSELINKS_H_
+#define SPARSELINKS_H_
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include "../utils/types.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * Weighted links stored in compressed sparse row (CSR) format.
+ *
+ * Links are first appended unsorted to an edge buffer. A call to compact()
+ * radix sorts the buffer on (source, target), aggregates the weights of
+ * duplicate links in the order they were appended, and merges the result into
+ * the rows. Within each row the links are sorted on target, so iterating
+ * over all rows visits the links in the same order as a sorted map of maps.
+ *
+ * The compacted links can also refer to external memory, such as a memory
+ * mapped binary network file, which is then copied to own storage before
+ * any modification.
+ */
+class SparseLinks
+{
+public:
+	struct Entry
+	{
+		Entry(unsigned int source = 0, unsigned int target = 0, double weight = 0.0) :
+			source(source), target(target), weight(weight) {}
+		unsigned int source;
+		unsigned int target;
+		double weight;
+	};
+
+	/**
+	 * A read-only cursor over the links of one row, consumed from the front.
+	 */
+	struct Row
+	{
+		Row(const unsigned int* targets = 0, const double* weights = 0, unsigned int size = 0) :
+			targets(targets), weights(weights), size(size) {}
+		bool empty() const { return size == 0; }
+		unsigned int target() const { return *targets; }
+		double weight() const { return *weights; }
+		void pop() { ++targets; ++weights; --size; }
+		const unsigned int* targets;
+		const double* weights;
+		unsigned int size;
+	};
+
+	SparseLinks() { updateView(); }
+	SparseLinks(const SparseLinks& other);
+	SparseLinks& operator=(const SparseLinks& other);
+	virtual ~SparseLinks() {}
+
+	void reserve(std::size_t numLinks) { m_buffer.reserve(numLinks); }
+
+	/**
+	 * Append a link to the edge buffer. Duplicates are aggregated on compact().
+	 */
+	void append(unsigned int source, unsigned int target, double weight)
+	{
+		m_buffer.push_back(Entry(source, target, weight));
+	}
+
+	/**
+	 * Grow the edge buffer with a number of links to be filled in by the caller,
+	 * possibly from multiple threads.
+	 * @return A pointer to the first new entry, valid until the buffer is changed
+	 */
+	Entry* extend(std::size_t numLinks)
+	{
+		std::size_t begin = m_buffer.size();
+		m_buffer.resize(begin + numLinks);
+		return m_buffer.data() + begin;
+	}
+
+	/**
+	 * Sort all appended links and merge them into the rows.
+	 * Weights of links defined more than once are summed in the order they
+	 * were added, after the weight of an already compacted link.
+	 * @param numRows The minimum number of rows, increased if any source
+	 * index is larger.
+	 * @return The number of links that was aggregated to existing links
+	 */
+	link_index compact(unsigned int numRows = 0);
+
+	/**
+	 * Write the transpose, with all links reversed, to the target.
+	 * @param weights Optional link weights in link index order to use instead
+	 * of the own weights
+	 * @note Only compacted links are included.
+	 */
+	void transpose(SparseLinks& target, const double* weights = 0) const;
+
+	/**
+	 * @return The link index of (source, target), or npos() if it doesn't exist
+	 */
+	link_index find(unsigned int source, unsigned int target) const;
+
+	/**
+	 * Replace all links with compacted links in external memory, without copying.
+	 * @param offsets The numRows + 1 row offsets into targets and weights
+	 * @param owner Kept as long as the links refer to the external memory
+	 */
+	void assignExternal(unsigned int numRows, const link_index* offsets, const unsigned int* targets,
+			const double* weights, const std::shared_ptr<const void>& owner);
+
+	/**
+	 * Replace all links with compacted links, taking over the weights.
+	 */
+	void assign(unsigned int numRows, const link_index* offsets, const unsigned int* targets,
+			std::vector<double>& weights);
+
+	/**
+	 * Replace all links with compacted links, taking over all three vectors.
+	 * @note The targets must be sorted within each row, without duplicates.
+	 */
+	void assign(unsigned int numRows, std::vector<link_index>& offsets, std::vector<unsigned int>& targets,
+			std::vector<double>& weights);
+
+	bool isCompact() const { return m_buffer.empty(); }
+	bool isExternal() const { return m_externalOwner.get() != 0; }
+	bool empty() const { return m_numLinks == 0 && m_buffer.empty(); }
+	link_index size() const { return m_numLinks; }
+	unsigned int numRows() const { return m_numRows; }
+
+	link_index rowBegin(unsigned int source) const { return m_offsetData[source]; }
+	link_index rowEnd(unsigned int source) const { return m_offsetData[source + 1]; }
+	unsigned int rowSize(unsigned int source) const
+	{
+		return source < m_numRows ? static_cast<unsigned int>(m_offsetData[source + 1] - m_offsetData[source]) : 0;
+	}
+	Row row(unsigned int source) const;
+
+	unsigned int target(link_index linkIndex) const { return m_targetData[linkIndex]; }
+	double weight(link_index linkIndex) const { return m_weightData[linkIndex]; }
+	double& weight(link_index linkIndex)
+	{
+		if (isExternal())
+			detach();
+		return m_weights[linkIndex];
+	}
+
+	/**
+	 * The raw compacted data, numRows() + 1 offsets and size() targets and weights.
+	 */
+	const link_index* offsets() const { return m_offsetData; }
+	const unsigned int* targets() const { return m_targetData; }
+	const double* weights() const { return m_weightData; }
+
+	void swap(SparseLinks& other);
+
+	/**
+	 * Release all memory, both compacted and buffered links.
+	 */
+	void clear();
+
+	static link_index npos() { return static_cast<link_index>(-1); }
+
+private:
+	/**
+	 * Stable LSD radix sort of the edge buffer on (source, target).
+	 */
+	void sortBuffer();
+
+	/**
+	 * Build the rows from the sorted edge buffer, aggregating duplicates.
+	 */
+	link_index buildFromSortedBuffer(unsigned int numRows);
+
+	/**
+	 * Merge the sorted edge buffer into the existing rows.
+	 */
+	link_index mergeSortedBuffer(unsigned int numRows);
+
+	/**
+	 * Copy external links to own storage.
+	 */
+	void detach();
+
+	/**
+	 * Point the data pointers to own storage, after it has been changed.
+	 */
+	void updateView();
+
+	std::vector<Entry> m_buffer;
+	std::vector<link_index> m_offsets;
+	std::vector<unsigned int> m_targets;
+	std::vector<double> m_weights;
+
+	// The compacted links, in own storage or external memory
+	std::shared_ptr<const void> m_externalOwner;
+	const link_index* m_offsetData;
+	const unsigned int* m_targetData;
+	const double* m_weightData;
+	unsigned int m_numRows;
+	link_index m_numLinks;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* SPARSELINKS_H_ */
@@ -36,7 +36,7 @@ TreeData::TreeData(NodeFactoryBase* nodeFactory)
 :	m_nodeFactory(nodeFactory),
 	m_numLeafEdges(0)
 {
-	m_root = m_nodeFactory->createNode("root", 1.0);
+	m_root = m_nodeFactory->createNode(1.0);
 }
 
 TreeData::~TreeData()
@@ -74,7 +74,7 @@ void TreeData::readFromSubNetwork(NodeBase* parent)
 			// If neighbour node is within the same cluster, add the link to this subnetwork.
 			if (edge.target.parent == parent)
 			{
-				addEdge(node.index, edge.target.index, edge.data.weight, edge.data.flow);
+				addEdge(node.index, edge.target.index, edge.data.getWeight(), edge.data.flow);
 			}
 			// else flow out of sub-network
 		}
@@ -32,6 +32,7 @@
 //#include "Edge.h"
 #include "Node.h"
 #include "NodeFactory.h"
+#include "../utils/types.h"
 #include <memory>
 
 #ifdef NS_INFOMAP
@@ -90,7 +91,7 @@ public:
 	unsigned int numLeafNodes() const
 	{ return m_leafNodes.size(); }
 
-	unsigned int numLeafEdges() const
+	link_index numLeafEdges() const
 	{ return m_numLeafEdges; }
 
 	unsigned int calcSize();
@@ -110,9 +111,9 @@ public:
 		m_leafNodes.push_back(node);
 	}
 
-	void addNewNode(std::string name, double flow, double teleportWeight)
+	void addNewNode(double flow, double teleportWeight)
 	{
-		NodeBase* node = m_nodeFactory->createNode(name, flow, teleportWeight);
+		NodeBase* node = m_nodeFactory->createNode(flow, teleportWeight);
 		m_root->addChild(node);
 		node->originalIndex = m_leafNodes.size();
 		m_leafNodes.push_back(node);
@@ -140,7 +141,7 @@ private:
 	std::auto_ptr<NodeFactoryBase> m_nodeFactory;
 	NodeBase* m_root;
 	std::vector<NodeBase*> m_leafNodes;
-	unsigned int m_numLeafEdges;
+	link_index m_numLeafEdges;
 //	std::vector<EdgeType*> m_leafEdges;
 
 };
@@ -0,0 +1,191 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "BinaryNetworkFormat.h"
+#include "MappedFile.h"
+#include "SafeFile.h"
+#include "convert.h"
+#include <cstring>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+using namespace BinaryNetwork;
+
+namespace
+{
+	const std::size_t SECTION_ALIGNMENT = 8;
+}
+
+BinaryNetworkHeader::BinaryNetworkHeader()
+{
+	std::memset(this, 0, sizeof(BinaryNetworkHeader));
+	std::memcpy(magic, MAGIC, sizeof(magic));
+	version = VERSION;
+	byteOrderMark = BYTE_ORDER_MARK;
+}
+
+bool isBinaryNetworkFile(const std::string& filename)
+{
+	std::FILE* file = std::fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	char magic[sizeof(MAGIC)];
+	bool isBinary = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+			std::memcmp(magic, MAGIC, sizeof(magic)) == 0;
+	std::fclose(file);
+	return isBinary;
+}
+
+BinaryNetworkReader::BinaryNetworkReader(const std::string& filename)
+:	m_filename(filename),
+	m_file(new MappedFile(filename)),
+	m_header(0)
+{
+	if (m_file->size() < sizeof(BinaryNetworkHeader) ||
+			std::memcmp(m_file->data(), MAGIC, sizeof(MAGIC)) != 0)
+		throw FileFormatError(io::Str() << "File '" << filename << "' is not a binary network file.");
+
+	m_header = reinterpret_cast<const BinaryNetworkHeader*>(m_file->data());
+	if (m_header->byteOrderMark != BYTE_ORDER_MARK)
+		throw FileFormatError(io::Str() << "Binary network file '" << filename <<
+				"' was written on a machine with a different byte order.");
+	if (m_header->version != VERSION)
+		throw FileFormatError(io::Str() << "Binary network file '" << filename << "' has version " <<
+				m_header->version << ", expected version " << VERSION << ".");
+
+	for (unsigned int i = 0; i < NUM_SECTIONS; ++i)
+	{
+		uint64_t offset = m_header->sectionOffset[i];
+		uint64_t size = m_header->sectionSize[i];
+		if (size != 0 && (offset % SECTION_ALIGNMENT != 0 || offset < sizeof(BinaryNetworkHeader) ||
+				offset > m_file->size() || size > m_file->size() - offset))
+			throw FileFormatError(io::Str() << "Corrupt section table in binary network file '" << filename << "'.");
+	}
+}
+
+const link_index* BinaryNetworkReader::linkOffsets(std::size_t count, std::vector<link_index>& storage) const
+{
+	bool isWide = (m_header->flags & WIDE_LINK_OFFSETS) != 0;
+	if (isWide == (sizeof(link_index) == sizeof(uint64_t)))
+		return section<link_index>(LINK_OFFSETS, count);
+
+	if (isWide)
+	{
+		const uint64_t* offsets = section<uint64_t>(LINK_OFFSETS, count);
+		if (offsets == 0)
+			return 0;
+		checkNumLinks(offsets[count - 1]);
+		storage.assign(offsets, offsets + count);
+	}
+	else
+	{
+		const uint32_t* offsets = section<uint32_t>(LINK_OFFSETS, count);
+		if (offsets == 0)
+			return 0;
+		storage.assign(offsets, offsets + count);
+	}
+	return storage.data();
+}
+
+void BinaryNetworkReader::checkNumLinks(uint64_t numLinks) const
+{
+	if (numLinks > static_cast<link_index>(-1))
+		throw InputDomainError(io::Str() << "The binary network file '" << m_filename << "' has " << numLinks <<
+				" links, build with INFOMAP_64BIT_INDEX to index more than " << static_cast<link_index>(-1) << " links.");
+}
+
+const void* BinaryNetworkReader::sectionData(Section section, std::size_t size) const
+{
+	if (!m_header->hasSection(section))
+		return 0;
+	if (m_header->sectionSize[section] != size)
+		throw FileFormatError(io::Str() << "Unexpected size of section " << section <<
+				" in binary network file '" << m_filename << "'.");
+	return m_file->data() + m_header->sectionOffset[section];
+}
+
+BinaryNetworkWriter::BinaryNetworkWriter(const std::string& filename)
+:	m_filename(filename),
+	m_file(std::fopen(filename.c_str(), "wb")),
+	m_position(0)
+{
+	if (m_file == NULL)
+		throw FileOpenError(io::Str() << "Error opening file '" << filename <<
+				"'. Check that the directory you are writing to exists and that you have write permissions.");
+	// Reserve space for the header
+	write(&m_header, sizeof(BinaryNetworkHeader));
+}
+
+BinaryNetworkWriter::~BinaryNetworkWriter()
+{
+	if (m_file != NULL)
+		std::fclose(m_file);
+}
+
+void BinaryNetworkWriter::writeSection(Section section, const void* data, std::size_t size)
+{
+	if (size == 0)
+		return;
+	const char padding[SECTION_ALIGNMENT] = { 0 };
+	if (m_position % SECTION_ALIGNMENT != 0)
+		write(padding, SECTION_ALIGNMENT - m_position % SECTION_ALIGNMENT);
+	m_header.sectionOffset[section] = m_position;
+	m_header.sectionSize[section] = size;
+	write(data, size);
+}
+
+void BinaryNetworkWriter::writeLinkOffsets(const link_index* offsets, std::size_t count)
+{
+	if (sizeof(link_index) == sizeof(uint64_t))
+		m_header.flags |= WIDE_LINK_OFFSETS;
+	writeSection(LINK_OFFSETS, offsets, count * sizeof(link_index));
+}
+
+void BinaryNetworkWriter::close()
+{
+	if (std::fseek(m_file, 0, SEEK_SET) != 0)
+		throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+	write(&m_header, sizeof(BinaryNetworkHeader));
+	int error = std::fclose(m_file);
+	m_file = NULL;
+	if (error != 0)
+		throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+}
+
+void BinaryNetworkWriter::write(const void* data, std::size_t size)
+{
+	if (std::fwrite(data, 1, size, m_file) != size)
+		throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+	m_position += size;
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
@@ -0,0 +1,222 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef BINARYNETWORKFORMAT_H_
+#define BINARYNETWORKFORMAT_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <vector>
+#include "../utils/types.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+class MappedFile;
+
+/**
+ * A versioned binary network format, where the finalized links are stored in
+ * compressed sparse row (CSR) format so that they can be memory mapped and
+ * used directly without parsing.
+ *
+ * The file starts with a BinaryNetworkHeader, followed by the sections listed
+ * in the header. Each section starts on an 8-byte boundary and is stored in
+ * the native byte order, checked on loading with the byte order mark.
+ *
+ * For state networks, the CSR rows are the state nodes in the order of the
+ * state sections, and the targets index into the same order.
+ */
+namespace BinaryNetwork
+{
+	const char MAGIC[8] = { 'I', 'N', 'F', 'O', 'M', 'A', 'P', 'N' };
+	const uint32_t VERSION = 2;
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+	const char* const FILE_EXTENSION = "bnet";
+
+	enum Flags
+	{
+		UNDIRECTED = 1 << 0,
+		FLOAT_WEIGHTS = 1 << 1, // Link weights stored as float instead of double
+		STATE_NETWORK = 1 << 2,
+		WIDE_LINK_OFFSETS = 1 << 3 // Link offsets stored as uint64_t instead of uint32_t
+	};
+
+	enum Section
+	{
+		NODE_NAME_OFFSETS, // uint64_t, numNodes + 1 offsets into the name data
+		NODE_NAME_DATA, // char, all names concatenated
+		NODE_WEIGHTS, // double, numNodes
+		LINK_OFFSETS, // uint32_t or uint64_t, numRows + 1 offsets into the link targets and weights
+		LINK_TARGETS, // uint32_t, numLinks
+		LINK_WEIGHTS, // double or float, numLinks, all 1.0 if omitted
+		STATE_IDS, // uint32_t, numStateNodes
+		STATE_PHYSICAL_IDS, // uint32_t, numStateNodes
+		STATE_WEIGHTS, // double, numStateNodes
+		NUM_SECTIONS
+	};
+}
+
+struct BinaryNetworkHeader
+{
+	BinaryNetworkHeader();
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrderMark;
+	uint32_t flags;
+	uint32_t numNodes;
+	uint32_t numRows;
+	uint32_t numStateNodes;
+	uint64_t numLinks;
+
+	// Parsing statistics of the original network
+	uint32_t numNodesFound;
+	uint32_t minNodeIndex;
+	uint32_t maxNodeIndex;
+	uint32_t numBipartiteNodes;
+	uint64_t numLinksFound;
+	uint64_t numAggregatedLinks;
+	uint64_t numSelfLinks;
+	uint64_t numSelfLinksFound;
+	uint64_t numAdditionalLinks;
+	double totalLinkWeight;
+	double totalSelfLinkWeight;
+	double sumAdditionalLinkWeight;
+	double sumNodeWeights;
+
+	// Byte offset and size of each section, zero size if omitted
+	uint64_t sectionOffset[BinaryNetwork::NUM_SECTIONS];
+	uint64_t sectionSize[BinaryNetwork::NUM_SECTIONS];
+
+	bool hasSection(BinaryNetwork::Section section) const { return sectionSize[section] != 0; }
+};
+
+/**
+ * Check the magic bytes in the beginning of the file.
+ */
+bool isBinaryNetworkFile(const std::string& filename);
+
+/**
+ * Memory map a binary network file and give typed access to its sections.
+ * The sections are valid as long as the reader or a copy of owner() exists.
+ */
+class BinaryNetworkReader
+{
+public:
+	/**
+	 * @throws FileOpenError if the file can't be opened
+	 * @throws FileFormatError if the header or section table is invalid
+	 */
+	explicit BinaryNetworkReader(const std::string& filename);
+
+	const BinaryNetworkHeader& header() const { return *m_header; }
+
+	/**
+	 * @return A pointer to the section data, or null if omitted
+	 * @throws FileFormatError if the section doesn't hold count values of type T
+	 */
+	template<typename T>
+	const T* section(BinaryNetwork::Section section, std::size_t count) const
+	{
+		return static_cast<const T*>(sectionData(section, count * sizeof(T)));
+	}
+
+	/**
+	 * The link offsets in the index width of this build. Offsets stored with
+	 * another width are converted to the storage vector, which is then non-empty.
+	 * @return A pointer to the offsets, or null if omitted
+	 * @throws InputDomainError if an offset is too large for this build
+	 */
+	const link_index* linkOffsets(std::size_t count, std::vector<link_index>& storage) const;
+
+	/**
+	 * Check that a number of links can be indexed in this build.
+	 * @throws InputDomainError if not
+	 */
+	void checkNumLinks(uint64_t numLinks) const;
+
+	std::shared_ptr<const void> owner() const { return m_file; }
+
+private:
+	const void* sectionData(BinaryNetwork::Section section, std::size_t size) const;
+
+	std::string m_filename;
+	std::shared_ptr<MappedFile> m_file;
+	const BinaryNetworkHeader* m_header;
+};
+
+/**
+ * Write the header and sections of a binary network file. Sections are
+ * written in any order, and the header last when the section table is
+ * complete.
+ */
+class BinaryNetworkWriter
+{
+public:
+	/**
+	 * @throws FileOpenError if the file can't be opened
+	 */
+	explicit BinaryNetworkWriter(const std::string& filename);
+	~BinaryNetworkWriter();
+
+	BinaryNetworkHeader& header() { return m_header; }
+
+	void writeSection(BinaryNetwork::Section section, const void* data, std::size_t size);
+
+	/**
+	 * Write the link offsets section in the index width of this build.
+	 */
+	void writeLinkOffsets(const link_index* offsets, std::size_t count);
+
+	/**
+	 * Write the header and close the file.
+	 * @throws FileOpenError on write errors
+	 */
+	void close();
+
+private:
+	void write(const void* data, std::size_t size);
+
+	BinaryNetworkWriter(const BinaryNetworkWriter&);
+	BinaryNetworkWriter& operator=(const BinaryNetworkWriter&);
+
+	std::string m_filename;
+	std::FILE* m_file;
+	uint64_t m_position;
+	BinaryNetworkHeader m_header;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* BINARYNETWORKFORMAT_H_ */
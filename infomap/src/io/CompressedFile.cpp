@@ -0,0 +1,398 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "CompressedFile.h"
+#include "SafeFile.h"
+#include "convert.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * Decompress a file in consecutive pieces.
+ */
+class Decompressor
+{
+public:
+	virtual ~Decompressor() {}
+
+	/**
+	 * Decompress up to size bytes to data.
+	 * @return The number of bytes decompressed, zero at the end of the file
+	 * @throws FileFormatError on corrupt or truncated data
+	 */
+	virtual std::size_t read(char* data, std::size_t size) = 0;
+};
+
+namespace
+{
+	const std::size_t INPUT_BUFFER_SIZE = 1 << 20;
+
+	// Limit each call to fit the 32-bit sizes of the compression libraries
+	const std::size_t MAX_READ_SIZE = 1 << 30;
+
+	const unsigned char GZIP_MAGIC[] = { 0x1f, 0x8b };
+	const unsigned char ZSTD_MAGIC[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+	/**
+	 * Read the compressed file in pieces.
+	 */
+	class InputFile
+	{
+	public:
+		explicit InputFile(const std::string& filename)
+		:	m_filename(filename),
+			m_file(std::fopen(filename.c_str(), "rb")),
+			m_buffer(INPUT_BUFFER_SIZE)
+		{
+			if (m_file == NULL)
+				throw FileOpenError(io::Str() << "Error opening file '" << filename <<
+						"'. Check that the path points to a file and that you have read permissions.");
+		}
+
+		~InputFile() { std::fclose(m_file); }
+
+		/**
+		 * @return The number of bytes read to the buffer, zero at the end of the file
+		 */
+		std::size_t read()
+		{
+			std::size_t numRead = std::fread(&m_buffer[0], 1, m_buffer.size(), m_file);
+			if (numRead == 0 && std::ferror(m_file))
+				throw FileOpenError(io::Str() << "Error reading file '" << m_filename << "'.");
+			return numRead;
+		}
+
+		const std::string& filename() const { return m_filename; }
+		char* buffer() { return &m_buffer[0]; }
+
+	private:
+		InputFile(const InputFile&);
+		InputFile& operator=(const InputFile&);
+
+		std::string m_filename;
+		std::FILE* m_file;
+		std::vector<char> m_buffer;
+	};
+
+#ifdef HAVE_ZLIB
+	/**
+	 * Decompress gzip files, including files of several concatenated members.
+	 */
+	class GzipDecompressor : public Decompressor
+	{
+	public:
+		explicit GzipDecompressor(const std::string& filename)
+		:	m_input(filename),
+			m_isMemberEnd(false),
+			m_isEnd(false)
+		{
+			std::memset(&m_stream, 0, sizeof(m_stream));
+			// Add 32 to the window bits to detect the gzip header
+			if (inflateInit2(&m_stream, 15 + 32) != Z_OK)
+				throw FileFormatError("Can't initialize gzip decompression.");
+		}
+
+		virtual ~GzipDecompressor() { inflateEnd(&m_stream); }
+
+		virtual std::size_t read(char* data, std::size_t size)
+		{
+			size = std::min(size, MAX_READ_SIZE);
+			m_stream.next_out = reinterpret_cast<Bytef*>(data);
+			m_stream.avail_out = static_cast<uInt>(size);
+			while (m_stream.avail_out > 0 && !m_isEnd)
+			{
+				if (m_stream.avail_in == 0)
+				{
+					std::size_t numRead = m_input.read();
+					if (numRead == 0)
+					{
+						if (!m_isMemberEnd)
+							throw FileFormatError(io::Str() << "Unexpected end of gzip compressed file '" <<
+									m_input.filename() << "'.");
+						m_isEnd = true;
+						break;
+					}
+					m_stream.next_in = reinterpret_cast<Bytef*>(m_input.buffer());
+					m_stream.avail_in = static_cast<uInt>(numRead);
+				}
+				int status = inflate(&m_stream, Z_NO_FLUSH);
+				if (status == Z_STREAM_END)
+				{
+					// Continue with the next member if any
+					m_isMemberEnd = true;
+					inflateReset(&m_stream);
+				}
+				else if (status == Z_OK)
+					m_isMemberEnd = false;
+				else
+					throw FileFormatError(io::Str() << "Corrupt gzip compressed file '" << m_input.filename() <<
+							"': " << (m_stream.msg != NULL ? m_stream.msg : "unknown error") << ".");
+			}
+			return size - m_stream.avail_out;
+		}
+
+	private:
+		InputFile m_input;
+		z_stream m_stream;
+		bool m_isMemberEnd;
+		bool m_isEnd;
+	};
+#endif
+
+#ifdef HAVE_ZSTD
+	/**
+	 * Decompress zstd files, including files of several concatenated frames.
+	 */
+	class ZstdDecompressor : public Decompressor
+	{
+	public:
+		explicit ZstdDecompressor(const std::string& filename)
+		:	m_input(filename),
+			m_stream(ZSTD_createDStream()),
+			m_isFrameEnd(false),
+			m_isEnd(false)
+		{
+			if (m_stream == NULL || ZSTD_isError(ZSTD_initDStream(m_stream)))
+				throw FileFormatError("Can't initialize zstd decompression.");
+			m_in.src = m_input.buffer();
+			m_in.size = 0;
+			m_in.pos = 0;
+		}
+
+		virtual ~ZstdDecompressor() { ZSTD_freeDStream(m_stream); }
+
+		virtual std::size_t read(char* data, std::size_t size)
+		{
+			ZSTD_outBuffer out = { data, std::min(size, MAX_READ_SIZE), 0 };
+			while (out.pos < out.size && !m_isEnd)
+			{
+				if (m_in.pos == m_in.size)
+				{
+					std::size_t numRead = m_input.read();
+					if (numRead == 0)
+					{
+						if (!m_isFrameEnd)
+							throw FileFormatError(io::Str() << "Unexpected end of zstd compressed file '" <<
+									m_input.filename() << "'.");
+						m_isEnd = true;
+						break;
+					}
+					m_in.size = numRead;
+					m_in.pos = 0;
+				}
+				std::size_t status = ZSTD_decompressStream(m_stream, &out, &m_in);
+				if (ZSTD_isError(status))
+					throw FileFormatError(io::Str() << "Corrupt zstd compressed file '" << m_input.filename() <<
+							"': " << ZSTD_getErrorName(status) << ".");
+				// Zero when a frame is completely decoded and flushed
+				m_isFrameEnd = status == 0;
+			}
+			return out.pos;
+		}
+
+	private:
+		InputFile m_input;
+		ZSTD_DStream* m_stream;
+		ZSTD_inBuffer m_in;
+		bool m_isFrameEnd;
+		bool m_isEnd;
+	};
+#endif
+
+	Decompressor* createDecompressor(const std::string& filename)
+	{
+		switch (CompressedFile::detectCompression(filename))
+		{
+		case CompressedFile::GZIP:
+#ifdef HAVE_ZLIB
+			return new GzipDecompressor(filename);
+#else
+			throw FileFormatError(io::Str() << "Can't read gzip compressed file '" << filename <<
+					"', Infomap was built without zlib.");
+#endif
+		case CompressedFile::ZSTD:
+#ifdef HAVE_ZSTD
+			return new ZstdDecompressor(filename);
+#else
+			throw FileFormatError(io::Str() << "Can't read zstd compressed file '" << filename <<
+					"', Infomap was built without zstd.");
+#endif
+		default:
+			throw FileFormatError(io::Str() << "File '" << filename << "' is not compressed with gzip or zstd.");
+		}
+	}
+}
+
+CompressedFile::CompressedFile(const std::string& filename)
+:	m_decompressor(createDecompressor(filename)),
+	m_buffers(NUM_BUFFERS),
+	m_numProduced(0),
+	m_numConsumed(0),
+	m_hasCurrentBlock(false),
+	m_isDone(false),
+	m_isStopped(false),
+	m_thread(&CompressedFile::decompress, this)
+{}
+
+CompressedFile::~CompressedFile()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopped = true;
+	}
+	m_consumed.notify_one();
+	m_thread.join();
+}
+
+bool CompressedFile::nextBlock(const char*& begin, const char*& end)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_hasCurrentBlock)
+	{
+		// Release the previous block to the reader thread
+		++m_numConsumed;
+		m_hasCurrentBlock = false;
+		m_consumed.notify_one();
+	}
+	m_produced.wait(lock, [this] { return m_numProduced > m_numConsumed || m_isDone; });
+	if (m_numProduced == m_numConsumed)
+	{
+		if (m_error)
+			std::rethrow_exception(m_error);
+		return false;
+	}
+	const Buffer& buffer = m_buffers[m_numConsumed % NUM_BUFFERS];
+	begin = &buffer.data[0];
+	end = begin + buffer.size;
+	m_hasCurrentBlock = true;
+	return true;
+}
+
+bool CompressedFile::waitForFreeBuffer()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_consumed.wait(lock, [this] { return m_numProduced - m_numConsumed < NUM_BUFFERS || m_isStopped; });
+	return !m_isStopped;
+}
+
+void CompressedFile::decompress()
+{
+	try
+	{
+		// The incomplete line after the last line break in the previous buffer
+		std::vector<char> carry;
+		bool isEnd = false;
+		while (!isEnd && waitForFreeBuffer())
+		{
+			// Only this thread accesses the free buffers
+			Buffer& buffer = m_buffers[m_numProduced % NUM_BUFFERS];
+			buffer.data.resize(std::max(std::max(buffer.data.size(), BUFFER_SIZE), 2 * carry.size()));
+			std::copy(carry.begin(), carry.end(), buffer.data.begin());
+			std::size_t size = carry.size();
+			std::size_t blockSize = 0;
+			while (true)
+			{
+				std::size_t numRead = m_decompressor->read(&buffer.data[size], buffer.data.size() - size);
+				if (numRead == 0)
+				{
+					isEnd = true;
+					blockSize = size;
+					break;
+				}
+				size += numRead;
+				if (size < buffer.data.size())
+					continue;
+				// Full, cut after the last line break or grow to fit a long line
+				std::size_t lineEnd = size;
+				while (lineEnd > 0 && buffer.data[lineEnd - 1] != '\n')
+					--lineEnd;
+				if (lineEnd > 0)
+				{
+					blockSize = lineEnd;
+					break;
+				}
+				buffer.data.resize(2 * buffer.data.size());
+			}
+			carry.assign(buffer.data.begin() + blockSize, buffer.data.begin() + size);
+			buffer.size = blockSize;
+
+			if (blockSize > 0)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_numProduced;
+			}
+			m_produced.notify_one();
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_error = std::current_exception();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isDone = true;
+	}
+	m_produced.notify_one();
+}
+
+CompressedFile::Compression CompressedFile::detectCompression(const std::string& filename)
+{
+	std::FILE* file = std::fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return NONE;
+	unsigned char magic[sizeof(ZSTD_MAGIC)];
+	std::size_t numRead = std::fread(magic, 1, sizeof(magic), file);
+	std::fclose(file);
+	if (numRead >= sizeof(GZIP_MAGIC) && std::memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0)
+		return GZIP;
+	if (numRead >= sizeof(ZSTD_MAGIC) && std::memcmp(magic, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0)
+		return ZSTD;
+	return NONE;
+}
+
+bool CompressedFile::isCompressedExtension(const std::string& extension)
+{
+	return extension == "gz" || extension == "zst";
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
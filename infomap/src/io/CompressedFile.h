@@ -0,0 +1,125 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef COMPRESSEDFILE_H_
+#define COMPRESSEDFILE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TextSource.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+class Decompressor;
+
+/**
+ * A gzip or zstd compressed text file, decompressed on a reader thread
+ * while the previous blocks are parsed.
+ *
+ * The reader thread fills a bounded ring of buffers, each cut after the last
+ * line break so that no line spans two blocks. A line longer than a buffer
+ * grows it. Support for each compression format depends on the libraries
+ * available at build time, see HAVE_ZLIB and HAVE_ZSTD.
+ */
+class CompressedFile : public TextSource
+{
+public:
+	enum Compression { NONE, GZIP, ZSTD };
+
+	/**
+	 * @throws FileOpenError if the file can't be opened
+	 * @throws FileFormatError if the compression format isn't supported
+	 */
+	explicit CompressedFile(const std::string& filename);
+	virtual ~CompressedFile();
+
+	/**
+	 * The next decompressed block, valid until the next call.
+	 * @throws FileFormatError on corrupt compressed data
+	 */
+	virtual bool nextBlock(const char*& begin, const char*& end);
+
+	/**
+	 * Detect the compression format from the magic bytes in the beginning of the file.
+	 */
+	static Compression detectCompression(const std::string& filename);
+
+	/**
+	 * @return true for the file extensions of the supported compression formats
+	 */
+	static bool isCompressedExtension(const std::string& extension);
+
+private:
+	struct Buffer
+	{
+		Buffer() : size(0) {}
+		std::vector<char> data;
+		std::size_t size;
+	};
+
+	/**
+	 * Fill the buffers on the reader thread until the end or stopped.
+	 */
+	void decompress();
+
+	/**
+	 * Wait for a free buffer.
+	 * @return false if stopped
+	 */
+	bool waitForFreeBuffer();
+
+	static const unsigned int NUM_BUFFERS = 4;
+	static const std::size_t BUFFER_SIZE = 1 << 23;
+
+	std::unique_ptr<Decompressor> m_decompressor;
+	std::vector<Buffer> m_buffers;
+	std::size_t m_numProduced;
+	std::size_t m_numConsumed;
+	bool m_hasCurrentBlock;
+	bool m_isDone;
+	bool m_isStopped;
+	std::exception_ptr m_error;
+	std::mutex m_mutex;
+	std::condition_variable m_produced;
+	std::condition_variable m_consumed;
+	std::thread m_thread;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* COMPRESSEDFILE_H_ */
@@ -55,11 +55,14 @@ struct Config
 	 	parseWithoutIOStreams(false),
 		zeroBasedNodeNumbers(false),
 		includeSelfLinks(false),
+		remapNodeIds(false),
 		ignoreEdgeWeights(false),
 		skipCompleteDanglingMemoryNodes(false),
 		nodeLimit(0),
 		preClusterMultiplex(false),
 	 	clusterDataFile(""),
+		flowStartFile(""),
+		flowCacheDirectory(""),
 	 	noInfomap(false),
 	 	twoLevel(false),
 		directed(false),
@@ -69,7 +72,12 @@ struct Config
 		recordedTeleportation(false),
 		teleportToNodes(false),
 		teleportationProbability(0.15),
+		flowTolerance(1.0e-15),
+		flowMinIterations(50),
+		flowMaxIterations(0),
+		flowExtrapolationInterval(0),
 		selfTeleportationProbability(-1),
+		teleportationSweep(""),
 		markovTime(1.0),
 		preferredNumberOfModules(0),
 		multiplexRelaxRate(-1),
@@ -104,6 +112,8 @@ struct Config
 		printFlowNetwork(false),
 		printPajekNetwork(false),
 		printStateNetwork(false),
+		printBinaryNetwork(false),
+		binaryFloatWeights(false),
 		printBinaryTree(false),
 		printBinaryFlowTree(false),
 		printExpanded(false),
@@ -132,11 +142,14 @@ struct Config
 	 	parseWithoutIOStreams(other.parseWithoutIOStreams),
 		zeroBasedNodeNumbers(other.zeroBasedNodeNumbers),
 		includeSelfLinks(other.includeSelfLinks),
+		remapNodeIds(other.remapNodeIds),
 		ignoreEdgeWeights(other.ignoreEdgeWeights),
 		skipCompleteDanglingMemoryNodes(other.skipCompleteDanglingMemoryNodes),
 		nodeLimit(other.nodeLimit),
 		preClusterMultiplex(other.preClusterMultiplex),
 	 	clusterDataFile(other.clusterDataFile),
+		flowStartFile(other.flowStartFile),
+		flowCacheDirectory(other.flowCacheDirectory),
 	 	noInfomap(other.noInfomap),
 	 	twoLevel(other.twoLevel),
 		directed(other.directed),
@@ -146,7 +159,12 @@ struct Config
 		recordedTeleportation(other.recordedTeleportation),
 		teleportToNodes(other.teleportToNodes),
 		teleportationProbability(other.teleportationProbability),
+		flowTolerance(other.flowTolerance),
+		flowMinIterations(other.flowMinIterations),
+		flowMaxIterations(other.flowMaxIterations),
+		flowExtrapolationInterval(other.flowExtrapolationInterval),
 		selfTeleportationProbability(other.selfTeleportationProbability),
+		teleportationSweep(other.teleportationSweep),
 		markovTime(other.markovTime),
 		preferredNumberOfModules(other.preferredNumberOfModules),
 		multiplexRelaxRate(other.multiplexRelaxRate),
@@ -181,6 +199,8 @@ struct Config
 		printFlowNetwork(other.printFlowNetwork),
 		printPajekNetwork(other.printPajekNetwork),
 		printStateNetwork(other.printStateNetwork),
+		printBinaryNetwork(other.printBinaryNetwork),
+		binaryFloatWeights(other.binaryFloatWeights),
 		printBinaryTree(other.printBinaryTree),
 		printBinaryFlowTree(other.printBinaryFlowTree),
 		printExpanded(other.printExpanded),
@@ -211,11 +231,14 @@ struct Config
 	 	parseWithoutIOStreams = other.parseWithoutIOStreams;
 		zeroBasedNodeNumbers = other.zeroBasedNodeNumbers;
 		includeSelfLinks = other.includeSelfLinks;
+		remapNodeIds = other.remapNodeIds;
 		ignoreEdgeWeights = other.ignoreEdgeWeights;
 		skipCompleteDanglingMemoryNodes = other.skipCompleteDanglingMemoryNodes;
 		nodeLimit = other.nodeLimit;
 		preClusterMultiplex = other.preClusterMultiplex;
 	 	clusterDataFile = other.clusterDataFile;
+		flowStartFile = other.flowStartFile;
+		flowCacheDirectory = other.flowCacheDirectory;
 	 	noInfomap = other.noInfomap;
 	 	twoLevel = other.twoLevel;
 		directed = other.directed;
@@ -225,7 +248,12 @@ struct Config
 		recordedTeleportation = other.recordedTeleportation;
 		teleportToNodes = other.teleportToNodes;
 		teleportationProbability = other.teleportationProbability;
+		flowTolerance = other.flowTolerance;
+		flowMinIterations = other.flowMinIterations;
+		flowMaxIterations = other.flowMaxIterations;
+		flowExtrapolationInterval = other.flowExtrapolationInterval;
 		selfTeleportationProbability = other.selfTeleportationProbability;
+		teleportationSweep = other.teleportationSweep;
 	 	markovTime = other.markovTime;
 	 	preferredNumberOfModules = other.preferredNumberOfModules;
 		multiplexRelaxRate = other.multiplexRelaxRate;
@@ -260,6 +288,8 @@ struct Config
 		printFlowNetwork = other.printFlowNetwork;
 		printPajekNetwork = other.printPajekNetwork;
 		printStateNetwork = other.printStateNetwork;
+		printBinaryNetwork = other.printBinaryNetwork;
+		binaryFloatWeights = other.binaryFloatWeights;
 		printBinaryTree = other.printBinaryTree;
 		printBinaryFlowTree = other.printBinaryFlowTree;
 		printExpanded = other.printExpanded;
@@ -427,11 +457,14 @@ struct Config
 	bool parseWithoutIOStreams;
 	bool zeroBasedNodeNumbers;
 	bool includeSelfLinks;
+	bool remapNodeIds;
 	bool ignoreEdgeWeights;
 	bool skipCompleteDanglingMemoryNodes;
 	unsigned int nodeLimit;
 	bool preClusterMultiplex;
 	std::string clusterDataFile;
+	std::string flowStartFile;
+	std::string flowCacheDirectory;
 	bool noInfomap;
 
 	// Core algorithm
@@ -443,7 +476,12 @@ struct Config
 	bool recordedTeleportation;
 	bool teleportToNodes;
 	double teleportationProbability;
+	double flowTolerance; // L1 difference between power iterations to stop at
+	unsigned int flowMinIterations;
+	unsigned int flowMaxIterations; // 0 for the default of the flow model
+	unsigned int flowExtrapolationInterval; // Extrapolate the power iteration every n >= 2 iterations, 0 for none
 	double selfTeleportationProbability;
+	std::string teleportationSweep;
 	double markovTime;
 	unsigned int preferredNumberOfModules;
 	double multiplexRelaxRate;
@@ -482,6 +520,8 @@ struct Config
 	bool printFlowNetwork;
 	bool printPajekNetwork;
 	bool printStateNetwork;
+	bool printBinaryNetwork;
+	bool binaryFloatWeights;
 	bool printBinaryTree;
 	bool printBinaryFlowTree; // tree including horizontal links (hierarchical network)
 	bool printExpanded; // Print the expanded network of memory nodes if possible
@@ -0,0 +1,355 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "FlowNetworkCache.h"
+#include "MappedFile.h"
+#include "SafeFile.h"
+#include "convert.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+using namespace FlowCache;
+
+namespace
+{
+	const std::size_t SECTION_ALIGNMENT = 8;
+
+	const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+	const uint64_t HASH_PRIME = 0x100000001b3ULL;
+
+	long processId()
+	{
+#ifdef _WIN32
+		return _getpid();
+#else
+		return getpid();
+#endif
+	}
+
+	/**
+	 * FNV-1a on 8-byte words with an extra shift to mix the high bits down,
+	 * fast enough to hash the input files on each run.
+	 */
+	uint64_t hashBytes(const char* data, std::size_t size, uint64_t hash)
+	{
+		std::size_t numWords = size / sizeof(uint64_t);
+		for (std::size_t i = 0; i < numWords; ++i)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+			hash = (hash ^ word) * HASH_PRIME;
+			hash ^= hash >> 29;
+		}
+		for (std::size_t i = numWords * sizeof(uint64_t); i < size; ++i)
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * HASH_PRIME;
+		return hash;
+	}
+
+	uint64_t hashString(const std::string& str, uint64_t hash)
+	{
+		return hashBytes(str.data(), str.size(), hash) ^ str.size();
+	}
+
+	uint64_t hashFile(const std::string& filename, uint64_t hash)
+	{
+		MappedFile file(filename);
+		const char* begin;
+		const char* end;
+		while (file.nextBlock(begin, end))
+			hash = hashBytes(begin, end - begin, hash);
+		return (hash ^ file.size()) * HASH_PRIME;
+	}
+
+	class SectionWriter
+	{
+	public:
+		explicit SectionWriter(const std::string& filename) :
+			m_filename(filename),
+			m_file(std::fopen(filename.c_str(), "wb")),
+			m_position(0),
+			m_payloadHash(HASH_SEED)
+		{
+			if (m_file == NULL)
+				throw FileOpenError(io::Str() << "Error opening file '" << filename <<
+						"'. Check that the directory you are writing to exists and that you have write permissions.");
+			write(&m_header, sizeof(FlowCacheHeader));
+		}
+
+		~SectionWriter()
+		{
+			if (m_file != NULL)
+			{
+				std::fclose(m_file);
+				std::remove(m_filename.c_str());
+			}
+		}
+
+		FlowCacheHeader& header() { return m_header; }
+
+		void writeSection(Section section, const void* data, std::size_t size)
+		{
+			if (size == 0)
+				return;
+			const char padding[SECTION_ALIGNMENT] = { 0 };
+			if (m_position % SECTION_ALIGNMENT != 0)
+				write(padding, SECTION_ALIGNMENT - m_position % SECTION_ALIGNMENT);
+			m_header.sectionOffset[section] = m_position;
+			m_header.sectionSize[section] = size;
+			write(data, size);
+			m_payloadHash = hashBytes(static_cast<const char*>(data), size, m_payloadHash);
+		}
+
+		void close()
+		{
+			if (std::fseek(m_file, 0, SEEK_SET) != 0)
+				throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+			m_header.payloadHash = m_payloadHash;
+			write(&m_header, sizeof(FlowCacheHeader));
+			int error = std::fclose(m_file);
+			m_file = NULL;
+			if (error != 0)
+				throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+		}
+
+	private:
+		void write(const void* data, std::size_t size)
+		{
+			if (std::fwrite(data, 1, size, m_file) != size)
+				throw FileOpenError(io::Str() << "Error writing to file '" << m_filename << "'.");
+			m_position += size;
+		}
+
+		std::string m_filename;
+		std::FILE* m_file;
+		uint64_t m_position;
+		uint64_t m_payloadHash;
+		FlowCacheHeader m_header;
+	};
+
+	/**
+	 * @return A pointer to the section data, or null if omitted or not of the expected size
+	 */
+	template<typename T>
+	const T* section(const MappedFile& file, const FlowCacheHeader& header, Section section, std::size_t count)
+	{
+		if (header.sectionSize[section] != count * sizeof(T) || count == 0)
+			return 0;
+		return reinterpret_cast<const T*>(file.data() + header.sectionOffset[section]);
+	}
+}
+
+FlowCacheHeader::FlowCacheHeader()
+{
+	std::memset(this, 0, sizeof(FlowCacheHeader));
+	std::memcpy(magic, MAGIC, sizeof(magic));
+	version = VERSION;
+	byteOrderMark = BYTE_ORDER_MARK;
+}
+
+uint64_t flowCacheKey(const Config& config)
+{
+	uint64_t hash = HASH_SEED;
+	hash = hashFile(config.networkFile, hash);
+	for (unsigned int i = 0; i < config.additionalInput.size(); ++i)
+		hash = hashFile(config.additionalInput[i], hash);
+
+	// All options that change the parsed network or its flow
+	std::string flowOptions = io::Str() << config.version << " " << sizeof(link_index) << " " <<
+			config.inputFormat << " " << config.bipartite << config.skipAdjustBipartiteFlow <<
+			config.nonBacktracking << config.zeroBasedNodeNumbers << config.includeSelfLinks <<
+			config.remapNodeIds << config.ignoreEdgeWeights << " " << config.nodeLimit << " " <<
+			config.directed << config.undirdir << config.outdirdir << config.rawdir <<
+			config.recordedTeleportation << config.teleportToNodes << " " <<
+			io::toPrecision(config.teleportationProbability, 17) << " " <<
+			io::toPrecision(config.selfTeleportationProbability, 17) << " " <<
+			io::toPrecision(config.flowTolerance, 17) << " " << config.flowMinIterations << " " <<
+			config.flowMaxIterations << " " << config.flowExtrapolationInterval;
+	return hashString(flowOptions, hash);
+}
+
+std::string flowCacheFilename(const Config& config, uint64_t key)
+{
+	std::string dir = config.flowCacheDirectory;
+	if (!dir.empty() && *--dir.end() != '/')
+		dir.append("/");
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+	return io::Str() << dir << hex << "." << FILE_EXTENSION;
+}
+
+void writeFlowCache(const std::string& filename, uint64_t key, const FlowNetwork& flowNetwork,
+		const NodeNames& nodeNames, unsigned int numBipartiteNodes)
+{
+	const std::vector<double>& nodeFlow = flowNetwork.getNodeFlow();
+	const std::vector<double>& teleportRates = flowNetwork.getNodeTeleportRates();
+	const FlowNetwork::LinkVec& links = flowNetwork.getFlowLinks();
+	link_index numLinks = links.size();
+	const std::vector<uint64_t>& nodeIds = nodeNames.ids();
+
+	// A unique temporary name for each concurrent writer, by process and within the process
+	std::string tmpFilename = io::Str() << filename << "." << processId() << "." <<
+			reinterpret_cast<uintptr_t>(&nodeFlow) << ".tmp";
+	SectionWriter out(tmpFilename);
+	FlowCacheHeader& header = out.header();
+	header.key = key;
+	header.numNodes = nodeFlow.size();
+	header.numNamedNodes = nodeNames.numNamed();
+	header.numNodeIds = nodeIds.size();
+	header.numBipartiteNodes = numBipartiteNodes;
+	header.defaultNameIndexOffset = nodeNames.defaultIndexOffset();
+	header.numLinks = numLinks;
+
+	out.writeSection(NODE_NAME_OFFSETS, nodeNames.offsets(), (nodeNames.numNamed() + 1) * sizeof(uint64_t));
+	out.writeSection(NODE_NAME_DATA, nodeNames.data(), nodeNames.offsets()[nodeNames.numNamed()]);
+	if (!nodeIds.empty())
+		out.writeSection(NODE_IDS, &nodeIds[0], nodeIds.size() * sizeof(uint64_t));
+	if (!nodeFlow.empty())
+	{
+		out.writeSection(NODE_FLOW, &nodeFlow[0], nodeFlow.size() * sizeof(double));
+		out.writeSection(NODE_TELEPORT_RATES, &teleportRates[0], teleportRates.size() * sizeof(double));
+	}
+
+	if (numLinks != 0)
+	{
+		std::vector<uint32_t> nodes(numLinks);
+		for (link_index i = 0; i < numLinks; ++i)
+			nodes[i] = links[i].source;
+		out.writeSection(LINK_SOURCES, &nodes[0], numLinks * sizeof(uint32_t));
+		for (link_index i = 0; i < numLinks; ++i)
+			nodes[i] = links[i].target;
+		out.writeSection(LINK_TARGETS, &nodes[0], numLinks * sizeof(uint32_t));
+		std::vector<uint32_t>().swap(nodes);
+
+		std::vector<double> values(numLinks);
+		for (link_index i = 0; i < numLinks; ++i)
+			values[i] = links[i].weight;
+		out.writeSection(LINK_WEIGHTS, &values[0], numLinks * sizeof(double));
+		for (link_index i = 0; i < numLinks; ++i)
+			values[i] = links[i].flow;
+		out.writeSection(LINK_FLOWS, &values[0], numLinks * sizeof(double));
+	}
+
+	out.close();
+	if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tmpFilename.c_str());
+		throw FileOpenError(io::Str() << "Error renaming file '" << tmpFilename << "' to '" << filename << "'.");
+	}
+}
+
+bool readFlowCache(const std::string& filename, uint64_t key, FlowNetwork& flowNetwork,
+		NodeNames& nodeNames, unsigned int& numBipartiteNodes)
+{
+	std::FILE* probe = std::fopen(filename.c_str(), "rb");
+	if (probe == NULL)
+		return false;
+	std::fclose(probe);
+
+	MappedFile file(filename);
+	if (file.size() < sizeof(FlowCacheHeader))
+		return false;
+	const FlowCacheHeader& header = *reinterpret_cast<const FlowCacheHeader*>(file.data());
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+			header.byteOrderMark != BYTE_ORDER_MARK || header.key != key)
+		return false;
+	for (unsigned int i = 0; i < NUM_SECTIONS; ++i)
+	{
+		uint64_t offset = header.sectionOffset[i];
+		uint64_t size = header.sectionSize[i];
+		if (size != 0 && (offset % SECTION_ALIGNMENT != 0 || offset < sizeof(FlowCacheHeader) ||
+				offset > file.size() || size > file.size() - offset))
+			return false;
+	}
+	if (header.numLinks > static_cast<link_index>(-1))
+		return false;
+
+	// Detect files corrupted after writing, as the flow values are used without further checks
+	uint64_t payloadHash = HASH_SEED;
+	for (unsigned int i = 0; i < NUM_SECTIONS; ++i)
+		payloadHash = hashBytes(file.data() + header.sectionOffset[i], header.sectionSize[i], payloadHash);
+	if (payloadHash != header.payloadHash)
+		return false;
+
+	unsigned int numNodes = header.numNodes;
+	link_index numLinks = header.numLinks;
+	const uint64_t* nameOffsets = section<uint64_t>(file, header, NODE_NAME_OFFSETS, header.numNamedNodes + 1);
+	const char* nameData = section<char>(file, header, NODE_NAME_DATA, nameOffsets == 0 ? 0 : nameOffsets[header.numNamedNodes]);
+	const uint64_t* nodeIds = section<uint64_t>(file, header, NODE_IDS, header.numNodeIds);
+	const double* nodeFlow = section<double>(file, header, NODE_FLOW, numNodes);
+	const double* teleportRates = section<double>(file, header, NODE_TELEPORT_RATES, numNodes);
+	const uint32_t* sources = section<uint32_t>(file, header, LINK_SOURCES, numLinks);
+	const uint32_t* targets = section<uint32_t>(file, header, LINK_TARGETS, numLinks);
+	const double* weights = section<double>(file, header, LINK_WEIGHTS, numLinks);
+	const double* flows = section<double>(file, header, LINK_FLOWS, numLinks);
+	if (nameOffsets == 0 || nodeFlow == 0 || teleportRates == 0 || (header.numNodeIds != 0 && nodeIds == 0) ||
+			(numLinks != 0 && (sources == 0 || targets == 0 || weights == 0 || flows == 0)))
+		return false;
+
+	// Check the contents once, as they are used directly without further checks
+	if (header.numNamedNodes > numNodes || header.numNodeIds > numNodes || header.numBipartiteNodes > numNodes)
+		return false;
+	if (nameOffsets[0] != 0)
+		return false;
+	for (unsigned int i = 0; i < header.numNamedNodes; ++i)
+	{
+		if (nameOffsets[i] > nameOffsets[i + 1])
+			return false;
+	}
+	for (link_index i = 0; i < numLinks; ++i)
+	{
+		if (sources[i] >= numNodes || targets[i] >= numNodes)
+			return false;
+	}
+
+	nodeNames.clear();
+	if (header.numNamedNodes != 0)
+		nodeNames.assign(header.numNamedNodes, nameOffsets, nameData);
+	nodeNames.setDefaultName("", header.defaultNameIndexOffset);
+	if (nodeIds != 0)
+		nodeNames.setDefaultIds(std::vector<uint64_t>(nodeIds, nodeIds + header.numNodeIds));
+	nodeNames.resize(numNodes);
+
+	flowNetwork.assign(numNodes, nodeFlow, teleportRates, numLinks, sources, targets, weights, flows);
+	numBipartiteNodes = header.numBipartiteNodes;
+	return true;
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
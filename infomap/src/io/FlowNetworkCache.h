@@ -0,0 +1,127 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef FLOWNETWORKCACHE_H_
+#define FLOWNETWORKCACHE_H_
+
+#include <string>
+#include <stdint.h>
+#include "Config.h"
+#include "NodeNames.h"
+#include "../infomap/FlowNetwork.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * A cache of calculated flow networks, to skip parsing and flow calculation
+ * when running again on the same input with the same flow options.
+ *
+ * Each flow network is stored in its own file in the cache directory, named
+ * by a key hashed from the content of the input files and the options that
+ * affect the parsed network or its flow. The file layout follows the binary
+ * network format: a FlowCacheHeader followed by 8-byte aligned sections in
+ * the native byte order.
+ */
+namespace FlowCache
+{
+	const char MAGIC[8] = { 'I', 'N', 'F', 'O', 'M', 'A', 'P', 'F' };
+	const uint32_t VERSION = 2;
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+	const char* const FILE_EXTENSION = "bflow";
+
+	enum Section
+	{
+		NODE_NAME_OFFSETS, // uint64_t, numNamedNodes + 1 offsets into the name data
+		NODE_NAME_DATA, // char, all names concatenated
+		NODE_IDS, // uint64_t, numNodeIds external ids of nodes added by id
+		NODE_FLOW, // double, numNodes
+		NODE_TELEPORT_RATES, // double, numNodes
+		LINK_SOURCES, // uint32_t, numLinks
+		LINK_TARGETS, // uint32_t, numLinks
+		LINK_WEIGHTS, // double, numLinks
+		LINK_FLOWS, // double, numLinks
+		NUM_SECTIONS
+	};
+}
+
+struct FlowCacheHeader
+{
+	FlowCacheHeader();
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrderMark;
+	uint64_t key;
+	uint32_t numNodes;
+	uint32_t numNamedNodes;
+	uint32_t numNodeIds;
+	uint32_t numBipartiteNodes;
+	uint32_t defaultNameIndexOffset;
+	uint32_t reserved;
+	uint64_t numLinks;
+	uint64_t payloadHash; // Hash of the section data, to detect corrupt files
+
+	// Byte offset and size of each section, zero size if omitted
+	uint64_t sectionOffset[FlowCache::NUM_SECTIONS];
+	uint64_t sectionSize[FlowCache::NUM_SECTIONS];
+};
+
+/**
+ * The cache key for the input files and flow options in the config.
+ * @throws FileOpenError if an input file can't be opened
+ */
+uint64_t flowCacheKey(const Config& config);
+
+/**
+ * The cache file for a key in the flow cache directory of the config.
+ */
+std::string flowCacheFilename(const Config& config, uint64_t key);
+
+/**
+ * Write a flow network with its node names to a cache file. The file is
+ * written under a temporary name and then renamed, so that concurrent runs
+ * never read a partial file.
+ * @throws FileOpenError on write errors
+ */
+void writeFlowCache(const std::string& filename, uint64_t key, const FlowNetwork& flowNetwork,
+		const NodeNames& nodeNames, unsigned int numBipartiteNodes);
+
+/**
+ * Read a flow network with its node names from a memory mapped cache file.
+ * @return false if there is no valid cache file for the key, or if its content is corrupt
+ */
+bool readFlowCache(const std::string& filename, uint64_t key, FlowNetwork& flowNetwork,
+		NodeNames& nodeNames, unsigned int& numBipartiteNodes);
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* FLOWNETWORKCACHE_H_ */
@@ -29,6 +29,7 @@
 #include <map>
 #include <stdexcept>
 #include "convert.h"
+#include "version.h"
 #include "../utils/Logger.h"
 
 #ifdef NS_INFOMAP
@@ -71,21 +72,19 @@ SNode& HierarchicalNetwork::addNode(SNode& parent, double flow, double exitFlow)
 	return *n;
 }
 
-SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex)
+SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex)
 {
-	return addLeafNode(parent, flow, exitFlow, name, leafIndex, leafIndex);
+	return addLeafNode(parent, flow, exitFlow, leafIndex, leafIndex);
 }
 
-SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex, unsigned int originalIndex)
+SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex, unsigned int originalIndex)
 {
 	if (leafIndex > m_leafNodes.size())
 		throw std::range_error("In HierarchicalNetwork::addLeafNode(), leaf index out of range or missed calling prepare method.");
 	SNode& n = addNode(parent, flow, exitFlow);
-	n.data.name = name;
 	n.isLeaf = true;
 	n.originalLeafIndex = originalIndex;
 	m_leafNodes[leafIndex] = &n;
-	propagateNodeNameUpInHierarchy(n);
 	if (n.depth > m_maxDepth)
 		m_maxDepth = n.depth;
 	SNode* node = n.parentNode;
@@ -99,10 +98,10 @@ SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitF
 	return n;
 }
 
-SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex,
+SNode& HierarchicalNetwork::addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex,
 		unsigned int originalIndex, bool isMemoryNode, unsigned int stateIndex, unsigned int physIndex)
 {
-	SNode& n = addLeafNode(parent, flow, exitFlow, name, leafIndex, originalIndex);
+	SNode& n = addLeafNode(parent, flow, exitFlow, leafIndex, originalIndex);
 	n.isMemoryNode = isMemoryNode;
 	n.stateIndex = stateIndex;
 	n.physIndex = physIndex;
@@ -140,13 +139,23 @@ bool HierarchicalNetwork::addLeafEdge(unsigned int sourceLeafNodeIndex, unsigned
 	return createdNewEdge;
 }
 
-void HierarchicalNetwork::propagateNodeNameUpInHierarchy(SNode& node)
+std::string HierarchicalNetwork::nodeName(const SNode& node) const
 {
-	if (node.parentNode != 0 && node.parentIndex == 0)
-	{
-		node.parentNode->data.name = io::Str() << node.data.name << (node.isLeaf? ",." : ".");
-		propagateNodeNameUpInHierarchy(*node.parentNode);
-	}
+	if (!node.data.name.empty())
+		return node.data.name;
+	if (node.isLeaf)
+		return node.originalLeafIndex < m_leafNodeNames.size() ? m_leafNodeNames[node.originalLeafIndex] : "";
+	if (node.children.empty())
+		return "";
+	const SNode& firstChild = *node.children[0];
+	return nodeName(firstChild) + (firstChild.isLeaf? ",." : ".");
+}
+
+void HierarchicalNetwork::materializeNodeNames(SNode& node)
+{
+	for (unsigned int i = 0; i < node.children.size(); ++i)
+		materializeNodeNames(*node.children[i]);
+	node.data.name = nodeName(node);
 }
 
 void HierarchicalNetwork::writeStreamableTree(const std::string& fileName, bool writeEdges)
@@ -161,7 +170,8 @@ void HierarchicalNetwork::writeStreamableTree(const std::string& fileName, bool
 	out << m_directedEdges;
 	out << m_networkName;
 	out << m_numLeafNodes;
-	out << m_numLeafEdges;
+	// Stored as a 32-bit count in the streamable tree format, saturated if larger
+	out << static_cast<unsigned int>(std::min<link_index>(m_numLeafEdges, std::numeric_limits<unsigned int>::max()));
 	out << m_numNodesInTree;
 	out << m_maxDepth;
 	out << m_oneLevelCodelength;
@@ -179,6 +189,7 @@ void HierarchicalNetwork::writeStreamableTree(const std::string& fileName, bool
 
 	std::deque<SNode*> nodeList;
 	nodeList.push_back(&m_rootNode);
+	materializeNodeNames(m_rootNode);
 	m_rootNode.data.name = m_networkName;
 	unsigned int childPosition = out.size() + m_rootNode.serializationSize(writeEdges);
 	using namespace SerialTypes;
@@ -208,6 +219,7 @@ void HierarchicalNetwork::readStreamableTree(const std::string& fileName)
 	SafeBinaryInFile dataStream(fileName.c_str());
 	std::string magicTag;
 	unsigned int numNodesInTree;
+	unsigned int numLeafEdges;
 	dataStream >> magicTag;
 	if (magicTag != "Infomap")
 		throw FileFormatError("The first content of the file doesn't match the format.");
@@ -216,11 +228,12 @@ void HierarchicalNetwork::readStreamableTree(const std::string& fileName)
 		>> m_directedEdges
 		>> m_networkName
 		>> m_numLeafNodes
-		>> m_numLeafEdges
+		>> numLeafEdges
 		>> numNodesInTree
 		>> m_maxDepth
 		>> m_oneLevelCodelength
 		>> m_codelength;
+	m_numLeafEdges = numLeafEdges;
 
 	Log() << "\nMetadata:\n";
 	Log() << "  Infomap version: \"" << m_infomapVersion << "\"" << std::endl;
@@ -271,6 +284,8 @@ void HierarchicalNetwork::writeClu(const std::string& fileName, int moduleIndexD
 	out << "partitioned in " << m_config.elapsedTime() << " from codelength " <<
 		io::toPrecision(m_oneLevelCodelength, 9, true) << " in one level to codelength " <<
 		io::toPrecision(m_codelength, 9, true) << " in " << m_maxDepth << " levels.\n";
+	if (*INFOMAP_BUILD_OPTIONS)
+		out << "# Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 	if (m_config.printExpanded) {
 		if (m_config.isMultiplexNetwork())
 			out << "# layer node cluster flow:\n";
@@ -294,7 +309,7 @@ void HierarchicalNetwork::writeClu(const std::string& fileName, int moduleIndexD
 				if (m_config.printExpanded && node.isMemoryNode)
 					out << node.printState(indexOffset) << " " << it.moduleIndex() + 1 << " " << node.data.flow << "\n";
 				else
-					out << node.originalLeafIndex + indexOffset << " " << it.moduleIndex() + 1 << " " << node.data.flow << "\n";
+					out << m_leafNodeNames.id(node.originalLeafIndex, indexOffset) << " " << it.moduleIndex() + 1 << " " << node.data.flow << "\n";
 			}
 		}
 	}
@@ -344,7 +359,7 @@ void HierarchicalNetwork::writeMap(const std::string& fileName)
 		unsigned int moduleIndex = it.childIndex();
 		NodeMap& leafNodes = nodeMaps[moduleIndex];
 		SNode& biggestLeafNode = *(leafNodes.begin()->second); // Use the biggest leaf node under each super module to name the super module
-		out << (moduleIndex + 1) << " \"" << biggestLeafNode.data.name << ",...\" " << module.data.flow << " " << module.data.exitFlow << "\n";
+		out << (moduleIndex + 1) << " \"" << nodeName(biggestLeafNode) << ",...\" " << module.data.flow << " " << module.data.exitFlow << "\n";
 	}
 
 	out << "*Nodes " << numNodes << "\n";
@@ -356,7 +371,7 @@ void HierarchicalNetwork::writeMap(const std::string& fileName)
 		for (NodeMap::iterator it(leafNodes.begin()), itEnd(leafNodes.end());
 				it != itEnd; ++it, ++nodeNumber)
 		{
-			out << (moduleIndex + 1) << ":" << nodeNumber << " \"" << it->second->data.name << "\" " <<
+			out << (moduleIndex + 1) << ":" << nodeNumber << " \"" << nodeName(*it->second) << "\" " <<
 				it->first << "\n";
 		}
 	}
@@ -380,6 +395,8 @@ void HierarchicalNetwork::writeHumanReadableTree(const std::string& fileName, bo
 	out << "partitioned in " << m_config.elapsedTime() << " from codelength " <<
 		io::toPrecision(m_oneLevelCodelength, 9, true) << " in one level to codelength " <<
 		io::toPrecision(m_codelength, 9, true) << " in " << m_maxDepth << " levels.\n";
+	if (*INFOMAP_BUILD_OPTIONS)
+		out << "# Build options: " << INFOMAP_BUILD_OPTIONS << "\n";
 
 	if (m_config.printExpanded) {
 		if (m_config.isMultiplexNetwork())
@@ -394,7 +411,7 @@ void HierarchicalNetwork::writeHumanReadableTree(const std::string& fileName, bo
 	for (TreeIterator it(&m_rootNode, 2); !it.isEnd(); ++it) {
 		SNode &node = *it;
 		if (node.isLeafNode()) {
-			out << io::stringify(it.path(), ":", 1) << " " << node.data.flow << " \"" << node.data.name << "\" ";
+			out << io::stringify(it.path(), ":", 1) << " " << node.data.flow << " \"" << nodeName(node) << "\" ";
 			if (m_config.isBipartite()) {
 				if (node.originalLeafIndex < m_config.minBipartiteNodeIndex)
 					out << 'n' << node.originalLeafIndex + indexOffset;
@@ -405,7 +422,7 @@ void HierarchicalNetwork::writeHumanReadableTree(const std::string& fileName, bo
 				if (m_config.printExpanded && node.isMemoryNode)
 					out << node.printState(indexOffset);
 				else
-					out << node.originalLeafIndex + indexOffset;
+					out << m_leafNodeNames.id(node.originalLeafIndex, indexOffset);
 			}
 			out << "\n";
 		}
@@ -40,9 +40,11 @@
 #include <functional>   // std::greater
 #include <limits>
 #include "../utils/Logger.h"
+#include "../utils/types.h"
 
 #include "../io/Config.h"
 #include "SafeFile.h"
+#include "NodeNames.h"
 
 #ifdef NS_INFOMAP
 namespace infomap
@@ -836,13 +838,28 @@ public:
 
 	SNode& addNode(SNode& parent, double flow, double exitFlow);
 
-	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex);
-	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex, unsigned int originalIndex);
-	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, const std::string& name, unsigned int leafIndex,
+	/**
+	 * Add a leaf node, named by its original index in the leaf node names.
+	 */
+	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex);
+	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex, unsigned int originalIndex);
+	SNode& addLeafNode(SNode& parent, double flow, double exitFlow, unsigned int leafIndex,
 		unsigned int originalIndex, bool isMemoryNode, unsigned int stateIndex, unsigned int physIndex);
 
 	void prepareAddLeafNodes(unsigned int numLeafNodes);
 
+	/**
+	 * Set the names of the leaf nodes, indexed on their original index.
+	 */
+	void setLeafNodeNames(const NodeNames& names) { m_leafNodeNames = names; }
+
+	/**
+	 * The name of a node, from the leaf node names if not explicitly named.
+	 * Modules are named after their first child, followed by ',.' if a leaf
+	 * node and '.' otherwise.
+	 */
+	std::string nodeName(const SNode& node) const;
+
 	/**
 	 * Add flow-edges to the tree. This method can aggregate the edges between the leaf-nodes
 	 * up in the tree based on the edge aggregation policy.
@@ -852,8 +869,6 @@ public:
 	 */
 	bool addLeafEdge(unsigned int sourceLeafNodeIndex, unsigned int targetLeafNodeIndex, double flow);
 
-	void propagateNodeNameUpInHierarchy(SNode& node);
-
 
 	/**
 	 * Print the network using a breadth-first algorithm. Each node keeps a pointer
@@ -912,7 +927,7 @@ public:
 	void writeMap(const std::string& fileName);
 
 	unsigned int numLeafNodes() { return m_numLeafNodes; }
-	unsigned int numLeafEdges() { return m_numLeafEdges; }
+	link_index numLeafEdges() { return m_numLeafEdges; }
 	unsigned int numNodesInTree() { return m_numNodesInTree; }
 	unsigned int maxDepth() { return m_maxDepth; }
 	double codelength() { return m_codelength; }
@@ -922,6 +937,11 @@ private:
 
 	void markNodesToSkip();
 
+	/**
+	 * Store the name of all nodes in the sub-tree, to be serialized.
+	 */
+	void materializeNodeNames(SNode& node);
+
 	void writeHumanReadableTreeRecursiveHelper(std::ostream& out, SNode& node, std::string prefix = "");
 	void writeHumanReadableTreeFlowLinksRecursiveHelper(std::ostream& out, SNode& node, std::string prefix = "");
 
@@ -938,9 +958,10 @@ private:
 	bool m_directedEdges;
 	SNode m_rootNode;
 	std::string m_networkName;
+	NodeNames m_leafNodeNames;
 	SNode::NodePtrList m_leafNodes;
 	unsigned int m_numLeafNodes;
-	unsigned int m_numLeafEdges;
+	link_index m_numLeafEdges;
 	unsigned int m_numNodesInTree;
 	unsigned int m_maxDepth;
 	double m_codelength;
@@ -0,0 +1,149 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "LineReader.h"
+#include "CompressedFile.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+namespace
+{
+	TextSource* openTextSource(const std::string& filename)
+	{
+		if (CompressedFile::detectCompression(filename) != CompressedFile::NONE)
+			return new CompressedFile(filename);
+		return new MappedFile(filename);
+	}
+}
+
+LineReader::LineReader(const std::string& filename)
+:	m_source(openTextSource(filename)),
+	m_pos(0),
+	m_end(0),
+	m_eof(false)
+{}
+
+LineReader::~LineReader()
+{
+	delete m_source;
+}
+
+bool LineReader::getline(std::string& line)
+{
+	line.clear();
+	if (!fill())
+	{
+		m_eof = true;
+		return false;
+	}
+	const char* lineEnd = static_cast<const char*>(std::memchr(m_pos, '\n', m_end - m_pos));
+	if (lineEnd == 0)
+	{
+		// Blocks end with a line break except the last one
+		line.assign(m_pos, m_end);
+		m_pos = m_end;
+		m_eof = true;
+		return true;
+	}
+	line.assign(m_pos, lineEnd);
+	m_pos = lineEnd + 1;
+	return true;
+}
+
+int LineReader::peek()
+{
+	if (!fill())
+	{
+		m_eof = true;
+		return EOF;
+	}
+	return static_cast<unsigned char>(*m_pos);
+}
+
+bool LineReader::skipSpace()
+{
+	while (fill())
+	{
+		if (io::skipSpace(m_pos, m_end))
+			return true;
+	}
+	m_eof = true;
+	return false;
+}
+
+bool LineReader::fill()
+{
+	while (m_pos == m_end)
+	{
+		if (!m_source->nextBlock(m_pos, m_end))
+		{
+			m_pos = m_end = 0;
+			return false;
+		}
+	}
+	return true;
+}
+
+const char* LineReader::nextLineStart(const char* pos, const char* end)
+{
+	if (pos >= end)
+		return end;
+	const char* lineEnd = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+	return lineEnd == 0 ? end : lineEnd + 1;
+}
+
+std::vector<const char*> LineReader::splitLines(const char* begin, const char* end)
+{
+	std::size_t size = end - begin;
+	std::size_t numChunks = 1;
+#ifdef _OPENMP
+	// Over-partition to balance the load between threads
+	numChunks = std::min(static_cast<std::size_t>(omp_get_max_threads()) * 4, size / MIN_CHUNK_SIZE);
+	if (numChunks == 0)
+		numChunks = 1;
+#endif
+	std::vector<const char*> chunks(1, begin);
+	for (std::size_t i = 1; i < numChunks; ++i)
+	{
+		const char* chunkBegin = nextLineStart(begin + i * (size / numChunks), end);
+		if (chunkBegin > chunks.back() && chunkBegin != end)
+			chunks.push_back(chunkBegin);
+	}
+	chunks.push_back(end);
+	return chunks;
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
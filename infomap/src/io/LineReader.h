@@ -0,0 +1,205 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef LINEREADER_H_
+#define LINEREADER_H_
+
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+#include "TextSource.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * Read lines of text from a file, as a replacement for std::getline on a
+ * file stream, with support to parse large sections of lines in parallel.
+ * Files compressed with gzip or zstd are decompressed on the fly.
+ *
+ * Lines are separated by '\n' and returned without it. A '\r' before the
+ * line break is kept, as with std::getline.
+ */
+class LineReader
+{
+public:
+	/**
+	 * @throws FileOpenError if the file can't be opened
+	 */
+	explicit LineReader(const std::string& filename);
+	virtual ~LineReader();
+
+	/**
+	 * Read the next line.
+	 * @return false if there are no more lines
+	 */
+	bool getline(std::string& line);
+
+	/**
+	 * @return the next character without consuming it, or EOF
+	 */
+	int peek();
+
+	/**
+	 * Skip whitespace including line breaks, as done by the stream extraction
+	 * operators before reading a value.
+	 * @return false if the end of the input was reached
+	 */
+	bool skipSpace();
+
+	/**
+	 * @return true if a read has reached the end of the input, like the
+	 * eofbit on a stream
+	 */
+	bool eof() const { return m_eof; }
+
+	/**
+	 * Parse the lines from the current position to the end of the input, or
+	 * until a header line starting with '*' if stopAtHeader is true.
+	 *
+	 * The lines are divided in chunks that are parsed in parallel by calling
+	 * parseLine(const char* begin, const char* end, Record& record) with the
+	 * range of each line. It should return false to skip the line and throw
+	 * on a parse error. The successfully parsed records are then handled by
+	 * calling handleRecord(const Record& record) in the order they appear in
+	 * the input. If a line fails to parse, the records before it are handled
+	 * and the exception is rethrown.
+	 *
+	 * @note parseLine must be safe to call concurrently.
+	 * @return The header line that ended the section, or an empty string at
+	 * the end of the input.
+	 */
+	template<typename Record, typename LineParser, typename RecordHandler>
+	std::string parseLines(LineParser parseLine, RecordHandler handleRecord, bool stopAtHeader = true);
+
+private:
+	LineReader(const LineReader&);
+	LineReader& operator=(const LineReader&);
+
+	/**
+	 * Make sure the current block has unread data.
+	 * @return false at the end of the input
+	 */
+	bool fill();
+
+	/**
+	 * @return the position after the first line break at or after pos, or end.
+	 */
+	static const char* nextLineStart(const char* pos, const char* end);
+
+	/**
+	 * Split the range at line boundaries in chunks of at least MIN_CHUNK_SIZE bytes.
+	 * @return The chunk boundaries, including begin and end
+	 */
+	static std::vector<const char*> splitLines(const char* begin, const char* end);
+
+	static const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+	static const std::size_t MAX_WINDOW_SIZE = 1 << 28;
+
+	TextSource* m_source;
+	const char* m_pos;
+	const char* m_end;
+	bool m_eof;
+};
+
+template<typename Record, typename LineParser, typename RecordHandler>
+std::string LineReader::parseLines(LineParser parseLine, RecordHandler handleRecord, bool stopAtHeader)
+{
+	while (fill())
+	{
+		// Parse a bounded window at a time to limit the memory of the parsed records
+		const char* windowEnd = static_cast<std::size_t>(m_end - m_pos) <= MAX_WINDOW_SIZE ?
+				m_end : nextLineStart(m_pos + MAX_WINDOW_SIZE, m_end);
+		std::vector<const char*> chunks = splitLines(m_pos, windowEnd);
+		int numChunks = static_cast<int>(chunks.size()) - 1;
+		std::vector<std::vector<Record> > records(numChunks);
+		std::vector<const char*> headers(numChunks, static_cast<const char*>(0));
+		std::vector<std::exception_ptr> errors(numChunks);
+
+#pragma omp parallel for schedule(dynamic) if(numChunks > 1)
+		for (int i = 0; i < numChunks; ++i)
+		{
+			const char* pos = chunks[i];
+			const char* chunkEnd = chunks[i + 1];
+			try
+			{
+				while (pos != chunkEnd)
+				{
+					if (stopAtHeader && *pos == '*')
+					{
+						headers[i] = pos;
+						break;
+					}
+					const char* lineEnd = static_cast<const char*>(std::memchr(pos, '\n', chunkEnd - pos));
+					if (lineEnd == 0)
+						lineEnd = chunkEnd;
+					Record record;
+					if (parseLine(pos, lineEnd, record))
+						records[i].push_back(record);
+					pos = lineEnd == chunkEnd ? chunkEnd : lineEnd + 1;
+				}
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+
+		for (int i = 0; i < numChunks; ++i)
+		{
+			for (typename std::vector<Record>::const_iterator it(records[i].begin()); it != records[i].end(); ++it)
+				handleRecord(*it);
+			std::vector<Record>().swap(records[i]);
+			if (errors[i])
+				std::rethrow_exception(errors[i]);
+			if (headers[i] != 0)
+			{
+				m_pos = headers[i];
+				std::string header;
+				getline(header);
+				return header;
+			}
+		}
+		m_pos = windowEnd;
+	}
+	m_eof = true;
+	return std::string();
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* LINEREADER_H_ */
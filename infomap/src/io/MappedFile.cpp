@@ -0,0 +1,119 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "MappedFile.h"
+#include "SafeFile.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+MappedFile::MappedFile(const std::string& filename)
+:	m_data(0),
+	m_size(0),
+	m_isMapped(false),
+	m_isRead(false)
+{
+#ifndef _WIN32
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw FileOpenError(io::Str() << "Error opening file '" << filename <<
+				"'. Check that the path points to a file and that you have read permissions.");
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode))
+	{
+		m_size = fileStat.st_size;
+		if (m_size == 0)
+		{
+			close(fd);
+			return;
+		}
+		void* mapping = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+		{
+#ifdef MADV_SEQUENTIAL
+			madvise(mapping, m_size, MADV_SEQUENTIAL);
+#endif
+			m_data = static_cast<const char*>(mapping);
+			m_isMapped = true;
+			close(fd);
+			return;
+		}
+	}
+	close(fd);
+#endif
+	readIntoBuffer(filename);
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (m_isMapped)
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+bool MappedFile::nextBlock(const char*& begin, const char*& end)
+{
+	if (m_isRead || m_size == 0)
+		return false;
+	m_isRead = true;
+	begin = m_data;
+	end = m_data + m_size;
+	return true;
+}
+
+void MappedFile::readIntoBuffer(const std::string& filename)
+{
+	std::FILE* file = std::fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		throw FileOpenError(io::Str() << "Error opening file '" << filename <<
+				"'. Check that the path points to a file and that you have read permissions.");
+	const std::size_t bufferSize = 1 << 20;
+	std::size_t numRead = 0;
+	do {
+		m_buffer.resize(m_buffer.size() + bufferSize);
+		numRead = std::fread(&m_buffer[m_buffer.size() - bufferSize], 1, bufferSize, file);
+		m_buffer.resize(m_buffer.size() - bufferSize + numRead);
+	} while (numRead == bufferSize);
+	std::fclose(file);
+	m_size = m_buffer.size();
+	m_data = m_buffer.empty() ? 0 : &m_buffer[0];
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
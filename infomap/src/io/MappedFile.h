@@ -0,0 +1,78 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "TextSource.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * A read-only view of a whole file in memory, mapped into the address space
+ * where supported so that the pages are loaded on demand by the operating
+ * system without copying. Falls back to reading the file into a buffer.
+ * The file is unmapped when the object goes out of scope.
+ */
+class MappedFile : public TextSource
+{
+public:
+	/**
+	 * @throws FileOpenError if the file can't be opened
+	 */
+	explicit MappedFile(const std::string& filename);
+	virtual ~MappedFile();
+
+	const char* data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+
+	/**
+	 * The whole file as a single block.
+	 */
+	virtual bool nextBlock(const char*& begin, const char*& end);
+
+private:
+	void readIntoBuffer(const std::string& filename);
+
+	const char* m_data;
+	std::size_t m_size;
+	bool m_isMapped;
+	bool m_isRead;
+	std::vector<char> m_buffer;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* MAPPEDFILE_H_ */
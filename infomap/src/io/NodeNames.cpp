@@ -0,0 +1,138 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#include "NodeNames.h"
+#include <cstdio>
+#include <utility>
+#include "convert.h"
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+std::string NodeNames::operator[](unsigned int index) const
+{
+	if (index >= numNamed())
+		return defaultName(index);
+	return std::string(m_data, m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+}
+
+void NodeNames::push_back(const char* begin, const char* end)
+{
+	materialize();
+	m_data.append(begin, end);
+	m_offsets.push_back(m_data.size());
+	++m_size;
+}
+
+void NodeNames::resize(unsigned int size)
+{
+	if (size < numNamed())
+	{
+		m_offsets.resize(size + 1);
+		m_data.resize(m_offsets.back());
+	}
+	m_size = size;
+}
+
+void NodeNames::setDefaultName(const std::string& prefix, unsigned int indexOffset)
+{
+	if (prefix == m_defaultPrefix && indexOffset == m_defaultIndexOffset)
+		return;
+	materialize();
+	m_defaultPrefix = prefix;
+	m_defaultIndexOffset = indexOffset;
+}
+
+void NodeNames::setDefaultIds(const std::vector<uint64_t>& ids)
+{
+	materialize();
+	m_ids = ids;
+}
+
+void NodeNames::assign(unsigned int numNames, const uint64_t* offsets, const char* data)
+{
+	for (unsigned int i = 0; i < numNames; ++i)
+		if (offsets[i] > offsets[i + 1])
+			throw FileFormatError("Corrupt node names, decreasing name offset.");
+	m_offsets.assign(offsets, offsets + numNames + 1);
+	// Rebase on the first offset to allow names from a larger block
+	for (unsigned int i = 0; i <= numNames; ++i)
+		m_offsets[i] -= offsets[0];
+	m_data.assign(data + offsets[0], data + offsets[numNames]);
+	m_size = numNames;
+}
+
+void NodeNames::materialize()
+{
+	for (unsigned int i = numNamed(); i < m_size; ++i)
+	{
+		m_data += defaultName(i);
+		m_offsets.push_back(m_data.size());
+	}
+}
+
+void NodeNames::reserve(unsigned int numNames, std::size_t numChars)
+{
+	m_offsets.reserve(numNames + 1);
+	m_data.reserve(numChars);
+}
+
+void NodeNames::clear()
+{
+	std::string().swap(m_data);
+	std::vector<uint64_t>(1, 0).swap(m_offsets);
+	std::vector<uint64_t>().swap(m_ids);
+	m_size = 0;
+}
+
+void NodeNames::swap(NodeNames& other)
+{
+	m_data.swap(other.m_data);
+	m_offsets.swap(other.m_offsets);
+	std::swap(m_size, other.m_size);
+	m_defaultPrefix.swap(other.m_defaultPrefix);
+	std::swap(m_defaultIndexOffset, other.m_defaultIndexOffset);
+	m_ids.swap(other.m_ids);
+}
+
+std::string NodeNames::defaultName(unsigned int index) const
+{
+	char number[24];
+	if (index < m_ids.size())
+	{
+		int length = snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(m_ids[index]));
+		return std::string(number, length);
+	}
+	int length = snprintf(number, sizeof(number), "%u", index + m_defaultIndexOffset);
+	return m_defaultPrefix + std::string(number, length);
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
@@ -0,0 +1,150 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef NODENAMES_H_
+#define NODENAMES_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * Node names indexed by node id, stored back to back in one contiguous string.
+ *
+ * Only explicitly named nodes use any storage. Nodes added with resize() are
+ * unnamed and get a default name, a prefix followed by the node number or
+ * the external node id if set, generated each time it is asked for.
+ */
+class NodeNames
+{
+public:
+	NodeNames() :
+		m_offsets(1, 0),
+		m_size(0),
+		m_defaultIndexOffset(1)
+	{}
+
+	/**
+	 * The number of nodes, named or unnamed.
+	 */
+	unsigned int size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	/**
+	 * The number of explicitly named nodes, which are always the first nodes.
+	 */
+	unsigned int numNamed() const { return static_cast<unsigned int>(m_offsets.size() - 1); }
+
+	/**
+	 * The name of a node, or the default name if unnamed.
+	 */
+	std::string operator[](unsigned int index) const;
+
+	/**
+	 * Append a named node. Any unnamed nodes before it get their default names stored.
+	 */
+	void push_back(const char* begin, const char* end);
+	void push_back(const std::string& name) { push_back(name.data(), name.data() + name.size()); }
+
+	/**
+	 * Truncate, or extend with unnamed nodes.
+	 */
+	void resize(unsigned int size);
+
+	/**
+	 * Set the default name of unnamed nodes to the prefix followed by the node
+	 * index plus indexOffset. Existing unnamed nodes keep their previous default name.
+	 */
+	void setDefaultName(const std::string& prefix, unsigned int indexOffset);
+
+	/**
+	 * Name unnamed nodes by their external id, the number the node had in the
+	 * input before it was remapped to its index. Existing unnamed nodes keep
+	 * their previous default name.
+	 */
+	void setDefaultIds(const std::vector<uint64_t>& ids);
+
+	/**
+	 * @return true if the nodes have external ids
+	 */
+	bool hasIds() const { return !m_ids.empty(); }
+	const std::vector<uint64_t>& ids() const { return m_ids; }
+
+	unsigned int defaultIndexOffset() const { return m_defaultIndexOffset; }
+
+	/**
+	 * The external id of a node, or the node index plus indexOffset if not set.
+	 */
+	uint64_t id(unsigned int index, unsigned int indexOffset) const
+	{
+		return index < m_ids.size() ? m_ids[index] : index + indexOffset;
+	}
+
+	/**
+	 * Replace all names with numNames names in the format of the raw data.
+	 * @throws FileFormatError if the offsets are not increasing
+	 */
+	void assign(unsigned int numNames, const uint64_t* offsets, const char* data);
+
+	/**
+	 * Store the default names of all unnamed nodes.
+	 */
+	void materialize();
+
+	void reserve(unsigned int numNames, std::size_t numChars = 0);
+
+	/**
+	 * The raw data of the numNamed() + 1 offsets into the concatenated names.
+	 */
+	const uint64_t* offsets() const { return &m_offsets[0]; }
+	const char* data() const { return m_data.data(); }
+
+	void clear();
+	void swap(NodeNames& other);
+
+private:
+	std::string defaultName(unsigned int index) const;
+
+	std::string m_data;
+	std::vector<uint64_t> m_offsets;
+	unsigned int m_size;
+	std::string m_defaultPrefix;
+	unsigned int m_defaultIndexOffset;
+	std::vector<uint64_t> m_ids;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* NODENAMES_H_ */
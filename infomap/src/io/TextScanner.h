@@ -0,0 +1,277 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef TEXTSCANNER_H_
+#define TEXTSCANNER_H_
+
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <stdint.h>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * Scanners for numbers and words in a character range, replacing the
+ * istream extraction operators when parsing input data.
+ *
+ * Each scanner skips leading whitespace, extracts the value and advances
+ * the position past it, with the same result as the corresponding
+ * extraction from a std::istringstream. On failure the value is set as
+ * the stream would have done it: unchanged if only whitespace remains,
+ * the closest limit on overflow, and otherwise zero.
+ */
+namespace io
+{
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	inline bool isDigit(char c)
+	{
+		return static_cast<unsigned int>(c - '0') < 10;
+	}
+
+	/**
+	 * @return true if any non-whitespace character remains
+	 */
+	inline bool skipSpace(const char*& pos, const char* end)
+	{
+		while (pos != end && isSpace(*pos))
+			++pos;
+		return pos != end;
+	}
+
+	inline bool scanWord(const char*& pos, const char* end, std::string& word)
+	{
+		if (!skipSpace(pos, end))
+			return false;
+		const char* begin = pos;
+		while (pos != end && !isSpace(*pos))
+			++pos;
+		word.assign(begin, pos);
+		return true;
+	}
+
+	/**
+	 * Scan an optional sign followed by decimal digits.
+	 * @param magnitude Set to the absolute value, saturated at the limit
+	 * @return false if no digits
+	 */
+	inline bool scanSignedMagnitude(const char*& pos, const char* end, unsigned long long limit,
+			bool& negative, unsigned long long& magnitude, bool& overflow)
+	{
+		negative = false;
+		if (*pos == '+' || *pos == '-')
+			negative = *pos++ == '-';
+		const char* digitsBegin = pos;
+		magnitude = 0;
+		overflow = false;
+		for (; pos != end && isDigit(*pos); ++pos)
+		{
+			if (overflow)
+				continue;
+			magnitude = magnitude * 10 + (*pos - '0');
+			overflow = magnitude > limit;
+		}
+		return pos != digitsBegin;
+	}
+
+	inline bool scanUnsigned(const char*& pos, const char* end, unsigned int& value)
+	{
+		if (!skipSpace(pos, end))
+			return false;
+		bool negative, overflow;
+		unsigned long long magnitude;
+		if (!scanSignedMagnitude(pos, end, std::numeric_limits<unsigned int>::max(), negative, magnitude, overflow))
+		{
+			value = 0;
+			return false;
+		}
+		if (overflow)
+		{
+			value = std::numeric_limits<unsigned int>::max();
+			return false;
+		}
+		value = static_cast<unsigned int>(magnitude);
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	/**
+	 * Scan a 64-bit unsigned number, such as an external node id.
+	 */
+	inline bool scanUnsigned(const char*& pos, const char* end, uint64_t& value)
+	{
+		if (!skipSpace(pos, end))
+			return false;
+		bool negative = false;
+		if (*pos == '+' || *pos == '-')
+			negative = *pos++ == '-';
+		const char* digitsBegin = pos;
+		const uint64_t maxValue = std::numeric_limits<uint64_t>::max();
+		bool overflow = false;
+		value = 0;
+		for (; pos != end && isDigit(*pos); ++pos)
+		{
+			unsigned int digit = *pos - '0';
+			overflow = overflow || value > (maxValue - digit) / 10;
+			if (!overflow)
+				value = value * 10 + digit;
+		}
+		if (pos == digitsBegin)
+		{
+			value = 0;
+			return false;
+		}
+		if (overflow)
+		{
+			value = maxValue;
+			return false;
+		}
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	inline bool scanInt(const char*& pos, const char* end, int& value)
+	{
+		if (!skipSpace(pos, end))
+			return false;
+		bool negative, overflow;
+		unsigned long long magnitude;
+		if (!scanSignedMagnitude(pos, end, std::numeric_limits<int>::max() + 1ULL, negative, magnitude, overflow))
+		{
+			value = 0;
+			return false;
+		}
+		if (overflow || (!negative && magnitude > static_cast<unsigned long long>(std::numeric_limits<int>::max())))
+		{
+			value = negative ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max();
+			return false;
+		}
+		value = negative ? static_cast<int>(-static_cast<long long>(magnitude)) : static_cast<int>(magnitude);
+		return true;
+	}
+
+	/**
+	 * Scan a decimal floating point number. Numbers with at most 19
+	 * significant digits and a decimal exponent within the range of exactly
+	 * representable powers of ten are computed directly, which is correctly
+	 * rounded as both operands are exact. Other numbers are delegated to
+	 * strtod, so the result is always identical to the stream extraction.
+	 */
+	inline bool scanDouble(const char*& pos, const char* end, double& value)
+	{
+		static const double exactPowersOfTen[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		if (!skipSpace(pos, end))
+			return false;
+		const char* begin = pos;
+		bool negative = false;
+		if (*pos == '+' || *pos == '-')
+			negative = *pos++ == '-';
+
+		unsigned long long mantissa = 0;
+		unsigned int numSignificantDigits = 0;
+		unsigned int numDigits = 0;
+		int exponent = 0;
+		for (; pos != end && isDigit(*pos); ++pos, ++numDigits)
+		{
+			if (numSignificantDigits < 19)
+				mantissa = mantissa * 10 + (*pos - '0');
+			else
+				++exponent;
+			if (mantissa != 0)
+				++numSignificantDigits;
+		}
+		if (pos != end && *pos == '.')
+		{
+			for (++pos; pos != end && isDigit(*pos); ++pos, ++numDigits)
+			{
+				if (numSignificantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*pos - '0');
+					--exponent;
+				}
+				if (mantissa != 0)
+					++numSignificantDigits;
+			}
+		}
+		bool valid = numDigits > 0;
+		if (pos != end && (*pos == 'e' || *pos == 'E'))
+		{
+			++pos;
+			bool negativeExponent = false;
+			if (pos != end && (*pos == '+' || *pos == '-'))
+				negativeExponent = *pos++ == '-';
+			int decimalExponent = 0;
+			const char* exponentBegin = pos;
+			for (; pos != end && isDigit(*pos); ++pos)
+				if (decimalExponent < 100000)
+					decimalExponent = decimalExponent * 10 + (*pos - '0');
+			valid = valid && pos != exponentBegin;
+			exponent += negativeExponent ? -decimalExponent : decimalExponent;
+		}
+		if (!valid)
+		{
+			value = 0.0;
+			return false;
+		}
+
+		if (mantissa == 0)
+			value = 0.0;
+		else if (numSignificantDigits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+			value = exponent < 0 ? mantissa / exactPowersOfTen[-exponent] : mantissa * exactPowersOfTen[exponent];
+		else
+		{
+			value = std::strtod(std::string(begin, pos).c_str(), 0);
+			if (value == std::numeric_limits<double>::infinity() || value == -std::numeric_limits<double>::infinity())
+			{
+				value = value > 0 ? std::numeric_limits<double>::max() : -std::numeric_limits<double>::max();
+				return false;
+			}
+			return true;
+		}
+		if (negative)
+			value = -value;
+		return true;
+	}
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* TEXTSCANNER_H_ */
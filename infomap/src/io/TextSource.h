@@ -0,0 +1,62 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+ 
+ For more information, see <http://www.mapequation.org>
+ 
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+#ifndef TEXTSOURCE_H_
+#define TEXTSOURCE_H_
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * A source of text delivered in consecutive blocks of memory.
+ */
+class TextSource
+{
+public:
+	TextSource() {}
+	virtual ~TextSource() {}
+
+	/**
+	 * Get the next block of text. Each block ends with a line break, except
+	 * possibly the last one, so that no line spans two blocks.
+	 * The block is valid until the next call.
+	 * @return false when there is no more text
+	 */
+	virtual bool nextBlock(const char*& begin, const char*& end) = 0;
+
+private:
+	TextSource(const TextSource&);
+	TextSource& operator=(const TextSource&);
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* TEXTSOURCE_H_ */
@@ -34,6 +34,28 @@ namespace infomap
 
 const char* INFOMAP_VERSION = "0.18.23";
 
+#ifdef INFOMAP_64BIT_INDEX
+#define INFOMAP_OPTION_64BIT_INDEX ", 64-bit link index"
+#else
+#define INFOMAP_OPTION_64BIT_INDEX ""
+#endif
+
+#ifdef INFOMAP_COMPACT_EDGES
+#define INFOMAP_OPTION_COMPACT_EDGES ", compact edges"
+#else
+#define INFOMAP_OPTION_COMPACT_EDGES ""
+#endif
+
+#ifdef INFOMAP_FAST_LOG
+#define INFOMAP_OPTION_FAST_LOG ", fast log"
+#else
+#define INFOMAP_OPTION_FAST_LOG ""
+#endif
+
+// Each option is prefixed with a separator, skipped for the first one
+static const char BUILD_OPTIONS[] = INFOMAP_OPTION_64BIT_INDEX INFOMAP_OPTION_COMPACT_EDGES INFOMAP_OPTION_FAST_LOG;
+const char* INFOMAP_BUILD_OPTIONS = BUILD_OPTIONS + (sizeof(BUILD_OPTIONS) > 1 ? 2 : 0);
+
 #ifdef NS_INFOMAP
 }
 #endif
@@ -35,6 +35,12 @@ namespace infomap
 
 extern const char* INFOMAP_VERSION;
 
+/**
+ * The build options that change the storage or precision of the results,
+ * such as "compact edges", or empty for the default build.
+ */
+extern const char* INFOMAP_BUILD_OPTIONS;
+
 #ifdef NS_INFOMAP
 }
 #endif
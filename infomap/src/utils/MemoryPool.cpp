@@ -0,0 +1,112 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+
+#include "MemoryPool.h"
+#include <new>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+MemoryPool::MemoryPool()
+:	m_chunkBegin(0),
+	m_chunkEnd(0),
+	m_nextChunkSize(MIN_CHUNK_SIZE),
+	m_numAllocated(0),
+	m_released(false)
+{
+	for (std::size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+		m_freeBlocks[i] = 0;
+}
+
+MemoryPool::~MemoryPool()
+{
+	for (std::size_t i = 0; i < m_chunks.size(); ++i)
+		::operator delete(m_chunks[i]);
+}
+
+void* MemoryPool::allocate(std::size_t size)
+{
+	std::size_t sizeClass = sizeClassOf(size);
+	if (sizeClass > NUM_SIZE_CLASSES)
+		return ::operator new(size);
+
+	++m_numAllocated;
+	FreeBlock*& freeBlock = m_freeBlocks[sizeClass - 1];
+	if (freeBlock != 0)
+	{
+		void* block = freeBlock;
+		freeBlock = freeBlock->next;
+		return block;
+	}
+
+	std::size_t blockSize = sizeClass * BLOCK_ALIGNMENT;
+	if (static_cast<std::size_t>(m_chunkEnd - m_chunkBegin) < blockSize)
+	{
+		// The rest of the current chunk is left unused
+		m_chunks.push_back(static_cast<char*>(::operator new(m_nextChunkSize)));
+		m_chunkBegin = m_chunks.back();
+		m_chunkEnd = m_chunkBegin + m_nextChunkSize;
+		if (m_nextChunkSize < MAX_CHUNK_SIZE)
+			m_nextChunkSize *= 2;
+	}
+	void* block = m_chunkBegin;
+	m_chunkBegin += blockSize;
+	return block;
+}
+
+void MemoryPool::deallocate(void* block, std::size_t size)
+{
+	if (block == 0)
+		return;
+	std::size_t sizeClass = sizeClassOf(size);
+	if (sizeClass > NUM_SIZE_CLASSES)
+	{
+		::operator delete(block);
+		return;
+	}
+
+	FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+	freeBlock->next = m_freeBlocks[sizeClass - 1];
+	m_freeBlocks[sizeClass - 1] = freeBlock;
+
+	if (--m_numAllocated == 0 && m_released)
+		delete this;
+}
+
+void MemoryPool::release()
+{
+	m_released = true;
+	if (m_numAllocated == 0)
+		delete this;
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
@@ -0,0 +1,107 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+
+#ifndef MEMORYPOOL_H_
+#define MEMORYPOOL_H_
+#include <cstddef>
+#include <vector>
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+/**
+ * A pool of small memory blocks for the nodes and edges of one tree.
+ *
+ * Blocks are carved from chunks that grow geometrically, so that small trees
+ * of sub-Infomap instances stay small, and freed blocks are reused through a
+ * free list per block size. All chunks are released together with the pool.
+ *
+ * The pool is not thread-safe, a tree is only modified by one thread at a time.
+ */
+class MemoryPool
+{
+public:
+	MemoryPool();
+
+	/**
+	 * Allocate a block of at least size bytes, aligned to BLOCK_ALIGNMENT.
+	 * Blocks larger than MAX_BLOCK_SIZE are allocated on the heap.
+	 */
+	void* allocate(std::size_t size);
+
+	/**
+	 * Return a block allocated with the same size to the pool.
+	 */
+	void deallocate(void* block, std::size_t size);
+
+	/**
+	 * Release the pool and all its chunks. If some blocks are still in use,
+	 * the release is deferred until the last one is deallocated.
+	 */
+	void release();
+
+	std::size_t numAllocated() const { return m_numAllocated; }
+
+	static const std::size_t BLOCK_ALIGNMENT = 8;
+	static const std::size_t MAX_BLOCK_SIZE = 256;
+
+private:
+	~MemoryPool();
+	MemoryPool(const MemoryPool&);
+	MemoryPool& operator=(const MemoryPool&);
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	static std::size_t sizeClassOf(std::size_t size)
+	{
+		return size == 0 ? 1 : (size + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT;
+	}
+
+	static const std::size_t NUM_SIZE_CLASSES = MAX_BLOCK_SIZE / BLOCK_ALIGNMENT;
+	static const std::size_t MIN_CHUNK_SIZE = 1 << 10;
+	static const std::size_t MAX_CHUNK_SIZE = 1 << 16;
+
+	FreeBlock* m_freeBlocks[NUM_SIZE_CLASSES];
+	std::vector<char*> m_chunks;
+	char* m_chunkBegin;
+	char* m_chunkEnd;
+	std::size_t m_nextChunkSize;
+	std::size_t m_numAllocated;
+	bool m_released;
+};
+
+#ifdef NS_INFOMAP
+}
+#endif
+
+#endif /* MEMORYPOOL_H_ */
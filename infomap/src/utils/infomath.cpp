@@ -0,0 +1,196 @@
+/**********************************************************************************
+
+ Infomap software package for multi-level network clustering
+
+ Copyright (c) 2013, 2014 Daniel Edler, Martin Rosvall
+
+ For more information, see <http://www.mapequation.org>
+
+
+ This file is part of Infomap software package.
+
+ Infomap software package is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Infomap software package is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Infomap software package.  If not, see <http://www.gnu.org/licenses/>.
+
+**********************************************************************************/
+
+
+
+
+#include "infomath.h"
+
+#if defined(INFOMAP_FAST_LOG) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INFOMAP_FAST_LOG_SIMD
+#include <immintrin.h>
+// AVX-512 implies FMA, which GCC would otherwise fuse the multiplications and additions with
+#ifdef __clang__
+#define NO_FP_CONTRACT
+#else
+#define NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#endif
+#endif
+
+#ifdef NS_INFOMAP
+namespace infomap
+{
+#endif
+
+namespace infomath
+{
+	namespace
+	{
+		struct Log2Table
+		{
+			Log2Table()
+			{
+				unsigned int size = 1u << LOG2_TABLE_BITS;
+				for (unsigned int i = 0; i < size; ++i)
+				{
+					double center = 1.0 + (i + 0.5) / size;
+					entries[i].inverse = 1.0 / center;
+					entries[i].log2 = log2(center);
+				}
+			}
+			Log2TableEntry entries[1u << LOG2_TABLE_BITS];
+		};
+
+		const Log2Table table;
+	}
+
+	const Log2TableEntry* const log2Table = table.entries;
+
+#ifdef INFOMAP_FAST_LOG_SIMD
+	namespace
+	{
+		/**
+		 * The operations of plogpFast in the same order on four values at a time,
+		 * without fused multiply-add, to give identical results.
+		 */
+		__attribute__((target("avx2")))
+		void plogpAvx2(const double* p, double* result, unsigned int n)
+		{
+			const double* tableInverse = &log2Table[0].inverse;
+			const double* tableLog2 = &log2Table[0].log2;
+			const __m256i mantissaMask = _mm256_set1_epi64x(0x000fffffffffffffLL);
+			const __m256i one = _mm256_set1_epi64x(0x3ff0000000000000LL);
+			const __m256i tableMask = _mm256_set1_epi64x((1 << LOG2_TABLE_BITS) - 1);
+			const __m256i exponentMagic = _mm256_set1_epi64x(0x4330000000000000LL);
+			const __m256d exponentOffset = _mm256_set1_pd(4503599627370496.0 + 1023.0);
+			const double LOG2_E = 1.4426950408889634;
+			unsigned int i = 0;
+			for (; i + 4 <= n; i += 4)
+			{
+				__m256d x = _mm256_loadu_pd(p + i);
+				__m256i bits = _mm256_castpd_si256(x);
+				// The biased exponent as the low bits of 2^52, to convert it to double exactly
+				__m256d exponent = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), exponentMagic)), exponentOffset);
+				__m256i index = _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(bits, 52 - LOG2_TABLE_BITS), tableMask), 1);
+				__m256d inverse = _mm256_i64gather_pd(tableInverse, index, 8);
+				__m256d log2Center = _mm256_i64gather_pd(tableLog2, index, 8);
+				__m256d mantissa = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), one));
+				__m256d r = _mm256_sub_pd(_mm256_mul_pd(mantissa, inverse), _mm256_set1_pd(1.0));
+				__m256d r2 = _mm256_mul_pd(r, r);
+				__m256d low = _mm256_mul_pd(r, _mm256_sub_pd(_mm256_set1_pd(LOG2_E), _mm256_mul_pd(r, _mm256_set1_pd(LOG2_E / 2))));
+				__m256d high = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(LOG2_E / 3), _mm256_mul_pd(r, _mm256_set1_pd(LOG2_E / 4))),
+						_mm256_mul_pd(r2, _mm256_sub_pd(_mm256_set1_pd(LOG2_E / 5), _mm256_mul_pd(r, _mm256_set1_pd(LOG2_E / 6)))));
+				__m256d log2OnePlusR = _mm256_add_pd(low, _mm256_mul_pd(_mm256_mul_pd(r2, r), high));
+				__m256d plogp = _mm256_mul_pd(x, _mm256_add_pd(_mm256_add_pd(exponent, log2Center), log2OnePlusR));
+				__m256d positive = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+				_mm256_storeu_pd(result + i, _mm256_and_pd(positive, plogp));
+			}
+			for (; i < n; ++i)
+				result[i] = plogpFast(p[i]);
+		}
+
+		/**
+		 * As plogpAvx2, on eight values at a time.
+		 */
+#if !defined(__clang__)
+#pragma GCC diagnostic push
+// False positives on the undefined source of the unmasked intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+		__attribute__((target("avx512f"))) NO_FP_CONTRACT
+		void plogpAvx512(const double* p, double* result, unsigned int n)
+		{
+			const double* tableInverse = &log2Table[0].inverse;
+			const double* tableLog2 = &log2Table[0].log2;
+			const __m512i mantissaMask = _mm512_set1_epi64(0x000fffffffffffffLL);
+			const __m512i one = _mm512_set1_epi64(0x3ff0000000000000LL);
+			const __m512i tableMask = _mm512_set1_epi64((1 << LOG2_TABLE_BITS) - 1);
+			const __m512i exponentMagic = _mm512_set1_epi64(0x4330000000000000LL);
+			const __m512d exponentOffset = _mm512_set1_pd(4503599627370496.0 + 1023.0);
+			const double LOG2_E = 1.4426950408889634;
+			unsigned int i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m512d x = _mm512_loadu_pd(p + i);
+				__m512i bits = _mm512_castpd_si512(x);
+				__m512d exponent = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(bits, 52), exponentMagic)), exponentOffset);
+				__m512i index = _mm512_slli_epi64(_mm512_and_si512(_mm512_srli_epi64(bits, 52 - LOG2_TABLE_BITS), tableMask), 1);
+				__m512d inverse = _mm512_i64gather_pd(index, tableInverse, 8);
+				__m512d log2Center = _mm512_i64gather_pd(index, tableLog2, 8);
+				__m512d mantissa = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, mantissaMask), one));
+				__m512d r = _mm512_sub_pd(_mm512_mul_pd(mantissa, inverse), _mm512_set1_pd(1.0));
+				__m512d r2 = _mm512_mul_pd(r, r);
+				__m512d low = _mm512_mul_pd(r, _mm512_sub_pd(_mm512_set1_pd(LOG2_E), _mm512_mul_pd(r, _mm512_set1_pd(LOG2_E / 2))));
+				__m512d high = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(LOG2_E / 3), _mm512_mul_pd(r, _mm512_set1_pd(LOG2_E / 4))),
+						_mm512_mul_pd(r2, _mm512_sub_pd(_mm512_set1_pd(LOG2_E / 5), _mm512_mul_pd(r, _mm512_set1_pd(LOG2_E / 6)))));
+				__m512d log2OnePlusR = _mm512_add_pd(low, _mm512_mul_pd(_mm512_mul_pd(r2, r), high));
+				__m512d plogp = _mm512_mul_pd(x, _mm512_add_pd(_mm512_add_pd(exponent, log2Center), log2OnePlusR));
+				__mmask8 positive = _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_GT_OQ);
+				_mm512_storeu_pd(result + i, _mm512_maskz_mov_pd(positive, plogp));
+			}
+			for (; i < n; ++i)
+				result[i] = plogpFast(p[i]);
+		}
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+	}
+#endif
+
+	namespace
+	{
+		void plogpScalar(const double* p, double* result, unsigned int n)
+		{
+			for (unsigned int i = 0; i < n; ++i)
+				result[i] = plogp(p[i]);
+		}
+
+		typedef void (*PlogpBatchFunction)(const double*, double*, unsigned int);
+
+		PlogpBatchFunction selectPlogpBatch()
+		{
+#ifdef INFOMAP_FAST_LOG_SIMD
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f"))
+				return plogpAvx512;
+			if (__builtin_cpu_supports("avx2"))
+				return plogpAvx2;
+#endif
+			return plogpScalar;
+		}
+
+	}
+
+	void plogp(const double* p, double* result, unsigned int n)
+	{
+		static const PlogpBatchFunction plogpBatch = selectPlogpBatch();
+		plogpBatch(p, result, n);
+	}
+}
+
+#ifdef NS_INFOMAP
+}
+#endif
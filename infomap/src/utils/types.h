@@ -28,6 +28,8 @@
 #ifndef TYPES_H_
 #define TYPES_H_
 
+#include <stdint.h>
+
 #ifdef NS_INFOMAP
 namespace infomap
 {
@@ -37,6 +39,30 @@ typedef unsigned int uint;
 typedef float number;
 //typedef double number;
 
+/**
+ * Index type for links, used for link counts and offsets into the links.
+ * 32-bit by default to keep the link arrays dense, or 64-bit if built with
+ * INFOMAP_64BIT_INDEX for networks with more than 2^32 - 1 links. Node
+ * indices are always 32-bit, as the memory of that many nodes is the limit.
+ */
+#ifdef INFOMAP_64BIT_INDEX
+typedef uint64_t link_index;
+#else
+typedef uint32_t link_index;
+#endif
+
+/**
+ * Storage type for the flow on the edges of the tree, double by default or
+ * single-precision if built with INFOMAP_COMPACT_EDGES to fit larger
+ * networks in memory. The flow of nodes and modules and all codelength sums
+ * are always double.
+ */
+#ifdef INFOMAP_COMPACT_EDGES
+typedef float edge_flow;
+#else
+typedef double edge_flow;
+#endif
+
 #ifdef NS_INFOMAP
 }
 #endif
@@ -37,13 +37,17 @@
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <igraph.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
 #include <sys/time.h>
 
 #include <Eigen/Core>
 #include "../infomap/src/Infomap.h"
-#include "../infomap/src/Infomap-igraph-interface.h"
-#include "Graph.h"
 
 #ifdef __linux__
 #include <mex.h>
@@ -82,7 +86,7 @@ static const char *error_strings[] =
     "Not enough input arguments.",
     "Non valid argument value.",
     "Non valid argument type.",
-    "Non valid input adjacency matrix. PACO accepts symmetric real dense-type (n x n) matrices or sparse edges-list representation \
+    "Non valid input adjacency matrix. PACO accepts symmetric real dense-type or sparse-type (n x n) matrices or sparse edges-list representation \
     [num_edges x 3] array of edges list with edge endpoints and weight.",
     "Expected some argument value but empty found.",
     "Unkwown argument."
@@ -94,6 +98,10 @@ struct InfomapParams
     //int rand_seed; // random seed for the louvain algorithm
     //int verbosity_level;
     std::string options;
+    // Sparsification of dense input, a link must pass all three filters
+    double threshold = 0.0; // Keep only links with weight above this value
+    int topk = 0; // Keep only links among the k strongest of either endpoint, 0 for all
+    double density = 0.0; // Keep only the strongest links, as a fraction of all node pairs, 0 for all
 };
 
 error_type parse_args(int nOutputArgs, mxArray *outputArgs[], int nInputArgs, const mxArray * inputArgs[], InfomapParams *pars, int *argposerr )
@@ -116,7 +124,7 @@ error_type parse_args(int nOutputArgs, mxArray *outputArgs[], int nInputArgs, co
     int N = mxGetN(W);
     // In this case we are feeding instead of the adjacency matrix, the result of [i j w]=find(A);
     bool feedingSparseMatrix=false;
-    if (N==3 && M>3)
+    if (N==3 && M>3 && !mxIsSparse(W))
     {
         feedingSparseMatrix=true;
     }
@@ -205,6 +213,37 @@ error_type parse_args(int nOutputArgs, mxArray *outputArgs[], int nInputArgs, co
                 }
                 argcount += 2;
             }
+            else if ( strcasecmp(cpartype,"threshold")==0 ) // Dense input only: Keep only links with weight above this value. (Default: 0)
+            {
+                pars->threshold = *mxGetPr(parval);
+                argcount += 2;
+            }
+            else if ( strcasecmp(cpartype,"topk")==0 ) // Dense input only: Keep only links among the k strongest of either endpoint. (Default: 0, all)
+            {
+                if (*mxGetPr(parval) <0 )
+                {
+                    *argposerr = argcount+1;
+                    return ERROR_ARG_VALUE;
+                }
+                else
+                {
+                    pars->topk = static_cast<int>(*mxGetPr(parval));
+                }
+                argcount += 2;
+            }
+            else if ( strcasecmp(cpartype,"density")==0 ) // Dense input only: Keep only the strongest links, as a fraction of all node pairs. (Default: 0, all)
+            {
+                if (*mxGetPr(parval) <0 || *mxGetPr(parval) > 1)
+                {
+                    *argposerr = argcount+1;
+                    return ERROR_ARG_VALUE;
+                }
+                else
+                {
+                    pars->density = *mxGetPr(parval);
+                }
+                argcount += 2;
+            }
             else if ( strcasecmp(cpartype,"markov-time")==0 ) // Scale link flow with this value to change the cost of moving between modules. Higher for less modules. (Default: 1)
             {
                 if (*mxGetPr(parval) <0 )
@@ -234,6 +273,294 @@ error_type parse_args(int nOutputArgs, mxArray *outputArgs[], int nInputArgs, co
     return NO_ERROR;
 }
 
+/**
+ * @brief sparse_to_infomap_network Read a native MATLAB sparse matrix directly into the network.
+ * The compressed columns are read as the rows of the network links, so a lower triangular or symmetric
+ * matrix, of which only the lower triangle is used, is taken over by the network without sorting.
+ * @param network
+ * @param W A square sparse matrix
+ */
+void sparse_to_infomap_network(infomap::Network &network, const mxArray *W)
+{
+    unsigned int n = static_cast<unsigned int>(mxGetN(W));
+    const mwIndex *jc = mxGetJc(W);
+    const mwIndex *ir = mxGetIr(W);
+    const double *pr = mxGetPr(W);
+
+    // Classify the non-zero entries in one pass over the columns
+    size_t num_upper = 0, num_lower = 0;
+    for (unsigned int col=0; col<n; ++col)
+    {
+        for (mwIndex k=jc[col]; k<jc[col+1]; ++k)
+        {
+            if (ir[k] == col)
+                throw std::logic_error("Adjacency matrix has self-loops, only simple graphs allowed");
+            if (pr[k] < 0)
+                throw std::logic_error("Negative edge weight found. Only positive weights supported.");
+            if (ir[k] < col)
+                ++num_upper;
+            else
+                ++num_lower;
+        }
+    }
+
+    bool isSymmetric = num_upper == num_lower;
+    bool isTriangular = num_upper == 0 || num_lower == 0;
+    if (!isSymmetric && !isTriangular)
+        throw std::logic_error("Matrix is not symmetric, nor triangular lower or upper triangular. Check diagonal and non symmetric values.");
+
+    // Keep the lower triangle of symmetric matrices, all entries of triangular ones
+    bool lower_only = !isTriangular || num_upper == 0;
+    size_t num_links = lower_only ? num_lower : num_upper;
+    std::vector<infomap::link_index> offsets(n + 1, 0);
+    std::vector<unsigned int> targets;
+    std::vector<double> weights;
+    targets.reserve(num_links);
+    weights.reserve(num_links);
+    for (unsigned int col=0; col<n; ++col)
+    {
+        for (mwIndex k=jc[col]; k<jc[col+1]; ++k)
+        {
+            if (lower_only && ir[k] < col)
+                continue;
+            targets.push_back(static_cast<unsigned int>(ir[k]));
+            weights.push_back(pr[k]);
+        }
+        offsets[col+1] = static_cast<infomap::link_index>(targets.size());
+    }
+
+    network.setLinks(n, offsets, targets, weights);
+    network.finalizeAndCheckNetwork(true, n);
+}
+
+/**
+ * @brief edges_list_to_infomap_network Read the [i j w] = find(A) edges list directly into the network.
+ * @param network
+ * @param IJW The column-major num_edges x 3 array of one-based edge endpoints and weights
+ * @param num_edges
+ */
+void edges_list_to_infomap_network(infomap::Network &network, const double *IJW, int num_edges)
+{
+    const double *I = IJW, *J = IJW + num_edges, *V = IJW + 2*num_edges;
+
+    // Condizione semplice da verificare facendo [i j w]=find(A), oppure [i j w]=find(triu(A)) oppure [i j w]=find(tril(A))
+    int sum1 = 0, sum2 = 0;
+    for (int l=0; l<num_edges; ++l)
+    {
+        if (I[l] >= J[l])
+            ++sum1;
+        else
+            ++sum2;
+    }
+    bool isSymmetric = sum1 == sum2;
+    bool isUpperTriangular = sum1 == 0 && sum2 == num_edges;
+    bool isLowerTriangular = sum1 == num_edges && sum2 == 0;
+    if (!isSymmetric && !isUpperTriangular && !isLowerTriangular)
+        throw std::logic_error("Matrix is not symmetric, nor triangular lower or upper triangular. Check diagonal and non symmetric values.");
+
+    std::vector<unsigned int> sources, targets;
+    std::vector<double> weights;
+    size_t num_links = (isUpperTriangular || isLowerTriangular) ? num_edges : sum2;
+    sources.reserve(num_links);
+    targets.reserve(num_links);
+    weights.reserve(num_links);
+    for (int l=0; l<num_edges; ++l)
+    {
+        // keeps only symmetric and also avoid self-loops (implicitly inserting upper triangular)
+        if (isUpperTriangular || isLowerTriangular || I[l] < J[l])
+        {
+            sources.push_back(static_cast<unsigned int>(J[l]-1));
+            targets.push_back(static_cast<unsigned int>(I[l]-1));
+            weights.push_back(V[l]);
+        }
+    }
+
+    network.addLinks(sources.data(), targets.data(), weights.data(), sources.size());
+    network.finalizeAndCheckNetwork(true);
+}
+
+/**
+ * @brief column_top_k_thresholds The weight of the k-th strongest link of each node, or minus
+ * infinity if a node has at most k links above the threshold.
+ * @param W The column-major symmetric n x n matrix
+ */
+std::vector<double> column_top_k_thresholds(const double *W, int n, int k, double threshold)
+{
+    std::vector<double> top_k(n, -std::numeric_limits<double>::infinity());
+#pragma omp parallel
+    {
+        std::vector<double> column;
+        column.reserve(n);
+#pragma omp for schedule(dynamic, 16)
+        for (int j=0; j<n; ++j)
+        {
+            column.clear();
+            const double *w = W + static_cast<size_t>(j)*n;
+            for (int i=0; i<n; ++i)
+                if (i != j && w[i] > threshold)
+                    column.push_back(w[i]);
+            if (static_cast<int>(column.size()) > k)
+            {
+                std::nth_element(column.begin(), column.begin() + (k-1), column.end(), std::greater<double>());
+                top_k[j] = column[k-1];
+            }
+        }
+    }
+    return top_k;
+}
+
+/**
+ * @brief density_threshold The smallest weight to keep to get the given fraction of all node pairs,
+ * selected on the bit pattern of the weights in two passes with 16 bits each, without sorting or storing them.
+ * @param W The column-major symmetric n x n matrix, of which the lower triangle is read
+ */
+double density_threshold(const double *W, int n, double density, double threshold)
+{
+    const int num_buckets = 1 << 16;
+    double num_pairs = 0.5*n*(n-1.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(density*num_pairs));
+    uint64_t prefix = 0; // The selected high bits of the threshold
+    uint64_t num_above = 0; // Links with weight above the selected prefix
+
+    for (int level=0; level<2; ++level)
+    {
+        int shift = 48 - 16*level;
+        std::vector<uint64_t> histogram(num_buckets, 0);
+#pragma omp parallel
+        {
+            std::vector<uint64_t> local(num_buckets, 0);
+#pragma omp for schedule(dynamic, 16)
+            for (int j=0; j<n; ++j)
+            {
+                const double *w = W + static_cast<size_t>(j)*n;
+                for (int i=j+1; i<n; ++i)
+                {
+                    // Positive doubles order as their bit patterns
+                    if (w[i] <= threshold || w[i] <= 0)
+                        continue;
+                    uint64_t bits;
+                    std::memcpy(&bits, &w[i], sizeof(bits));
+                    if (level == 0 || (bits >> 48) == prefix)
+                        ++local[(bits >> shift) & (num_buckets-1)];
+                }
+            }
+#pragma omp critical (densityHistogram)
+            for (int b=0; b<num_buckets; ++b)
+                histogram[b] += local[b];
+        }
+
+        int bucket = num_buckets-1;
+        for (; bucket > 0 && num_above + histogram[bucket] < target; --bucket)
+            num_above += histogram[bucket];
+        if (level == 0 && bucket == 0 && num_above + histogram[0] < target)
+            return threshold; // Not enough links to cut
+        prefix = (prefix << 16) | bucket;
+    }
+
+    uint64_t bits = prefix << 32;
+    double cut;
+    std::memcpy(&cut, &bits, sizeof(cut));
+    return cut;
+}
+
+/**
+ * @brief dense_to_infomap_network Convert a dense symmetric matrix in place to the network links in one pass,
+ * reading the lower triangle column by column in parallel and sparsifying it on the fly.
+ * @param network
+ * @param W The column-major symmetric n x n matrix
+ * @param n
+ * @param pars The sparsification filters
+ */
+void dense_to_infomap_network(infomap::Network &network, const double *W, int n, const InfomapParams &pars)
+{
+    for (int i=0; i<n; ++i)
+    {
+        if (W[static_cast<size_t>(i)*n + i] != 0)
+            throw std::logic_error("Adjacency matrix has self-loops, only simple graphs allowed");
+    }
+
+    std::vector<double> top_k;
+    if (pars.topk > 0)
+        top_k = column_top_k_thresholds(W, n, pars.topk, pars.threshold);
+    double min_weight = pars.density > 0 ? density_threshold(W, n, pars.density, pars.threshold) : -std::numeric_limits<double>::infinity();
+
+    // Each block of columns collects its links, with the column j as source and the rows i > j as targets
+    const int block_size = 256;
+    int num_blocks = (n + block_size - 1) / block_size;
+    std::vector<std::vector<unsigned int> > block_targets(num_blocks);
+    std::vector<std::vector<double> > block_weights(num_blocks);
+    std::vector<infomap::link_index> offsets(n + 1, 0);
+    std::vector<char> block_negative(num_blocks, 0);
+    std::vector<char> block_weighted(num_blocks, 0);
+    std::vector<double> block_first_weight(num_blocks, 0.0);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int b=0; b<num_blocks; ++b)
+    {
+        std::vector<unsigned int>& targets = block_targets[b];
+        std::vector<double>& weights = block_weights[b];
+        int end = std::min(n, (b+1)*block_size);
+        for (int j=b*block_size; j<end; ++j)
+        {
+            const double *w = W + static_cast<size_t>(j)*n;
+            for (int i=j+1; i<n; ++i)
+            {
+                // Check before the filters, to reject negative weights as the sparse input does
+                if (w[i] < 0)
+                    block_negative[b] = 1;
+                if (w[i] <= pars.threshold || w[i] == 0 || w[i] < min_weight)
+                    continue;
+                if (!top_k.empty() && w[i] < top_k[i] && w[i] < top_k[j])
+                    continue;
+                if (weights.empty())
+                    block_first_weight[b] = w[i];
+                else if (w[i] != block_first_weight[b])
+                    block_weighted[b] = 1;
+                targets.push_back(static_cast<unsigned int>(i));
+                weights.push_back(w[i]);
+            }
+            offsets[j+1] = static_cast<infomap::link_index>(targets.size());
+        }
+    }
+
+    // Merge the blocks, keeping the weights only if they are not all equal
+    bool is_weighted = false;
+    double first_weight = 0.0;
+    bool has_weight = false;
+    std::vector<size_t> block_begin(num_blocks + 1, 0);
+    for (int b=0; b<num_blocks; ++b)
+    {
+        if (block_negative[b])
+            throw std::logic_error("Negative edge weight found. Only positive weights supported.");
+        if (!block_weights[b].empty())
+        {
+            is_weighted = is_weighted || block_weighted[b] || (has_weight && block_first_weight[b] != first_weight);
+            if (!has_weight)
+                first_weight = block_first_weight[b];
+            has_weight = true;
+        }
+        int end = std::min(n, (b+1)*block_size);
+        for (int j=b*block_size; j<end; ++j)
+            offsets[j+1] += block_begin[b];
+        block_begin[b+1] = block_begin[b] + block_targets[b].size();
+    }
+
+    std::vector<unsigned int> targets(block_begin[num_blocks]);
+    std::vector<double> weights(is_weighted ? targets.size() : 0);
+#pragma omp parallel for schedule(static)
+    for (int b=0; b<num_blocks; ++b)
+    {
+        std::copy(block_targets[b].begin(), block_targets[b].end(), targets.begin() + block_begin[b]);
+        if (is_weighted)
+            std::copy(block_weights[b].begin(), block_weights[b].end(), weights.begin() + block_begin[b]);
+        std::vector<unsigned int>().swap(block_targets[b]);
+        std::vector<double>().swap(block_weights[b]);
+    }
+
+    network.setLinks(n, offsets, targets, weights);
+    network.finalizeAndCheckNetwork(true, n);
+}
+
 //void printClusters(infomap::HierarchicalNetwork& tree)
 //{
 //    std::cout << "\nClusters:\n#originalIndex clusterIndex:\n";
@@ -270,97 +597,44 @@ void mexFunction(int nOutputArgs, mxArray *outputArgs[], int nInputArgs, const m
 
     // In this case we are feeding instead of the adjacency matrix, the result of [i j w]=find(A);
     bool feedingSparseMatrix=false;
-    if (M>3 && N==3)
+    if (M>3 && N==3 && !mxIsSparse(inputArgs[0]))
     {
         feedingSparseMatrix=true;
     }
 
-    // Create the Graph helper object specifying edge weights too
-    GraphC *G=NULL;
     try
     {
-        if (feedingSparseMatrix)
+        pars.options += std::string("--two-level");
+        infomap::Config config = infomap::init(pars.options);
+        infomap::Network network(config);
+        if (mxIsSparse(inputArgs[0]))
         {
-            // Map the Mx3 array memory to an Eigen container, to facilitate handling
-            Eigen::MatrixXd IJW = Eigen::Map<Eigen::MatrixXd>(W,M,N);
-            Eigen::Matrix<int,Eigen::Dynamic,Eigen::Dynamic> B1,B2;
-            B1 = (IJW.col(0).array() >= IJW.col(1).array()).cast<int>();
-            B2 = (IJW.col(0).array() < IJW.col(1).array()).cast<int>();
-
-            bool isUpperTriangular=false;
-            bool isLowerTriangular=false;
-            bool isSymmetric=false;
-            int sum1 = B1.sum();
-            int sum2 = B2.sum();
-            // Condizione semplice da verificare facendo [i j w]=find(A), oppure [i j w]=find(triu(A)) oppure [i j w]=find(tril(A))
-            if (sum1 == sum2)
-                isSymmetric=true;
-            if (sum1==0 && sum2==M)
-                isUpperTriangular=true;
-            if (sum1==M && sum2==0)
-                isLowerTriangular=true;
-
-            //printf("sum1=%d sum2=%d Is Symmetric=%d Is isUpperTriangular=%d isLowerTriangular=%d\n",sum1,sum2,isSymmetric,isUpperTriangular,isLowerTriangular);
-            
-            if (!isSymmetric && !isUpperTriangular && !isLowerTriangular)
-            {
-                throw std::logic_error("Matrix is not symmetric, nor triangular lower or upper triangular. Check diagonal and non symmetric values.");
-            }
-
-            std::vector<double> edges_list;
-            std::vector<double> edges_weights;
-
-            for (int l=0; l<M; ++l)
-            {
-                double row_node = IJW(l,0); //indice riga della find
-                double column_node = IJW(l,1); //indice colonna della find
-                double w = IJW(l,2);
-
-                if ( isUpperTriangular || isLowerTriangular) // keeps only symmetric and also avoid self-loops (implicitly inserting upper triangular)
-                {
-                    edges_list.push_back(column_node-1);
-                    edges_list.push_back(row_node-1);
-                    edges_weights.push_back(w);
-                }
-                else if (isSymmetric)
-                {
-                    if (row_node<column_node)
-                    {
-                        edges_list.push_back(column_node-1);
-                        edges_list.push_back(row_node-1);
-                        edges_weights.push_back(w);
-                    }
-                }
-            }
-            
-            G = new GraphC(edges_list.data(),edges_weights.data(),edges_weights.size());
+            sparse_to_infomap_network(network, inputArgs[0]);
+        }
+        else if (feedingSparseMatrix)
+        {
+            edges_list_to_infomap_network(network, W, M);
         }
         else
         {
-            G  = new GraphC(mxGetPr(inputArgs[0]),N,N);
+            dense_to_infomap_network(network, W, N, pars);
         }
+        unsigned int num_nodes = network.numNodes();
 
-        // adapt it to an infomap matrix
-        pars.options += std::string("--two-level");
-        infomap::Config config = infomap::init(pars.options);
-        infomap::Network network(config);
-        infomap::igraphToInfomapNetwork(network, G->get_igraph(),G->get_edge_weights());
         infomap::HierarchicalNetwork resultNetwork(config);
         infomap::run(network, resultNetwork);
         // Prepare output
-        outputArgs[0] = mxCreateDoubleMatrix(1,(mwSize)G->number_of_nodes(), mxREAL);
-        std::vector<double> membership(G->number_of_nodes());
+        outputArgs[0] = mxCreateDoubleMatrix(1,(mwSize)num_nodes, mxREAL);
+        std::vector<double> membership(num_nodes);
         for (infomap::LeafIterator leafIt(&resultNetwork.getRootNode()); !leafIt.isEnd(); ++leafIt)
         {
             membership.at(leafIt->originalLeafIndex) = double(leafIt->parentNode->parentIndex);
         }
         // Copy the membership of nodes to outputArgs[0]
-        memcpy(mxGetPr(outputArgs[0]), membership.data(), sizeof(double)*G->number_of_nodes());
+        memcpy(mxGetPr(outputArgs[0]), membership.data(), sizeof(double)*num_nodes);
 
         // // Copy the value of codelength
         outputArgs[1] = mxCreateDoubleScalar(resultNetwork.codelength());
-        // Cleanup the memory (follow this order)
-        delete G;
     }
     catch (std::exception &e)
     {